@@ -0,0 +1,116 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "blockreader.h"
+#include "chainparams.h"
+#include "clientversion.h"
+#include "main.h"
+#include "random.h"
+#include "util.h"
+
+#include <boost/filesystem.hpp>
+
+// Blocks a peer doing IBD asks for, one after another
+static const int BLOCKREADER_BENCH_BLOCKS = 100;
+// Transactions per block, about 230 kB per block
+static const int BLOCKREADER_BENCH_TXS = 1000;
+
+// Block files in a temporary data directory for the length of a benchmark
+class CBenchBlockFiles
+{
+public:
+    boost::filesystem::path pathTemp;
+    std::vector<CBlockIndex*> vIndex;
+    std::vector<uint256> vHashes;
+
+    CBenchBlockFiles()
+    {
+        SelectParams(CBaseChainParams::REGTEST);
+        ClearDatadirCache();
+        pathTemp = GetTempPath() / strprintf("bench_3dcoin_%lu_%i", (unsigned long)GetTime(), (int)(GetRand(100000)));
+        mapArgs["-datadir"] = pathTemp.string();
+        boost::filesystem::create_directories(GetDataDir() / "blocks");
+
+        vHashes.resize(BLOCKREADER_BENCH_BLOCKS);
+        CDiskBlockPos pos(0, 0);
+        for (int i = 0; i < BLOCKREADER_BENCH_BLOCKS; i++) {
+            CBlock block;
+            block.nTime = i;
+            for (int j = 0; j < BLOCKREADER_BENCH_TXS; j++) {
+                CMutableTransaction tx;
+                tx.vin.resize(1);
+                tx.vin[0].prevout = COutPoint(GetRandHash(), 0);
+                tx.vin[0].scriptSig = CScript() << std::vector<unsigned char>(72, 1) << std::vector<unsigned char>(33, 2);
+                tx.vout.resize(2);
+                tx.vout[0].scriptPubKey = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 3) << OP_EQUALVERIFY << OP_CHECKSIG;
+                tx.vout[1].scriptPubKey = tx.vout[0].scriptPubKey;
+                block.vtx.push_back(tx);
+            }
+            assert(WriteBlockToDisk(block, pos, Params().MessageStart()));
+            vHashes[i] = block.GetHash();
+            CBlockIndex* pindex = new CBlockIndex(block);
+            pindex->phashBlock = &vHashes[i];
+            pindex->nFile = pos.nFile;
+            pindex->nDataPos = pos.nPos;
+            pindex->nStatus |= BLOCK_HAVE_DATA;
+            vIndex.push_back(pindex);
+            pos.nPos += ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION) + 8;
+        }
+    }
+
+    ~CBenchBlockFiles()
+    {
+        blockreader.CloseFile(0);
+        for (size_t i = 0; i < vIndex.size(); i++)
+            delete vIndex[i];
+        boost::filesystem::remove_all(pathTemp);
+        mapArgs.erase("-datadir");
+        ClearDatadirCache();
+    }
+};
+
+// How getdata requests for blocks were served: open the file, decode the
+// block, hash it to check it and encode it again
+static void BlockServeDecode(benchmark::State& state)
+{
+    CBenchBlockFiles files;
+    size_t n = 0;
+    while (state.KeepRunning()) {
+        const CBlockIndex* pindex = files.vIndex[n++ % files.vIndex.size()];
+        CBlock block;
+        CAutoFile filein(OpenBlockFile(pindex->GetBlockPos(), true), SER_DISK, CLIENT_VERSION);
+        filein >> block;
+        assert(block.GetHash() == pindex->GetBlockHash());
+        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+        ssBlock << block;
+    }
+}
+
+// Copying the block out of the mapped file as it is stored
+static void BlockServeRaw(benchmark::State& state)
+{
+    CBenchBlockFiles files;
+    size_t n = 0;
+    while (state.KeepRunning()) {
+        const CBlockIndex* pindex = files.vIndex[n++ % files.vIndex.size()];
+        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+        assert(blockreader.ReadRawBlock(ssBlock, pindex->GetBlockPos(), Params().MessageStart()));
+    }
+}
+
+// Callers which need the block decoded, all asking for the same recent ones
+static void BlockReadCached(benchmark::State& state)
+{
+    CBenchBlockFiles files;
+    size_t n = 0;
+    while (state.KeepRunning()) {
+        const CBlockIndex* pindex = files.vIndex[n++ % 10];
+        assert(blockreader.ReadBlock(pindex, Params().MessageStart()));
+    }
+}
+
+BENCHMARK(BlockServeDecode);
+BENCHMARK(BlockServeRaw);
+BENCHMARK(BlockReadCached);
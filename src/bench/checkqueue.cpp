@@ -0,0 +1,74 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "checkqueue.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+// About the number of inputs of a full block
+static const int CHECKQUEUE_BENCH_CHECKS = 2000;
+// Inputs per transaction, each transaction adds its checks at once
+static const int CHECKQUEUE_BENCH_TX_INPUTS = 2;
+
+// Stands in for a signature check, a few microseconds of work
+struct CFakeCheck
+{
+    uint64_t nSeed;
+
+    CFakeCheck() : nSeed(0) {}
+    CFakeCheck(uint64_t nSeedIn) : nSeed(nSeedIn) {}
+
+    bool operator()()
+    {
+        uint64_t n = nSeed;
+        for (int i = 0; i < 5000; i++)
+            n = n * 6364136223846793005ULL + 1442695040888963407ULL;
+        return n != 0 || nSeed != 0;
+    }
+
+    void swap(CFakeCheck& check)
+    {
+        std::swap(nSeed, check.nSeed);
+    }
+};
+
+// Checking one block after another with -par=nThreads
+static void CheckQueueBlocks(benchmark::State& state, int nThreads)
+{
+    CCheckQueue<CFakeCheck> queue(128);
+    boost::thread_group threadGroup;
+    for (int i = 0; i < nThreads - 1; i++)
+        threadGroup.create_thread(boost::bind(&CCheckQueue<CFakeCheck>::Thread, &queue));
+
+    uint64_t nSeed = 1;
+    while (state.KeepRunning()) {
+        CCheckQueueControl<CFakeCheck> control(&queue);
+        for (int i = 0; i < CHECKQUEUE_BENCH_CHECKS; i += CHECKQUEUE_BENCH_TX_INPUTS) {
+            std::vector<CFakeCheck> vChecks;
+            for (int j = 0; j < CHECKQUEUE_BENCH_TX_INPUTS; j++)
+                vChecks.push_back(CFakeCheck(nSeed++));
+            control.Add(vChecks);
+        }
+        assert(control.Wait());
+    }
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
+static void CheckQueue1Thread(benchmark::State& state) { CheckQueueBlocks(state, 1); }
+static void CheckQueue2Threads(benchmark::State& state) { CheckQueueBlocks(state, 2); }
+static void CheckQueue4Threads(benchmark::State& state) { CheckQueueBlocks(state, 4); }
+static void CheckQueue8Threads(benchmark::State& state) { CheckQueueBlocks(state, 8); }
+static void CheckQueue16Threads(benchmark::State& state) { CheckQueueBlocks(state, 16); }
+static void CheckQueue32Threads(benchmark::State& state) { CheckQueueBlocks(state, 32); }
+
+BENCHMARK(CheckQueue1Thread);
+BENCHMARK(CheckQueue2Threads);
+BENCHMARK(CheckQueue4Threads);
+BENCHMARK(CheckQueue8Threads);
+BENCHMARK(CheckQueue16Threads);
+BENCHMARK(CheckQueue32Threads);
@@ -0,0 +1,82 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "chainparams.h"
+#include "crypto/common.h"
+#include "governance-classes.h"
+#include "main.h"
+#include "utilmoneystr.h"
+#include "utilstrencodings.h"
+
+static const int SUPERBLOCK_BENCH_PAYEES = 250;
+static const CAmount SUPERBLOCK_BENCH_AMOUNT = 1000;
+
+// Superblock height on regtest, see nSuperblockStartBlock/nSuperblockCycle
+static int SuperblockHeight()
+{
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    int nHeight = std::max(consensusParams.nSuperblockStartBlock, 2510);
+    return nHeight - nHeight % consensusParams.nSuperblockCycle;
+}
+
+static std::string CreateTriggerData(int nBlockHeight, std::vector<CScript>& vecScriptsRet)
+{
+    std::string strAddresses;
+    std::string strAmounts;
+    for(int i = 0; i < SUPERBLOCK_BENCH_PAYEES; i++) {
+        CKeyID keyID;
+        WriteLE32(keyID.begin(), i + 1);
+        CBitcoinAddress address(keyID);
+        vecScriptsRet.push_back(GetScriptForDestination(keyID));
+        strAddresses += (i ? "|" : "") + address.ToString();
+        strAmounts += (i ? "|" : "") + FormatMoney(SUPERBLOCK_BENCH_AMOUNT);
+    }
+
+    std::string strJSON = strprintf("[[\"trigger\",{\"event_block_height\":%d,\"payment_addresses\":\"%s\","
+                                    "\"payment_amounts\":\"%s\",\"type\":%d}]]",
+                                    nBlockHeight, strAddresses, strAmounts, GOVERNANCE_OBJECT_TRIGGER);
+    return HexStr(strJSON.begin(), strJSON.end());
+}
+
+// Decode the trigger payload and build the payment schedule, done once per object
+static void SuperblockParse(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    std::vector<CScript> vecScripts;
+    std::string strData = CreateTriggerData(SuperblockHeight(), vecScripts);
+
+    while (state.KeepRunning()) {
+        CGovernanceObject govobj(uint256(), 1, 0, uint256(), strData);
+        CSuperblock superblock(govobj);
+        assert(superblock.CountPayments() == SUPERBLOCK_BENCH_PAYEES);
+    }
+}
+
+// Check a coinbase against the schedule, done for every block at a superblock height
+static void SuperblockIsValid(benchmark::State& state)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+    int nBlockHeight = SuperblockHeight();
+    std::vector<CScript> vecScripts;
+    CGovernanceObject govobj(uint256(), 1, 0, uint256(), CreateTriggerData(nBlockHeight, vecScripts));
+    CSuperblock superblock(govobj);
+
+    CAmount blockReward = GetBlockSubsidy(nBlockHeight - 1, Params().GetConsensus());
+    CMutableTransaction txNew;
+    txNew.vin.resize(1);
+    txNew.vout.push_back(CTxOut(blockReward, CScript() << OP_TRUE));
+    for(size_t i = 0; i < vecScripts.size(); i++) {
+        txNew.vout.push_back(CTxOut(SUPERBLOCK_BENCH_AMOUNT, vecScripts[i]));
+    }
+    CTransaction tx(txNew);
+
+    while (state.KeepRunning()) {
+        bool fValid = superblock.IsValid(tx, nBlockHeight, blockReward);
+        assert(fValid);
+    }
+}
+
+BENCHMARK(SuperblockParse);
+BENCHMARK(SuperblockIsValid);
@@ -0,0 +1,113 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "hash.h"
+#include "main.h"
+#include "instantx.h"
+#include "masternode/man.h"
+
+static const int INSTANTSEND_BENCH_MASTERNODES = 2000;
+static const int INSTANTSEND_BENCH_LOCK_REQUESTS = 1000;
+static const int INSTANTSEND_BENCH_INPUTS = 2;
+// distinct reference heights the inputs of all lock requests come from
+static const int INSTANTSEND_BENCH_HEIGHTS = 50;
+static const int INSTANTSEND_BENCH_ORPHAN_VOTES = 10000;
+
+static std::vector<CTxIn> SetupMasternodes()
+{
+    std::vector<CTxIn> vecVins;
+    mnodeman.Clear();
+    for(int i = 0; i < INSTANTSEND_BENCH_MASTERNODES; i++) {
+        CTxIn vin(COutPoint(Hash(BEGIN(i), END(i)), 0));
+        CMasternode mn(CService(strprintf("1.%d.%d.1", i / 256, i % 256), 9999), vin, CPubKey(), CPubKey(), MIN_INSTANTSEND_PROTO_VERSION);
+        mnodeman.Add(mn);
+        vecVins.push_back(vin);
+    }
+    return vecVins;
+}
+
+static uint256 BlockHash(int nRound, int nHeight)
+{
+    return Hash(BEGIN(nRound), END(nRound), BEGIN(nHeight), END(nHeight));
+}
+
+// Quorum checks for all votes of INSTANTSEND_BENCH_LOCK_REQUESTS lock requests,
+// every input gets a vote from each of SIGNATURES_TOTAL masternodes
+static void InstantSendQuorumVotes(benchmark::State& state)
+{
+    std::vector<CTxIn> vecVins = SetupMasternodes();
+    int nRound = 0;
+
+    while (state.KeepRunning()) {
+        // new block hashes every round so quorums are computed again
+        ++nRound;
+        for(int i = 0; i < INSTANTSEND_BENCH_LOCK_REQUESTS; i++) {
+            for(int j = 0; j < INSTANTSEND_BENCH_INPUTS; j++) {
+                uint256 blockHash = BlockHash(nRound, (i * INSTANTSEND_BENCH_INPUTS + j) % INSTANTSEND_BENCH_HEIGHTS);
+                for(int k = 0; k < COutPointLock::SIGNATURES_TOTAL; k++) {
+                    const CTxIn& vin = vecVins[(i * 31 + j * 7 + k) % vecVins.size()];
+                    mnodeman.GetMasternodeQuorumRank(vin, blockHash, COutPointLock::SIGNATURES_TOTAL, MIN_INSTANTSEND_PROTO_VERSION);
+                }
+            }
+        }
+    }
+
+    mnodeman.Clear();
+}
+
+// A single quorum check against a block we have not seen yet, i.e. a full rescoring of the list
+static void InstantSendQuorumRankUncached(benchmark::State& state)
+{
+    std::vector<CTxIn> vecVins = SetupMasternodes();
+    int nHeight = 0;
+
+    while (state.KeepRunning()) {
+        mnodeman.GetMasternodeQuorumRank(vecVins[nHeight % vecVins.size()], BlockHash(0, nHeight), COutPointLock::SIGNATURES_TOTAL, MIN_INSTANTSEND_PROTO_VERSION);
+        ++nHeight;
+    }
+
+    mnodeman.Clear();
+}
+
+// A flood of INSTANTSEND_BENCH_ORPHAN_VOTES orphan votes for INSTANTSEND_BENCH_LOCK_REQUESTS
+// unknown txes: store them, look up the votes of every tx once its lock request
+// arrives and finally expire whatever is left
+static void InstantSendOrphanVoteFlood(benchmark::State& state)
+{
+    std::vector<CTxLockVote> vecVotes;
+    vecVotes.reserve(INSTANTSEND_BENCH_ORPHAN_VOTES);
+    std::vector<uint256> vecTxHashes;
+    for(int i = 0; i < INSTANTSEND_BENCH_LOCK_REQUESTS; i++) {
+        vecTxHashes.push_back(Hash(BEGIN(i), END(i)));
+    }
+    for(int i = 0; i < INSTANTSEND_BENCH_ORPHAN_VOTES; i++) {
+        int nTx = i % INSTANTSEND_BENCH_LOCK_REQUESTS;
+        int nInput = (i / INSTANTSEND_BENCH_LOCK_REQUESTS) % INSTANTSEND_BENCH_INPUTS;
+        COutPoint outpointMasternode(Hash(BEGIN(i), END(i), BEGIN(nTx), END(nTx)), 0);
+        vecVotes.push_back(CTxLockVote(vecTxHashes[nTx], COutPoint(vecTxHashes[nTx], nInput), outpointMasternode));
+    }
+
+    while (state.KeepRunning()) {
+        CTxLockVoteOrphans orphans;
+        for(size_t i = 0; i < vecVotes.size(); i++) {
+            orphans.Add(vecVotes[i], i);
+        }
+        // lock requests for half of the txes show up
+        for(size_t i = 0; i < vecTxHashes.size(); i += 2) {
+            std::map<COutPoint, int> mapCounts = orphans.CountVotes(vecTxHashes[i]);
+            assert(mapCounts.size() == INSTANTSEND_BENCH_INPUTS);
+            std::vector<CTxLockVote> vecTxVotes = orphans.GetVotes(vecTxHashes[i]);
+            for(size_t j = 0; j < vecTxVotes.size(); j++) {
+                orphans.Remove(vecTxVotes[j].GetHash());
+            }
+        }
+        orphans.RemoveExpired(INSTANTSEND_BENCH_ORPHAN_VOTES);
+        assert(orphans.size() == 0);
+    }
+}
+
+BENCHMARK(InstantSendQuorumVotes);
+BENCHMARK(InstantSendQuorumRankUncached);
+BENCHMARK(InstantSendOrphanVoteFlood);
@@ -0,0 +1,68 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "chainparams.h"
+#include "random.h"
+#include "wallet/wallet.h"
+
+// Keys generated per run, i.e. keys/s = KEYPOOL_BENCH_KEYS / time per run
+static const int KEYPOOL_BENCH_KEYS = 1000;
+
+static void SetupHDWallet(CWallet& wallet)
+{
+    SelectParams(CBaseChainParams::REGTEST);
+
+    std::vector<unsigned char> vchSeed(64);
+    GetRandBytes(&vchSeed[0], vchSeed.size());
+    CHDChain hdChain;
+    hdChain.SetSeed(SecureVector(vchSeed.begin(), vchSeed.end()), true);
+
+    LOCK(wallet.cs_wallet);
+    wallet.SetHDChain(hdChain, true);
+}
+
+static void RefillKeyPool(CWallet& wallet, benchmark::State& state)
+{
+    while (state.KeepRunning()) {
+        LOCK(wallet.cs_wallet);
+        wallet.setExternalKeyPool.clear();
+        wallet.setInternalKeyPool.clear();
+        wallet.TopUpKeyPool(KEYPOOL_BENCH_KEYS);
+    }
+}
+
+// Refill of an empty HD keypool, KEYPOOL_BENCH_KEYS external and as many internal keys
+static void KeyPoolRefillHD(benchmark::State& state)
+{
+    CWallet wallet;
+    SetupHDWallet(wallet);
+    RefillKeyPool(wallet, state);
+}
+
+// The same number of HD keys derived one by one, as for a single new address
+static void KeyPoolDeriveHDOneByOne(benchmark::State& state)
+{
+    CWallet wallet;
+    SetupHDWallet(wallet);
+
+    while (state.KeepRunning()) {
+        LOCK(wallet.cs_wallet);
+        for (int i = 0; i < KEYPOOL_BENCH_KEYS; i++) {
+            wallet.GenerateNewKey(0, false);
+            wallet.GenerateNewKey(0, true);
+        }
+    }
+}
+
+// Refill of an empty keypool of a non-HD wallet, KEYPOOL_BENCH_KEYS random keys
+static void KeyPoolRefillLegacy(benchmark::State& state)
+{
+    CWallet wallet;
+    RefillKeyPool(wallet, state);
+}
+
+BENCHMARK(KeyPoolRefillHD);
+BENCHMARK(KeyPoolDeriveHDOneByOne);
+BENCHMARK(KeyPoolRefillLegacy);
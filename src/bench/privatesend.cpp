@@ -0,0 +1,92 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "darksend.h"
+#include "hash.h"
+#include "wallet/wallet.h"
+
+// PRIVATESEND_BENCH_LEVELS mixing rounds of PRIVATESEND_BENCH_TXES txes with
+// PRIVATESEND_BENCH_OUTPUTS denominated outputs each, i.e. 100k outputs in total
+static const int PRIVATESEND_BENCH_LEVELS = 10;
+static const int PRIVATESEND_BENCH_TXES = 1000;
+static const int PRIVATESEND_BENCH_OUTPUTS = 10;
+
+// Every tx of a level spends one output of PRIVATESEND_BENCH_OUTPUTS txes of the previous level,
+// so outputs of level N have N rounds
+static std::vector<CTxIn> SetupMixingWallet(CWallet& wallet)
+{
+    darkSendPool.InitDenominations();
+
+    CKey key;
+    key.MakeNewKey(true);
+    wallet.AddKeyPubKey(key, key.GetPubKey());
+    CScript scriptPubKey = GetScriptForDestination(key.GetPubKey().GetID());
+
+    LOCK(wallet.cs_wallet);
+    std::vector<uint256> vecPrevHashes;
+    std::vector<CTxIn> vecTxIns;
+    for(int nLevel = 0; nLevel < PRIVATESEND_BENCH_LEVELS; nLevel++) {
+        std::vector<uint256> vecHashes;
+        for(int i = 0; i < PRIVATESEND_BENCH_TXES; i++) {
+            CMutableTransaction tx;
+            if(nLevel == 0) {
+                // funded from outside of the wallet
+                tx.vin.push_back(CTxIn(COutPoint(Hash(BEGIN(i), END(i)), 0)));
+            } else {
+                for(int j = 0; j < PRIVATESEND_BENCH_OUTPUTS; j++) {
+                    tx.vin.push_back(CTxIn(COutPoint(vecPrevHashes[(i + j) % PRIVATESEND_BENCH_TXES], j)));
+                }
+            }
+            for(int j = 0; j < PRIVATESEND_BENCH_OUTPUTS; j++) {
+                tx.vout.push_back(CTxOut(vecPrivateSendDenominations[1], scriptPubKey));
+            }
+            CWalletTx wtx(&wallet, tx);
+            wallet.AddToWallet(wtx, true, NULL);
+            vecHashes.push_back(wtx.GetHash());
+            for(int j = 0; j < PRIVATESEND_BENCH_OUTPUTS; j++) {
+                vecTxIns.push_back(CTxIn(COutPoint(wtx.GetHash(), j)));
+            }
+        }
+        vecPrevHashes.swap(vecHashes);
+    }
+    return vecTxIns;
+}
+
+// Rounds of all outputs of a mixing wallet right after it was loaded without a rounds cache
+static void PrivateSendRoundsUncached(benchmark::State& state)
+{
+    CWallet wallet;
+    std::vector<CTxIn> vecTxIns = SetupMixingWallet(wallet);
+
+    while (state.KeepRunning()) {
+        LOCK(wallet.cs_wallet);
+        wallet.ClearPrivateSendRoundsCache();
+        for(size_t i = 0; i < vecTxIns.size(); i++) {
+            wallet.GetRealInputPrivateSendRounds(vecTxIns[i], 0);
+        }
+        assert(wallet.GetRealInputPrivateSendRounds(vecTxIns.back(), 0) == PRIVATESEND_BENCH_LEVELS - 1);
+    }
+}
+
+// Rounds of all outputs of a mixing wallet once they are cached (or loaded from the wallet file)
+static void PrivateSendRoundsCached(benchmark::State& state)
+{
+    CWallet wallet;
+    std::vector<CTxIn> vecTxIns = SetupMixingWallet(wallet);
+
+    LOCK(wallet.cs_wallet);
+    for(size_t i = 0; i < vecTxIns.size(); i++) {
+        wallet.GetRealInputPrivateSendRounds(vecTxIns[i], 0);
+    }
+
+    while (state.KeepRunning()) {
+        for(size_t i = 0; i < vecTxIns.size(); i++) {
+            wallet.GetRealInputPrivateSendRounds(vecTxIns[i], 0);
+        }
+    }
+}
+
+BENCHMARK(PrivateSendRoundsUncached);
+BENCHMARK(PrivateSendRoundsCached);
@@ -0,0 +1,57 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "cuckoocache.h"
+#include "random.h"
+#include "util.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+// Lookups per thread and run, half of them hits
+static const int SIGCACHE_BENCH_LOOKUPS = 100000;
+// Same size as the default -maxsigcachesize
+static const size_t SIGCACHE_BENCH_BYTES = 40 << 20;
+
+static void LookupEntries(const CCuckooCache* pcache, const std::vector<uint256>* pvEntries, size_t nOffset, bool fErase)
+{
+    for (int i = 0; i < SIGCACHE_BENCH_LOOKUPS; i++)
+        pcache->Contains((*pvEntries)[(nOffset + i) % pvEntries->size()], fErase);
+}
+
+// Script check threads looking up the signatures of a block at once, while
+// another thread keeps inserting as the mempool does
+static void SigCacheLookups(benchmark::State& state, int nThreads, bool fErase)
+{
+    CCuckooCache cache(SIGCACHE_BENCH_BYTES);
+    std::vector<uint256> vEntries;
+    for (size_t i = 0; i < cache.GetCapacity() / 2; i++) {
+        vEntries.push_back(GetRandHash());
+        if (i % 2 == 0)
+            cache.Insert(vEntries.back());
+    }
+    std::vector<uint256> vInserts;
+    for (int i = 0; i < SIGCACHE_BENCH_LOOKUPS / 10; i++)
+        vInserts.push_back(GetRandHash());
+
+    while (state.KeepRunning()) {
+        boost::thread_group threadGroup;
+        for (int i = 0; i < nThreads; i++)
+            threadGroup.create_thread(boost::bind(&LookupEntries, &cache, &vEntries, i * SIGCACHE_BENCH_LOOKUPS, fErase));
+        for (size_t i = 0; i < vInserts.size(); i++)
+            cache.Insert(vInserts[i]);
+        threadGroup.join_all();
+    }
+}
+
+static void SigCacheLookups1Thread(benchmark::State& state) { SigCacheLookups(state, 1, false); }
+static void SigCacheLookups4Threads(benchmark::State& state) { SigCacheLookups(state, 4, false); }
+static void SigCacheLookups16Threads(benchmark::State& state) { SigCacheLookups(state, 16, false); }
+static void SigCacheLookupsErase4Threads(benchmark::State& state) { SigCacheLookups(state, 4, true); }
+
+BENCHMARK(SigCacheLookups1Thread);
+BENCHMARK(SigCacheLookups4Threads);
+BENCHMARK(SigCacheLookups16Threads);
+BENCHMARK(SigCacheLookupsErase4Threads);
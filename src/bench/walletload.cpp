@@ -0,0 +1,92 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "hash.h"
+#include "wallet/txloader.h"
+#include "wallet/wallet.h"
+
+// Every tx spends WALLET_LOAD_BENCH_INPUTS outputs of earlier txes and has
+// WALLET_LOAD_BENCH_OUTPUTS outputs, like a wallet which has done a lot of mixing
+static const int WALLET_LOAD_BENCH_INPUTS = 3;
+static const int WALLET_LOAD_BENCH_OUTPUTS = 3;
+
+// The "tx" records of a wallet with nTxes txes, sorted by key as the db cursor returns them
+static std::vector<std::pair<CDataStream, CDataStream> > MakeTxRecords(int nTxes)
+{
+    std::map<uint256, std::pair<CDataStream, CDataStream> > mapRecords;
+    std::vector<uint256> vecHashes;
+    for (int i = 0; i < nTxes; i++) {
+        CMutableTransaction tx;
+        for (int j = 0; j < WALLET_LOAD_BENCH_INPUTS; j++) {
+            uint256 hashPrev = vecHashes.empty() ? Hash(BEGIN(i), END(i)) : vecHashes[(i * 7 + j * 13) % vecHashes.size()];
+            tx.vin.push_back(CTxIn(COutPoint(hashPrev, j), CScript() << std::vector<unsigned char>(72, 1) << std::vector<unsigned char>(33, 2)));
+        }
+        for (int j = 0; j < WALLET_LOAD_BENCH_OUTPUTS; j++) {
+            tx.vout.push_back(CTxOut(COIN + j, CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, j) << OP_EQUALVERIFY << OP_CHECKSIG));
+        }
+        CWalletTx wtx(NULL, tx);
+        wtx.nOrderPos = i;
+        wtx.nTimeReceived = i;
+        vecHashes.push_back(wtx.GetHash());
+
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        ssKey << std::make_pair(std::string("tx"), wtx.GetHash());
+        ssValue << wtx;
+        mapRecords.insert(std::make_pair(wtx.GetHash(), std::make_pair(ssKey, ssValue)));
+    }
+
+    std::vector<std::pair<CDataStream, CDataStream> > vRecords;
+    for (std::map<uint256, std::pair<CDataStream, CDataStream> >::iterator it = mapRecords.begin(); it != mapRecords.end(); ++it)
+        vRecords.push_back(it->second);
+    return vRecords;
+}
+
+static void LoadTxRecords(const std::vector<std::pair<CDataStream, CDataStream> >& vRecords, int nThreads, benchmark::State& state)
+{
+    while (state.KeepRunning()) {
+        CWallet wallet;
+        CWalletTxLoader txLoader(nThreads);
+        for (size_t i = 0; i < vRecords.size(); i++)
+            txLoader.Add(vRecords[i].first, vRecords[i].second);
+
+        std::list<CWalletTx> lWtx;
+        std::vector<uint256> vUpgraded;
+        std::vector<std::string> vErrors;
+        unsigned int nFailed;
+        txLoader.Finish(lWtx, vUpgraded, vErrors, nFailed);
+        assert(nFailed == 0 && lWtx.size() == vRecords.size());
+
+        LOCK(wallet.cs_wallet);
+        wallet.LoadWalletTxes(lWtx);
+    }
+}
+
+// Time to load the txes of wallets of growing size, the rest of the records are cheap in comparison
+static void WalletLoad1kTxes(benchmark::State& state)
+{
+    LoadTxRecords(MakeTxRecords(1000), GetNumCores(), state);
+}
+
+static void WalletLoad10kTxes(benchmark::State& state)
+{
+    LoadTxRecords(MakeTxRecords(10000), GetNumCores(), state);
+}
+
+static void WalletLoad100kTxes(benchmark::State& state)
+{
+    LoadTxRecords(MakeTxRecords(100000), GetNumCores(), state);
+}
+
+// The same with a single loader thread, i.e. deserialization and checks are not spread out
+static void WalletLoad10kTxesOneThread(benchmark::State& state)
+{
+    LoadTxRecords(MakeTxRecords(10000), 1, state);
+}
+
+BENCHMARK(WalletLoad1kTxes);
+BENCHMARK(WalletLoad10kTxes);
+BENCHMARK(WalletLoad100kTxes);
+BENCHMARK(WalletLoad10kTxesOneThread);
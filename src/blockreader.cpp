@@ -0,0 +1,318 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockreader.h"
+
+#include "clientversion.h"
+#include "core_memusage.h"
+#include "crypto/common.h"
+#include "main.h"
+#include "util.h"
+
+#include <string.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+CBlockReader blockreader;
+
+/** Unmapped once the last block read from it is done */
+class CBlockReader::CMapping
+{
+public:
+    const unsigned char* pch;
+    uint64_t nSize;
+
+    CMapping(const unsigned char* pchIn, uint64_t nSizeIn) : pch(pchIn), nSize(nSizeIn) {}
+    ~CMapping()
+    {
+#ifndef WIN32
+        munmap((void*)pch, nSize);
+#endif
+    }
+};
+
+/** Deserializes from memory that stays in place, instead of copying it into a CDataStream first */
+class CMemoryReader
+{
+private:
+    const unsigned char* pch;
+    const unsigned char* pend;
+    int nType;
+    int nVersion;
+
+public:
+    CMemoryReader(const unsigned char* pchIn, size_t nSize, int nTypeIn, int nVersionIn) :
+        pch(pchIn), pend(pchIn + nSize), nType(nTypeIn), nVersion(nVersionIn) {}
+
+    int GetType() const { return nType; }
+    int GetVersion() const { return nVersion; }
+
+    void read(char* pchOut, size_t nSize)
+    {
+        if (nSize > (size_t)(pend - pch))
+            throw std::ios_base::failure("CMemoryReader::read(): end of data");
+        memcpy(pchOut, pch, nSize);
+        pch += nSize;
+    }
+
+    void ignore(size_t nSize)
+    {
+        if (nSize > (size_t)(pend - pch))
+            throw std::ios_base::failure("CMemoryReader::ignore(): end of data");
+        pch += nSize;
+    }
+
+    template<typename T>
+    CMemoryReader& operator>>(T& obj)
+    {
+        ::Unserialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
+CBlockReader::CBlockReader() :
+    nFileUses(0),
+    nMappedBytes(0),
+    nMaxMappedBytes(MAX_MAPPED_BLOCK_BYTES),
+    nCacheUsage(0),
+    nMaxCacheUsage(DEFAULT_BLOCK_CACHE_SIZE << 20),
+    nRawReads(0),
+    nCacheHits(0),
+    nCacheMisses(0)
+{
+}
+
+CBlockReader::~CBlockReader()
+{
+}
+
+void CBlockReader::UnmapOldest()
+{
+    std::map<int, std::pair<MappingPtr, uint64_t> >::iterator itOldest = mapFiles.begin();
+    for (std::map<int, std::pair<MappingPtr, uint64_t> >::iterator it = mapFiles.begin(); it != mapFiles.end(); it++)
+        if (it->second.second < itOldest->second.second)
+            itOldest = it;
+    // reads still using it keep it mapped until they finish
+    nMappedBytes -= itOldest->second.first->nSize;
+    mapFiles.erase(itOldest);
+}
+
+bool CBlockReader::GetMapping(int nFile, uint64_t nEnd, MappingPtr& mappingRet)
+{
+#ifndef WIN32
+    boost::unique_lock<boost::mutex> lock(cs);
+    std::map<int, std::pair<MappingPtr, uint64_t> >::iterator it = mapFiles.find(nFile);
+    if (it != mapFiles.end() && it->second.first->nSize >= nEnd) {
+        it->second.second = ++nFileUses;
+        mappingRet = it->second.first;
+        return true;
+    }
+
+    // Not mapped yet, or the file grew since. Blocks are only appended, so
+    // a mapping stays valid for everything it covers.
+    if (it != mapFiles.end()) {
+        nMappedBytes -= it->second.first->nSize;
+        mapFiles.erase(it);
+    }
+    std::string strPath = GetBlockPosFilename(CDiskBlockPos(nFile, 0), "blk").string();
+    int fd = open(strPath.c_str(), O_RDONLY);
+    if (fd == -1)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < nEnd || (uint64_t)st.st_size > nMaxMappedBytes) {
+        close(fd);
+        return false;
+    }
+    while (!mapFiles.empty() && (mapFiles.size() >= (size_t)MAX_MAPPED_BLOCK_FILES || nMappedBytes + st.st_size > nMaxMappedBytes))
+        UnmapOldest();
+    void* p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        LogPrintf("%s: cannot map %s, reading it with stdio\n", __func__, strPath);
+        return false;
+    }
+
+    mappingRet.reset(new CMapping((const unsigned char*)p, st.st_size));
+    mapFiles[nFile] = std::make_pair(mappingRet, ++nFileUses);
+    nMappedBytes += st.st_size;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool CBlockReader::ReadRawBlockFromFile(const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart, CRawBlock& raw)
+{
+    raw.mapping.reset();
+    CAutoFile filein(OpenBlockFile(CDiskBlockPos(pos.nFile, pos.nPos - MESSAGE_START_SIZE - 4), true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s: OpenBlockFile failed for %s", __func__, pos.ToString());
+    try {
+        CMessageHeader::MessageStartChars pchMagic;
+        filein >> FLATDATA(pchMagic) >> raw.nSize;
+        if (memcmp(pchMagic, messageStart, MESSAGE_START_SIZE) != 0)
+            return error("%s: no block magic at %s", __func__, pos.ToString());
+        if (raw.nSize > MAX_SIZE)
+            return error("%s: invalid block size %u at %s", __func__, raw.nSize, pos.ToString());
+        raw.vchBlock.resize(raw.nSize);
+        filein.read((char*)begin_ptr(raw.vchBlock), raw.nSize);
+    } catch (const std::exception& e) {
+        return error("%s: I/O error - %s at %s", __func__, e.what(), pos.ToString());
+    }
+    raw.pch = begin_ptr(raw.vchBlock);
+    return true;
+}
+
+bool CBlockReader::GetRawBlock(const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart, CRawBlock& raw)
+{
+    // every block is preceded by the magic and its size
+    if (pos.IsNull() || pos.nPos < MESSAGE_START_SIZE + 4)
+        return error("%s: no block at %s", __func__, pos.ToString());
+
+    // files that can't be mapped, e.g. past the mapping limit, are read with stdio
+    if (!GetMapping(pos.nFile, pos.nPos, raw.mapping))
+        return ReadRawBlockFromFile(pos, messageStart, raw);
+    const unsigned char* pchHeader = raw.mapping->pch + pos.nPos - MESSAGE_START_SIZE - 4;
+    if (memcmp(pchHeader, messageStart, MESSAGE_START_SIZE) != 0)
+        return error("%s: no block magic at %s", __func__, pos.ToString());
+    raw.nSize = ReadLE32(pchHeader + MESSAGE_START_SIZE);
+    if (raw.nSize > MAX_SIZE)
+        return error("%s: invalid block size %u at %s", __func__, raw.nSize, pos.ToString());
+    uint64_t nEnd = (uint64_t)pos.nPos + raw.nSize;
+    if (nEnd > raw.mapping->nSize && !GetMapping(pos.nFile, nEnd, raw.mapping))
+        return ReadRawBlockFromFile(pos, messageStart, raw);
+    raw.pch = raw.mapping->pch + pos.nPos;
+    return true;
+}
+
+void CBlockReader::TrimCache()
+{
+    while (nCacheUsage > nMaxCacheUsage && !listBlocks.empty()) {
+        nCacheUsage -= listBlocks.back().nUsage;
+        mapBlocks.erase(listBlocks.back().hash);
+        listBlocks.pop_back();
+    }
+}
+
+void CBlockReader::SetMaxCacheUsage(size_t nMaxCacheUsageIn)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    nMaxCacheUsage = nMaxCacheUsageIn;
+    TrimCache();
+}
+
+void CBlockReader::SetMaxMappedBytes(uint64_t nMaxMappedBytesIn)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    nMaxMappedBytes = nMaxMappedBytesIn;
+    while (!mapFiles.empty() && nMappedBytes > nMaxMappedBytes)
+        UnmapOldest();
+}
+
+bool CBlockReader::ReadRawBlock(CDataStream& ss, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
+{
+    CRawBlock raw;
+    if (!GetRawBlock(pos, messageStart, raw))
+        return false;
+    ss.write((const char*)raw.pch, raw.nSize);
+
+    boost::unique_lock<boost::mutex> lock(cs);
+    nRawReads++;
+    return true;
+}
+
+boost::shared_ptr<const CBlock> CBlockReader::ReadBlock(const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart)
+{
+    uint256 hash = pindex->GetBlockHash();
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        std::map<uint256, CachedBlocks::iterator>::iterator it = mapBlocks.find(hash);
+        if (it != mapBlocks.end()) {
+            listBlocks.splice(listBlocks.begin(), listBlocks, it->second);
+            nCacheHits++;
+            return it->second->pblock;
+        }
+        nCacheMisses++;
+    }
+
+    boost::shared_ptr<CBlock> pblock(new CBlock());
+    {
+        CRawBlock raw;
+        if (!GetRawBlock(pindex->GetBlockPos(), messageStart, raw))
+            return boost::shared_ptr<const CBlock>();
+        try {
+            CMemoryReader reader(raw.pch, raw.nSize, SER_DISK, CLIENT_VERSION);
+            reader >> *pblock;
+        } catch (const std::exception& e) {
+            error("%s: Deserialize error - %s at %s", __func__, e.what(), pindex->GetBlockPos().ToString());
+            return boost::shared_ptr<const CBlock>();
+        }
+    }
+    // the index entry was checked for proof of work already
+    if (pblock->GetHash() != hash) {
+        error("%s: GetHash() doesn't match index for %s at %s", __func__, pindex->ToString(), pindex->GetBlockPos().ToString());
+        return boost::shared_ptr<const CBlock>();
+    }
+
+    boost::unique_lock<boost::mutex> lock(cs);
+    if (nMaxCacheUsage > 0 && !mapBlocks.count(hash)) {
+        CCachedBlock cached;
+        cached.hash = hash;
+        cached.pblock = pblock;
+        cached.nUsage = sizeof(CBlock) + RecursiveDynamicUsage(*pblock);
+        listBlocks.push_front(cached);
+        mapBlocks[hash] = listBlocks.begin();
+        nCacheUsage += cached.nUsage;
+        TrimCache();
+    }
+    return pblock;
+}
+
+bool CBlockReader::ReadTransaction(const CDiskTxPos& postx, const CMessageHeader::MessageStartChars& messageStart, CTransaction& txOut, uint256& hashBlock)
+{
+    CRawBlock raw;
+    if (!GetRawBlock(postx, messageStart, raw))
+        return false;
+    CBlockHeader header;
+    try {
+        CMemoryReader reader(raw.pch, raw.nSize, SER_DISK, CLIENT_VERSION);
+        reader >> header;
+        reader.ignore(postx.nTxOffset);
+        reader >> txOut;
+    } catch (const std::exception& e) {
+        return error("%s: Deserialize error - %s at %s", __func__, e.what(), postx.ToString());
+    }
+    hashBlock = header.GetHash();
+    return true;
+}
+
+void CBlockReader::CloseFile(int nFile)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    std::map<int, std::pair<MappingPtr, uint64_t> >::iterator it = mapFiles.find(nFile);
+    if (it != mapFiles.end()) {
+        nMappedBytes -= it->second.first->nSize;
+        mapFiles.erase(it);
+    }
+}
+
+CBlockReaderStats CBlockReader::GetStats() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    CBlockReaderStats stats;
+    stats.nRawReads = nRawReads;
+    stats.nCacheHits = nCacheHits;
+    stats.nCacheMisses = nCacheMisses;
+    stats.nCacheBlocks = listBlocks.size();
+    stats.nCacheUsage = nCacheUsage;
+    stats.nMaxCacheUsage = nMaxCacheUsage;
+    stats.nMappedFiles = mapFiles.size();
+    stats.nMappedBytes = nMappedBytes;
+    return stats;
+}
@@ -0,0 +1,135 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BLOCKREADER_H
+#define BLOCKREADER_H
+
+#include "chain.h"
+#include "primitives/block.h"
+#include "protocol.h"
+#include "streams.h"
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+struct CDiskTxPos;
+
+/** Default for -blockcachesize, MiB of decoded blocks kept for serving them again */
+static const int64_t DEFAULT_BLOCK_CACHE_SIZE = 32;
+/** Block files which stay mapped at once, the least recently used one is unmapped first */
+static const int MAX_MAPPED_BLOCK_FILES = 64;
+/** Bytes of block files mapped at once, less where the address space is small */
+static const uint64_t MAX_MAPPED_BLOCK_BYTES = sizeof(void*) > 4 ? ((uint64_t)4 << 30) : ((uint64_t)256 << 20);
+
+struct CBlockReaderStats
+{
+    uint64_t nRawReads;
+    uint64_t nCacheHits;
+    uint64_t nCacheMisses;
+    size_t nCacheBlocks;
+    size_t nCacheUsage;
+    size_t nMaxCacheUsage;
+    int nMappedFiles;
+    uint64_t nMappedBytes;
+
+    CBlockReaderStats() : nRawReads(0), nCacheHits(0), nCacheMisses(0), nCacheBlocks(0), nCacheUsage(0), nMaxCacheUsage(0), nMappedFiles(0), nMappedBytes(0) {}
+};
+
+/**
+ * Read path for serving blocks that are stored already: to peers, RPC, REST
+ * and ZMQ.
+ *
+ * Block files are memory mapped, so a block is copied out of the page cache
+ * without opening and seeking the file for every request. Where a file can't
+ * be mapped, e.g. for lack of address space, the block is read with stdio. Raw reads hand out
+ * the block as it is serialized on disk, which is what the network format is
+ * too. Decoded blocks are kept in a LRU cache bounded by their memory usage,
+ * so they are deserialized and hashed once for all the callers asking for the
+ * same recent blocks.
+ *
+ * Only the magic and the size written in front of a block are checked on raw
+ * reads, decoded blocks are checked against the hash of their index entry.
+ * Validation keeps reading through ReadBlockFromDisk.
+ */
+class CBlockReader
+{
+private:
+    class CMapping;
+    typedef boost::shared_ptr<CMapping> MappingPtr;
+
+    /** A block in memory, owned by a mapping or by vchBlock */
+    struct CRawBlock
+    {
+        MappingPtr mapping;
+        std::vector<unsigned char> vchBlock;
+        const unsigned char* pch;
+        uint32_t nSize;
+    };
+
+    struct CCachedBlock
+    {
+        uint256 hash;
+        boost::shared_ptr<const CBlock> pblock;
+        size_t nUsage;
+    };
+    typedef std::list<CCachedBlock> CachedBlocks;
+
+    mutable boost::mutex cs;
+
+    //! Mapped block files with the last time they were used (protected by cs)
+    std::map<int, std::pair<MappingPtr, uint64_t> > mapFiles;
+    uint64_t nFileUses;
+    uint64_t nMappedBytes;
+    uint64_t nMaxMappedBytes;
+
+    //! Decoded blocks, most recently used first (protected by cs)
+    CachedBlocks listBlocks;
+    std::map<uint256, CachedBlocks::iterator> mapBlocks;
+    size_t nCacheUsage;
+    size_t nMaxCacheUsage;
+
+    uint64_t nRawReads;
+    uint64_t nCacheHits;
+    uint64_t nCacheMisses;
+
+    CBlockReader(const CBlockReader&);
+    void operator=(const CBlockReader&);
+
+    void UnmapOldest();
+    bool GetMapping(int nFile, uint64_t nEnd, MappingPtr& mappingRet);
+    bool ReadRawBlockFromFile(const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart, CRawBlock& raw);
+    bool GetRawBlock(const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart, CRawBlock& raw);
+    void TrimCache();
+
+public:
+    CBlockReader();
+    ~CBlockReader();
+
+    /** Bytes of decoded blocks to keep, 0 disables the cache */
+    void SetMaxCacheUsage(size_t nMaxCacheUsageIn);
+    /** Bytes of block files to keep mapped, 0 reads every block with stdio */
+    void SetMaxMappedBytes(uint64_t nMaxMappedBytesIn);
+
+    /** Appends the block at pos to ss as serialized on disk, without decoding it */
+    bool ReadRawBlock(CDataStream& ss, const CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
+
+    /** Returns the block of pindex decoded, from the cache or from disk. NULL on errors. */
+    boost::shared_ptr<const CBlock> ReadBlock(const CBlockIndex* pindex, const CMessageHeader::MessageStartChars& messageStart);
+
+    /** Reads a transaction at a position of the transaction index, and the hash of its block */
+    bool ReadTransaction(const CDiskTxPos& postx, const CMessageHeader::MessageStartChars& messageStart, CTransaction& txOut, uint256& hashBlock);
+
+    /** Unmaps a block file, before it is deleted */
+    void CloseFile(int nFile);
+
+    CBlockReaderStats GetStats() const;
+};
+
+extern CBlockReader blockreader;
+
+#endif // BLOCKREADER_H
@@ -114,6 +114,13 @@ public:
         consensus.vDeployments[Consensus::DEPLOYMENT_CSV].nStartTime = 1486252800; // Feb 5th, 2017
         consensus.vDeployments[Consensus::DEPLOYMENT_CSV].nTimeout = 1517788800; // Feb 5th, 2018
 
+        // The best chain should have at least this much work.
+        // Blocks 0 - 471285 at the proof of work limit, the real chain has a lot more.
+        consensus.nMinimumChainWork = uint256S("0x730f6730f6");
+
+        // By default assume that the signatures in ancestors of this block are valid.
+        consensus.defaultAssumeValid = uint256S("0x00000000000c1e56df5f188d8776c5f268d218ae779eeabbe991eed0b9d58d38"); // 471285
+
         /**
          * The message start string is designed to be unlikely to occur in normal data.
          * The characters are rarely used upper ASCII, not valid as UTF-8, and produce
@@ -182,13 +189,16 @@ public:
             (  170690, uint256S("0x0000000000115dd61216bb43ab76eb4921ffc33e47fd57e4c108c49371e5bd86"))
             (  409223, uint256S("0x000000000000033ac12f288d05943b22aa223de94b90c1c41594df08781d7528"))
             (  423781, uint256S("0x0000000000007a5f6302854a8f9a559ce640e82d503064ffe1316b076195ae6e"))
-            (  471285, uint256S("0x00000000000c1e56df5f188d8776c5f268d218ae779eeabbe991eed0b9d58d38"))
-            (  471285, uint256S("0x000000007048de8db28b27814fb768220be37a32f8f6839f9de88114fddfa281")),
+            (  471285, uint256S("0x00000000000c1e56df5f188d8776c5f268d218ae779eeabbe991eed0b9d58d38")),
             1562828734, // * UNIX timestamp of last checkpoint block
             441125,    // * total number of transactions between genesis and last checkpoint
                         //   (the tx=... number in the SetBestChain debug.log lines)
             0        // * estimated number of transactions per day after checkpoint
         };
+
+        // UTXO snapshots which -loadutxosnapshot accepts, add them as reported by dumptxoutset on a synced node:
+        // CUTXOSnapshotData snapshot = { uint256S("<content hash>"), <nchaintx> };
+        // mapUTXOSnapshots[uint256S("<base block hash>")] = snapshot;
     }
 };
 static CMainParams mainParams;
@@ -241,6 +251,12 @@ public:
         consensus.vDeployments[Consensus::DEPLOYMENT_CSV].nStartTime = 1456790400; // March 1st, 2016
         consensus.vDeployments[Consensus::DEPLOYMENT_CSV].nTimeout = 1493596800; // May 1st, 2017
 
+        // The best chain should have at least this much work.
+        consensus.nMinimumChainWork = uint256S("0x00");
+
+        // By default assume that the signatures in ancestors of this block are valid.
+        consensus.defaultAssumeValid = uint256S("0x00");
+
         pchMessageStart[0] = 0xde;
         pchMessageStart[1] = 0xa2;
         pchMessageStart[2] = 0xc4;
@@ -349,6 +365,12 @@ public:
         consensus.vDeployments[Consensus::DEPLOYMENT_CSV].nStartTime = 0;
         consensus.vDeployments[Consensus::DEPLOYMENT_CSV].nTimeout = 999999999999ULL;
 
+        // The best chain should have at least this much work.
+        consensus.nMinimumChainWork = uint256S("0x00");
+
+        // By default assume that the signatures in ancestors of this block are valid.
+        consensus.defaultAssumeValid = uint256S("0x00");
+
         pchMessageStart[0] = 0xec;
         pchMessageStart[1] = 0xa1;
         pchMessageStart[2] = 0xc7;
@@ -386,6 +408,11 @@ public:
             0,
             0
         };
+
+        // Snapshot after block 1 with only its coinbase: version 4, time of genesis + 60, nonce 1, paying 1 COIN to OP_TRUE
+        // with scriptSig 1 OP_0 (see snapshot_tests)
+        CUTXOSnapshotData snapshot1 = { uint256S("0xba5b69d03ff10aed09fe88221ecf8855bf971a3ada47a5ae9164c441648b78f7"), 2 };
+        mapUTXOSnapshots[uint256S("0x1e5605dbb1d08a9e294f8272d6e6f437110aac5cd7b9be987da09de919ef4177")] = snapshot1;
         // Regtest 3DCoin addresses start with 'R'
         base58Prefixes[PUBKEY_ADDRESS] = std::vector<unsigned char>(1, 61);
         // Regtest 3DCoin script addresses start with 'r'
@@ -32,6 +32,16 @@ struct CCheckpointData {
     double fTransactionsPerDay;
 };
 
+/** What a UTXO snapshot taken at a block must match to be loaded with -loadutxosnapshot */
+struct CUTXOSnapshotData {
+    /** Content hash of the snapshot, as returned by dumptxoutset */
+    uint256 hashContent;
+    /** Transactions in the chain up to and including the block */
+    unsigned int nChainTx;
+};
+
+typedef std::map<uint256, CUTXOSnapshotData> MapUTXOSnapshots;
+
 /**
  * CChainParams defines various tweakable parameters of a given instance of the
  * 3DCoin system. There are three: the main network on which people trade goods
@@ -78,6 +88,8 @@ public:
     int ExtCoinType() const { return nExtCoinType; }
     const std::vector<SeedSpec6>& FixedSeeds() const { return vFixedSeeds; }
     const CCheckpointData& Checkpoints() const { return checkpointData; }
+    /** Blocks whose UTXO snapshots are trusted, by block hash */
+    const MapUTXOSnapshots& UTXOSnapshots() const { return mapUTXOSnapshots; }
     int PoolMaxTransactions() const { return nPoolMaxTransactions; }
     int FulfilledRequestExpireTime() const { return nFulfilledRequestExpireTime; }
     std::string SporkPubKey() const { return strSporkPubKey; }
@@ -103,6 +115,7 @@ protected:
     bool fMineBlocksOnDemand;
     bool fTestnetToBeDeprecatedFieldRPC;
     CCheckpointData checkpointData;
+    MapUTXOSnapshots mapUTXOSnapshots;
     int nPoolMaxTransactions;
     int nFulfilledRequestExpireTime;
     std::string strSporkPubKey;
@@ -6,6 +6,8 @@
 #define BITCOIN_CHECKQUEUE_H
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
 #include <vector>
 
 #include <boost/foreach.hpp>
@@ -13,10 +15,13 @@
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
 
+/** Worker threads a CCheckQueue can have, not counting the master */
+static const int MAX_CHECKQUEUE_WORKERS = 64;
+
 template <typename T>
 class CCheckQueueControl;
 
-/** 
+/**
  * Queue for verifications that have to be performed.
   * The verifications are represented by a type T, which must provide an
   * operator(), returning a bool.
@@ -25,12 +30,32 @@ class CCheckQueueControl;
   * onto the queue, where they are processed by N-1 worker threads. When
   * the master is done adding work, it temporarily joins the worker pool
   * as an N'th worker, until all jobs are done.
+  *
+  * Every thread has a deque of its own, the master adds to the back of its
+  * deque. Threads take the newest checks from the back of their own deque,
+  * and when it is empty steal half of the oldest ones from the front of
+  * another, so the checks spread out over the workers without all of them
+  * going through one lock. While adding, the master runs checks itself
+  * once the workers fall behind.
   */
 template <typename T>
 class CCheckQueue
 {
 private:
-    //! Mutex to protect the inner state
+    //! The checks of one thread, others steal from the front
+    struct CWorkQueue
+    {
+        boost::mutex mutex;
+        std::deque<T> queue;
+    };
+
+    //! Index 0 belongs to the master, worker threads claim the next ones as they start
+    CWorkQueue vQueues[MAX_CHECKQUEUE_WORKERS + 1];
+
+    //! The number of worker threads which claimed a queue
+    std::atomic<int> nWorkers;
+
+    //! Mutex for idle threads to sleep on, it doesn't protect the checks
     boost::mutex mutex;
 
     //! Worker threads block on this when out of work
@@ -39,122 +64,163 @@ private:
     //! Master thread blocks on this when out of work
     boost::condition_variable condMaster;
 
-    //! The queue of elements to be processed.
-    //! As the order of booleans doesn't matter, it is used as a LIFO (stack)
-    std::vector<T> queue;
-
-    //! The number of workers (including the master) that are idle.
+    //! The number of workers that are idle (protected by mutex)
     int nIdle;
 
-    //! The total number of workers (including the master).
-    int nTotal;
-
-    //! The temporary evaluation result.
-    bool fAllOk;
+    //! Checks which are in one of the queues, none is taken while this is zero
+    std::atomic<int> nQueued;
 
     /**
      * Number of verifications that haven't completed yet.
-     * This includes elements that are no longer queued, but still in the
-     * worker's own batches.
+     * This includes elements that are no longer queued, but still being
+     * run by a worker.
      */
-    unsigned int nTodo;
+    std::atomic<int> nTodo;
 
-    //! Whether we're shutting down.
-    bool fQuit;
+    //! The temporary evaluation result.
+    std::atomic<bool> fAllOk;
 
-    //! The maximum number of elements to be processed in one batch
+    //! The maximum number of elements the master lets pile up per thread before it helps out
     unsigned int nBatchSize;
 
+    /** Takes the newest check of a thread's own queue */
+    bool TakeOwn(int nSelf, T& check)
+    {
+        CWorkQueue& work = vQueues[nSelf];
+        boost::unique_lock<boost::mutex> lock(work.mutex);
+        if (work.queue.empty())
+            return false;
+        check.swap(work.queue.back());
+        work.queue.pop_back();
+        nQueued--;
+        return true;
+    }
+
+    /** Moves the older half of another thread's queue into its own one, returns one of them */
+    bool Steal(int nSelf, T& check)
+    {
+        int nQueues = nWorkers + 1;
+        std::vector<T> vStolen;
+        for (int i = 1; i < nQueues && vStolen.empty(); i++) {
+            CWorkQueue& victim = vQueues[(nSelf + i) % nQueues];
+            boost::unique_lock<boost::mutex> lock(victim.mutex);
+            size_t nSteal = (victim.queue.size() + 1) / 2;
+            vStolen.resize(nSteal);
+            for (size_t j = 0; j < nSteal; j++) {
+                vStolen[j].swap(victim.queue.front());
+                victim.queue.pop_front();
+            }
+        }
+        if (vStolen.empty())
+            return false;
+        check.swap(vStolen.back());
+        nQueued--;
+        if (vStolen.size() > 1) {
+            CWorkQueue& work = vQueues[nSelf];
+            boost::unique_lock<boost::mutex> lock(work.mutex);
+            for (size_t j = 0; j + 1 < vStolen.size(); j++) {
+                work.queue.push_back(T());
+                work.queue.back().swap(vStolen[j]);
+            }
+        }
+        return true;
+    }
+
+    /** Runs a check, once one failed the remaining ones are only counted off */
+    void Run(T& check)
+    {
+        if (fAllOk && !check())
+            fAllOk = false;
+        T().swap(check);
+        if (--nTodo == 0) {
+            // We processed the last element; inform the master it can exit and return the result
+            boost::unique_lock<boost::mutex> lock(mutex);
+            condMaster.notify_one();
+        }
+    }
+
     /** Internal function that does bulk of the verification work. */
-    bool Loop(bool fMaster = false)
+    bool Loop(int nSelf, bool fMaster = false)
     {
-        boost::condition_variable& cond = fMaster ? condMaster : condWorker;
-        std::vector<T> vChecks;
-        vChecks.reserve(nBatchSize);
-        unsigned int nNow = 0;
-        bool fOk = true;
+        T check;
         do {
-            {
-                boost::unique_lock<boost::mutex> lock(mutex);
-                // first do the clean-up of the previous loop run (allowing us to do it in the same critsect)
-                if (nNow) {
-                    fAllOk &= fOk;
-                    nTodo -= nNow;
-                    if (nTodo == 0 && !fMaster)
-                        // We processed the last element; inform the master it can exit and return the result
-                        condMaster.notify_one();
-                } else {
-                    // first iteration
-                    nTotal++;
-                }
-                // logically, the do loop starts here
-                while (queue.empty()) {
-                    if ((fMaster || fQuit) && nTodo == 0) {
-                        nTotal--;
-                        bool fRet = fAllOk;
-                        // reset the status for new work later
-                        if (fMaster)
-                            fAllOk = true;
-                        // return the current status
-                        return fRet;
-                    }
-                    nIdle++;
-                    cond.wait(lock); // wait
-                    nIdle--;
-                }
-                // Decide how many work units to process now.
-                // * Do not try to do everything at once, but aim for increasingly smaller batches so
-                //   all workers finish approximately simultaneously.
-                // * Try to account for idle jobs which will instantly start helping.
-                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
-                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() / (nTotal + nIdle + 1)));
-                vChecks.resize(nNow);
-                for (unsigned int i = 0; i < nNow; i++) {
-                    // We want the lock on the mutex to be as short as possible, so swap jobs from the global
-                    // queue to the local batch vector instead of copying.
-                    vChecks[i].swap(queue.back());
-                    queue.pop_back();
-                }
-                // Check whether we need to do work at all
-                fOk = fAllOk;
+            if (TakeOwn(nSelf, check) || Steal(nSelf, check)) {
+                Run(check);
+                continue;
             }
-            // execute work
-            BOOST_FOREACH (T& check, vChecks)
-                if (fOk)
-                    fOk = check();
-            vChecks.clear();
+            boost::unique_lock<boost::mutex> lock(mutex);
+            // checks which are being moved by a steal are counted but not visible, try again
+            if (nQueued > 0)
+                continue;
+            if (fMaster) {
+                // only the master adds, nothing will be queued until it returns
+                while (nTodo > 0)
+                    condMaster.wait(lock);
+                bool fRet = fAllOk;
+                // reset the status for new work later
+                fAllOk = true;
+                // return the current status
+                return fRet;
+            }
+            nIdle++;
+            condWorker.wait(lock); // wait
+            nIdle--;
         } while (true);
     }
 
 public:
     //! Create a new check queue
-    CCheckQueue(unsigned int nBatchSizeIn) : nIdle(0), nTotal(0), fAllOk(true), nTodo(0), fQuit(false), nBatchSize(nBatchSizeIn) {}
+    CCheckQueue(unsigned int nBatchSizeIn) : nWorkers(0), nIdle(0), nQueued(0), nTodo(0), fAllOk(true), nBatchSize(nBatchSizeIn) {}
 
     //! Worker thread
     void Thread()
     {
-        Loop();
+        int nSelf = ++nWorkers;
+        if (nSelf > MAX_CHECKQUEUE_WORKERS) {
+            nWorkers--;
+            return;
+        }
+        Loop(nSelf);
     }
 
     //! Wait until execution finishes, and return whether all evaluations were successful.
     bool Wait()
     {
-        return Loop(true);
+        return Loop(0, true);
     }
 
     //! Add a batch of checks to the queue
     void Add(std::vector<T>& vChecks)
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        BOOST_FOREACH (T& check, vChecks) {
-            queue.push_back(T());
-            check.swap(queue.back());
-        }
+        if (vChecks.empty())
+            return;
+        // counted before they can be taken, so the counters never drop below zero
         nTodo += vChecks.size();
-        if (vChecks.size() == 1)
-            condWorker.notify_one();
-        else if (vChecks.size() > 1)
-            condWorker.notify_all();
+        nQueued += vChecks.size();
+        size_t nBacklog;
+        {
+            CWorkQueue& work = vQueues[0];
+            boost::unique_lock<boost::mutex> lock(work.mutex);
+            BOOST_FOREACH (T& check, vChecks) {
+                work.queue.push_back(T());
+                check.swap(work.queue.back());
+            }
+            nBacklog = work.queue.size();
+        }
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (nIdle > 0) {
+                if (vChecks.size() == 1)
+                    condWorker.notify_one();
+                else
+                    condWorker.notify_all();
+            }
+        }
+        // Rather than queueing up more and more, check some here while the workers are busy
+        size_t nMaxBacklog = (size_t)nBatchSize * (nWorkers + 1);
+        T check;
+        while (nBacklog-- > nMaxBacklog && TakeOwn(0, check))
+            Run(check);
     }
 
     ~CCheckQueue()
@@ -163,13 +229,12 @@ public:
 
     bool IsIdle()
     {
-        boost::unique_lock<boost::mutex> lock(mutex);
-        return (nTotal == nIdle && nTodo == 0 && fAllOk == true);
+        return (nTodo == 0 && nQueued == 0 && fAllOk == true);
     }
 
 };
 
-/** 
+/**
  * RAII-style controller object for a CCheckQueue that guarantees the passed
  * queue is finished before continuing.
  */
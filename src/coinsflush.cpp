@@ -0,0 +1,197 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coinsflush.h"
+
+#include "txdb.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <boost/bind.hpp>
+
+CCoinsViewFlusher::CCoinsViewFlusher(CCoinsView* viewIn, CCoinsViewDB* pdbIn, bool fBackgroundIn) :
+    CCoinsViewBacked(viewIn),
+    pdb(pdbIn),
+    fBackground(fBackgroundIn),
+    fStop(false),
+    fPending(false),
+    fFailed(false)
+{
+    stats.fBackground = fBackground;
+    if (fBackground)
+        threadFlush = boost::thread(boost::bind(&CCoinsViewFlusher::ThreadFlush, this));
+}
+
+CCoinsViewFlusher::~CCoinsViewFlusher()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fStop = true;
+    }
+    condFlusher.notify_all();
+    // a pending write is finished first
+    if (threadFlush.joinable())
+        threadFlush.join();
+}
+
+bool CCoinsViewFlusher::GetCoin(const COutPoint& outpoint, Coin& coin) const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (!mapFrozen.empty()) {
+            CCoinsMap::const_iterator it = mapFrozen.find(outpoint);
+            if (it != mapFrozen.end()) {
+                if (it->second.coin.IsSpent())
+                    return false;
+                coin = it->second.coin;
+                return true;
+            }
+        }
+    }
+    // not in the pending write, so the database value is current whether
+    // or not that write lands in the meantime
+    return base->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewFlusher::HaveCoin(const COutPoint& outpoint) const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (!mapFrozen.empty()) {
+            CCoinsMap::const_iterator it = mapFrozen.find(outpoint);
+            if (it != mapFrozen.end())
+                return !it->second.coin.IsSpent();
+        }
+    }
+    return base->HaveCoin(outpoint);
+}
+
+uint256 CCoinsViewFlusher::GetBestBlock() const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (fPending && !hashFrozen.IsNull())
+            return hashFrozen;
+    }
+    return base->GetBestBlock();
+}
+
+uint256 CCoinsViewFlusher::GetWrittenBestBlock() const
+{
+    // a write either landed or not, the database has some whole block either way
+    return base->GetBestBlock();
+}
+
+bool CCoinsViewFlusher::BatchWrite(CCoinsMap& mapCoinsIn, const uint256& hashBlock)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (fPending)
+        condWritten.wait(lock);
+    if (fFailed)
+        return false;
+
+    if (!fBackground) {
+        lock.unlock();
+        int64_t nStart = GetTimeMicros();
+        bool fOk = pdb->BatchWrite(mapCoinsIn, hashBlock);
+        int64_t nTime = GetTimeMicros() - nStart;
+        lock.lock();
+        stats.nFlushes++;
+        stats.nLastWriteTime = nTime;
+        stats.nTotalWriteTime += nTime;
+        return fOk;
+    }
+
+    // Only the dirty coins need writing, the rest is what the database has
+    for (CCoinsMap::iterator it = mapCoinsIn.begin(); it != mapCoinsIn.end(); it++) {
+        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+            CCoinsCacheEntry& entry = mapFrozen[it->first];
+            entry.coin.swap(it->second.coin);
+            entry.flags = CCoinsCacheEntry::DIRTY;
+        }
+    }
+    mapCoinsIn.clear();
+    hashFrozen = hashBlock;
+    fPending = true;
+    stats.fWriting = true;
+    condFlusher.notify_one();
+    return true;
+}
+
+bool CCoinsViewFlusher::GetStats(CCoinsStats& statsRet) const
+{
+    // the statistics are computed from the database
+    if (!Sync())
+        return false;
+    return base->GetStats(statsRet);
+}
+
+bool CCoinsViewFlusher::Sync() const
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (fPending)
+        condWritten.wait(lock);
+    return !fFailed;
+}
+
+void CCoinsViewFlusher::ThreadFlush()
+{
+    RenameThread("3dcoin-flush");
+    while (true) {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (!fPending && !fStop)
+                condFlusher.wait(lock);
+            if (!fPending)
+                return;
+        }
+
+        // mapFrozen doesn't change while fPending is set, readers only look things up
+        int64_t nStart = GetTimeMicros();
+        bool fOk = false;
+        try {
+            fOk = pdb->WriteCoins(mapFrozen, hashFrozen);
+        } catch (const std::exception& e) {
+            LogPrintf("%s: %s\n", __func__, e.what());
+        }
+        int64_t nTime = GetTimeMicros() - nStart;
+
+        CCoinsMap mapWritten;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            // On failure the coins stay frozen, so lookups keep returning the
+            // current state, and the next flush reports the error
+            if (fOk) {
+                mapWritten.swap(mapFrozen);
+                hashFrozen.SetNull();
+            } else {
+                fFailed = true;
+            }
+            fPending = false;
+            stats.nFlushes++;
+            stats.nLastWriteTime = nTime;
+            stats.nTotalWriteTime += nTime;
+            stats.fWriting = false;
+        }
+        condWritten.notify_all();
+        if (!fOk)
+            LogPrintf("ERROR: %s: failed to write to coin database\n", __func__);
+        else
+            LogPrint("coindb", "%s: wrote %u coins in %.2fms\n", __func__, mapWritten.size(), nTime * 0.001);
+        // freed outside the lock, this can take a while for a large cache
+    }
+}
+
+void CCoinsViewFlusher::AddLockTime(int64_t nTime)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    stats.nLastLockTime = nTime;
+    stats.nTotalLockTime += nTime;
+}
+
+CCoinsFlushStats CCoinsViewFlusher::GetFlushStats() const
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return stats;
+}
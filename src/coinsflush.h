@@ -0,0 +1,90 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef COINSFLUSH_H
+#define COINSFLUSH_H
+
+#include "coins.h"
+
+#include <boost/thread.hpp>
+
+class CCoinsViewDB;
+
+/** Default for -backgroundflush */
+static const bool DEFAULT_BACKGROUND_FLUSH = false;
+
+/** Timings of the chainstate flushes, in microseconds */
+struct CCoinsFlushStats
+{
+    uint64_t nFlushes;
+    /** Time cs_main was held writing the coins cache out */
+    int64_t nLastLockTime;
+    int64_t nTotalLockTime;
+    /** Time the database write took, on the flush thread when in the background */
+    int64_t nLastWriteTime;
+    int64_t nTotalWriteTime;
+    /** Whether the database is written on the flush thread */
+    bool fBackground;
+    /** Whether a background write is in progress */
+    bool fWriting;
+
+    CCoinsFlushStats() : nFlushes(0), nLastLockTime(0), nTotalLockTime(0), nLastWriteTime(0), nTotalWriteTime(0), fBackground(false), fWriting(false) {}
+};
+
+/**
+ * Layer right above the chainstate database which takes the coins flushed
+ * out of pcoinsTip. In background mode BatchWrite only moves the dirty coins
+ * into a frozen map and returns, a thread then writes them to the database
+ * in one batch together with the best block, so the database always holds
+ * the state at some block, as with a synchronous flush. Until that write is
+ * done lookups are served from the frozen map first, it is newer than the
+ * database. A flush arriving while the last one is still being written waits
+ * for it.
+ *
+ * Without background mode BatchWrite writes to the database right away.
+ */
+class CCoinsViewFlusher : public CCoinsViewBacked
+{
+private:
+    CCoinsViewDB* pdb;
+    bool fBackground;
+
+    mutable boost::mutex mutex;
+    boost::condition_variable condFlusher;
+    mutable boost::condition_variable condWritten;
+    boost::thread threadFlush;
+    bool fStop;
+    /** mapFrozen is being written, it is not changed until that is done */
+    bool fPending;
+    bool fFailed;
+    CCoinsMap mapFrozen;
+    uint256 hashFrozen;
+    CCoinsFlushStats stats;
+
+    void ThreadFlush();
+
+public:
+    /** Reads go through viewIn, writes go to pdbIn, which must be the database below it */
+    CCoinsViewFlusher(CCoinsView* viewIn, CCoinsViewDB* pdbIn, bool fBackgroundIn);
+    ~CCoinsViewFlusher();
+
+    bool GetCoin(const COutPoint& outpoint, Coin& coin) const;
+    bool HaveCoin(const COutPoint& outpoint) const;
+    uint256 GetBestBlock() const;
+    bool BatchWrite(CCoinsMap& mapCoinsIn, const uint256& hashBlock);
+    bool GetStats(CCoinsStats& statsRet) const;
+
+    /** Waits for a background write to finish, false if one failed */
+    bool Sync() const;
+
+    bool IsBackground() const { return fBackground; }
+    /** Best block of the database itself, without a background write still in progress */
+    uint256 GetWrittenBestBlock() const;
+
+    /** Accounts for a flush which held cs_main for nTime microseconds */
+    void AddLockTime(int64_t nTime);
+    CCoinsFlushStats GetFlushStats() const;
+};
+
+#endif // COINSFLUSH_H
@@ -0,0 +1,221 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coinsprefetch.h"
+
+#include "chainparams.h"
+#include "main.h" // For ReadBlockFromDisk
+#include "util.h"
+
+#include <set>
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+
+void GetPrefetchOutPoints(const CBlock& block, std::vector<COutPoint>& vOutPointsRet)
+{
+    std::set<uint256> setBlockTxids;
+    BOOST_FOREACH(const CTransaction& tx, block.vtx)
+        setBlockTxids.insert(tx.GetHash());
+
+    BOOST_FOREACH(const CTransaction& tx, block.vtx) {
+        if (tx.IsCoinBase())
+            continue;
+        BOOST_FOREACH(const CTxIn& txin, tx.vin) {
+            if (!setBlockTxids.count(txin.prevout.hash))
+                vOutPointsRet.push_back(txin.prevout);
+        }
+    }
+}
+
+CCoinsViewPrefetch::CCoinsViewPrefetch(CCoinsView* viewIn, int nThreads) :
+    CCoinsViewBacked(viewIn),
+    fStop(false),
+    nWrites(0),
+    nHits(0),
+    nMisses(0)
+{
+    if (nThreads > MAX_PREFETCH_THREADS)
+        nThreads = MAX_PREFETCH_THREADS;
+    for (int i = 0; i < nThreads; i++)
+        threadGroup.create_thread(boost::bind(&CCoinsViewPrefetch::ThreadPrefetch, this));
+}
+
+CCoinsViewPrefetch::~CCoinsViewPrefetch()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fStop = true;
+    }
+    condWorker.notify_all();
+    threadGroup.join_all();
+}
+
+bool CCoinsViewPrefetch::GetCoin(const COutPoint& outpoint, Coin& coin) const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        std::map<COutPoint, Coin>::iterator it = mapCoins.find(outpoint);
+        if (it != mapCoins.end()) {
+            // the cache above keeps it from now on
+            coin.swap(it->second);
+            mapCoins.erase(it);
+            nHits++;
+            return true;
+        }
+        nMisses++;
+    }
+    return base->GetCoin(outpoint, coin);
+}
+
+bool CCoinsViewPrefetch::HaveCoin(const COutPoint& outpoint) const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (mapCoins.count(outpoint))
+            return true;
+    }
+    return base->HaveCoin(outpoint);
+}
+
+bool CCoinsViewPrefetch::BatchWrite(CCoinsMap& mapCoinsIn, const uint256& hashBlock)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        // odd while the database gets written, loads overlapping the write
+        // may have read either side of it and are thrown away
+        nWrites++;
+        if (!mapCoins.empty()) {
+            for (std::map<COutPoint, Coin>::iterator it = mapCoins.begin(); it != mapCoins.end(); ) {
+                if (mapCoinsIn.count(it->first))
+                    mapCoins.erase(it++);
+                else
+                    ++it;
+            }
+        }
+    }
+    bool fResult = base->BatchWrite(mapCoinsIn, hashBlock);
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nWrites++;
+    }
+    return fResult;
+}
+
+void CCoinsViewPrefetch::QueueOutPoints(const std::vector<COutPoint>& vOutPoints, bool fFront)
+{
+    std::vector<CPrefetchJob> vJobs;
+    for (size_t i = 0; i < vOutPoints.size(); i += PREFETCH_CHUNK_SIZE) {
+        vJobs.push_back(CPrefetchJob());
+        vJobs.back().vOutPoints.assign(vOutPoints.begin() + i, vOutPoints.begin() + std::min(i + PREFETCH_CHUNK_SIZE, vOutPoints.size()));
+    }
+    if (vJobs.empty())
+        return;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (queueJobs.size() >= MAX_PREFETCH_QUEUE)
+            return;
+        // a block read from disk goes first, its connection is the next to come
+        if (fFront)
+            queueJobs.insert(queueJobs.begin(), vJobs.begin(), vJobs.end());
+        else
+            queueJobs.insert(queueJobs.end(), vJobs.begin(), vJobs.end());
+    }
+    condWorker.notify_all();
+}
+
+void CCoinsViewPrefetch::Prefetch(const CBlock& block)
+{
+    if (threadGroup.size() == 0)
+        return;
+    std::vector<COutPoint> vOutPoints;
+    GetPrefetchOutPoints(block, vOutPoints);
+    QueueOutPoints(vOutPoints, false);
+}
+
+void CCoinsViewPrefetch::Prefetch(const CDiskBlockPos& pos)
+{
+    if (threadGroup.size() == 0 || pos.IsNull())
+        return;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (queueJobs.size() >= MAX_PREFETCH_QUEUE)
+            return;
+        queueJobs.push_back(CPrefetchJob());
+        queueJobs.back().pos = pos;
+    }
+    condWorker.notify_one();
+}
+
+void CCoinsViewPrefetch::LoadOutPoints(const std::vector<COutPoint>& vOutPoints)
+{
+    uint64_t nWritesStart;
+    std::vector<COutPoint> vToLoad;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nWritesStart = nWrites;
+        BOOST_FOREACH(const COutPoint& outpoint, vOutPoints) {
+            if (!mapCoins.count(outpoint))
+                vToLoad.push_back(outpoint);
+        }
+    }
+
+    std::vector<std::pair<COutPoint, Coin> > vLoaded;
+    vLoaded.reserve(vToLoad.size());
+    BOOST_FOREACH(const COutPoint& outpoint, vToLoad) {
+        Coin coin;
+        if (!base->GetCoin(outpoint, coin) || coin.IsSpent())
+            continue;
+        vLoaded.push_back(std::make_pair(outpoint, Coin()));
+        vLoaded.back().second.swap(coin);
+    }
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (nWrites != nWritesStart || (nWritesStart & 1))
+        return;
+    // Coins of blocks which never got connected, or which the cache above
+    // already had, are never asked for. Rather than tracking their age just
+    // start over when full, they are cheap to load again.
+    if (mapCoins.size() + vLoaded.size() > MAX_PREFETCH_COINS)
+        mapCoins.clear();
+    for (size_t i = 0; i < vLoaded.size(); i++)
+        mapCoins[vLoaded[i].first].swap(vLoaded[i].second);
+}
+
+void CCoinsViewPrefetch::ThreadPrefetch()
+{
+    RenameThread("3dcoin-prefetch");
+    while (true) {
+        CPrefetchJob job;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (queueJobs.empty() && !fStop)
+                condWorker.wait(lock);
+            if (fStop)
+                return;
+            job.pos = queueJobs.front().pos;
+            job.vOutPoints.swap(queueJobs.front().vOutPoints);
+            queueJobs.pop_front();
+        }
+
+        if (job.pos.IsNull()) {
+            LoadOutPoints(job.vOutPoints);
+            continue;
+        }
+        // only a hint, the block will be read again and checked when it gets connected
+        CBlock block;
+        if (!ReadBlockFromDisk(block, job.pos, Params().GetConsensus()))
+            continue;
+        std::vector<COutPoint> vOutPoints;
+        GetPrefetchOutPoints(block, vOutPoints);
+        QueueOutPoints(vOutPoints, true);
+    }
+}
+
+void CCoinsViewPrefetch::GetCounters(uint64_t& nHitsRet, uint64_t& nMissesRet) const
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    nHitsRet = nHits;
+    nMissesRet = nMisses;
+}
@@ -0,0 +1,88 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef COINSPREFETCH_H
+#define COINSPREFETCH_H
+
+#include "chain.h"
+#include "coins.h"
+
+#include <deque>
+#include <map>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+class CBlock;
+
+/** Default number of threads loading coins ahead of ConnectBlock */
+static const int DEFAULT_PREFETCH_THREADS = 4;
+/** Maximum number of prefetch threads */
+static const int MAX_PREFETCH_THREADS = 16;
+/** Coins held at most by the prefetch layer, it starts over once full */
+static const size_t MAX_PREFETCH_COINS = 200000;
+/** Outpoints a prefetch thread loads at a time */
+static const size_t PREFETCH_CHUNK_SIZE = 64;
+/** Pending chunks and blocks at which new prefetch requests get dropped */
+static const size_t MAX_PREFETCH_QUEUE = 4096;
+
+/**
+ * Read-through layer between pcoinsTip and the chainstate database. Worker
+ * threads load the coins spent by blocks which are about to get connected, so
+ * the misses of the coins cache while connecting them are served from memory
+ * instead of waiting for a database read each.
+ *
+ * Prefetched coins are only used when the cache above doesn't have the
+ * outpoint, which means it hasn't been changed since the last flush, so the
+ * database value read by a worker is current. A flush through BatchWrite
+ * drops the coins it writes and makes the reads still in flight get thrown
+ * away, as they may predate it.
+ */
+class CCoinsViewPrefetch : public CCoinsViewBacked
+{
+private:
+    struct CPrefetchJob
+    {
+        /** Block to read from disk and load the spent coins of, if not null */
+        CDiskBlockPos pos;
+        std::vector<COutPoint> vOutPoints;
+    };
+
+    mutable boost::mutex mutex;
+    boost::condition_variable condWorker;
+    boost::thread_group threadGroup;
+    bool fStop;
+    std::deque<CPrefetchJob> queueJobs;
+    mutable std::map<COutPoint, Coin> mapCoins;
+    /** Bumped before and after every BatchWrite, loads overlapping one are stale */
+    uint64_t nWrites;
+
+    mutable uint64_t nHits;
+    mutable uint64_t nMisses;
+
+    void ThreadPrefetch();
+    void QueueOutPoints(const std::vector<COutPoint>& vOutPoints, bool fFront);
+    void LoadOutPoints(const std::vector<COutPoint>& vOutPoints);
+
+public:
+    CCoinsViewPrefetch(CCoinsView* viewIn, int nThreads);
+    ~CCoinsViewPrefetch();
+
+    bool GetCoin(const COutPoint& outpoint, Coin& coin) const;
+    bool HaveCoin(const COutPoint& outpoint) const;
+    bool BatchWrite(CCoinsMap& mapCoinsIn, const uint256& hashBlock);
+
+    /** Starts loading the coins spent by a block which was just received */
+    void Prefetch(const CBlock& block);
+    /** Same for a block which is on disk already, it is read by a worker thread */
+    void Prefetch(const CDiskBlockPos& pos);
+
+    /** Lookups served from prefetched coins and lookups which went to the database */
+    void GetCounters(uint64_t& nHitsRet, uint64_t& nMissesRet) const;
+};
+
+/** The outpoints spent by a block, leaving out those created by the block itself */
+void GetPrefetchOutPoints(const CBlock& block, std::vector<COutPoint>& vOutPointsRet);
+
+#endif // COINSPREFETCH_H
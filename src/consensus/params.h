@@ -80,6 +80,10 @@ struct Params {
     int64_t nPowTargetSpacing;
     int64_t nPowTargetTimespan;
     int64_t DifficultyAdjustmentInterval() const { return nPowTargetTimespan / nPowTargetSpacing; }
+    /** Chain work the best header chain needs before script checks get skipped for defaultAssumeValid */
+    uint256 nMinimumChainWork;
+    /** By default assume that the signatures in ancestors of this block are valid */
+    uint256 defaultAssumeValid;
 };
 } // namespace Consensus
 
@@ -0,0 +1,142 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "cuckoocache.h"
+
+#include "crypto/common.h"
+
+#include <new>
+#include <string.h>
+
+static const size_t CUCKOO_CACHE_LINE = 64;
+
+CCuckooCache::CCuckooCache(size_t nBytes) : pchMemory(NULL), pBuckets(NULL), nBuckets(0), nRand(0x9e3779b97f4a7c15ULL)
+{
+    static_assert(sizeof(CBucket) == 128, "CCuckooCache buckets must span two cache lines");
+    size_t n = nBytes / sizeof(CBucket);
+    if (n > 0xffffffff)
+        n = 0xffffffff;
+    nBuckets = n;
+    if (nBuckets == 0)
+        return;
+    pchMemory = new unsigned char[(size_t)nBuckets * sizeof(CBucket) + CUCKOO_CACHE_LINE];
+    unsigned char* pchAligned = pchMemory + (CUCKOO_CACHE_LINE - (size_t)pchMemory % CUCKOO_CACHE_LINE) % CUCKOO_CACHE_LINE;
+    pBuckets = reinterpret_cast<CBucket*>(pchAligned);
+    for (uint32_t i = 0; i < nBuckets; i++) {
+        CBucket* pBucket = new (&pBuckets[i]) CBucket;
+        pBucket->nSeq.store(0, std::memory_order_relaxed);
+        pBucket->nFree.store((1 << CUCKOO_BUCKET_SLOTS) - 1, std::memory_order_relaxed);
+        for (int j = 0; j < CUCKOO_BUCKET_SLOTS; j++)
+            for (int k = 0; k < 4; k++)
+                pBucket->vKeys[j][k].store(0, std::memory_order_relaxed);
+    }
+    // published to other threads by whatever hands them the cache
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+CCuckooCache::~CCuckooCache()
+{
+    for (uint32_t i = 0; i < nBuckets; i++)
+        pBuckets[i].~CBucket();
+    delete[] pchMemory;
+}
+
+uint32_t CCuckooCache::GetBucket(const uint256& key, int nHash) const
+{
+    // maps the 32 bits onto [0, nBuckets) without a division
+    return ((uint64_t)ReadLE32(key.begin() + 4 * nHash) * nBuckets) >> 32;
+}
+
+bool CCuckooCache::Find(CBucket& bucket, const uint64_t* pKey, bool fErase) const
+{
+    uint32_t nSeq = bucket.nSeq.load(std::memory_order_acquire);
+    if (nSeq & 1)
+        return false;
+    uint32_t nFree = bucket.nFree.load(std::memory_order_relaxed);
+    int nFound = -1;
+    for (int i = 0; i < CUCKOO_BUCKET_SLOTS && nFound < 0; i++) {
+        if (nFree & (1 << i))
+            continue;
+        if (bucket.vKeys[i][0].load(std::memory_order_relaxed) == pKey[0] &&
+            bucket.vKeys[i][1].load(std::memory_order_relaxed) == pKey[1] &&
+            bucket.vKeys[i][2].load(std::memory_order_relaxed) == pKey[2] &&
+            bucket.vKeys[i][3].load(std::memory_order_relaxed) == pKey[3])
+            nFound = i;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (nFound < 0 || bucket.nSeq.load(std::memory_order_relaxed) != nSeq)
+        return false;
+    // may race with an insert reusing the slot, which then loses its entry
+    if (fErase)
+        bucket.nFree.fetch_or(1 << nFound, std::memory_order_relaxed);
+    return true;
+}
+
+void CCuckooCache::Write(CBucket& bucket, int nSlot, const uint64_t* pKey)
+{
+    uint32_t nSeq = bucket.nSeq.load(std::memory_order_relaxed);
+    bucket.nSeq.store(nSeq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (int k = 0; k < 4; k++)
+        bucket.vKeys[nSlot][k].store(pKey[k], std::memory_order_relaxed);
+    bucket.nFree.fetch_and(~(1 << nSlot), std::memory_order_relaxed);
+    bucket.nSeq.store(nSeq + 2, std::memory_order_release);
+}
+
+bool CCuckooCache::Place(CBucket& bucket, const uint64_t* pKey)
+{
+    uint32_t nFree = bucket.nFree.load(std::memory_order_relaxed);
+    for (int i = 0; i < CUCKOO_BUCKET_SLOTS; i++) {
+        if (nFree & (1 << i)) {
+            Write(bucket, i, pKey);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CCuckooCache::Contains(const uint256& key, bool fErase) const
+{
+    if (nBuckets == 0)
+        return false;
+    uint64_t vKey[4];
+    memcpy(vKey, key.begin(), 32);
+    uint32_t nBucket1 = GetBucket(key, 0);
+    if (Find(pBuckets[nBucket1], vKey, fErase))
+        return true;
+    uint32_t nBucket2 = GetBucket(key, 1);
+    return nBucket2 != nBucket1 && Find(pBuckets[nBucket2], vKey, fErase);
+}
+
+void CCuckooCache::Insert(const uint256& key)
+{
+    if (nBuckets == 0)
+        return;
+    boost::unique_lock<boost::mutex> lock(mutex);
+    uint256 keyCurrent = key;
+    uint64_t vKey[4];
+    for (int nKicks = 0; nKicks <= CUCKOO_MAX_KICKS; nKicks++) {
+        memcpy(vKey, keyCurrent.begin(), 32);
+        CBucket& bucket1 = pBuckets[GetBucket(keyCurrent, 0)];
+        CBucket& bucket2 = pBuckets[GetBucket(keyCurrent, 1)];
+        if (Place(bucket1, vKey) || Place(bucket2, vKey))
+            return;
+        if (nKicks == CUCKOO_MAX_KICKS)
+            break;
+        // make room by moving a random entry of either bucket to its other one
+        nRand ^= nRand << 13;
+        nRand ^= nRand >> 7;
+        nRand ^= nRand << 17;
+        CBucket& bucket = (nRand & 1) ? bucket2 : bucket1;
+        int nSlot = (nRand >> 1) % CUCKOO_BUCKET_SLOTS;
+        uint256 keyVictim;
+        for (int k = 0; k < 4; k++) {
+            uint64_t nWord = bucket.vKeys[nSlot][k].load(std::memory_order_relaxed);
+            memcpy(keyVictim.begin() + 8 * k, &nWord, 8);
+        }
+        Write(bucket, nSlot, vKey);
+        keyCurrent = keyVictim;
+    }
+    // keyCurrent is dropped, this part of the table is full
+}
@@ -0,0 +1,80 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef CUCKOOCACHE_H
+#define CUCKOOCACHE_H
+
+#include "uint256.h"
+
+#include <atomic>
+#include <stdint.h>
+
+#include <boost/thread/mutex.hpp>
+
+/** Entries held by a bucket of CCuckooCache */
+static const int CUCKOO_BUCKET_SLOTS = 3;
+/** Entries moved around to make room for a new one before the last one moved is dropped */
+static const int CUCKOO_MAX_KICKS = 16;
+
+/**
+ * Fixed size set of uint256 keys which are uniformly distributed already,
+ * such as salted hashes, for use as a cache: inserting into a full cache
+ * drops other entries.
+ *
+ * Every key can go into one of two buckets of CUCKOO_BUCKET_SLOTS entries,
+ * picked by its first and second 32 bits. An insert which finds both full
+ * moves an entry to its other bucket, and so on for up to CUCKOO_MAX_KICKS
+ * entries.
+ *
+ * Lookups take no lock and never wait. Each bucket is written under a
+ * sequence counter which is odd while it changes, a lookup seeing it change
+ * reports a miss, which only costs the caller its own check again. Entries
+ * are erased by setting a flag with a single atomic operation, so a lookup
+ * can erase what it found without a lock as well. Inserts are serialized.
+ */
+class CCuckooCache
+{
+private:
+    /** Two cache lines, aligned to one */
+    struct CBucket
+    {
+        std::atomic<uint32_t> nSeq;
+        /** Bit i set: slot i is free */
+        std::atomic<uint32_t> nFree;
+        std::atomic<uint64_t> vKeys[CUCKOO_BUCKET_SLOTS][4];
+        unsigned char padding[128 - 8 - CUCKOO_BUCKET_SLOTS * 32];
+    };
+
+    unsigned char* pchMemory;
+    CBucket* pBuckets;
+    uint32_t nBuckets;
+
+    /** Serializes inserts */
+    boost::mutex mutex;
+    uint64_t nRand;
+
+    CCuckooCache(const CCuckooCache&);
+    void operator=(const CCuckooCache&);
+
+    uint32_t GetBucket(const uint256& key, int nHash) const;
+    bool Find(CBucket& bucket, const uint64_t* pKey, bool fErase) const;
+    void Write(CBucket& bucket, int nSlot, const uint64_t* pKey);
+    bool Place(CBucket& bucket, const uint64_t* pKey);
+
+public:
+    /** Uses at most nBytes, an empty cache if that is less than a bucket */
+    explicit CCuckooCache(size_t nBytes);
+    ~CCuckooCache();
+
+    /** Whether key is in the cache, removing it if fErase is set and it is */
+    bool Contains(const uint256& key, bool fErase) const;
+    void Insert(const uint256& key);
+
+    /** Number of entries the cache can hold */
+    size_t GetCapacity() const { return (size_t)nBuckets * CUCKOO_BUCKET_SLOTS; }
+    /** Memory used by the table */
+    size_t GetMemoryUsage() const { return (size_t)nBuckets * sizeof(CBucket); }
+};
+
+#endif // CUCKOOCACHE_H
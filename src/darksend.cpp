@@ -12,11 +12,13 @@
 #include "masternode/sync.h"
 #include "masternode/man.h"
 #include "messagesigner.h"
+#include "scheduler.h"
 #include "script/sign.h"
 #include "txmempool.h"
 #include "util.h"
 #include "utilmoneystr.h"
 
+#include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
 
 int nPrivateSendRounds = DEFAULT_PRIVATESEND_ROUNDS;
@@ -26,6 +28,7 @@ bool fEnablePrivateSend = false;
 bool fPrivateSendMultiSession = DEFAULT_PRIVATESEND_MULTISESSION;
 
 CDarksendPool darkSendPool;
+CPrivateSendScheduler privateSendScheduler;
 std::map<uint256, CDarksendBroadcastTx> mapDarksendBroadcastTxes;
 std::vector<CAmount> vecPrivateSendDenominations;
 
@@ -2422,57 +2425,170 @@ void CDarksendPool::UpdatedBlockTip(const CBlockIndex *pindex)
     }
 }
 
-//TODO: Rename/move to core
-void ThreadCheckDarkSendPool()
+void CPrivateSendTask::ClearStats()
+{
+    nRuns = 0;
+    nSkipped = 0;
+    histRunTime.Clear();
+    histLockWait.Clear();
+    histLockHold.Clear();
+}
+
+static void CheckMasternodeList()
+{
+    mnodeman.ProcessMasternodeConnections();
+    mnodeman.CheckAndRemove();
+}
+
+static void CheckDarkSendPool()
+{
+    darkSendPool.CheckTimeout();
+    darkSendPool.CheckForCompleteQueue();
+}
+
+CScheduler& CPrivateSendScheduler::GetScheduler(const CPrivateSendTask& task)
+{
+    return task.fOwnThread ? schedulerOwnThread : *pscheduler;
+}
+
+void CPrivateSendScheduler::AddTask(const CPrivateSendTask& task)
+{
+    vecTasks.push_back(task);
+    int nTask = vecTasks.size() - 1;
+    GetScheduler(task).scheduleFromNow(boost::bind(&CPrivateSendScheduler::Run, this, nTask, false), task.nDelay);
+}
+
+void CPrivateSendScheduler::Start(CScheduler& scheduler, boost::thread_group& threadGroup)
 {
     if(fLiteMode) return; // disable all 3DCoin specific functionality
 
-    static bool fOneThread;
-    if(fOneThread) return;
-    fOneThread = true;
+    LOCK(cs);
+    if(pscheduler) return;
+    pscheduler = &scheduler;
+    nTimeStatsStart = GetTime();
+
+    CScheduler::Function serviceLoop = boost::bind(&CScheduler::serviceQueue, &schedulerOwnThread);
+    threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "privatesend", serviceLoop));
+
+    // try to sync from all available nodes, one step at a time
+    AddTask(CPrivateSendTask("mnsync", 1, 1, false, NULL, boost::bind(&CMasternodeSync::ProcessTick, &masternodeSync)));
+    // every masternode is checked once its MASTERNODE_CHECK_SECONDS passed
+    AddTask(CPrivateSendTask("mncheck", 1, 1, true, NULL, boost::bind(&CMasternodeMan::CheckDue, &mnodeman)));
+    // check if we should activate or ping every few minutes,
+    // slightly postpone first run to give net thread a chance to connect to some peers
+    AddTask(CPrivateSendTask("mnstate", MASTERNODE_MIN_MNP_SECONDS, 15, true, NULL, boost::bind(&CActiveMasternode::ManageState, &activeMasternode)));
+    AddTask(CPrivateSendTask("mnlist", 60, 60, true, NULL, &CheckMasternodeList));
+    // these depend on the chain height and are also run on every new block, see UpdatedBlockTip
+    AddTask(CPrivateSendTask("mnpayments", 60, 60, true, &cs_mapMasternodeBlocks, boost::bind(&CMasternodePayments::CheckAndRemove, &mnpayments)));
+    AddTask(CPrivateSendTask("instantsend", 60, 60, true, &instantsend.cs_instantsend, boost::bind(&CInstantSend::CheckAndRemove, &instantsend)));
+    if(fMasterNode) {
+        CPrivateSendTask taskVerify("mnverify", 5 * 60, 5 * 60, true, NULL, boost::bind(&CMasternodeMan::DoFullVerificationStep, &mnodeman));
+        taskVerify.fOwnThread = true;
+        AddTask(taskVerify);
+    }
+    AddTask(CPrivateSendTask("dspool", 1, 1, true, NULL, &CheckDarkSendPool));
 
-    // Make this thread recognisable as the PrivateSend thread
-    RenameThread("3dcoin-privatesend");
+    CPrivateSendTask taskAutoDenom("dsauto", PRIVATESEND_AUTO_TIMEOUT_MIN, PRIVATESEND_AUTO_TIMEOUT_MIN, true, NULL, boost::bind(&CDarksendPool::DoAutomaticDenominating, &darkSendPool, false));
+    taskAutoDenom.nPeriodJitter = PRIVATESEND_AUTO_TIMEOUT_MAX - PRIVATESEND_AUTO_TIMEOUT_MIN;
+    taskAutoDenom.fOwnThread = true;
+    AddTask(taskAutoDenom);
 
-    unsigned int nTick = 0;
-    unsigned int nDoAutoNextRun = nTick + PRIVATESEND_AUTO_TIMEOUT_MIN;
+    LogPrintf("CPrivateSendScheduler::Start -- %d tasks scheduled\n", vecTasks.size());
+}
 
-    while (true)
+int CPrivateSendScheduler::FindTask(const std::string& strName)
+{
+    for(size_t i = 0; i < vecTasks.size(); i++) {
+        if(vecTasks[i].strName == strName) return i;
+    }
+    return -1;
+}
+
+void CPrivateSendScheduler::Run(int nTask, bool fEvent)
+{
+    boost::function<void()> func;
+    CCriticalSection* pcs;
+    bool fRequireSynced;
+    int64_t nPeriod;
+    CScheduler* pschedulerTask;
     {
-        MilliSleep(1000);
+        LOCK(cs);
+        CPrivateSendTask& task = vecTasks[nTask];
+        if(fEvent) task.fPending = false;
+        func = task.func;
+        pcs = task.pcs;
+        fRequireSynced = task.fRequireSynced;
+        nPeriod = task.nPeriod + (task.nPeriodJitter > 0 ? GetRandInt(task.nPeriodJitter) : 0);
+        pschedulerTask = &GetScheduler(task);
+    }
 
-        // try to sync from all available nodes, one step at a time
-        masternodeSync.ProcessTick();
+    if(ShutdownRequested()) return;
 
-        if(masternodeSync.IsBlockchainSynced() && !ShutdownRequested()) {
+    if(fRequireSynced && !masternodeSync.IsBlockchainSynced()) {
+        LOCK(cs);
+        vecTasks[nTask].nSkipped++;
+    } else {
+        int64_t nTimeStart = GetTimeMicros();
+        int64_t nTimeLocked = nTimeStart;
+        if(pcs) {
+            LOCK(*pcs);
+            nTimeLocked = GetTimeMicros();
+            func();
+        } else {
+            func();
+        }
+        int64_t nTimeEnd = GetTimeMicros();
 
-            nTick++;
+        LOCK(cs);
+        CPrivateSendTask& task = vecTasks[nTask];
+        task.nRuns++;
+        task.histRunTime.Add(nTimeEnd - nTimeStart);
+        if(pcs) {
+            task.histLockWait.Add(nTimeLocked - nTimeStart);
+            task.histLockHold.Add(nTimeEnd - nTimeLocked);
+        }
+    }
 
-            // make sure to check all masternodes first
-            mnodeman.Check();
+    if(!fEvent) {
+        pschedulerTask->scheduleFromNow(boost::bind(&CPrivateSendScheduler::Run, this, nTask, false), nPeriod);
+    }
+}
 
-            // check if we should activate or ping every few minutes,
-            // slightly postpone first run to give net thread a chance to connect to some peers
-            if(nTick % MASTERNODE_MIN_MNP_SECONDS == 15)
-                activeMasternode.ManageState();
+void CPrivateSendScheduler::RunNow(const std::string& strName)
+{
+    LOCK(cs);
+    int nTask = FindTask(strName);
+    if(nTask < 0 || vecTasks[nTask].fPending) return;
+    vecTasks[nTask].fPending = true;
+    GetScheduler(vecTasks[nTask]).scheduleFromNow(boost::bind(&CPrivateSendScheduler::Run, this, nTask, true), 0);
+}
 
-            if(nTick % 60 == 0) {
-                mnodeman.ProcessMasternodeConnections();
-                mnodeman.CheckAndRemove();
-                mnpayments.CheckAndRemove();
-                instantsend.CheckAndRemove();
-            }
-            if(fMasterNode && (nTick % (60 * 5) == 0)) {
-                mnodeman.DoFullVerificationStep();
-            }
+std::vector<CPrivateSendTask> CPrivateSendScheduler::GetTasks(int64_t& nTimeStatsStartRet) const
+{
+    LOCK(cs);
+    nTimeStatsStartRet = nTimeStatsStart;
+    return vecTasks;
+}
 
-            darkSendPool.CheckTimeout();
-            darkSendPool.CheckForCompleteQueue();
+void CPrivateSendScheduler::ResetStats()
+{
+    LOCK(cs);
+    for(size_t i = 0; i < vecTasks.size(); i++) {
+        vecTasks[i].ClearStats();
+    }
+    nTimeStatsStart = GetTime();
+}
 
-            if(nDoAutoNextRun == nTick) {
-                darkSendPool.DoAutomaticDenominating();
-                nDoAutoNextRun = nTick + PRIVATESEND_AUTO_TIMEOUT_MIN + GetRandInt(PRIVATESEND_AUTO_TIMEOUT_MAX - PRIVATESEND_AUTO_TIMEOUT_MIN);
-            }
-        }
+void CPrivateSendScheduler::UpdatedBlockTip(const CBlockIndex *pindex)
+{
+    if(!pindex || !masternodeSync.IsBlockchainSynced()) return;
+
+    {
+        LOCK(cs);
+        if(!pscheduler) return;
     }
+
+    // old payment votes and lock candidates expire by height
+    RunNow("mnpayments");
+    RunNow("instantsend");
 }
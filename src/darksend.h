@@ -5,11 +5,17 @@
 #ifndef DARKSEND_H
 #define DARKSEND_H
 
+#include "latencyhistogram.h"
 #include "masternode.h"
+#include "scheduler.h"
 #include "wallet/wallet.h"
 
+#include <boost/function.hpp>
+#include <boost/thread.hpp>
+
 class CDarksendPool;
 class CDarksendBroadcastTx;
+class CPrivateSendScheduler;
 
 // timeouts
 static const int PRIVATESEND_AUTO_TIMEOUT_MIN       = 5;
@@ -463,6 +469,92 @@ public:
     void UpdatedBlockTip(const CBlockIndex *pindex);
 };
 
-void ThreadCheckDarkSendPool();
+/** A PrivateSend or masternode maintenance job and how long it took so far */
+class CPrivateSendTask
+{
+public:
+    std::string strName;
+    /// Seconds between two runs, a random 0..nPeriodJitter seconds are added every time
+    int64_t nPeriod;
+    int64_t nPeriodJitter;
+    /// Seconds before the first run
+    int64_t nDelay;
+    /// Skip the job until the blockchain is synced
+    bool fRequireSynced;
+    /// Lock the job takes first, if any, it is locked here to measure lock waits and holds
+    CCriticalSection* pcs;
+    boost::function<void()> func;
+    /// Run on the PrivateSend thread, for jobs which can take long enough to hold up the shared scheduler
+    bool fOwnThread;
+
+    /// Set when an extra run was queued by an event and has not started yet
+    bool fPending;
+
+    // stats
+    uint64_t nRuns;
+    uint64_t nSkipped;
+    /// Microseconds from the start of the job till its end
+    CLatencyHistogram histRunTime;
+    /// Microseconds spent waiting for and holding pcs
+    CLatencyHistogram histLockWait;
+    CLatencyHistogram histLockHold;
+
+    CPrivateSendTask(const std::string& strNameIn, int64_t nPeriodIn, int64_t nDelayIn, bool fRequireSyncedIn,
+                     CCriticalSection* pcsIn, const boost::function<void()>& funcIn) :
+        strName(strNameIn),
+        nPeriod(nPeriodIn),
+        nPeriodJitter(0),
+        nDelay(nDelayIn),
+        fRequireSynced(fRequireSyncedIn),
+        pcs(pcsIn),
+        func(funcIn),
+        fOwnThread(false),
+        fPending(false),
+        nRuns(0),
+        nSkipped(0)
+        {}
+
+    void ClearStats();
+};
+
+/**
+ * Runs the PrivateSend and masternode maintenance jobs on CScheduler, each one
+ * with its own period, instead of a thread checking everything every second.
+ * Jobs which depend on the chain height are run on new blocks too. Mixing and
+ * masternode verification connect to other nodes and can take seconds, they
+ * get a scheduler thread of their own so they don't delay the other jobs.
+ */
+class CPrivateSendScheduler
+{
+private:
+    // protects the job list (fixed once started) and their stats
+    mutable CCriticalSection cs;
+
+    CScheduler* pscheduler;
+    CScheduler schedulerOwnThread;
+    std::vector<CPrivateSendTask> vecTasks;
+    int64_t nTimeStatsStart;
+
+    CScheduler& GetScheduler(const CPrivateSendTask& task);
+    void AddTask(const CPrivateSendTask& task);
+    int FindTask(const std::string& strName);
+    /// Run the job, fEvent is set for extra runs which must not schedule the next periodic one
+    void Run(int nTask, bool fEvent);
+    void RunNow(const std::string& strName);
+
+public:
+    CPrivateSendScheduler() : pscheduler(NULL), nTimeStatsStart(0) {}
+
+    /// Schedule all jobs, the PrivateSend thread is added to threadGroup
+    void Start(CScheduler& scheduler, boost::thread_group& threadGroup);
+
+    /// Copy of all jobs with their current stats
+    std::vector<CPrivateSendTask> GetTasks(int64_t& nTimeStatsStartRet) const;
+    void ResetStats();
+
+    void UpdatedBlockTip(const CBlockIndex *pindex);
+};
+
+extern CPrivateSendScheduler privateSendScheduler;
 
 #endif
@@ -40,6 +40,11 @@ public:
      */
     CDBBatch(const std::vector<unsigned char> *obfuscate_key) : obfuscate_key(obfuscate_key) { };
 
+    void Clear()
+    {
+        batch.Clear();
+    }
+
     template <typename K, typename V>
     void Write(const K& key, const V& value)
     {
@@ -26,6 +26,7 @@ void CDSNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindex)
     mnpayments.UpdatedBlockTip(pindex);
     governance.UpdatedBlockTip(pindex);
     masternodeSync.UpdatedBlockTip(pindex);
+    privateSendScheduler.UpdatedBlockTip(pindex);
 }
 
 void CDSNotificationInterface::SyncTransaction(const CTransaction &tx, const CBlock *pblock)
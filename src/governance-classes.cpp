@@ -20,19 +20,25 @@ CGovernanceTriggerManager triggerman;
 
 // SPLIT UP STRING BY DELIMITER
 // http://www.boost.org/doc/libs/1_58_0/doc/html/boost/algorithm/split_idp202406848.html
-std::vector<std::string> SplitBy(std::string strCommand, std::string strDelimit)
+std::vector<std::string> SplitBy(const std::string& strCommand, const std::string& strDelimit)
 {
     std::vector<std::string> vParts;
     boost::split(vParts, strCommand, boost::is_any_of(strDelimit));
 
-    for(int q=0; q<(int)vParts.size(); q++) {
+    // drop empty parts, compacting in place instead of erasing one by one
+    size_t nKept = 0;
+    for(size_t q = 0; q < vParts.size(); q++) {
         if(strDelimit.find(vParts[q]) != std::string::npos) {
-            vParts.erase(vParts.begin()+q);
-            --q;
+            continue;
+        }
+        if(nKept != q) {
+            vParts[nKept].swap(vParts[q]);
         }
+        ++nKept;
     }
+    vParts.resize(nKept);
 
-   return vParts;
+    return vParts;
 }
 
 CAmount ParsePaymentAmount(const std::string& strAmount)
@@ -209,6 +215,7 @@ void CGovernanceTriggerManager::CleanAndRemove()
                             LogPrint("gobject", "CGovernanceTriggerManager::CleanAndRemove -- Expiring outdated object: %s\n", pgovobj->GetHash().ToString());
                             pgovobj->fExpired = true;
                             pgovobj->nDeletionTime = GetAdjustedTime();
+                            governance.ScheduleDeletion(*pgovobj);
                         }
                     }
                 }
@@ -418,31 +425,25 @@ void CSuperblockManager::CreateSuperblock(CMutableTransaction& txNewRet, int nBl
     //       Consider at least following limits:
     //          - max coinbase tx size
     //          - max "budget" available
-    for(int i = 0; i < pSuperblock->CountPayments(); i++) {
-        CGovernancePayment payment;
+    const std::vector<CGovernancePayment>& vecPayments = pSuperblock->GetPayments();
+    txNewRet.vout.reserve(txNewRet.vout.size() + vecPayments.size());
+    voutSuperblockRet.reserve(vecPayments.size());
+    for(int i = 0; i < (int)vecPayments.size(); i++) {
+        const CGovernancePayment& payment = vecPayments[i];
         DBG( cout << "CSuperblockManager::CreateSuperblock i = " << i << endl; );
-        if(pSuperblock->GetPayment(i, payment)) {
-            DBG( cout << "CSuperblockManager::CreateSuperblock Payment found " << endl; );
-            // SET COINBASE OUTPUT TO SUPERBLOCK SETTING
+        // SET COINBASE OUTPUT TO SUPERBLOCK SETTING
 
-            CTxOut txout = CTxOut(payment.nAmount, payment.script);
-            txNewRet.vout.push_back(txout);
-            voutSuperblockRet.push_back(txout);
+        CTxOut txout = CTxOut(payment.nAmount, payment.script);
+        txNewRet.vout.push_back(txout);
+        voutSuperblockRet.push_back(txout);
 
-            // PRINT NICE LOG OUTPUT FOR SUPERBLOCK PAYMENT
+        // PRINT NICE LOG OUTPUT FOR SUPERBLOCK PAYMENT
 
-            CTxDestination address1;
-            ExtractDestination(payment.script, address1);
-            CBitcoinAddress address2(address1);
+        // TODO: PRINT NICE N.N 3DC OUTPUT
 
-            // TODO: PRINT NICE N.N 3DC OUTPUT
-
-            DBG( cout << "CSuperblockManager::CreateSuperblock Before LogPrintf call, nAmount = " << payment.nAmount << endl; );
-            LogPrintf("NEW Superblock : output %d (addr %s, amount %d)\n", i, address2.ToString(), payment.nAmount);
-            DBG( cout << "CSuperblockManager::CreateSuperblock After LogPrintf call " << endl; );
-        } else {
-            DBG( cout << "CSuperblockManager::CreateSuperblock Payment not found " << endl; );
-        }
+        DBG( cout << "CSuperblockManager::CreateSuperblock Before LogPrintf call, nAmount = " << payment.nAmount << endl; );
+        LogPrintf("NEW Superblock : output %d (addr %s, amount %d)\n", i, payment.strAddress, payment.nAmount);
+        DBG( cout << "CSuperblockManager::CreateSuperblock After LogPrintf call " << endl; );
     }
 
     DBG( cout << "CSuperblockManager::CreateSuperblock End" << endl; );
@@ -466,7 +467,8 @@ CSuperblock()
     : nGovObjHash(),
       nEpochStart(0),
       nStatus(SEEN_OBJECT_UNKNOWN),
-      vecPayments()
+      vecPayments(),
+      nPaymentsTotalAmount(0)
 {}
 
 CSuperblock::
@@ -474,7 +476,8 @@ CSuperblock(uint256& nHash)
     : nGovObjHash(nHash),
       nEpochStart(0),
       nStatus(SEEN_OBJECT_UNKNOWN),
-      vecPayments()
+      vecPayments(),
+      nPaymentsTotalAmount(0)
 {
     DBG( cout << "CSuperblock Constructor Start" << endl; );
 
@@ -485,17 +488,35 @@ CSuperblock(uint256& nHash)
         throw std::runtime_error("CSuperblock: Failed to find Governance Object");
     }
 
+    LoadGovernanceObject(*pGovObj);
+}
+
+CSuperblock::
+CSuperblock(CGovernanceObject& govobj)
+    : nGovObjHash(govobj.GetHash()),
+      nEpochStart(0),
+      nStatus(SEEN_OBJECT_UNKNOWN),
+      vecPayments(),
+      nPaymentsTotalAmount(0)
+{
+    LoadGovernanceObject(govobj);
+}
+
+void CSuperblock::LoadGovernanceObject(CGovernanceObject& govobj)
+{
     DBG( cout << "CSuperblock Constructor pGovObj : "
-         << pGovObj->GetDataAsString()
-         << ", nObjectType = " << pGovObj->GetObjectType()
+         << govobj.GetDataAsString()
+         << ", nObjectType = " << govobj.GetObjectType()
          << endl; );
 
-    if (pGovObj->GetObjectType() != GOVERNANCE_OBJECT_TRIGGER) {
+    if (govobj.GetObjectType() != GOVERNANCE_OBJECT_TRIGGER) {
         DBG( cout << "CSuperblock Constructor pHoObj not a trigger, returning" << endl; );
         throw std::runtime_error("CSuperblock: Governance Object not a trigger");
     }
 
-    UniValue obj = pGovObj->GetJSONObject();
+    // shared with the governance object, no need to decode strData again
+    CGovernanceObject::data_sptr_t pObj = govobj.GetDataObject();
+    const UniValue& obj = *pObj;
 
     // FIRST WE GET THE START EPOCH, THE DATE WHICH THE PAYMENT SHALL OCCUR
     nEpochStart = obj["event_block_height"].get_int();
@@ -542,7 +563,7 @@ CAmount CSuperblock::GetPaymentsLimit(int nBlockHeight)
     return nPaymentsLimit;
 }
 
-void CSuperblock::ParsePaymentSchedule(std::string& strPaymentAddresses, std::string& strPaymentAmounts)
+void CSuperblock::ParsePaymentSchedule(const std::string& strPaymentAddresses, const std::string& strPaymentAmounts)
 {
     // SPLIT UP ADDR/AMOUNT STRINGS AND PUT IN VECTORS
 
@@ -575,6 +596,8 @@ void CSuperblock::ParsePaymentSchedule(std::string& strPaymentAddresses, std::st
 
     DBG( cout << "CSuperblock::ParsePaymentSchedule vecParsed1.size() = " << vecParsed1.size() << endl; );
 
+    vecPayments.reserve(vecParsed1.size());
+
     for (int i = 0; i < (int)vecParsed1.size(); i++) {
         CBitcoinAddress address(vecParsed1[i]);
         if (!address.IsValid()) {
@@ -598,9 +621,11 @@ void CSuperblock::ParsePaymentSchedule(std::string& strPaymentAddresses, std::st
         CGovernancePayment payment(address, nAmount);
         if(payment.IsValid()) {
             vecPayments.push_back(payment);
+            nPaymentsTotalAmount += nAmount;
         }
         else {
             vecPayments.clear();
+            nPaymentsTotalAmount = 0;
             std::ostringstream ostr;
             ostr << "CSuperblock::ParsePaymentSchedule -- Invalid payment found: address = " << address.ToString()
                  << ", amount = " << nAmount;
@@ -620,18 +645,6 @@ bool CSuperblock::GetPayment(int nPaymentIndex, CGovernancePayment& paymentRet)
     return true;
 }
 
-CAmount CSuperblock::GetPaymentsTotalAmount()
-{
-    CAmount nPaymentsTotalAmount = 0;
-    int nPayments = CountPayments();
-
-    for(int i = 0; i < nPayments; i++) {
-        nPaymentsTotalAmount += vecPayments[i].nAmount;
-    }
-
-    return nPaymentsTotalAmount;
-}
-
 /**
 *   Is Transaction Valid
 *
@@ -658,8 +671,8 @@ bool CSuperblock::IsValid(const CTransaction& txNew, int nBlockHeight, CAmount b
     int nPayments = CountPayments();
     int nMinerPayments = nOutputs - nPayments;
 
-    LogPrint("gobject", "CSuperblock::IsValid nOutputs = %d, nPayments = %d, strData = %s\n",
-             nOutputs, nPayments, GetGovernanceObject()->GetDataAsHex());
+    LogPrint("gobject", "CSuperblock::IsValid nOutputs = %d, nPayments = %d, nGovObjHash = %s\n",
+             nOutputs, nPayments, nGovObjHash.ToString());
 
     // We require an exact match (including order) between the expected
     // superblock payments and the payments actually in the block.
@@ -689,19 +702,14 @@ bool CSuperblock::IsValid(const CTransaction& txNew, int nBlockHeight, CAmount b
 
     int nVoutIndex = 0;
     for(int i = 0; i < nPayments; i++) {
-        CGovernancePayment payment;
-        if(!GetPayment(i, payment)) {
-            // This shouldn't happen so log a warning
-            LogPrintf("CSuperblock::IsValid -- WARNING: Failed to find payment: %d of %d total payments\n", i, nPayments);
-            continue;
-        }
+        const CGovernancePayment& payment = vecPayments[i];
 
         bool fPaymentMatch = false;
 
         for (int j = nVoutIndex; j < nOutputs; j++) {
-            // Find superblock payment
-            fPaymentMatch = ((payment.script == txNew.vout[j].scriptPubKey) &&
-                             (payment.nAmount == txNew.vout[j].nValue));
+            // Find superblock payment, cheap amount check first
+            fPaymentMatch = ((payment.nAmount == txNew.vout[j].nValue) &&
+                             (payment.script == txNew.vout[j].scriptPubKey));
 
             if (fPaymentMatch) {
                 nVoutIndex = j;
@@ -712,10 +720,7 @@ bool CSuperblock::IsValid(const CTransaction& txNew, int nBlockHeight, CAmount b
         if(!fPaymentMatch) {
             // Superblock payment not found!
 
-            CTxDestination address1;
-            ExtractDestination(payment.script, address1);
-            CBitcoinAddress address2(address1);
-            LogPrintf("CSuperblock::IsValid -- ERROR: Block invalid: %d payment %d to %s not found\n", i, payment.nAmount, address2.ToString());
+            LogPrintf("CSuperblock::IsValid -- ERROR: Block invalid: %d payment %d to %s not found\n", i, payment.nAmount, payment.strAddress);
 
             return false;
         }
@@ -745,23 +750,15 @@ std::string CSuperblockManager::GetRequiredPaymentsString(int nBlockHeight)
 
     // LOOP THROUGH SUPERBLOCK PAYMENTS, CONFIGURE OUTPUT STRING
 
-    for(int i = 0; i < pSuperblock->CountPayments(); i++) {
-        CGovernancePayment payment;
-        if(pSuperblock->GetPayment(i, payment)) {
-            // PRINT NICE LOG OUTPUT FOR SUPERBLOCK PAYMENT
-
-            CTxDestination address1;
-            ExtractDestination(payment.script, address1);
-            CBitcoinAddress address2(address1);
+    const std::vector<CGovernancePayment>& vecPayments = pSuperblock->GetPayments();
+    for(int i = 0; i < (int)vecPayments.size(); i++) {
+        // RETURN NICE OUTPUT FOR CONSOLE
 
-            // RETURN NICE OUTPUT FOR CONSOLE
-
-            if(ret != "Unknown") {
-                ret += ", " + address2.ToString();
-            }
-            else {
-                ret = address2.ToString();
-            }
+        if(ret != "Unknown") {
+            ret += ", " + vecPayments[i].strAddress;
+        }
+        else {
+            ret = vecPayments[i].strAddress;
         }
     }
 
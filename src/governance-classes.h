@@ -28,7 +28,7 @@ typedef boost::shared_ptr<CSuperblock> CSuperblock_sptr;
 extern CGovernanceTriggerManager triggerman;
 
 // SPLIT A STRING UP - USED FOR SUPERBLOCK PAYMENTS
-std::vector<std::string> SplitBy(std::string strCommand, std::string strDelimit);
+std::vector<std::string> SplitBy(const std::string& strCommand, const std::string& strDelimit);
 
 /**
 *   Trigger Mananger
@@ -91,23 +91,28 @@ private:
 public:
     CScript script;
     CAmount nAmount;
+    /// Base58 form of the payee, kept for logging and RPC output
+    std::string strAddress;
 
     CGovernancePayment()
         :fValid(false),
          script(),
-         nAmount(0)
+         nAmount(0),
+         strAddress()
     {}
 
     CGovernancePayment(CBitcoinAddress addrIn, CAmount nAmountIn)
         :fValid(false),
          script(),
-         nAmount(0)
+         nAmount(0),
+         strAddress()
     {
         try
         {
             CTxDestination dest = addrIn.Get();
             script = GetScriptForDestination(dest);
             nAmount = nAmountIn;
+            strAddress = addrIn.ToString();
             fValid = true;
         }
         catch(std::exception& e)
@@ -141,6 +146,9 @@ public:
 *       "payment_addresses" : "addr1|addr2|addr3",
 *       "payment_amounts"   : "amount1|amount2|amount3"
 *   }
+*
+*   The payment schedule is parsed once when the trigger is added and is not
+*   modified afterwards, block validation and creation only read it.
 */
 
 class CSuperblock : public CGovernanceObject
@@ -151,13 +159,16 @@ private:
     int nEpochStart;
     int nStatus;
     std::vector<CGovernancePayment> vecPayments;
+    CAmount nPaymentsTotalAmount;
 
-    void ParsePaymentSchedule(std::string& strPaymentAddresses, std::string& strPaymentAmounts);
+    void LoadGovernanceObject(CGovernanceObject& govobj);
+    void ParsePaymentSchedule(const std::string& strPaymentAddresses, const std::string& strPaymentAmounts);
 
 public:
 
     CSuperblock();
     CSuperblock(uint256& nHash);
+    explicit CSuperblock(CGovernanceObject& govobj);
 
     static bool IsValidBlockHeight(int nBlockHeight);
     static CAmount GetPaymentsLimit(int nBlockHeight);
@@ -200,8 +211,9 @@ public:
     }
 
     int CountPayments() { return (int)vecPayments.size(); }
+    const std::vector<CGovernancePayment>& GetPayments() const { return vecPayments; }
     bool GetPayment(int nPaymentIndex, CGovernancePayment& paymentRet);
-    CAmount GetPaymentsTotalAmount();
+    CAmount GetPaymentsTotalAmount() { return nPaymentsTotalAmount; }
 
     bool IsValid(const CTransaction& txNew, int nBlockHeight, CAmount blockReward);
 };
@@ -22,6 +22,7 @@ CGovernanceObject::CGovernanceObject()
   nDeletionTime(0),
   nCollateralHash(),
   strData(),
+  pDataObject(),
   vinMasternode(),
   vchSig(),
   fCachedLocalValidity(false),
@@ -50,6 +51,7 @@ CGovernanceObject::CGovernanceObject(uint256 nHashParentIn, int nRevisionIn, int
   nDeletionTime(0),
   nCollateralHash(nCollateralHashIn),
   strData(strDataIn),
+  pDataObject(),
   vinMasternode(),
   vchSig(),
   fCachedLocalValidity(false),
@@ -78,6 +80,7 @@ CGovernanceObject::CGovernanceObject(const CGovernanceObject& other)
   nDeletionTime(other.nDeletionTime),
   nCollateralHash(other.nCollateralHash),
   strData(other.strData),
+  pDataObject(other.pDataObject),
   vinMasternode(other.vinMasternode),
   vchSig(other.vchSig),
   fCachedLocalValidity(other.fCachedLocalValidity),
@@ -182,6 +185,7 @@ bool CGovernanceObject::ProcessVote(CNode* pfrom,
     fileVotes.AddVote(vote);
     mnodeman.AddGovernanceVote(vote.GetVinMasternode(), vote.GetParentHash());
     fDirtyCache = true;
+    governance.AddMasternodeVote(vote);
     return true;
 }
 
@@ -200,29 +204,16 @@ void CGovernanceObject::RebuildVoteMap()
     mapCurrentMNVotes = mapMNVotesNew;
 }
 
-void CGovernanceObject::ClearMasternodeVotes()
+std::vector<uint256> CGovernanceObject::ClearMasternodeVotes(const CTxIn& vinMasternode)
 {
-    vote_m_it it = mapCurrentMNVotes.begin();
-    while(it != mapCurrentMNVotes.end()) {
-        bool fIndexRebuilt = false;
-        CTxIn vinMasternode;
-        bool fRemove = true;
-        if(mnodeman.Get(it->first, vinMasternode, fIndexRebuilt)) {
-            if(mnodeman.Has(vinMasternode)) {
-                fRemove = false;
-            }
-            else {
-                fileVotes.RemoveVotesFromMasternode(vinMasternode);
-            }
-        }
-
-        if(fRemove) {
-            mapCurrentMNVotes.erase(it++);
-        }
-        else {
-            ++it;
-        }
+    // Index of a removed masternode stays valid until the index is rebuilt,
+    // a rebuild drops its votes from mapCurrentMNVotes anyway (see RebuildVoteMap)
+    int nMNIndex = governance.GetMasternodeIndex(vinMasternode);
+    if(nMNIndex >= 0) {
+        mapCurrentMNVotes.erase(nMNIndex);
     }
+    fDirtyCache = true;
+    return fileVotes.RemoveVotesFromMasternode(vinMasternode);
 }
 
 std::string CGovernanceObject::GetSignatureMessage() const
@@ -322,14 +313,33 @@ UniValue CGovernanceObject::GetJSONObject()
         return obj;
     }
 
+    obj = *GetDataObject();
+
+    return obj;
+}
+
+/**
+   Return the parsed JSON object, strData is decoded and parsed only once.
+
+   strData is covered by the object hash so the result never changes for
+   this object and can be shared with copies and superblock triggers.
+ */
+CGovernanceObject::data_sptr_t CGovernanceObject::GetDataObject()
+{
+    LOCK(cs);
+
+    if(pDataObject) {
+        return pDataObject;
+    }
+
     UniValue objResult(UniValue::VOBJ);
     GetData(objResult);
 
     std::vector<UniValue> arr1 = objResult.getValues();
     std::vector<UniValue> arr2 = arr1.at( 0 ).getValues();
-    obj = arr2.at( 1 );
+    pDataObject.reset(new UniValue(arr2.at( 1 )));
 
-    return obj;
+    return pDataObject;
 }
 
 /**
@@ -351,15 +361,12 @@ void CGovernanceObject::LoadData()
 
     try  {
         // ATTEMPT TO LOAD JSON STRING FROM STRDATA
-        UniValue objResult(UniValue::VOBJ);
-        GetData(objResult);
-
         DBG( cout << "CGovernanceObject::LoadData strData = "
              << GetDataAsString()
              << endl; );
 
-        UniValue obj = GetJSONObject();
-        nObjectType = obj["type"].get_int();
+        data_sptr_t pObj = GetDataObject();
+        nObjectType = (*pObj)["type"].get_int();
     }
     catch(std::exception& e) {
         fUnparsable = true;
@@ -705,6 +712,7 @@ void CGovernanceObject::swap(CGovernanceObject& first, CGovernanceObject& second
     swap(first.nDeletionTime, second.nDeletionTime);
     swap(first.nCollateralHash, second.nCollateralHash);
     swap(first.strData, second.strData);
+    swap(first.pDataObject, second.pDataObject);
     swap(first.nObjectType, second.nObjectType);
 
     // swap all cached valid flags
@@ -18,6 +18,8 @@
 
 #include <univalue.h>
 
+#include <boost/shared_ptr.hpp>
+
 class CGovernanceManager;
 class CGovernanceTriggerManager;
 class CGovernanceObject;
@@ -121,6 +123,8 @@ public: // Types
 
     typedef vote_m_t::const_iterator vote_m_cit;
 
+    typedef boost::shared_ptr<const UniValue> data_sptr_t;
+
     typedef CacheMultiMap<CTxIn, vote_time_pair_t> vote_mcache_t;
 
 private:
@@ -148,6 +152,9 @@ private:
     /// Data field - can be used for anything
     std::string strData;
 
+    /// Parsed strData, built on first use and shared between copies of the object
+    data_sptr_t pDataObject;
+
     /// Masternode info for signed objects
     CTxIn vinMasternode;
     std::vector<unsigned char> vchSig;
@@ -278,6 +285,9 @@ public:
 
     UniValue GetJSONObject();
 
+    /// Parsed inner JSON object of strData, throws if the data can't be parsed
+    data_sptr_t GetDataObject();
+
     void Relay();
 
     uint256 GetHash() const;
@@ -313,6 +323,9 @@ public:
         READWRITE(nTime);
         READWRITE(nCollateralHash);
         READWRITE(LIMITED_STRING(strData, MAX_GOVERNANCE_OBJECT_DATA_SIZE));
+        if(ser_action.ForRead()) {
+            pDataObject.reset();
+        }
         READWRITE(nObjectType);
         READWRITE(vinMasternode);
         READWRITE(vchSig);
@@ -346,8 +359,8 @@ private:
 
     void RebuildVoteMap();
 
-    /// Called when MN's which have voted on this object have been removed
-    void ClearMasternodeVotes();
+    /// Called when a MN which has voted on this object has been removed, returns hashes of the removed votes
+    std::vector<uint256> ClearMasternodeVotes(const CTxIn& vinMasternode);
 
     void CheckOrphanVotes();
 
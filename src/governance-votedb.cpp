@@ -53,18 +53,23 @@ std::vector<CGovernanceVote> CGovernanceObjectVoteFile::GetVotes() const
     return vecResult;
 }
 
-void CGovernanceObjectVoteFile::RemoveVotesFromMasternode(const CTxIn& vinMasternode)
+std::vector<uint256> CGovernanceObjectVoteFile::RemoveVotesFromMasternode(const CTxIn& vinMasternode)
 {
+    std::vector<uint256> vecRemoved;
     vote_l_it it = listVotes.begin();
     while(it != listVotes.end()) {
         if(it->GetVinMasternode() == vinMasternode) {
-            mapVoteIndex.erase(it->GetHash());
+            uint256 nHash = it->GetHash();
+            vecRemoved.push_back(nHash);
+            mapVoteIndex.erase(nHash);
             listVotes.erase(it++);
+            --nMemoryVotes;
         }
         else {
             ++it;
         }
     }
+    return vecRemoved;
 }
 
 CGovernanceObjectVoteFile& CGovernanceObjectVoteFile::operator=(const CGovernanceObjectVoteFile& other)
@@ -72,7 +72,10 @@ public:
 
     CGovernanceObjectVoteFile& operator=(const CGovernanceObjectVoteFile& other);
 
-    void RemoveVotesFromMasternode(const CTxIn& vinMasternode);
+    /**
+     * Remove all votes cast by the given masternode, returns the hashes of the removed votes
+     */
+    std::vector<uint256> RemoveVotesFromMasternode(const CTxIn& vinMasternode);
 
     ADD_SERIALIZE_METHODS;
 
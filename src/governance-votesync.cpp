@@ -0,0 +1,278 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "governance-votesync.h"
+#include "tinyformat.h"
+
+#include <algorithm>
+
+const size_t CGovernanceVoteSync::PEERS_PER_OBJECT_MAX;
+const int64_t CGovernanceVoteSync::REASK_DELAY;
+const int64_t CGovernanceVoteSync::REQUEST_TIMEOUT;
+const int64_t CGovernanceVoteSync::PEER_EXPIRATION_TIME;
+const int CGovernanceVoteSync::QUEUE_SCAN_MAX;
+
+CGovernanceVoteSync::CGovernanceVoteSync()
+    : mapObjects(),
+      setQueue(),
+      mapReaskTimes(),
+      mapPeers(),
+      nRequestsTotal(0),
+      nResponsesTotal(0),
+      nTimeoutsTotal(0)
+{}
+
+void CGovernanceVoteSync::AddObject(const uint256& nHash, bool fTrigger, int64_t nNow)
+{
+    if(mapObjects.count(nHash)) {
+        return;
+    }
+    object_rec_t& rec = mapObjects[nHash];
+    rec.fTrigger = fTrigger;
+    rec.nTimeChanged = nNow;
+    Enqueue(nHash, rec);
+}
+
+void CGovernanceVoteSync::RemoveObject(const uint256& nHash)
+{
+    object_m_it it = mapObjects.find(nHash);
+    if(it == mapObjects.end()) {
+        return;
+    }
+    Dequeue(nHash, it->second);
+    // Stale entries in mapReaskTimes and in peer queues are skipped when they come up
+    mapObjects.erase(it);
+}
+
+void CGovernanceVoteSync::ObjectChanged(const uint256& nHash, int64_t nNow)
+{
+    object_m_it it = mapObjects.find(nHash);
+    if(it == mapObjects.end()) {
+        return;
+    }
+    object_rec_t& rec = it->second;
+    if(rec.nTimeChanged >= nNow) {
+        return;
+    }
+    if(rec.fQueued) {
+        setQueue.erase(GetKey(nHash, rec));
+        rec.nTimeChanged = nNow;
+        setQueue.insert(GetKey(nHash, rec));
+    }
+    else {
+        rec.nTimeChanged = nNow;
+    }
+}
+
+void CGovernanceVoteSync::ResponseReceived(NodeId id, const uint256& nHash, int64_t nNow)
+{
+    peer_m_it it = mapPeers.find(id);
+    if(it == mapPeers.end()) {
+        return;
+    }
+    peer_rec_t& peer = it->second;
+
+    // Replies to requests which timed out already or which we never sent are ignored
+    std::deque<std::pair<uint256, int64_t> >::iterator itReq = peer.dqInFlight.begin();
+    while(itReq != peer.dqInFlight.end() && itReq->first != nHash) {
+        ++itReq;
+    }
+    if(itReq == peer.dqInFlight.end()) {
+        return;
+    }
+
+    int64_t nLatency = std::max(int64_t(0), nNow - itReq->second);
+    peer.dqInFlight.erase(itReq);
+    peer.nLatencyAvg = (peer.nResponses == 0) ? nLatency : (peer.nLatencyAvg * 7 + nLatency) / 8;
+    ++peer.nResponses;
+    ++nResponsesTotal;
+}
+
+std::vector<CGovernanceVoteSync::request_t> CGovernanceVoteSync::Schedule(const std::vector<peer_info_t>& vPeers, int64_t nNow,
+                                                                            int nMaxInFlightPerPeer, size_t nProjectedVotes)
+{
+    std::vector<request_t> vecRequests;
+
+    ExpireAsks(nNow);
+    ExpireRequests(nNow);
+
+    // Register peers and order them by their average response time, fastest first
+    std::vector<std::pair<int64_t, size_t> > vecOrder;
+    for(size_t i = 0; i < vPeers.size(); ++i) {
+        peer_rec_t& peer = mapPeers[vPeers[i].id];
+        peer.addr = vPeers[i].addr;
+        peer.nTimeLastSeen = nNow;
+        vecOrder.push_back(std::make_pair(peer.nLatencyAvg, i));
+    }
+    std::sort(vecOrder.begin(), vecOrder.end());
+
+    peer_m_it itPeer = mapPeers.begin();
+    while(itPeer != mapPeers.end()) {
+        if(itPeer->second.nTimeLastSeen + PEER_EXPIRATION_TIME < nNow) {
+            mapPeers.erase(itPeer++);
+        }
+        else {
+            ++itPeer;
+        }
+    }
+
+    // Don't wait for more peers than we actually have
+    size_t nPeersPerObject = PEERS_PER_OBJECT_MAX;
+    if(mapPeers.size() < nPeersPerObject) {
+        nPeersPerObject = mapPeers.size();
+    }
+    if(nPeersPerObject == 0) {
+        return vecRequests;
+    }
+
+    std::vector<int> vecBudget(vecOrder.size(), 0);
+    int nBudgetTotal = 0;
+    for(size_t j = 0; j < vecOrder.size(); ++j) {
+        const peer_info_t& info = vPeers[vecOrder[j].second];
+        const peer_rec_t& peer = mapPeers[info.id];
+        int nInFlight = (int)peer.dqInFlight.size();
+        int nBudget = (IsSlowPeer(peer) ? 1 : nMaxInFlightPerPeer) - nInFlight;
+        // stop early to prevent setAskFor overflow
+        while(nBudget > 0 && info.nAskForSize + (nInFlight + nBudget) * nProjectedVotes > SETASKFOR_MAX_SZ/2) {
+            --nBudget;
+        }
+        vecBudget[j] = std::max(0, nBudget);
+        nBudgetTotal += vecBudget[j];
+    }
+
+    std::vector<uint256> vecAsked;
+    int nScanned = 0;
+    std::set<queue_key_t>::const_iterator itQueue = setQueue.begin();
+    while(itQueue != setQueue.end() && nBudgetTotal > 0 && nScanned < QUEUE_SCAN_MAX) {
+        const uint256& nHash = itQueue->nHash;
+        object_rec_t& rec = mapObjects[nHash];
+        for(size_t j = 0; j < vecOrder.size() && rec.mapAskedPeers.size() < nPeersPerObject; ++j) {
+            if(vecBudget[j] <= 0) continue;
+            const peer_info_t& info = vPeers[vecOrder[j].second];
+            if(rec.mapAskedPeers.count(info.addr)) continue;
+
+            int64_t nTimeReask = nNow + REASK_DELAY;
+            rec.mapAskedPeers[info.addr] = nTimeReask;
+            mapReaskTimes.insert(std::make_pair(nTimeReask, std::make_pair(nHash, info.addr)));
+            mapPeers[info.id].dqInFlight.push_back(std::make_pair(nHash, nNow));
+            vecRequests.push_back(request_t(info.id, nHash));
+            --vecBudget[j];
+            --nBudgetTotal;
+        }
+        if(rec.mapAskedPeers.size() >= nPeersPerObject) {
+            vecAsked.push_back(nHash);
+        }
+        ++itQueue;
+        ++nScanned;
+    }
+
+    for(size_t i = 0; i < vecAsked.size(); ++i) {
+        Dequeue(vecAsked[i], mapObjects[vecAsked[i]]);
+    }
+
+    nRequestsTotal += vecRequests.size();
+    return vecRequests;
+}
+
+int CGovernanceVoteSync::GetInFlight(NodeId id) const
+{
+    peer_m_t::const_iterator it = mapPeers.find(id);
+    if(it == mapPeers.end()) {
+        return 0;
+    }
+    return (int)it->second.dqInFlight.size();
+}
+
+int64_t CGovernanceVoteSync::GetLatency(NodeId id) const
+{
+    peer_m_t::const_iterator it = mapPeers.find(id);
+    if(it == mapPeers.end()) {
+        return 0;
+    }
+    return it->second.nLatencyAvg;
+}
+
+void CGovernanceVoteSync::Clear()
+{
+    mapObjects.clear();
+    setQueue.clear();
+    mapReaskTimes.clear();
+    mapPeers.clear();
+}
+
+std::string CGovernanceVoteSync::ToString() const
+{
+    return strprintf("Objects: %d, queued: %d, peers: %d, requests: %d, responses: %d, timeouts: %d",
+                     (int)mapObjects.size(), (int)setQueue.size(), (int)mapPeers.size(),
+                     nRequestsTotal, nResponsesTotal, nTimeoutsTotal);
+}
+
+CGovernanceVoteSync::queue_key_t CGovernanceVoteSync::GetKey(const uint256& nHash, const object_rec_t& rec) const
+{
+    queue_key_t key;
+    key.fTrigger = rec.fTrigger;
+    key.nTimeChanged = rec.nTimeChanged;
+    key.nHash = nHash;
+    return key;
+}
+
+void CGovernanceVoteSync::Enqueue(const uint256& nHash, object_rec_t& rec)
+{
+    if(rec.fQueued) {
+        return;
+    }
+    setQueue.insert(GetKey(nHash, rec));
+    rec.fQueued = true;
+}
+
+void CGovernanceVoteSync::Dequeue(const uint256& nHash, object_rec_t& rec)
+{
+    if(!rec.fQueued) {
+        return;
+    }
+    setQueue.erase(GetKey(nHash, rec));
+    rec.fQueued = false;
+}
+
+void CGovernanceVoteSync::ExpireAsks(int64_t nNow)
+{
+    expiry_mm_t::iterator it = mapReaskTimes.begin();
+    while(it != mapReaskTimes.end() && it->first <= nNow) {
+        object_m_it itObj = mapObjects.find(it->second.first);
+        if(itObj != mapObjects.end()) {
+            object_rec_t& rec = itObj->second;
+            std::map<CService, int64_t>::iterator itAsked = rec.mapAskedPeers.find(it->second.second);
+            // entry might be outdated if the request timed out and was asked again
+            if(itAsked != rec.mapAskedPeers.end() && itAsked->second == it->first) {
+                rec.mapAskedPeers.erase(itAsked);
+                Enqueue(itObj->first, rec);
+            }
+        }
+        mapReaskTimes.erase(it++);
+    }
+}
+
+void CGovernanceVoteSync::ExpireRequests(int64_t nNow)
+{
+    for(peer_m_it it = mapPeers.begin(); it != mapPeers.end(); ++it) {
+        peer_rec_t& peer = it->second;
+        while(!peer.dqInFlight.empty() && peer.dqInFlight.front().second + REQUEST_TIMEOUT <= nNow) {
+            // Let some other peer answer instead
+            object_m_it itObj = mapObjects.find(peer.dqInFlight.front().first);
+            if(itObj != mapObjects.end()) {
+                itObj->second.mapAskedPeers.erase(peer.addr);
+                Enqueue(itObj->first, itObj->second);
+            }
+            peer.dqInFlight.pop_front();
+            peer.nLatencyAvg = (peer.nLatencyAvg * 7 + REQUEST_TIMEOUT) / 8;
+            ++peer.nTimeouts;
+            ++nTimeoutsTotal;
+        }
+    }
+}
+
+bool CGovernanceVoteSync::IsSlowPeer(const peer_rec_t& peer) const
+{
+    return (peer.nTimeouts > peer.nResponses) || (peer.nLatencyAvg > REQUEST_TIMEOUT / 2);
+}
@@ -0,0 +1,200 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef GOVERNANCE_VOTESYNC_H
+#define GOVERNANCE_VOTESYNC_H
+
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "net.h"
+#include "uint256.h"
+
+/// Default number of pipelined vote sync requests per peer
+static const int GOVERNANCE_VOTESYNC_INFLIGHT_MAX = 4;
+
+/**
+ * Schedules per-object vote sync requests (MNGOVERNANCESYNC with an object hash)
+ * across peers.
+ *
+ * Objects waiting for vote sync are kept in a priority queue ordered by
+ * type (triggers first) and by the time they last changed (newest first), so
+ * a call only touches the head of the queue instead of walking every object.
+ * Every peer has an in-flight budget which allows several requests to be
+ * pipelined; a request is completed by the SYNCSTATUSCOUNT reply naming the
+ * object which the peer sends at the end of its answer, which also gives us the
+ * response latency.
+ * Peers which answer slowly or not at all are limited to a single request.
+ *
+ * Not thread safe, the owner (CGovernanceManager) must serialize access.
+ */
+class CGovernanceVoteSync
+{
+public: // Types
+    struct peer_info_t {
+        peer_info_t(NodeId idIn, const CService& addrIn, size_t nAskForSizeIn)
+            : id(idIn),
+              addr(addrIn),
+              nAskForSize(nAskForSizeIn)
+            {}
+
+        NodeId id;
+        CService addr;
+        /// Number of inventory items the peer already has queued for us
+        size_t nAskForSize;
+    };
+
+    struct request_t {
+        request_t(NodeId idIn, const uint256& nHashIn)
+            : id(idIn),
+              nHash(nHashIn)
+            {}
+
+        NodeId id;
+        uint256 nHash;
+    };
+
+private: // Types
+    /// Queue order: triggers first, then most recently changed, then by hash
+    struct queue_key_t {
+        bool fTrigger;
+        int64_t nTimeChanged;
+        uint256 nHash;
+
+        bool operator<(const queue_key_t& other) const
+        {
+            if(fTrigger != other.fTrigger) return fTrigger;
+            if(nTimeChanged != other.nTimeChanged) return nTimeChanged > other.nTimeChanged;
+            return nHash < other.nHash;
+        }
+    };
+
+    struct object_rec_t {
+        object_rec_t()
+            : fTrigger(false),
+              nTimeChanged(0),
+              fQueued(false),
+              mapAskedPeers()
+            {}
+
+        bool fTrigger;
+        int64_t nTimeChanged;
+        bool fQueued;
+        /// Peers asked for this object and the time we may ask them again
+        std::map<CService, int64_t> mapAskedPeers;
+    };
+
+    struct peer_rec_t {
+        peer_rec_t()
+            : addr(),
+              dqInFlight(),
+              nLatencyAvg(0),
+              nResponses(0),
+              nTimeouts(0),
+              nTimeLastSeen(0)
+            {}
+
+        CService addr;
+        /// Outstanding requests in the order they were sent, with send time
+        std::deque<std::pair<uint256, int64_t> > dqInFlight;
+        /// Exponential moving average of the response time, ms
+        int64_t nLatencyAvg;
+        int nResponses;
+        int nTimeouts;
+        int64_t nTimeLastSeen;
+    };
+
+    typedef std::map<uint256, object_rec_t> object_m_t;
+
+    typedef object_m_t::iterator object_m_it;
+
+    typedef std::map<NodeId, peer_rec_t> peer_m_t;
+
+    typedef peer_m_t::iterator peer_m_it;
+
+    typedef std::multimap<int64_t, std::pair<uint256, CService> > expiry_mm_t;
+
+public:
+    /// How many different peers are asked for the votes of a single object
+    static const size_t PEERS_PER_OBJECT_MAX = 3;
+
+    /// How long a peer is not asked again for the same object, ms
+    static const int64_t REASK_DELAY = 60 * 60 * 1000;
+
+    /// How long we wait for a peer to answer a request, ms
+    static const int64_t REQUEST_TIMEOUT = 30 * 1000;
+
+    /// Peers not seen for this long are forgotten, ms
+    static const int64_t PEER_EXPIRATION_TIME = 60 * 60 * 1000;
+
+    /// Upper bound on queue entries examined by a single Schedule call
+    static const int QUEUE_SCAN_MAX = 1000;
+
+private:
+    object_m_t mapObjects;
+
+    std::set<queue_key_t> setQueue;
+
+    expiry_mm_t mapReaskTimes;
+
+    peer_m_t mapPeers;
+
+    int64_t nRequestsTotal;
+
+    int64_t nResponsesTotal;
+
+    int64_t nTimeoutsTotal;
+
+public:
+    CGovernanceVoteSync();
+
+    /// Start tracking an object, it is queued for vote sync immediately
+    void AddObject(const uint256& nHash, bool fTrigger, int64_t nNow);
+
+    void RemoveObject(const uint256& nHash);
+
+    /// Moves the object ahead of objects which changed less recently
+    void ObjectChanged(const uint256& nHash, int64_t nNow);
+
+    /// Called when a peer finished answering its request for nHash
+    void ResponseReceived(NodeId id, const uint256& nHash, int64_t nNow);
+
+    /**
+     * Pick the next requests to send to the given peers.
+     * nMaxInFlightPerPeer limits pipelining per peer and nProjectedVotes
+     * is the number of vote inventory items one request is expected to add
+     * to the peer's setAskFor.
+     */
+    std::vector<request_t> Schedule(const std::vector<peer_info_t>& vPeers, int64_t nNow,
+                                    int nMaxInFlightPerPeer, size_t nProjectedVotes);
+
+    /// Number of objects which still have to be asked from more peers
+    int GetQueueSize() const { return (int)setQueue.size(); }
+
+    int GetInFlight(NodeId id) const;
+
+    int64_t GetLatency(NodeId id) const;
+
+    void Clear();
+
+    std::string ToString() const;
+
+private:
+    queue_key_t GetKey(const uint256& nHash, const object_rec_t& rec) const;
+
+    void Enqueue(const uint256& nHash, object_rec_t& rec);
+
+    void Dequeue(const uint256& nHash, object_rec_t& rec);
+
+    void ExpireAsks(int64_t nNow);
+
+    void ExpireRequests(int64_t nNow);
+
+    bool IsSlowPeer(const peer_rec_t& peer) const;
+};
+
+#endif
@@ -38,6 +38,8 @@ CGovernanceManager::CGovernanceManager()
       mapOrphanVotes(MAX_CACHE_SIZE),
       mapLastMasternodeObject(),
       setRequestedObjects(),
+      setRequestedVotes(),
+      voteSync(),
       fRateChecksEnabled(true),
       cs()
 {}
@@ -353,7 +355,12 @@ bool CGovernanceManager::AddGovernanceObject(CGovernanceObject& govobj, CNode* p
     }
 
     // INSERT INTO OUR GOVERNANCE OBJECT MEMORY
-    mapObjects.insert(std::make_pair(nHash, govobj));
+    CGovernanceObject& govobjAdded = mapObjects.insert(std::make_pair(nHash, govobj)).first->second;
+    if(govobjAdded.IsSetDirtyCache()) {
+        setDirtyObjects.insert(nHash);
+    }
+    ScheduleDeletion(govobjAdded);
+    voteSync.AddObject(nHash, govobj.nObjectType == GOVERNANCE_OBJECT_TRIGGER, GetTimeMillis());
 
     // SHOULD WE ADD THIS OBJECT TO ANY OTHER MANANGERS?
 
@@ -404,6 +411,7 @@ bool CGovernanceManager::UpdateCurrentWatchdog(CGovernanceObject& watchdogNew)
             if(it->second.nDeletionTime == 0) {
                 it->second.nDeletionTime = nNow;
             }
+            ScheduleDeletion(it->second);
         }
         nHashWatchdogCurrent = watchdogNew.GetHash();
         nTimeWatchdogCurrent = watchdogNew.GetCreationTime();
@@ -419,7 +427,7 @@ void CGovernanceManager::UpdateCachesAndClean()
 {
     LogPrint("gobject", "CGovernanceManager::UpdateCachesAndClean\n");
 
-    std::vector<uint256> vecDirtyHashes = mnodeman.GetAndClearDirtyGovernanceObjectHashes();
+    std::vector<CTxIn> vecRemovedMasternodes = mnodeman.GetAndClearRemovedMasternodeVins();
 
     LOCK(cs);
 
@@ -439,6 +447,7 @@ void CGovernanceManager::UpdateCachesAndClean()
                     if(it2->second.nDeletionTime == 0) {
                         it2->second.nDeletionTime = nNow;
                     }
+                    ScheduleDeletion(it2->second);
                 }
                 if(it->first == nHashWatchdogCurrent) {
                     nHashWatchdogCurrent = uint256();
@@ -451,13 +460,8 @@ void CGovernanceManager::UpdateCachesAndClean()
         }
     }
 
-    for(size_t i = 0; i < vecDirtyHashes.size(); ++i) {
-        object_m_it it = mapObjects.find(vecDirtyHashes[i]);
-        if(it == mapObjects.end()) {
-            continue;
-        }
-        it->second.ClearMasternodeVotes();
-        it->second.fDirtyCache = true;
+    for(size_t i = 0; i < vecRemovedMasternodes.size(); ++i) {
+        RemoveMasternodeVotes(vecRemovedMasternodes[i]);
     }
 
     // DOUBLE CHECK THAT WE HAVE A VALID POINTER TO TIP
@@ -466,77 +470,140 @@ void CGovernanceManager::UpdateCachesAndClean()
 
     fRateChecksEnabled = false;
 
-    LogPrint("gobject", "CGovernanceManager::UpdateCachesAndClean -- After pCurrentBlockIndex (not NULL)\n");
-
-    // UPDATE CACHE FOR EACH OBJECT THAT IS FLAGGED DIRTYCACHE=TRUE
-
-    object_m_it it = mapObjects.begin();
+    LogPrint("gobject", "CGovernanceManager::UpdateCachesAndClean -- After pCurrentBlockIndex (not NULL), dirty objects: %d, scheduled for deletion: %d\n",
+             setDirtyObjects.size(), queueDeletion.size());
 
     // Clean up any expired or invalid triggers
     triggerman.CleanAndRemove();
 
-    while(it != mapObjects.end())
-    {
-        CGovernanceObject* pObj = &((*it).second);
+    // UPDATE CACHE FOR EACH OBJECT THAT IS FLAGGED DIRTYCACHE=TRUE
 
-        if(!pObj) {
-            ++it;
+    for(hash_s_it it = setDirtyObjects.begin(); it != setDirtyObjects.end(); ++it) {
+        object_m_it it2 = mapObjects.find(*it);
+        if(it2 == mapObjects.end()) {
             continue;
         }
+        CGovernanceObject& govobj = it2->second;
 
-        uint256 nHash = it->first;
-        std::string strHash = nHash.ToString();
-
-        // IF CACHE IS NOT DIRTY, WHY DO THIS?
-        if(pObj->IsSetDirtyCache()) {
+        if(govobj.IsSetDirtyCache()) {
             // UPDATE LOCAL VALIDITY AGAINST CRYPTO DATA
-            pObj->UpdateLocalValidity();
+            govobj.UpdateLocalValidity();
 
             // UPDATE SENTINEL SIGNALING VARIABLES
-            pObj->UpdateSentinelVariables();
+            govobj.UpdateSentinelVariables();
         }
 
-        if(pObj->IsSetCachedDelete() && (nHash == nHashWatchdogCurrent)) {
+        if(govobj.IsSetCachedDelete() && (*it == nHashWatchdogCurrent)) {
             nHashWatchdogCurrent = uint256();
         }
 
-        // IF DELETE=TRUE, THEN CLEAN THE MESS UP!
+        ScheduleDeletion(govobj);
+    }
+    setDirtyObjects.clear();
+
+    // IF DELETE=TRUE, THEN CLEAN THE MESS UP!
 
-        int64_t nTimeSinceDeletion = GetAdjustedTime() - pObj->GetDeletionTime();
+    nNow = GetAdjustedTime();
+    while(!queueDeletion.empty() && queueDeletion.top().first <= nNow) {
+        uint256 nHash = queueDeletion.top().second;
+        queueDeletion.pop();
+
+        object_m_it it = mapObjects.find(nHash);
+        if(it == mapObjects.end()) {
+            continue;
+        }
+        CGovernanceObject& govobj = it->second;
+
+        int64_t nTimeSinceDeletion = nNow - govobj.GetDeletionTime();
 
         LogPrint("gobject", "CGovernanceManager::UpdateCachesAndClean -- Checking object for deletion: %s, deletion time = %d, time since deletion = %d, delete flag = %d, expired flag = %d\n",
-                 strHash, pObj->GetDeletionTime(), nTimeSinceDeletion, pObj->IsSetCachedDelete(), pObj->IsSetExpired());
+                 nHash.ToString(), govobj.GetDeletionTime(), nTimeSinceDeletion, govobj.IsSetCachedDelete(), govobj.IsSetExpired());
 
-        if((pObj->IsSetCachedDelete() || pObj->IsSetExpired()) &&
+        // deletion time might have been moved since this entry was queued, a newer entry exists then
+        if((govobj.IsSetCachedDelete() || govobj.IsSetExpired()) &&
            (nTimeSinceDeletion >= GOVERNANCE_DELETION_DELAY)) {
-            LogPrintf("CGovernanceManager::UpdateCachesAndClean -- erase obj %s\n", (*it).first.ToString());
-            mnodeman.RemoveGovernanceObject(pObj->GetHash());
-
-            // Remove vote references
-            const object_ref_cache_t::list_t& listItems = mapVoteToObject.GetItemList();
-            object_ref_cache_t::list_cit lit = listItems.begin();
-            while(lit != listItems.end()) {
-                if(lit->value == pObj) {
-                    uint256 nKey = lit->key;
-                    ++lit;
-                    mapVoteToObject.Erase(nKey);
-                }
-                else {
-                    ++lit;
-                }
-            }
-            if(pObj->nObjectType == GOVERNANCE_OBJECT_WATCHDOG) {
-                mapWatchdogObjects.erase(it->first);
-            }
-            mapObjects.erase(it++);
-        } else {
-            ++it;
+            LogPrintf("CGovernanceManager::UpdateCachesAndClean -- erase obj %s\n", nHash.ToString());
+            RemoveObject(it);
         }
     }
 
     fRateChecksEnabled = true;
 }
 
+void CGovernanceManager::ScheduleDeletion(CGovernanceObject& govobj)
+{
+    LOCK(cs);
+    if(!govobj.IsSetCachedDelete() && !govobj.IsSetExpired()) {
+        return;
+    }
+    queueDeletion.push(time_hash_pair_t(govobj.GetDeletionTime() + GOVERNANCE_DELETION_DELAY, govobj.GetHash()));
+}
+
+void CGovernanceManager::AddMasternodeVote(const CGovernanceVote& vote)
+{
+    LOCK(cs);
+    mapMasternodeVotedObjects[vote.GetVinMasternode().prevout].insert(vote.GetParentHash());
+    setDirtyObjects.insert(vote.GetParentHash());
+}
+
+void CGovernanceManager::RemoveMasternodeVotes(const CTxIn& vinMasternode)
+{
+    txout_hash_s_m_it it = mapMasternodeVotedObjects.find(vinMasternode.prevout);
+    if(it == mapMasternodeVotedObjects.end()) {
+        return;
+    }
+
+    for(hash_s_it it2 = it->second.begin(); it2 != it->second.end(); ++it2) {
+        object_m_it it3 = mapObjects.find(*it2);
+        if(it3 == mapObjects.end()) {
+            continue;
+        }
+        std::vector<uint256> vecRemovedVotes = it3->second.ClearMasternodeVotes(vinMasternode);
+        for(size_t i = 0; i < vecRemovedVotes.size(); ++i) {
+            mapVoteToObject.Erase(vecRemovedVotes[i]);
+        }
+        setDirtyObjects.insert(*it2);
+    }
+
+    LogPrint("gobject", "CGovernanceManager::RemoveMasternodeVotes -- masternode %s, objects %d\n",
+             vinMasternode.prevout.ToStringShort(), it->second.size());
+    mapMasternodeVotedObjects.erase(it);
+}
+
+void CGovernanceManager::RemoveObject(object_m_it it)
+{
+    const uint256& nHash = it->first;
+    CGovernanceObject* pObj = &(it->second);
+
+    mnodeman.RemoveGovernanceObject(nHash);
+
+    // Remove vote references
+    std::vector<CGovernanceVote> vecVotes = pObj->GetVoteFile().GetVotes();
+    for(size_t i = 0; i < vecVotes.size(); ++i) {
+        CGovernanceObject* pVoteObj = NULL;
+        if(mapVoteToObject.Get(vecVotes[i].GetHash(), pVoteObj) && (pVoteObj == pObj)) {
+            mapVoteToObject.Erase(vecVotes[i].GetHash());
+        }
+        txout_hash_s_m_it it2 = mapMasternodeVotedObjects.find(vecVotes[i].GetVinMasternode().prevout);
+        if(it2 != mapMasternodeVotedObjects.end()) {
+            it2->second.erase(nHash);
+            if(it2->second.empty()) {
+                mapMasternodeVotedObjects.erase(it2);
+            }
+        }
+    }
+
+    if(pObj->nObjectType == GOVERNANCE_OBJECT_WATCHDOG) {
+        mapWatchdogObjects.erase(nHash);
+    }
+    if(nHash == nHashWatchdogCurrent) {
+        nHashWatchdogCurrent = uint256();
+    }
+    setDirtyObjects.erase(nHash);
+    voteSync.RemoveObject(nHash);
+    mapObjects.erase(it);
+}
+
 CGovernanceObject *CGovernanceManager::FindGovernanceObject(const uint256& nHash)
 {
     LOCK(cs);
@@ -771,43 +838,50 @@ void CGovernanceManager::Sync(CNode* pfrom, const uint256& nProp, const CBloomFi
             }
         } else {
             // single valid object and its valid votes
+            // the counts are sent even if there is nothing to sync, they complete the peer's request
             object_m_it it = mapObjects.find(nProp);
             if(it == mapObjects.end()) {
                 LogPrint("gobject", "CGovernanceManager::Sync -- no matching object for hash %s, peer=%d\n", nProp.ToString(), pfrom->id);
-                return;
             }
-            CGovernanceObject& govobj = it->second;
-            std::string strHash = it->first.ToString();
-
-            LogPrint("gobject", "CGovernanceManager::Sync -- attempting to sync govobj: %s, peer=%d\n", strHash, pfrom->id);
-
-            if(govobj.IsSetCachedDelete() || govobj.IsSetExpired()) {
+            else if(it->second.IsSetCachedDelete() || it->second.IsSetExpired()) {
                 LogPrintf("CGovernanceManager::Sync -- not syncing deleted/expired govobj: %s, peer=%d\n",
-                          strHash, pfrom->id);
-                return;
+                          it->first.ToString(), pfrom->id);
             }
+            else {
+                CGovernanceObject& govobj = it->second;
+                std::string strHash = it->first.ToString();
 
-            // Push the inventory budget proposal message over to the other client
-            LogPrint("gobject", "CGovernanceManager::Sync -- syncing govobj: %s, peer=%d\n", strHash, pfrom->id);
-            pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT, it->first));
-            ++nObjCount;
+                LogPrint("gobject", "CGovernanceManager::Sync -- attempting to sync govobj: %s, peer=%d\n", strHash, pfrom->id);
 
-            std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
-            for(size_t i = 0; i < vecVotes.size(); ++i) {
-                if(!vecVotes[i].IsValid(true)) {
-                    continue;
-                }
-                if(filter.contains(vecVotes[i].GetHash())) {
-                    continue;
+                // Push the inventory budget proposal message over to the other client
+                LogPrint("gobject", "CGovernanceManager::Sync -- syncing govobj: %s, peer=%d\n", strHash, pfrom->id);
+                pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT, it->first));
+                ++nObjCount;
+
+                std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
+                for(size_t i = 0; i < vecVotes.size(); ++i) {
+                    if(!vecVotes[i].IsValid(true)) {
+                        continue;
+                    }
+                    if(filter.contains(vecVotes[i].GetHash())) {
+                        continue;
+                    }
+                    pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT_VOTE, vecVotes[i].GetHash()));
+                    ++nVoteCount;
                 }
-                pfrom->PushInventory(CInv(MSG_GOVERNANCE_OBJECT_VOTE, vecVotes[i].GetHash()));
-                ++nVoteCount;
             }
         }
     }
 
     pfrom->PushMessage(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_GOVOBJ, nObjCount);
-    pfrom->PushMessage(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_GOVOBJ_VOTE, nVoteCount);
+    if(nProp == uint256()) {
+        pfrom->PushMessage(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_GOVOBJ_VOTE, nVoteCount);
+    }
+    else {
+        // the hash tells the peer which of its pipelined requests this answers,
+        // older peers read the first two fields only
+        pfrom->PushMessage(NetMsgType::SYNCSTATUSCOUNT, MASTERNODE_SYNC_GOVOBJ_VOTE, nVoteCount, nProp);
+    }
     LogPrintf("CGovernanceManager::Sync -- sent %d objects and %d votes to peer=%d\n", nObjCount, nVoteCount, pfrom->id);
 }
 
@@ -966,6 +1040,7 @@ bool CGovernanceManager::ProcessVote(CNode* pfrom, const CGovernanceVote& vote,
     bool fOk = govobj.ProcessVote(pfrom, vote, exception);
     if(fOk) {
         mapVoteToObject.Insert(nHashVote, &govobj);
+        voteSync.ObjectChanged(nHashGovobj, GetTimeMillis());
 
         if(govobj.GetObjectType() == GOVERNANCE_OBJECT_WATCHDOG) {
             mnodeman.UpdateWatchdogVoteTime(vote.GetVinMasternode());
@@ -1063,102 +1138,53 @@ int CGovernanceManager::RequestGovernanceObjectVotes(CNode* pnode)
 
 int CGovernanceManager::RequestGovernanceObjectVotes(const std::vector<CNode*>& vNodesCopy)
 {
-    static std::map<uint256, std::map<CService, int64_t> > mapAskedRecently;
-
     if(vNodesCopy.empty()) return -1;
 
-    LOCK2(cs_main, cs);
+    LOCK(cs);
 
     if(mapObjects.empty()) return -2;
 
-    int64_t nNow = GetTime();
-    int nTimeout = 60 * 60;
-    size_t nPeersPerHashMax = 3;
-
     // This should help us to get some idea about an impact this can bring once deployed on mainnet.
     // Testnet is ~40 times smaller in masternode count, but only ~1000 masternodes usually vote,
     // so 1 obj on mainnet == ~10 objs or ~1000 votes on testnet. However we want to test a higher
     // number of votes to make sure it's robust enough, so aim at 2000 votes per masternode per request.
-    // On mainnet nMaxObjRequestsPerNode is always set to 1.
-    int nMaxObjRequestsPerNode = 1;
+    // On mainnet we pipeline GOVERNANCE_VOTESYNC_INFLIGHT_MAX requests per node.
+    int nMaxObjRequestsPerNode = GOVERNANCE_VOTESYNC_INFLIGHT_MAX;
     size_t nProjectedVotes = 2000;
     if(Params().NetworkIDString() != CBaseChainParams::MAIN) {
-        nMaxObjRequestsPerNode = std::max(1, int(nProjectedVotes / std::max(1, mnodeman.size())));
+        nMaxObjRequestsPerNode = std::max(nMaxObjRequestsPerNode, int(nProjectedVotes / std::max(1, mnodeman.size())));
     }
 
-    std::vector<CGovernanceObject*> vpGovObjsTmp;
-    std::vector<CGovernanceObject*> vpGovObjsTriggersTmp;
-
-    for(object_m_it it = mapObjects.begin(); it != mapObjects.end(); ++it) {
-        if(mapAskedRecently.count(it->first)) {
-            std::map<CService, int64_t>::iterator it1 = mapAskedRecently[it->first].begin();
-            while(it1 != mapAskedRecently[it->first].end()) {
-                if(it1->second < nNow) {
-                    mapAskedRecently[it->first].erase(it1++);
-                } else {
-                    ++it1;
-                }
-            }
-            if(mapAskedRecently[it->first].size() >= nPeersPerHashMax) continue;
-        }
-        if(it->second.nObjectType == GOVERNANCE_OBJECT_TRIGGER) {
-            vpGovObjsTriggersTmp.push_back(&(it->second));
-        } else {
-            vpGovObjsTmp.push_back(&(it->second));
-        }
+    std::vector<CGovernanceVoteSync::peer_info_t> vPeers;
+    std::map<NodeId, CNode*> mapNodes;
+    BOOST_FOREACH(CNode* pnode, vNodesCopy) {
+        // Only use reqular peers, don't try to ask from outbound "masternode" connections -
+        // they stay connected for a short period of time and it's possible that we won't get everything we should.
+        // Only use outbound connections - inbound connection could be a "masternode" connection
+        // initialted from another node, so skip it too.
+        if(pnode->fMasternode || (fMasterNode && pnode->fInbound)) continue;
+        // only use up to date peers
+        if(pnode->nVersion < MIN_GOVERNANCE_PEER_PROTO_VERSION) continue;
+        vPeers.push_back(CGovernanceVoteSync::peer_info_t(pnode->id, pnode->addr, pnode->setAskFor.size()));
+        mapNodes[pnode->id] = pnode;
     }
 
-    LogPrint("gobject", "CGovernanceManager::RequestGovernanceObjectVotes -- start: vpGovObjsTriggersTmp %d vpGovObjsTmp %d mapAskedRecently %d\n",
-                vpGovObjsTriggersTmp.size(), vpGovObjsTmp.size(), mapAskedRecently.size());
+    LogPrint("gobject", "CGovernanceManager::RequestGovernanceObjectVotes -- start: peers %d, %s\n", vPeers.size(), voteSync.ToString());
 
-    InsecureRand insecureRand;
-    // shuffle pointers
-    std::random_shuffle(vpGovObjsTriggersTmp.begin(), vpGovObjsTriggersTmp.end(), insecureRand);
-    std::random_shuffle(vpGovObjsTmp.begin(), vpGovObjsTmp.end(), insecureRand);
+    std::vector<CGovernanceVoteSync::request_t> vecRequests = voteSync.Schedule(vPeers, GetTimeMillis(), nMaxObjRequestsPerNode, nProjectedVotes);
+    for(size_t i = 0; i < vecRequests.size(); ++i) {
+        RequestGovernanceObject(mapNodes[vecRequests[i].id], vecRequests[i].nHash, true);
+    }
 
-    for (int i = 0; i < nMaxObjRequestsPerNode; ++i) {
-        uint256 nHashGovobj;
+    LogPrint("gobject", "CGovernanceManager::RequestGovernanceObjectVotes -- end: asked %d, %s\n", vecRequests.size(), voteSync.ToString());
 
-        // ask for triggers first
-        if(vpGovObjsTriggersTmp.size()) {
-            nHashGovobj = vpGovObjsTriggersTmp.back()->GetHash();
-        } else {
-            if(vpGovObjsTmp.empty()) break;
-            nHashGovobj = vpGovObjsTmp.back()->GetHash();
-        }
-        bool fAsked = false;
-        BOOST_FOREACH(CNode* pnode, vNodesCopy) {
-            // Only use reqular peers, don't try to ask from outbound "masternode" connections -
-            // they stay connected for a short period of time and it's possible that we won't get everything we should.
-            // Only use outbound connections - inbound connection could be a "masternode" connection
-            // initialted from another node, so skip it too.
-            if(pnode->fMasternode || (fMasterNode && pnode->fInbound)) continue;
-            // only use up to date peers
-            if(pnode->nVersion < MIN_GOVERNANCE_PEER_PROTO_VERSION) continue;
-            // stop early to prevent setAskFor overflow
-            size_t nProjectedSize = pnode->setAskFor.size() + nProjectedVotes;
-            if(nProjectedSize > SETASKFOR_MAX_SZ/2) continue;
-            // to early to ask the same node
-            if(mapAskedRecently[nHashGovobj].count(pnode->addr)) continue;
-
-            RequestGovernanceObject(pnode, nHashGovobj, true);
-            mapAskedRecently[nHashGovobj][pnode->addr] = nNow + nTimeout;
-            fAsked = true;
-            // stop loop if max number of peers per obj was asked
-            if(mapAskedRecently[nHashGovobj].size() >= nPeersPerHashMax) break;
-        }
-        // NOTE: this should match `if` above (the one before `while`)
-        if(vpGovObjsTriggersTmp.size()) {
-            vpGovObjsTriggersTmp.pop_back();
-        } else {
-            vpGovObjsTmp.pop_back();
-        }
-        if(!fAsked) i--;
-    }
-    LogPrint("gobject", "CGovernanceManager::RequestGovernanceObjectVotes -- end: vpGovObjsTriggersTmp %d vpGovObjsTmp %d mapAskedRecently %d\n",
-                vpGovObjsTriggersTmp.size(), vpGovObjsTmp.size(), mapAskedRecently.size());
+    return voteSync.GetQueueSize();
+}
 
-    return int(vpGovObjsTriggersTmp.size() + vpGovObjsTmp.size());
+void CGovernanceManager::VoteSyncResponseReceived(CNode* pfrom, const uint256& nHash)
+{
+    LOCK(cs);
+    voteSync.ResponseReceived(pfrom->id, nHash, GetTimeMillis());
 }
 
 bool CGovernanceManager::AcceptObjectMessage(const uint256& nHash)
@@ -1188,11 +1214,13 @@ bool CGovernanceManager::AcceptMessage(const uint256& nHash, hash_s_t& setHash)
 void CGovernanceManager::RebuildIndexes()
 {
     mapVoteToObject.Clear();
+    mapMasternodeVotedObjects.clear();
     for(object_m_it it = mapObjects.begin(); it != mapObjects.end(); ++it) {
         CGovernanceObject& govobj = it->second;
         std::vector<CGovernanceVote> vecVotes = govobj.GetVoteFile().GetVotes();
         for(size_t i = 0; i < vecVotes.size(); ++i) {
             mapVoteToObject.Insert(vecVotes[i].GetHash(), &govobj);
+            mapMasternodeVotedObjects[vecVotes[i].GetVinMasternode().prevout].insert(it->first);
         }
     }
 }
@@ -1242,6 +1270,13 @@ void CGovernanceManager::InitOnLoad()
     LogPrintf("Preparing masternode indexes and governance triggers...\n");
     RebuildIndexes();
     AddCachedTriggers();
+    int64_t nNow = GetTimeMillis();
+    for(object_m_it it = mapObjects.begin(); it != mapObjects.end(); ++it) {
+        voteSync.AddObject(it->first, it->second.nObjectType == GOVERNANCE_OBJECT_TRIGGER, nNow);
+        // cached flags are not stored on disk
+        setDirtyObjects.insert(it->first);
+        ScheduleDeletion(it->second);
+    }
     LogPrintf("Masternode indexes and governance triggers prepared  %dms\n", GetTimeMillis() - nStart);
     LogPrintf("     %s\n", ToString());
 }
@@ -14,11 +14,14 @@
 #include "governance-exceptions.h"
 #include "governance-object.h"
 #include "governance-vote.h"
+#include "governance-votesync.h"
 #include "net.h"
 #include "sync.h"
 #include "timedata.h"
 #include "util.h"
 
+#include <queue>
+
 class CGovernanceManager;
 class CGovernanceTriggerManager;
 class CGovernanceObject;
@@ -216,6 +219,15 @@ public: // Types
 
     typedef hash_time_m_t::const_iterator hash_time_m_cit;
 
+    typedef std::map<COutPoint, hash_s_t> txout_hash_s_m_t;
+
+    typedef txout_hash_s_m_t::iterator txout_hash_s_m_it;
+
+    typedef std::pair<int64_t, uint256> time_hash_pair_t;
+
+    /// Min-heap of (earliest deletion time, object hash)
+    typedef std::priority_queue<time_hash_pair_t, std::vector<time_hash_pair_t>, std::greater<time_hash_pair_t> > deletion_q_t;
+
 private:
     static const int MAX_CACHE_SIZE = 1000000;
 
@@ -252,6 +264,17 @@ private:
 
     hash_s_t setRequestedVotes;
 
+    /// Objects whose cached flags have to be recalculated
+    hash_s_t setDirtyObjects;
+
+    /// Objects flagged for deletion, entries are rechecked when they come due
+    deletion_q_t queueDeletion;
+
+    /// Objects each masternode has voted on
+    txout_hash_s_m_t mapMasternodeVotedObjects;
+
+    CGovernanceVoteSync voteSync;
+
     bool fRateChecksEnabled;
 
 public:
@@ -311,6 +334,10 @@ public:
         mapInvalidVotes.Clear();
         mapOrphanVotes.Clear();
         mapLastMasternodeObject.clear();
+        setDirtyObjects.clear();
+        queueDeletion = deletion_q_t();
+        mapMasternodeVotedObjects.clear();
+        voteSync.Clear();
     }
 
     std::string ToString() const;
@@ -377,6 +404,9 @@ public:
 
     void CheckMasternodeOrphanVotes();
 
+    /// Queue an object flagged as deleted or expired for removal after GOVERNANCE_DELETION_DELAY
+    void ScheduleDeletion(CGovernanceObject& govobj);
+
     void CheckMasternodeOrphanObjects();
 
     bool AreRateChecksEnabled() const {
@@ -389,6 +419,9 @@ public:
     int RequestGovernanceObjectVotes(CNode* pnode);
     int RequestGovernanceObjectVotes(const std::vector<CNode*>& vNodesCopy);
 
+    /// Called when a peer sent the vote count which ends its reply to the vote request for nHash
+    void VoteSyncResponseReceived(CNode* pfrom, const uint256& nHash);
+
 private:
     void RequestGovernanceObject(CNode* pfrom, const uint256& nHash, bool fUseFilter = false);
 
@@ -404,6 +437,13 @@ private:
 
     bool ProcessVote(CNode* pfrom, const CGovernanceVote& vote, CGovernanceException& exception);
 
+    /// Called by CGovernanceObject when it has accepted a vote
+    void AddMasternodeVote(const CGovernanceVote& vote);
+
+    void RemoveMasternodeVotes(const CTxIn& vinMasternode);
+
+    void RemoveObject(object_m_it it);
+
     /// Called to indicate a requested object has been received
     bool AcceptObjectMessage(const uint256& nHash);
 
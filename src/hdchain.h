@@ -112,6 +112,8 @@ public:
 
     uint256 GetSeedHash();
     void DeriveChildExtKey(uint32_t nAccountIndex, bool fInternal, uint32_t nChildIndex, CExtKey& extKeyRet);
+    /// Key at m/purpose'/coin_type'/account'/change, the parent of all keys of the account's chain
+    void DeriveChangeExtKey(uint32_t nAccountIndex, bool fInternal, CExtKey& extKeyRet);
 
     void AddAccount();
     bool GetAccount(uint32_t nAccountIndex, CHDAccount& hdAccountRet);
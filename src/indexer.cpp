@@ -0,0 +1,456 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "indexer.h"
+
+#include "chainparams.h"
+#include "hash.h"
+#include "txdb.h"
+#include "undo.h"
+#include "util.h"
+
+#include <boost/bind.hpp>
+#include <boost/function.hpp>
+
+CBlockIndexer blockIndexer;
+
+std::string GetIndexerIndexName(int nIndex)
+{
+    switch (nIndex) {
+    case INDEXER_ADDRESS: return "addressindex";
+    case INDEXER_SPENT: return "spentindex";
+    case INDEXER_TIMESTAMP: return "timestampindex";
+    }
+    return "";
+}
+
+/** Comma separated names of the indexes in a bit set */
+static std::string GetIndexerIndexNames(int nIndexes)
+{
+    std::string strRet;
+    for (int i = 0; i < INDEXER_COUNT; i++)
+        if (nIndexes & (1 << i))
+            strRet += (strRet.empty() ? "" : ", ") + GetIndexerIndexName(i);
+    return strRet;
+}
+
+/** Address type of a script for the address index (1 for P2PKH and P2PK, 2 for P2SH, 0 if not indexed) and its hash */
+static int GetAddressType(const CScript& script, uint160& hashBytesRet)
+{
+    if (script.IsPayToScriptHash()) {
+        hashBytesRet = uint160(std::vector<unsigned char>(script.begin()+2, script.begin()+22));
+        return 2;
+    }
+    if (script.IsPayToPublicKeyHash()) {
+        hashBytesRet = uint160(std::vector<unsigned char>(script.begin()+3, script.begin()+23));
+        return 1;
+    }
+    if (script.IsPayToPublicKey()) {
+        hashBytesRet = Hash160(script.begin()+1, script.end()-1);
+        return 1;
+    }
+    hashBytesRet.SetNull();
+    return 0;
+}
+
+bool AddConnectedBlockEntries(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex, CIndexBatch& batch)
+{
+    if (blockundo.vtxundo.size() + 1 != block.vtx.size())
+        return false;
+    const bool fAddress = batch.HasIndex(INDEXER_ADDRESS);
+    const bool fSpent = batch.HasIndex(INDEXER_SPENT);
+    const bool fTimestamp = batch.HasIndex(INDEXER_TIMESTAMP);
+
+    for (unsigned int i = 0; i < block.vtx.size(); i++) {
+        const CTransaction& tx = block.vtx[i];
+        const uint256 txhash = tx.GetHash();
+
+        if (i > 0 && (fAddress || fSpent)) {
+            const CTxUndo& txundo = blockundo.vtxundo[i-1];
+            if (txundo.vprevout.size() != tx.vin.size())
+                return false;
+            for (unsigned int j = 0; j < tx.vin.size(); j++) {
+                const COutPoint& prevout = tx.vin[j].prevout;
+                const CTxOut& out = txundo.vprevout[j].out;
+                uint160 hashBytes;
+                int nAddressType = GetAddressType(out.scriptPubKey, hashBytes);
+
+                if (fAddress && nAddressType > 0) {
+                    // record spending activity
+                    batch.vAddressIndex.push_back(std::make_pair(CAddressIndexKey(nAddressType, hashBytes, pindex->nHeight, i, txhash, j, true), out.nValue * -1));
+
+                    // remove address from unspent index
+                    batch.vAddressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(nAddressType, hashBytes, prevout.hash, prevout.n), CAddressUnspentValue()));
+                }
+
+                if (fSpent) {
+                    // the txid and input that spent an output, and the amount and address of an input
+                    batch.vSpentIndex.push_back(std::make_pair(CSpentIndexKey(prevout.hash, prevout.n), CSpentIndexValue(txhash, j, pindex->nHeight, out.nValue, nAddressType, hashBytes)));
+                }
+            }
+        }
+
+        if (fAddress) {
+            for (unsigned int k = 0; k < tx.vout.size(); k++) {
+                const CTxOut& out = tx.vout[k];
+                uint160 hashBytes;
+                int nAddressType = GetAddressType(out.scriptPubKey, hashBytes);
+                if (nAddressType == 0)
+                    continue;
+
+                // record receiving activity
+                batch.vAddressIndex.push_back(std::make_pair(CAddressIndexKey(nAddressType, hashBytes, pindex->nHeight, i, txhash, k, false), out.nValue));
+
+                // record unspent output
+                batch.vAddressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(nAddressType, hashBytes, txhash, k), CAddressUnspentValue(out.nValue, out.scriptPubKey, pindex->nHeight)));
+            }
+        }
+    }
+
+    if (fTimestamp)
+        batch.vTimestampIndex.push_back(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash()));
+
+    return true;
+}
+
+bool AddDisconnectedBlockEntries(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex, CIndexBatch& batch)
+{
+    if (blockundo.vtxundo.size() + 1 != block.vtx.size())
+        return false;
+    const bool fAddress = batch.HasIndex(INDEXER_ADDRESS);
+    const bool fSpent = batch.HasIndex(INDEXER_SPENT);
+    const bool fTimestamp = batch.HasIndex(INDEXER_TIMESTAMP);
+
+    // undo transactions in reverse order
+    for (int i = block.vtx.size() - 1; i >= 0; i--) {
+        const CTransaction& tx = block.vtx[i];
+        const uint256 txhash = tx.GetHash();
+
+        if (fAddress) {
+            for (unsigned int k = tx.vout.size(); k-- > 0;) {
+                const CTxOut& out = tx.vout[k];
+                uint160 hashBytes;
+                int nAddressType = GetAddressType(out.scriptPubKey, hashBytes);
+                if (nAddressType == 0)
+                    continue;
+
+                // undo receiving activity
+                batch.vAddressIndex.push_back(std::make_pair(CAddressIndexKey(nAddressType, hashBytes, pindex->nHeight, i, txhash, k, false), out.nValue));
+
+                // undo unspent index
+                batch.vAddressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(nAddressType, hashBytes, txhash, k), CAddressUnspentValue()));
+            }
+        }
+
+        if (i > 0 && (fAddress || fSpent)) {
+            const CTxUndo& txundo = blockundo.vtxundo[i-1];
+            if (txundo.vprevout.size() != tx.vin.size())
+                return false;
+            for (unsigned int j = tx.vin.size(); j-- > 0;) {
+                const COutPoint& prevout = tx.vin[j].prevout;
+                const Coin& undo = txundo.vprevout[j];
+                uint160 hashBytes;
+                int nAddressType = GetAddressType(undo.out.scriptPubKey, hashBytes);
+
+                if (fSpent) {
+                    // delete the spent index
+                    batch.vSpentIndex.push_back(std::make_pair(CSpentIndexKey(prevout.hash, prevout.n), CSpentIndexValue()));
+                }
+
+                if (fAddress && nAddressType > 0) {
+                    // undo spending activity
+                    batch.vAddressIndex.push_back(std::make_pair(CAddressIndexKey(nAddressType, hashBytes, pindex->nHeight, i, txhash, j, true), undo.out.nValue * -1));
+
+                    // restore unspent index
+                    batch.vAddressUnspentIndex.push_back(std::make_pair(CAddressUnspentKey(nAddressType, hashBytes, prevout.hash, prevout.n), CAddressUnspentValue(undo.out.nValue, undo.out.scriptPubKey, undo.nHeight)));
+                }
+            }
+        }
+    }
+
+    if (fTimestamp)
+        batch.vTimestampIndex.push_back(CTimestampIndexKey(pindex->nTime, pindex->GetBlockHash()));
+
+    return true;
+}
+
+/** Stores whether an index is enabled, a newly enabled one gets wiped and is rebuilt from the genesis block */
+static bool SetIndexFlag(int nIndex, bool fEnable, bool (CBlockTreeDB::*pWipe)())
+{
+    const std::string strName = GetIndexerIndexName(nIndex);
+    bool fStored = false;
+    pblocktree->ReadFlag(strName, fStored);
+    if (fEnable && !fStored) {
+        // entries left from an earlier time the index was enabled are stale
+        if (!(pblocktree->*pWipe)())
+            return error("%s: failed to wipe the %s", __func__, strName);
+        if (!pblocktree->WriteIndexBestBlock(strName, uint256()))
+            return error("%s: failed to reset the %s", __func__, strName);
+        LogPrintf("%s: %s enabled, building it in the background\n", __func__, strName);
+    }
+    if (fEnable != fStored && !pblocktree->WriteFlag(strName, fEnable))
+        return error("%s: failed to write the %s flag", __func__, strName);
+    LogPrintf("%s: %s %s\n", __func__, strName, fEnable ? "enabled" : "disabled");
+    return true;
+}
+
+CBlockIndexer::CBlockIndexer() :
+    fRunning(false),
+    fStop(false),
+    fNotified(false),
+    nEnabled(0)
+{
+    for (int i = 0; i < INDEXER_COUNT; i++)
+        pindexBest[i] = NULL;
+}
+
+bool CBlockIndexer::Start()
+{
+    fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX);
+    fSpentIndex = GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
+    fTimestampIndex = GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX);
+
+    if (!SetIndexFlag(INDEXER_ADDRESS, fAddressIndex, &CBlockTreeDB::WipeAddressIndex) ||
+        !SetIndexFlag(INDEXER_SPENT, fSpentIndex, &CBlockTreeDB::WipeSpentIndex) ||
+        !SetIndexFlag(INDEXER_TIMESTAMP, fTimestampIndex, &CBlockTreeDB::WipeTimestampIndex))
+        return false;
+
+    int nEnabledNew = (fAddressIndex ? 1 << INDEXER_ADDRESS : 0) | (fSpentIndex ? 1 << INDEXER_SPENT : 0) | (fTimestampIndex ? 1 << INDEXER_TIMESTAMP : 0);
+    if (!nEnabledNew)
+        return true;
+
+    const CBlockIndex* pindexBestNew[INDEXER_COUNT];
+    {
+        LOCK(cs_main);
+        for (int i = 0; i < INDEXER_COUNT; i++) {
+            const std::string strName = GetIndexerIndexName(i);
+            pindexBestNew[i] = NULL;
+            uint256 hashBest;
+            if (!(nEnabledNew & (1 << i))) {
+                continue;
+            } else if (!pblocktree->ReadIndexBestBlock(strName, hashBest)) {
+                // earlier versions wrote the indexes along with the chain state
+                pindexBestNew[i] = chainActive.Tip();
+            } else if (!hashBest.IsNull()) {
+                BlockMap::iterator mi = mapBlockIndex.find(hashBest);
+                if (mi != mapBlockIndex.end())
+                    pindexBestNew[i] = mi->second;
+            }
+            LogPrintf("CBlockIndexer::Start -- %s covers the chain up to height %d\n", strName, pindexBestNew[i] ? pindexBestNew[i]->nHeight : -1);
+        }
+    }
+
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nEnabled = nEnabledNew;
+        for (int i = 0; i < INDEXER_COUNT; i++)
+            pindexBest[i] = pindexBestNew[i];
+        fStop = false;
+        fNotified = true;
+        fRunning = true;
+    }
+    RegisterValidationInterface(this);
+    thread = boost::thread(boost::bind(&TraceThread<boost::function<void()> >, "indexer", boost::function<void()>(boost::bind(&CBlockIndexer::ThreadIndex, this))));
+    return true;
+}
+
+void CBlockIndexer::Stop()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (!fRunning)
+            return;
+        fStop = true;
+    }
+    UnregisterValidationInterface(this);
+    condWake.notify_all();
+    thread.join();
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    fRunning = false;
+}
+
+bool CBlockIndexer::IsRunning() const
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return fRunning;
+}
+
+const CBlockIndex* CBlockIndexer::GetBestBlock() const
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    const CBlockIndex* pindexRet = NULL;
+    bool fFirst = true;
+    for (int i = 0; i < INDEXER_COUNT; i++) {
+        if (!(nEnabled & (1 << i)))
+            continue;
+        if (fFirst || !pindexBest[i] || (pindexRet && pindexBest[i]->nHeight < pindexRet->nHeight))
+            pindexRet = pindexBest[i];
+        fFirst = false;
+    }
+    return pindexRet;
+}
+
+bool CBlockIndexer::IsStopping()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return fStop;
+}
+
+void CBlockIndexer::BlockConnected(const CBlockIndex* pindex)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fNotified = true;
+    }
+    condWake.notify_one();
+}
+
+void CBlockIndexer::BlockDisconnected(const CBlockIndex* pindex)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fNotified = true;
+    }
+    condWake.notify_one();
+}
+
+bool CBlockIndexer::FindNextBlocks(std::vector<const CBlockIndex*>& vpindexRet, bool& fDisconnectRet, int& nIndexesRet)
+{
+    // pindexBest is only changed by this thread
+    LOCK(cs_main);
+    const CBlockIndex* pindexTip = chainActive.Tip();
+    // the index furthest behind on the active chain goes first, with all the indexes at the same block
+    int nNext = -1;
+    for (int i = 0; i < INDEXER_COUNT; i++) {
+        if (!(nEnabled & (1 << i)))
+            continue;
+        const CBlockIndex* pindex = pindexBest[i];
+        if (pindex && !chainActive.Contains(pindex)) {
+            // the active chain is still catching up to us, e.g. with -reindex-chainstate
+            if (!pindexTip || pindex->GetAncestor(pindexTip->nHeight) == pindexTip)
+                continue;
+
+            // reorg: undo the blocks which left the active chain, newest first
+            fDisconnectRet = true;
+            nIndexesRet = 0;
+            for (int j = 0; j < INDEXER_COUNT; j++)
+                if ((nEnabled & (1 << j)) && pindexBest[j] == pindex)
+                    nIndexesRet |= 1 << j;
+            for (; pindex && !chainActive.Contains(pindex) && vpindexRet.size() < INDEXER_BATCH_BLOCKS; pindex = pindex->pprev)
+                vpindexRet.push_back(pindex);
+            return true;
+        }
+        if (nNext < 0 || (pindexBest[nNext] && (!pindex || pindex->nHeight < pindexBest[nNext]->nHeight)))
+            nNext = i;
+    }
+    if (nNext < 0)
+        return false;
+
+    // stop at the next index ahead, from there on they go together
+    const CBlockIndex* pindexStart = pindexBest[nNext];
+    int nStopHeight = pindexTip ? pindexTip->nHeight : -1;
+    fDisconnectRet = false;
+    nIndexesRet = 0;
+    for (int i = 0; i < INDEXER_COUNT; i++) {
+        if (!(nEnabled & (1 << i)) || (pindexBest[i] && !chainActive.Contains(pindexBest[i])))
+            continue;
+        if (pindexBest[i] == pindexStart)
+            nIndexesRet |= 1 << i;
+        else
+            nStopHeight = std::min(nStopHeight, pindexBest[i]->nHeight);
+    }
+    for (const CBlockIndex* pindex = pindexStart ? chainActive.Next(pindexStart) : chainActive.Genesis(); pindex && pindex->nHeight <= nStopHeight && vpindexRet.size() < INDEXER_BATCH_BLOCKS; pindex = chainActive.Next(pindex))
+        vpindexRet.push_back(pindex);
+    return !vpindexRet.empty();
+}
+
+bool CBlockIndexer::WriteBatch(CIndexBatch& batch, const CBlockIndex* pindexNewBest)
+{
+    batch.hashBestBlock = pindexNewBest ? pindexNewBest->GetBlockHash() : uint256();
+    if (!pblocktree->WriteIndexBatch(batch))
+        return error("CBlockIndexer::WriteBatch -- failed to write the indexes");
+    batch.Clear();
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    for (int i = 0; i < INDEXER_COUNT; i++)
+        if (batch.HasIndex(i))
+            pindexBest[i] = pindexNewBest;
+    return true;
+}
+
+bool CBlockIndexer::IndexBlocks(const std::vector<const CBlockIndex*>& vpindex, bool fDisconnect, int nIndexes)
+{
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    CIndexBatch batch;
+    batch.fDisconnect = fDisconnect;
+    batch.nIndexes = nIndexes;
+    const CBlockIndex* pindexNewBest = NULL;
+    unsigned int nSkipped = 0;
+
+    for (size_t i = 0; i < vpindex.size() && !IsStopping(); i++) {
+        const CBlockIndex* pindex = vpindex[i];
+        bool fHaveData;
+        {
+            LOCK(cs_main);
+            fHaveData = (pindex->nStatus & BLOCK_HAVE_DATA) && (pindex->nStatus & BLOCK_HAVE_UNDO);
+        }
+        // the genesis block has no entries, its outputs can't be spent
+        if (pindex->pprev && !fHaveData) {
+            // pruned, or below the base of a UTXO snapshot: the indexes go on without its entries
+            nSkipped++;
+        } else if (pindex->pprev) {
+            CBlock block;
+            CBlockUndo blockundo;
+            if (!ReadBlockFromDisk(block, pindex, consensusParams))
+                return error("CBlockIndexer::IndexBlocks -- failed to read block %s", pindex->GetBlockHash().ToString());
+            CDiskBlockPos posUndo = pindex->GetUndoPos();
+            if (posUndo.IsNull() || !UndoReadFromDisk(blockundo, posUndo, pindex->pprev->GetBlockHash()))
+                return error("CBlockIndexer::IndexBlocks -- failed to read undo data of block %s", pindex->GetBlockHash().ToString());
+            bool fOk = fDisconnect ? AddDisconnectedBlockEntries(block, blockundo, pindex, batch) : AddConnectedBlockEntries(block, blockundo, pindex, batch);
+            if (!fOk)
+                return error("CBlockIndexer::IndexBlocks -- block %s and its undo data are inconsistent", pindex->GetBlockHash().ToString());
+        }
+        pindexNewBest = fDisconnect ? pindex->pprev : pindex;
+
+        if (batch.Size() >= INDEXER_BATCH_ENTRIES && !WriteBatch(batch, pindexNewBest))
+            return false;
+    }
+
+    if (pindexNewBest && !WriteBatch(batch, pindexNewBest))
+        return false;
+    if (nSkipped)
+        LogPrintf("CBlockIndexer::IndexBlocks -- %u blocks have no data, their entries are missing from the indexes\n", nSkipped);
+    if (vpindex.size() > 1 && pindexNewBest)
+        LogPrintf("CBlockIndexer::IndexBlocks -- %s %u blocks, %s cover the chain up to height %d\n", fDisconnect ? "disconnected" : "connected", vpindex.size(), GetIndexerIndexNames(nIndexes), pindexNewBest->nHeight);
+    return true;
+}
+
+void CBlockIndexer::ThreadIndex()
+{
+    while (!IsStopping()) {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            fNotified = false;
+        }
+
+        std::vector<const CBlockIndex*> vpindex;
+        bool fDisconnect = false;
+        int nIndexes = 0;
+        if (FindNextBlocks(vpindex, fDisconnect, nIndexes)) {
+            if (!IndexBlocks(vpindex, fDisconnect, nIndexes)) {
+                // keep what got written and try again later, e.g. after a read error
+                LogPrintf("CBlockIndexer::ThreadIndex -- indexing paused, trying again in %d seconds\n", INDEXER_RETRY_SECONDS);
+                boost::unique_lock<boost::mutex> lock(mutex);
+                boost::system_time deadline = boost::get_system_time() + boost::posix_time::seconds(INDEXER_RETRY_SECONDS);
+                while (!fStop && condWake.timed_wait(lock, deadline)) {}
+            }
+            continue;
+        }
+
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (!fStop && !fNotified)
+            condWake.wait(lock);
+    }
+}
@@ -0,0 +1,138 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef INDEXER_H
+#define INDEXER_H
+
+#include "main.h"
+#include "validationinterface.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+class CBlockUndo;
+
+/** Most blocks the indexer handles before writing their entries */
+static const unsigned int INDEXER_BATCH_BLOCKS = 1000;
+/** Entries at which the indexer writes a batch even before INDEXER_BATCH_BLOCKS blocks */
+static const size_t INDEXER_BATCH_ENTRIES = 500000;
+/** Seconds the indexer waits before trying again to read a block it failed to read */
+static const int INDEXER_RETRY_SECONDS = 60;
+
+/** The indexes built by the indexer, each of them keeps its own best block */
+enum IndexerIndex
+{
+    INDEXER_ADDRESS,
+    INDEXER_SPENT,
+    INDEXER_TIMESTAMP,
+    INDEXER_COUNT
+};
+
+/** Name of an index, its flag and best block are stored under it in the block tree db */
+std::string GetIndexerIndexName(int nIndex);
+
+/**
+ * Entries of the address, spent and timestamp indexes for a run of connected or
+ * disconnected blocks, written to the block tree db in a single batch
+ */
+struct CIndexBatch
+{
+    /** The blocks are disconnected: the address and timestamp index entries are erased */
+    bool fDisconnect;
+    /** Bit (1 << index) for each index the entries are added for, all of them by default */
+    int nIndexes;
+    std::vector<std::pair<CAddressIndexKey, CAmount> > vAddressIndex;
+    /** Null values erase the entry, here and in vSpentIndex */
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > vAddressUnspentIndex;
+    std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> > vSpentIndex;
+    std::vector<CTimestampIndexKey> vTimestampIndex;
+    /** The last block covered by the indexes in nIndexes once the batch is written */
+    uint256 hashBestBlock;
+
+    CIndexBatch() : fDisconnect(false), nIndexes((1 << INDEXER_COUNT) - 1) {}
+
+    bool HasIndex(int nIndex) const
+    {
+        return nIndexes & (1 << nIndex);
+    }
+
+    size_t Size() const
+    {
+        return vAddressIndex.size() + vAddressUnspentIndex.size() + vSpentIndex.size() + vTimestampIndex.size();
+    }
+
+    void Clear()
+    {
+        vAddressIndex.clear();
+        vAddressUnspentIndex.clear();
+        vSpentIndex.clear();
+        vTimestampIndex.clear();
+    }
+};
+
+/**
+ * Adds the index entries of a connected block, blockundo holds the outputs it spends.
+ * Returns false if the block and its undo data don't match.
+ */
+bool AddConnectedBlockEntries(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex, CIndexBatch& batch);
+/** Adds what undoes the index entries of a block when it gets disconnected */
+bool AddDisconnectedBlockEntries(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex, CIndexBatch& batch);
+
+/**
+ * Maintains the address, spent and timestamp indexes on a thread of its own,
+ * so connecting a block does not wait for them. It follows the active chain
+ * from the last block it indexed, reading blocks and their undo data from disk,
+ * which lets it catch up after falling behind during initial sync or after an
+ * index got switched on, without -reindex. Each index has a best block of its own,
+ * an index enabled later is built up to the others before they go on together.
+ * Blocks without data (pruned, or below a UTXO snapshot) are left out of the
+ * indexes. The tx index is still written by ConnectBlock, GetTransaction() relies
+ * on it being in sync.
+ */
+class CBlockIndexer : public CValidationInterface
+{
+private:
+    mutable boost::mutex mutex;
+    boost::condition_variable condWake;
+    boost::thread thread;
+    bool fRunning;
+    bool fStop;
+    bool fNotified;
+    /** Bit (1 << index) for each enabled index */
+    int nEnabled;
+    /** Last block covered by each index, NULL while not even the genesis block is */
+    const CBlockIndex* pindexBest[INDEXER_COUNT];
+
+    void ThreadIndex();
+    bool IsStopping();
+    bool FindNextBlocks(std::vector<const CBlockIndex*>& vpindexRet, bool& fDisconnectRet, int& nIndexesRet);
+    bool IndexBlocks(const std::vector<const CBlockIndex*>& vpindex, bool fDisconnect, int nIndexes);
+    bool WriteBatch(CIndexBatch& batch, const CBlockIndex* pindexNewBest);
+
+protected:
+    void BlockConnected(const CBlockIndex* pindex);
+    void BlockDisconnected(const CBlockIndex* pindex);
+
+public:
+    CBlockIndexer();
+
+    /**
+     * Switches the indexes on or off as set by -addressindex, -spentindex and
+     * -timestampindex, wiping the stale entries of newly enabled ones, and
+     * starts the thread if any of them is enabled
+     */
+    bool Start();
+    void Stop();
+
+    bool IsRunning() const;
+    /** The last block covered by all the enabled indexes, the best block of the one furthest behind, NULL if none */
+    const CBlockIndex* GetBestBlock() const;
+};
+
+extern CBlockIndexer blockIndexer;
+
+#endif // INDEXER_H
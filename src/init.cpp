@@ -12,13 +12,17 @@
 
 #include "addrman.h"
 #include "amount.h"
+#include "blockreader.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "compat/sanity.h"
+#include "coinsflush.h"
+#include "coinsprefetch.h"
 #include "consensus/validation.h"
 #include "httpserver.h"
 #include "httprpc.h"
+#include "indexer.h"
 #include "key.h"
 #include "main.h"
 #include "miner.h"
@@ -29,6 +33,7 @@
 #include "script/standard.h"
 #include "script/sigcache.h"
 #include "scheduler.h"
+#include "snapshot.h"
 #include "txdb.h"
 #include "txmempool.h"
 #include "torcontrol.h"
@@ -166,9 +171,9 @@ class CCoinsViewErrorCatcher : public CCoinsViewBacked
 {
 public:
     CCoinsViewErrorCatcher(CCoinsView* view) : CCoinsViewBacked(view) {}
-    bool GetCoins(const uint256 &txid, CCoins &coins) const {
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const {
         try {
-            return CCoinsViewBacked::GetCoins(txid, coins);
+            return CCoinsViewBacked::GetCoin(outpoint, coin);
         } catch(const std::runtime_error& e) {
             uiInterface.ThreadSafeMessageBox(_("Error reading from database, shutting down."), "", CClientUIInterface::MSG_ERROR);
             LogPrintf("Error reading from database: %s\n", e.what());
@@ -182,8 +187,9 @@ public:
     // Writes do not need similar protection, as failure to write is handled by the caller.
 };
 
-static CCoinsViewDB *pcoinsdbview = NULL;
 static CCoinsViewErrorCatcher *pcoinscatcher = NULL;
+static int nPrefetchThreads = DEFAULT_PREFETCH_THREADS;
+static bool fBackgroundFlush = DEFAULT_BACKGROUND_FLUSH;
 static boost::scoped_ptr<ECCVerifyHandle> globalVerifyHandle;
 
 void Interrupt(boost::thread_group& threadGroup)
@@ -247,6 +253,8 @@ void PrepareShutdown()
         fFeeEstimatesInitialized = false;
     }
 
+    blockIndexer.Stop();
+
     {
         LOCK(cs_main);
         if (pcoinsTip != NULL) {
@@ -254,6 +262,10 @@ void PrepareShutdown()
         }
         delete pcoinsTip;
         pcoinsTip = NULL;
+        delete pcoinsPrefetch;
+        pcoinsPrefetch = NULL;
+        delete pcoinsFlusher;
+        pcoinsFlusher = NULL;
         delete pcoinscatcher;
         pcoinscatcher = NULL;
         delete pcoinsdbview;
@@ -379,6 +391,9 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-version", _("Print version and exit"));
     strUsage += HelpMessageOpt("-alerts", strprintf(_("Receive and display P2P network alerts (default: %u)"), DEFAULT_ALERTS));
     strUsage += HelpMessageOpt("-alertnotify=<cmd>", _("Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)"));
+    strUsage += HelpMessageOpt("-assumevalid=<hex>", strprintf(_("If this block is in the chain assume that it and its ancestors are valid and potentially skip their script verification (0 to verify all, default: %s, testnet: %s)"), Params(CBaseChainParams::MAIN).GetConsensus().defaultAssumeValid.GetHex(), Params(CBaseChainParams::TESTNET).GetConsensus().defaultAssumeValid.GetHex()));
+    strUsage += HelpMessageOpt("-backgroundflush", strprintf(_("Write the coins cache to the chainstate database on a background thread instead of while holding up block processing (default: %u)"), DEFAULT_BACKGROUND_FLUSH));
+    strUsage += HelpMessageOpt("-blockcachesize=<n>", strprintf(_("Keep up to <n> MiB of recently served blocks decoded in memory (0 to disable, default: %u)"), DEFAULT_BLOCK_CACHE_SIZE));
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash)"));
     if (showDebug)
         strUsage += HelpMessageOpt("-blocksonly", strprintf(_("Whether to operate in a blocks only mode (default: %u)"), DEFAULT_BLOCKSONLY));
@@ -394,6 +409,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file on startup"));
+    strUsage += HelpMessageOpt("-loadutxosnapshot=<file>", _("Start a new node from a UTXO set snapshot written by dumptxoutset, if its content hash is known to this version. The blocks below it are downloaded and validated in the background"));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
     strUsage += HelpMessageOpt("-maxmempool=<n>", strprintf(_("Keep the transaction memory pool below <n> megabytes (default: %u)"), DEFAULT_MAX_MEMPOOL_SIZE));
     strUsage += HelpMessageOpt("-mempoolexpiry=<n>", strprintf(_("Do not keep transactions in the mempool longer than <n> hours (default: %u)"), DEFAULT_MEMPOOL_EXPIRY));
@@ -402,6 +418,8 @@ std::string HelpMessage(HelpMessageMode mode)
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), BITCOIN_PID_FILENAME));
 #endif
+    strUsage += HelpMessageOpt("-prefetchthreads=<n>", strprintf(_("Set the number of threads loading the coins spent by new blocks ahead of their validation (0 to %d, 0 = disable, default: %d)"),
+        MAX_PREFETCH_THREADS, DEFAULT_PREFETCH_THREADS));
     strUsage += HelpMessageOpt("-prune=<n>", strprintf(_("Reduce storage requirements by pruning (deleting) old blocks. This mode is incompatible with -txindex and -rescan. "
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
             "(default: 0 = disable pruning blocks, >%u = target size in MiB to use for block files)"), MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024));
@@ -505,6 +523,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-zmqpubrawblock=<address>", _("Enable publish raw block in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtx=<address>", _("Enable publish raw transaction in <address>"));
     strUsage += HelpMessageOpt("-zmqpubrawtxlock=<address>", _("Enable publish raw transaction (locked via InstantSend) in <address>"));
+    strUsage += HelpMessageOpt("-zmqpubtxlocklatency=<address>", _("Enable publish InstantSend lock latency of transactions in <address>"));
 #endif
 
     strUsage += HelpMessageGroup(_("Debugging/Testing options:"));
@@ -515,6 +534,7 @@ std::string HelpMessage(HelpMessageMode mode)
         strUsage += HelpMessageOpt("-checkmempool=<n>", strprintf("Run checks every <n> transactions (default: %u)", Params(CBaseChainParams::MAIN).DefaultConsistencyChecks()));
         strUsage += HelpMessageOpt("-checkpoints", strprintf("Disable expensive verification for known chain history (default: %u)", DEFAULT_CHECKPOINTS_ENABLED));
 #ifdef ENABLE_WALLET
+        strUsage += HelpMessageOpt("-checkwalletbalances", strprintf("Recount the wallet balances from all wallet transactions on every query and compare them with the running totals (default: %u)", Params(CBaseChainParams::MAIN).DefaultConsistencyChecks()));
         strUsage += HelpMessageOpt("-dblogsize=<n>", strprintf("Flush wallet database activity from memory to disk log every <n> megabytes (default: %u)", DEFAULT_WALLET_DBLOGSIZE));
 #endif
         strUsage += HelpMessageOpt("-disablesafemode", strprintf("Disable safemode, override a real safe mode event (default: %u)", DEFAULT_DISABLE_SAFEMODE));
@@ -977,6 +997,8 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     if (GetArg("-prune", 0)) {
         if (GetBoolArg("-txindex", DEFAULT_TXINDEX))
             return InitError(_("Prune mode is incompatible with -txindex."));
+        if (GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) || GetBoolArg("-spentindex", DEFAULT_SPENTINDEX) || GetBoolArg("-timestampindex", DEFAULT_TIMESTAMPINDEX))
+            return InitError(_("Prune mode is incompatible with -addressindex, -spentindex and -timestampindex."));
 #ifdef ENABLE_WALLET
         if (GetBoolArg("-rescan", false)) {
             return InitError(_("Rescans are not possible in pruned mode. You will need to use -reindex which will download the whole blockchain again."));
@@ -1031,6 +1053,12 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     fCheckBlockIndex = GetBoolArg("-checkblockindex", chainparams.DefaultConsistencyChecks());
     fCheckpointsEnabled = GetBoolArg("-checkpoints", DEFAULT_CHECKPOINTS_ENABLED);
 
+    hashAssumeValid = uint256S(GetArg("-assumevalid", chainparams.GetConsensus().defaultAssumeValid.GetHex()));
+    if (!hashAssumeValid.IsNull())
+        LogPrintf("Assuming ancestors of block %s have valid signatures.\n", hashAssumeValid.GetHex());
+    else
+        LogPrintf("Validating signatures for all blocks.\n");
+
     // mempool limits
     int64_t nMempoolSizeMax = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000;
     int64_t nMempoolSizeMin = GetArg("-limitdescendantsize", DEFAULT_DESCENDANT_SIZE_LIMIT) * 1000 * 40;
@@ -1046,6 +1074,14 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
         nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
 
+    nPrefetchThreads = GetArg("-prefetchthreads", DEFAULT_PREFETCH_THREADS);
+    if (nPrefetchThreads < 0)
+        nPrefetchThreads = 0;
+    else if (nPrefetchThreads > MAX_PREFETCH_THREADS)
+        nPrefetchThreads = MAX_PREFETCH_THREADS;
+
+    fBackgroundFlush = GetBoolArg("-backgroundflush", DEFAULT_BACKGROUND_FLUSH);
+
     fServer = GetBoolArg("-server", false);
 
     // block pruning; get the amount of disk space (in MiB) to allot for block & undo files
@@ -1139,6 +1175,7 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     nTxConfirmTarget = GetArg("-txconfirmtarget", DEFAULT_TX_CONFIRM_TARGET);
     bSpendZeroConfChange = GetBoolArg("-spendzeroconfchange", DEFAULT_SPEND_ZEROCONF_CHANGE);
     fSendFreeTransactions = GetBoolArg("-sendfreetransactions", DEFAULT_SEND_FREE_TRANSACTIONS);
+    fCheckWalletBalances = GetBoolArg("-checkwalletbalances", chainparams.DefaultConsistencyChecks());
 
     std::string strWalletFile = GetArg("-wallet", "wallet.dat");
 #endif // ENABLE_WALLET
@@ -1225,6 +1262,8 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         for (int i=0; i<nScriptCheckThreads-1; i++)
             threadGroup.create_thread(&ThreadScriptCheck);
     }
+    LogPrintf("Using %u threads for coins prefetch\n", nPrefetchThreads);
+    LogPrintf("Chainstate flushes are written %s\n", fBackgroundFlush ? "in the background" : "synchronously");
 
     if (mapArgs.count("-sporkkey")) // spork priv key
     {
@@ -1468,10 +1507,14 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set\n", nCoinCacheUsage * (1.0 / 1024 / 1024));
+    int64_t nBlockCacheUsage = std::max((int64_t)0, GetArg("-blockcachesize", DEFAULT_BLOCK_CACHE_SIZE)) << 20;
+    blockreader.SetMaxCacheUsage(nBlockCacheUsage);
+    LogPrintf("* Using %.1fMiB for served blocks\n", nBlockCacheUsage * (1.0 / 1024 / 1024));
 
     bool fLoaded = false;
     while (!fLoaded) {
         bool fReset = fReindex;
+        bool fSnapshotLoaded = false;
         std::string strLoadError;
 
         uiInterface.InitMessage(_("Loading block index..."));
@@ -1481,6 +1524,8 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             try {
                 UnloadBlockIndex();
                 delete pcoinsTip;
+                delete pcoinsPrefetch;
+                delete pcoinsFlusher;
                 delete pcoinsdbview;
                 delete pcoinscatcher;
                 delete pblocktree;
@@ -1488,7 +1533,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                 pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex);
                 pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex || fReindexChainState);
                 pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
-                pcoinsTip = new CCoinsViewCache(pcoinscatcher);
+                pcoinsFlusher = new CCoinsViewFlusher(pcoinscatcher, pcoinsdbview, fBackgroundFlush);
+                pcoinsPrefetch = new CCoinsViewPrefetch(pcoinsFlusher, nPrefetchThreads);
+                pcoinsTip = new CCoinsViewCache(pcoinsPrefetch);
 
                 if (fReindex) {
                     pblocktree->WriteReindexing(true);
@@ -1502,11 +1549,25 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                     break;
                 }
 
+                // The chainstate only has part of the coins if loading a UTXO snapshot got interrupted
+                bool fSnapshotLoading = false;
+                pblocktree->ReadFlag("utxosnapshotloading", fSnapshotLoading);
+                if (fSnapshotLoading) {
+                    strLoadError = _("Loading the UTXO snapshot was interrupted, the block database needs to be rebuilt");
+                    break;
+                }
+
                 // If the loaded chain has a wrong genesis, bail out immediately
                 // (we're likely using a testnet datadir, or the other way around).
                 if (!mapBlockIndex.empty() && mapBlockIndex.count(chainparams.GetConsensus().hashGenesisBlock) == 0)
                     return InitError(_("Incorrect or no genesis block found. Wrong datadir for network?"));
 
+                // If necessary, upgrade from the per-transaction chainstate format.
+                if (!pcoinsdbview->Upgrade()) {
+                    strLoadError = _("Error upgrading chainstate database");
+                    break;
+                }
+
                 // Initialize the block index (no-op if non-empty database was already loaded)
                 if (!InitBlockIndex(chainparams)) {
                     strLoadError = _("Error initializing block database");
@@ -1526,6 +1587,23 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                     break;
                 }
 
+                // A new node can start from a UTXO snapshot instead of connecting every block,
+                // the block index and chainstate are then loaded again starting at its base block
+                if (mapArgs.count("-loadutxosnapshot") && !fReindex && !fReindexChainState) {
+                    if (chainActive.Height() > 0) {
+                        LogPrintf("Ignoring -loadutxosnapshot, the chainstate is past the genesis block already\n");
+                    } else {
+                        std::string strError;
+                        if (!LoadUTXOSnapshot(GetArg("-loadutxosnapshot", ""), chainparams, strError)) {
+                            if (fRequestShutdown)
+                                break;
+                            return InitError(strError);
+                        }
+                        fSnapshotLoaded = true;
+                        break;
+                    }
+                }
+
                 uiInterface.InitMessage(_("Verifying blocks..."));
                 if (fHavePruned && GetArg("-checkblocks", DEFAULT_CHECKBLOCKS) > MIN_BLOCKS_TO_KEEP) {
                     LogPrintf("Prune: pruned datadir may not have more than %d blocks; -checkblocks=%d may fail\n",
@@ -1557,7 +1635,11 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             fLoaded = true;
         } while(false);
 
-        if (!fLoaded) {
+        if (fSnapshotLoaded)
+            continue;
+
+        // an interrupted chainstate upgrade resumes on the next start, no need to offer a reindex
+        if (!fLoaded && !fRequestShutdown) {
             // first suggest a reindex
             if (!fReset) {
                 bool fRet = uiInterface.ThreadSafeMessageBox(
@@ -1593,6 +1675,10 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         mempool.ReadFeeEstimates(est_filein);
     fFeeEstimatesInitialized = true;
 
+    // the address, spent and timestamp indexes are built in the background
+    if (!blockIndexer.Start())
+        return InitError(_("Error initializing the address, spent and timestamp indexes"));
+
     // ********************************************************* Step 8: load wallet
 #ifdef ENABLE_WALLET
     if (fDisableWallet) {
@@ -1790,6 +1876,18 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
         }
     }
 
+    // the blocks below a UTXO snapshot are downloaded and validated in the background,
+    // there is no history to serve until that is done
+    if (pindexSnapshotBase) {
+        bool fSnapshotValidated = false;
+        pblocktree->ReadFlag("utxosnapshotvalidated", fSnapshotValidated);
+        if (!fSnapshotValidated) {
+            LogPrintf("Unsetting NODE_NETWORK for a chainstate loaded from a UTXO snapshot\n");
+            nLocalServices &= ~NODE_NETWORK;
+            threadGroup.create_thread(&ThreadValidateUTXOSnapshot);
+        }
+    }
+
     // ********************************************************* Step 10: import blocks
 
     if (mapArgs.count("-blocknotify"))
@@ -1937,9 +2035,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     masternodeSync.UpdatedBlockTip(chainActive.Tip());
     governance.UpdatedBlockTip(chainActive.Tip());
 
-    // ********************************************************* Step 11d: start 3dcoin-privatesend thread
+    // ********************************************************* Step 11d: schedule 3dcoin-privatesend tasks
 
-    threadGroup.create_thread(boost::bind(&ThreadCheckDarkSendPool));
+    privateSendScheduler.Start(scheduler, threadGroup);
 
     // ********************************************************* Step 12: start node
 
@@ -57,16 +57,43 @@ void CInstantSend::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataSt
         CTxLockVote vote;
         vRecv >> vote;
 
-        LOCK2(cs_main, cs_instantsend);
-
         uint256 nVoteHash = vote.GetHash();
 
-        pfrom->setAskFor.erase(nVoteHash);
+        {
+            LOCK(cs_instantsend);
+            pfrom->setAskFor.erase(nVoteHash);
+            if(mapTxLockVotes.count(nVoteHash)) return;
+        }
+
+        // Masternode rank and signature checks are the expensive part of vote processing,
+        // do them first without holding cs_main so that block validation and RPC can go on meanwhile.
+        // Only the state update below needs the locks.
+        int64_t nTimeVerifyStart = GetTimeMicros();
+        bool fVoteValid = vote.IsValid(pfrom);
+        int64_t nTimeVerify = GetTimeMicros() - nTimeVerifyStart;
+
+        int64_t nTimeLockStart = GetTimeMicros();
+        LOCK(cs_main);
+        int64_t nTimeCsMainWait = GetTimeMicros() - nTimeLockStart;
+        LOCK(cs_instantsend);
+
+        stats.histVoteVerify.Add(nTimeVerify);
+        stats.histCsMainWait.Add(nTimeCsMainWait);
 
+        // could have been added while we were verifying it
         if(mapTxLockVotes.count(nVoteHash)) return;
         mapTxLockVotes.insert(std::make_pair(nVoteHash, vote));
 
+        if(!fVoteValid) {
+            // could be because of missing MN
+            LogPrint("instantsend", "CInstantSend::ProcessMessage -- Vote is invalid, txid=%s\n", vote.GetTxHash().ToString());
+            return;
+        }
+
+        stats.nVotesReceived++;
+        int64_t nTimeProcessStart = GetTimeMicros();
         ProcessTxLockVote(pfrom, vote);
+        stats.histVoteProcess.Add(GetTimeMicros() - nTimeProcessStart);
 
         return;
     }
@@ -74,7 +101,12 @@ void CInstantSend::ProcessMessage(CNode* pfrom, std::string& strCommand, CDataSt
 
 bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest)
 {
-    LOCK2(cs_main, cs_instantsend);
+    int64_t nTimeLockStart = GetTimeMicros();
+    LOCK(cs_main);
+    int64_t nTimeCsMainWait = GetTimeMicros() - nTimeLockStart;
+    LOCK(cs_instantsend);
+
+    stats.histCsMainWait.Add(nTimeCsMainWait);
 
     uint256 txHash = txLockRequest.GetHash();
 
@@ -115,7 +147,7 @@ bool CInstantSend::ProcessTxLockRequest(const CTxLockRequest& txLockRequest)
     std::map<uint256, CTxLockCandidate>::iterator itLockCandidate = mapTxLockCandidates.find(txHash);
     CTxLockCandidate& txLockCandidate = itLockCandidate->second;
     Vote(txLockCandidate);
-    ProcessOrphanTxLockVotes();
+    ProcessOrphanTxLockVotes(txHash);
 
     // Masternodes will sometimes propagate votes before the transaction is known to the client.
     // If this just happened - lock inputs, resolve conflicting locks, update transaction status
@@ -144,6 +176,7 @@ bool CInstantSend::CreateTxLockCandidate(const CTxLockRequest& txLockRequest)
             txLockCandidate.AddOutPointLock(txin.prevout);
         }
         mapTxLockCandidates.insert(std::make_pair(txHash, txLockCandidate));
+        stats.histRequestToCandidate.Add(GetTimeMicros() - txLockRequest.GetTimeCreatedMicros());
     } else {
         LogPrint("instantsend", "CInstantSend::CreateTxLockCandidate -- seen, txid=%s\n", txHash.ToString());
     }
@@ -171,17 +204,11 @@ void CInstantSend::Vote(CTxLockCandidate& txLockCandidate)
 
         int nLockInputHeight = nPrevoutHeight + 4;
 
-        int n = mnodeman.GetMasternodeRank(activeMasternode.vin, nLockInputHeight, MIN_INSTANTSEND_PROTO_VERSION);
+        int nSignaturesTotal = COutPointLock::SIGNATURES_TOTAL;
+        int n = mnodeman.GetMasternodeQuorumRank(activeMasternode.vin, nLockInputHeight, nSignaturesTotal, MIN_INSTANTSEND_PROTO_VERSION);
 
         if(n == -1) {
-            LogPrint("instantsend", "CInstantSend::Vote -- Can't calculate rank for masternode %s\n", activeMasternode.vin.prevout.ToStringShort());
-            ++itOutpointLock;
-            continue;
-        }
-
-        int nSignaturesTotal = COutPointLock::SIGNATURES_TOTAL;
-        if(n > nSignaturesTotal) {
-            LogPrint("instantsend", "CInstantSend::Vote -- Masternode not in the top %d (%d)\n", nSignaturesTotal, n);
+            LogPrint("instantsend", "CInstantSend::Vote -- Masternode %s is not in the top %d\n", activeMasternode.vin.prevout.ToStringShort(), nSignaturesTotal);
             ++itOutpointLock;
             continue;
         }
@@ -257,19 +284,16 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote)
 
     uint256 txHash = vote.GetTxHash();
 
-    if(!vote.IsValid(pfrom)) {
-        // could be because of missing MN
-        LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Vote is invalid, txid=%s\n", txHash.ToString());
-        return false;
-    }
+    // NOTE: vote is not verified here, this was done when it was received.
+    // Orphan votes are only kept for ORPHAN_VOTE_SECONDS so they are not verified again when reprocessed.
 
     // Masternodes will sometimes propagate votes before the transaction is known to the client,
     // will actually process only after the lock request itself has arrived
 
     std::map<uint256, CTxLockCandidate>::iterator it = mapTxLockCandidates.find(txHash);
     if(it == mapTxLockCandidates.end()) {
-        if(!mapTxLockVotesOrphan.count(vote.GetHash())) {
-            mapTxLockVotesOrphan[vote.GetHash()] = vote;
+        if(txLockVotesOrphan.Add(vote, vote.GetTimeCreated() + ORPHAN_VOTE_SECONDS)) {
+            stats.nVotesOrphan++;
             LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- Orphan vote: txid=%s  masternode=%s new\n",
                     txHash.ToString(), vote.GetMasternodeOutpoint().ToStringShort());
             bool fReprocess = true;
@@ -297,10 +321,11 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote)
         // TODO: make sure this works good enough for multi-quorum
 
         int nMasternodeOrphanExpireTime = GetTime() + 60*10; // keep time data for 10 minutes
-        if(!mapMasternodeOrphanVotes.count(vote.GetMasternodeOutpoint())) {
-            mapMasternodeOrphanVotes[vote.GetMasternodeOutpoint()] = nMasternodeOrphanExpireTime;
+        std::map<COutPoint, int64_t>::iterator itMnOrphan = mapMasternodeOrphanVotes.find(vote.GetMasternodeOutpoint());
+        if(itMnOrphan == mapMasternodeOrphanVotes.end()) {
+            SetMasternodeOrphanVoteTime(vote.GetMasternodeOutpoint(), nMasternodeOrphanExpireTime);
         } else {
-            int64_t nPrevOrphanVote = mapMasternodeOrphanVotes[vote.GetMasternodeOutpoint()];
+            int64_t nPrevOrphanVote = itMnOrphan->second;
             if(nPrevOrphanVote > GetTime() && nPrevOrphanVote > GetAverageMasternodeOrphanVoteTime()) {
                 LogPrint("instantsend", "CInstantSend::ProcessTxLockVote -- masternode is spamming orphan Transaction Lock Votes: txid=%s  masternode=%s\n",
                         txHash.ToString(), vote.GetMasternodeOutpoint().ToStringShort());
@@ -308,7 +333,7 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote)
                 return false;
             }
             // not spamming, refresh
-            mapMasternodeOrphanVotes[vote.GetMasternodeOutpoint()] = nMasternodeOrphanExpireTime;
+            SetMasternodeOrphanVoteTime(vote.GetMasternodeOutpoint(), nMasternodeOrphanExpireTime);
         }
 
         return true;
@@ -362,15 +387,14 @@ bool CInstantSend::ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote)
     return true;
 }
 
-void CInstantSend::ProcessOrphanTxLockVotes()
+void CInstantSend::ProcessOrphanTxLockVotes(const uint256& txHash)
 {
     LOCK2(cs_main, cs_instantsend);
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.begin();
-    while(it != mapTxLockVotesOrphan.end()) {
-        if(ProcessTxLockVote(NULL, it->second)) {
-            mapTxLockVotesOrphan.erase(it++);
-        } else {
-            ++it;
+    // only orphans of this tx can be processed now, the rest are still waiting for their lock requests
+    std::vector<CTxLockVote> vecVotes = txLockVotesOrphan.GetVotes(txHash);
+    BOOST_FOREACH(CTxLockVote& vote, vecVotes) {
+        if(ProcessTxLockVote(NULL, vote)) {
+            txLockVotesOrphan.Remove(vote.GetHash());
         }
     }
 }
@@ -378,35 +402,23 @@ void CInstantSend::ProcessOrphanTxLockVotes()
 bool CInstantSend::IsEnoughOrphanVotesForTx(const CTxLockRequest& txLockRequest)
 {
     // There could be a situation when we already have quite a lot of votes
-    // but tx lock request still wasn't received. Let's scan through
-    // orphan votes to check if this is the case.
+    // but tx lock request still wasn't received. Let's check orphan votes
+    // of this tx to see if this is the case.
+    std::map<COutPoint, int> mapVoteCounts;
+    {
+        LOCK(cs_instantsend);
+        mapVoteCounts = txLockVotesOrphan.CountVotes(txLockRequest.GetHash());
+    }
     BOOST_FOREACH(const CTxIn& txin, txLockRequest.vin) {
-        if(!IsEnoughOrphanVotesForTxAndOutPoint(txLockRequest.GetHash(), txin.prevout)) {
+        std::map<COutPoint, int>::iterator it = mapVoteCounts.find(txin.prevout);
+        if(it == mapVoteCounts.end() || it->second < COutPointLock::SIGNATURES_REQUIRED) {
             return false;
         }
     }
     return true;
 }
 
-bool CInstantSend::IsEnoughOrphanVotesForTxAndOutPoint(const uint256& txHash, const COutPoint& outpoint)
-{
-    // Scan orphan votes to check if this outpoint has enough orphan votes to be locked in some tx.
-    LOCK2(cs_main, cs_instantsend);
-    int nCountVotes = 0;
-    std::map<uint256, CTxLockVote>::iterator it = mapTxLockVotesOrphan.begin();
-    while(it != mapTxLockVotesOrphan.end()) {
-        if(it->second.GetTxHash() == txHash && it->second.GetOutpoint() == outpoint) {
-            nCountVotes++;
-            if(nCountVotes >= COutPointLock::SIGNATURES_REQUIRED) {
-                return true;
-            }
-        }
-        ++it;
-    }
-    return false;
-}
-
-void CInstantSend::TryToFinalizeLockCandidate(const CTxLockCandidate& txLockCandidate)
+void CInstantSend::TryToFinalizeLockCandidate(CTxLockCandidate& txLockCandidate)
 {
     LOCK2(cs_main, cs_instantsend);
 
@@ -416,6 +428,7 @@ void CInstantSend::TryToFinalizeLockCandidate(const CTxLockCandidate& txLockCand
         LogPrint("instantsend", "CInstantSend::TryToFinalizeLockCandidate -- Transaction Lock is ready to complete, txid=%s\n", txHash.ToString());
         if(ResolveConflicts(txLockCandidate, Params().GetConsensus().nInstantSendKeepLock)) {
             LockTransactionInputs(txLockCandidate);
+            UpdateLockLatencyStats(txLockCandidate);
             UpdateLockedTransaction(txLockCandidate);
         }
     }
@@ -444,9 +457,46 @@ void CInstantSend::UpdateLockedTransaction(const CTxLockCandidate& txLockCandida
 
     GetMainSignals().NotifyTransactionLock(txLockCandidate.txLockRequest);
 
+    if(txLockCandidate.nTimeLockedMicros) {
+        stats.histLockToNotify.Add(GetTimeMicros() - txLockCandidate.nTimeLockedMicros);
+        GetMainSignals().NotifyTransactionLockLatency(txHash,
+                txLockCandidate.nTimeLockedMicros - txLockCandidate.txLockRequest.GetTimeCreatedMicros(),
+                txLockCandidate.nTimeLockedMicros - txLockCandidate.nTimeFirstVoteMicros,
+                txLockCandidate.CountVotes());
+    }
+
     LogPrint("instantsend", "CInstantSend::UpdateLockedTransaction -- done, txid=%s\n", txHash.ToString());
 }
 
+void CInstantSend::UpdateLockLatencyStats(CTxLockCandidate& txLockCandidate)
+{
+    LOCK(cs_instantsend);
+
+    if(!IsLockedInstantSendTransaction(txLockCandidate.GetHash())) return;
+
+    int64_t nTimeNow = GetTimeMicros();
+    int64_t nTimeFirstVote = nTimeNow;
+    int nVotes = 0;
+
+    std::map<COutPoint, COutPointLock>::const_iterator itOutpointLock = txLockCandidate.mapOutPointLocks.begin();
+    while(itOutpointLock != txLockCandidate.mapOutPointLocks.end()) {
+        std::vector<CTxLockVote> vVotes = itOutpointLock->second.GetVotes();
+        for(size_t i = 0; i < vVotes.size(); ++i) {
+            stats.histVoteToLock.Add(nTimeNow - vVotes[i].GetTimeCreatedMicros());
+            nTimeFirstVote = std::min(nTimeFirstVote, vVotes[i].GetTimeCreatedMicros());
+        }
+        nVotes += vVotes.size();
+        ++itOutpointLock;
+    }
+
+    txLockCandidate.nTimeFirstVoteMicros = nTimeFirstVote;
+    txLockCandidate.nTimeLockedMicros = nTimeNow;
+
+    stats.histFirstVoteToLock.Add(nTimeNow - nTimeFirstVote);
+    stats.histRequestToLock.Add(nTimeNow - txLockCandidate.txLockRequest.GetTimeCreatedMicros());
+    stats.histVotesPerLock.Add(nVotes);
+}
+
 void CInstantSend::LockTransactionInputs(const CTxLockCandidate& txLockCandidate)
 {
     LOCK(cs_instantsend);
@@ -535,10 +585,8 @@ bool CInstantSend::ResolveConflicts(const CTxLockCandidate& txLockCandidate, int
     }
     // Not in block yet, make sure all its inputs are still unspent
     BOOST_FOREACH(const CTxIn& txin, txLockCandidate.txLockRequest.vin) {
-        CCoins coins;
-        if(!pcoinsTip->GetCoins(txin.prevout.hash, coins) ||
-           (unsigned int)txin.prevout.n>=coins.vout.size() ||
-           coins.vout[txin.prevout.n].IsNull()) {
+        Coin coin;
+        if(!pcoinsTip->GetCoin(txin.prevout, coin)) {
             // Not in UTXO anymore? A conflicting tx was mined while we were waiting for votes.
             // Reprocess tip to make sure tx for this lock is included.
             LogPrintf("CTxLockRequest::ResolveConflicts -- Failed to find UTXO %s - disconnecting tip...\n", txin.prevout.ToStringShort());
@@ -568,15 +616,20 @@ int64_t CInstantSend::GetAverageMasternodeOrphanVoteTime()
     // NOTE: should never actually call this function when mapMasternodeOrphanVotes is empty
     if(mapMasternodeOrphanVotes.empty()) return 0;
 
-    std::map<COutPoint, int64_t>::iterator it = mapMasternodeOrphanVotes.begin();
-    int64_t total = 0;
+    return nMasternodeOrphanVoteTimeTotal / (int64_t)mapMasternodeOrphanVotes.size();
+}
 
-    while(it != mapMasternodeOrphanVotes.end()) {
-        total+= it->second;
-        ++it;
+void CInstantSend::SetMasternodeOrphanVoteTime(const COutPoint& outpointMasternode, int64_t nTime)
+{
+    // keep the running total in sync so the average is O(1)
+    std::map<COutPoint, int64_t>::iterator it = mapMasternodeOrphanVotes.find(outpointMasternode);
+    if(it == mapMasternodeOrphanVotes.end()) {
+        mapMasternodeOrphanVotes.insert(std::make_pair(outpointMasternode, nTime));
+    } else {
+        nMasternodeOrphanVoteTimeTotal -= it->second;
+        it->second = nTime;
     }
-
-    return total / mapMasternodeOrphanVotes.size();
+    nMasternodeOrphanVoteTimeTotal += nTime;
 }
 
 void CInstantSend::CheckAndRemove()
@@ -620,16 +673,10 @@ void CInstantSend::CheckAndRemove()
     }
 
     // remove expired orphan votes
-    std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.begin();
-    while(itOrphanVote != mapTxLockVotesOrphan.end()) {
-        if(GetTime() - itOrphanVote->second.GetTimeCreated() > ORPHAN_VOTE_SECONDS) {
-            LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing expired orphan vote: txid=%s  masternode=%s\n",
-                    itOrphanVote->second.GetTxHash().ToString(), itOrphanVote->second.GetMasternodeOutpoint().ToStringShort());
-            mapTxLockVotes.erase(itOrphanVote->first);
-            mapTxLockVotesOrphan.erase(itOrphanVote++);
-        } else {
-            ++itOrphanVote;
-        }
+    std::vector<uint256> vecExpiredOrphans = txLockVotesOrphan.RemoveExpired(GetTime());
+    BOOST_FOREACH(const uint256& nVoteHash, vecExpiredOrphans) {
+        LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing expired orphan vote: hash=%s\n", nVoteHash.ToString());
+        mapTxLockVotes.erase(nVoteHash);
     }
 
     // remove expired masternode orphan votes (DOS protection)
@@ -638,6 +685,7 @@ void CInstantSend::CheckAndRemove()
         if(itMasternodeOrphan->second < GetTime()) {
             LogPrint("instantsend", "CInstantSend::CheckAndRemove -- Removing expired orphan masternode vote: masternode=%s\n",
                     itMasternodeOrphan->first.ToStringShort());
+            nMasternodeOrphanVoteTimeTotal -= itMasternodeOrphan->second;
             mapMasternodeOrphanVotes.erase(itMasternodeOrphan++);
         } else {
             ++itMasternodeOrphan;
@@ -645,6 +693,10 @@ void CInstantSend::CheckAndRemove()
     }
 
     LogPrintf("CInstantSend::CheckAndRemove -- %s\n", ToString());
+    LogPrint("instantsend", "CInstantSend::CheckAndRemove -- vote verification: %s\n", stats.histVoteVerify.ToString());
+    LogPrint("instantsend", "CInstantSend::CheckAndRemove -- vote to lock: %s\n", stats.histVoteToLock.ToString());
+    LogPrint("instantsend", "CInstantSend::CheckAndRemove -- request to lock: %s\n", stats.histRequestToLock.ToString());
+    LogPrint("instantsend", "CInstantSend::CheckAndRemove -- cs_main wait: %s\n", stats.histCsMainWait.ToString());
 }
 
 bool CInstantSend::AlreadyHave(const uint256& hash)
@@ -834,17 +886,27 @@ void CInstantSend::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
     }
 
     // check orphan votes
-    std::map<uint256, CTxLockVote>::iterator itOrphanVote = mapTxLockVotesOrphan.begin();
-    while(itOrphanVote != mapTxLockVotesOrphan.end()) {
-        if(itOrphanVote->second.GetTxHash() == txHash) {
-            LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d vote %s updated\n",
-                    txHash.ToString(), nHeightNew, itOrphanVote->first.ToString());
-            mapTxLockVotes[itOrphanVote->first].SetConfirmedHeight(nHeightNew);
-        }
-        ++itOrphanVote;
+    std::vector<CTxLockVote> vecOrphanVotes = txLockVotesOrphan.GetVotes(txHash);
+    BOOST_FOREACH(const CTxLockVote& vote, vecOrphanVotes) {
+        uint256 nVoteHash = vote.GetHash();
+        LogPrint("instantsend", "CInstantSend::SyncTransaction -- txid=%s nHeightNew=%d vote %s updated\n",
+                txHash.ToString(), nHeightNew, nVoteHash.ToString());
+        mapTxLockVotes[nVoteHash].SetConfirmedHeight(nHeightNew);
     }
 }
 
+CInstantSendStats CInstantSend::GetStats()
+{
+    LOCK(cs_instantsend);
+    return stats;
+}
+
+void CInstantSend::ResetStats()
+{
+    LOCK(cs_instantsend);
+    stats.Clear();
+}
+
 std::string CInstantSend::ToString()
 {
     LOCK(cs_instantsend);
@@ -885,12 +947,10 @@ bool CTxLockRequest::IsValid(bool fRequireUnspent) const
 
     BOOST_FOREACH(const CTxIn& txin, vin) {
 
-        CCoins coins;
+        Coin coin;
         int nPrevoutHeight = 0;
         CAmount nValue = 0;
-        if(!pcoinsTip->GetCoins(txin.prevout.hash, coins) ||
-           (unsigned int)txin.prevout.n>=coins.vout.size() ||
-           coins.vout[txin.prevout.n].IsNull()) {
+        if(!pcoinsTip->GetCoin(txin.prevout, coin)) {
             LogPrint("instantsend", "CTxLockRequest::IsValid -- Failed to find UTXO %s\n", txin.prevout.ToStringShort());
             // Normally above sould be enough, but in case we are reprocessing this because of
             // a lot of legit orphan votes we should also check already spent outpoints.
@@ -917,8 +977,8 @@ bool CTxLockRequest::IsValid(bool fRequireUnspent) const
             nPrevoutHeight = mi->second->nHeight;
             nValue = txOutpointCreated.vout[txin.prevout.n].nValue;
         } else {
-            nPrevoutHeight = coins.nHeight;
-            nValue = coins.vout[txin.prevout.n].nValue;
+            nPrevoutHeight = coin.nHeight;
+            nValue = coin.out.nValue;
         }
 
         int nTxAge = chainActive.Height() - nPrevoutHeight + 1;
@@ -998,22 +1058,17 @@ bool CTxLockVote::IsValid(CNode* pnode) const
 
     int nLockInputHeight = nPrevoutHeight + 4;
 
-    int n = mnodeman.GetMasternodeRank(CTxIn(outpointMasternode), nLockInputHeight, MIN_INSTANTSEND_PROTO_VERSION);
+    int nSignaturesTotal = COutPointLock::SIGNATURES_TOTAL;
+    int n = mnodeman.GetMasternodeQuorumRank(CTxIn(outpointMasternode), nLockInputHeight, nSignaturesTotal, MIN_INSTANTSEND_PROTO_VERSION);
 
     if(n == -1) {
-        //can be caused by past versions trying to vote with an invalid protocol
-        LogPrint("instantsend", "CTxLockVote::IsValid -- Can't calculate rank for masternode %s\n", outpointMasternode.ToStringShort());
+        //can also be caused by past versions trying to vote with an invalid protocol
+        LogPrint("instantsend", "CTxLockVote::IsValid -- Masternode %s is not in the top %d, vote hash=%s\n",
+                outpointMasternode.ToStringShort(), nSignaturesTotal, GetHash().ToString());
         return false;
     }
     LogPrint("instantsend", "CTxLockVote::IsValid -- Masternode %s, rank=%d\n", outpointMasternode.ToStringShort(), n);
 
-    int nSignaturesTotal = COutPointLock::SIGNATURES_TOTAL;
-    if(n > nSignaturesTotal) {
-        LogPrint("instantsend", "CTxLockVote::IsValid -- Masternode %s is not in the top %d (%d), vote hash=%s\n",
-                outpointMasternode.ToStringShort(), nSignaturesTotal, n, GetHash().ToString());
-        return false;
-    }
-
     if(!CheckSignature()) {
         LogPrintf("CTxLockVote::IsValid -- Signature invalid\n");
         return false;
@@ -1081,6 +1136,104 @@ bool CTxLockVote::IsExpired(int nHeight) const
     return (nConfirmedHeight != -1) && (nHeight - nConfirmedHeight > Params().GetConsensus().nInstantSendKeepLock);
 }
 
+//
+// CTxLockVoteOrphans
+//
+
+bool CTxLockVoteOrphans::Add(const CTxLockVote& vote, int64_t nExpirationTime)
+{
+    uint256 nVoteHash = vote.GetHash();
+    if(!mapVotes.insert(std::make_pair(nVoteHash, std::make_pair(vote, nExpirationTime))).second) {
+        return false;
+    }
+    mapVotesByTx[vote.GetTxHash()].insert(nVoteHash);
+    mapExpiration.insert(std::make_pair(nExpirationTime, nVoteHash));
+    return true;
+}
+
+bool CTxLockVoteOrphans::Has(const uint256& nVoteHash) const
+{
+    return mapVotes.count(nVoteHash);
+}
+
+bool CTxLockVoteOrphans::Remove(const uint256& nVoteHash)
+{
+    std::map<uint256, std::pair<CTxLockVote, int64_t> >::iterator it = mapVotes.find(nVoteHash);
+    if(it == mapVotes.end()) {
+        return false;
+    }
+
+    uint256 txHash = it->second.first.GetTxHash();
+    std::map<uint256, std::set<uint256> >::iterator itTx = mapVotesByTx.find(txHash);
+    if(itTx != mapVotesByTx.end()) {
+        itTx->second.erase(nVoteHash);
+        if(itTx->second.empty()) {
+            mapVotesByTx.erase(itTx);
+        }
+    }
+
+    std::pair<std::multimap<int64_t, uint256>::iterator, std::multimap<int64_t, uint256>::iterator> range =
+            mapExpiration.equal_range(it->second.second);
+    for(std::multimap<int64_t, uint256>::iterator itExp = range.first; itExp != range.second; ++itExp) {
+        if(itExp->second == nVoteHash) {
+            mapExpiration.erase(itExp);
+            break;
+        }
+    }
+
+    mapVotes.erase(it);
+    return true;
+}
+
+std::vector<CTxLockVote> CTxLockVoteOrphans::GetVotes(const uint256& txHash) const
+{
+    std::vector<CTxLockVote> vecVotes;
+    std::map<uint256, std::set<uint256> >::const_iterator itTx = mapVotesByTx.find(txHash);
+    if(itTx == mapVotesByTx.end()) {
+        return vecVotes;
+    }
+    vecVotes.reserve(itTx->second.size());
+    BOOST_FOREACH(const uint256& nVoteHash, itTx->second) {
+        vecVotes.push_back(mapVotes.find(nVoteHash)->second.first);
+    }
+    return vecVotes;
+}
+
+std::map<COutPoint, int> CTxLockVoteOrphans::CountVotes(const uint256& txHash) const
+{
+    std::map<COutPoint, int> mapCounts;
+    std::map<uint256, std::set<uint256> >::const_iterator itTx = mapVotesByTx.find(txHash);
+    if(itTx == mapVotesByTx.end()) {
+        return mapCounts;
+    }
+    BOOST_FOREACH(const uint256& nVoteHash, itTx->second) {
+        ++mapCounts[mapVotes.find(nVoteHash)->second.first.GetOutpoint()];
+    }
+    return mapCounts;
+}
+
+std::vector<uint256> CTxLockVoteOrphans::RemoveExpired(int64_t nTime)
+{
+    std::vector<uint256> vecRemoved;
+    while(!mapExpiration.empty() && mapExpiration.begin()->first < nTime) {
+        uint256 nVoteHash = mapExpiration.begin()->second;
+        // Remove() drops the expiration entry too
+        if(!Remove(nVoteHash)) {
+            mapExpiration.erase(mapExpiration.begin());
+            continue;
+        }
+        vecRemoved.push_back(nVoteHash);
+    }
+    return vecRemoved;
+}
+
+void CTxLockVoteOrphans::Clear()
+{
+    mapVotes.clear();
+    mapVotesByTx.clear();
+    mapExpiration.clear();
+}
+
 //
 // COutPointLock
 //
@@ -4,10 +4,12 @@
 #ifndef INSTANTX_H
 #define INSTANTX_H
 
+#include "latencyhistogram.h"
 #include "net.h"
 #include "primitives/transaction.h"
 
 class CTxLockVote;
+class CTxLockVoteOrphans;
 class COutPointLock;
 class CTxLockRequest;
 class CTxLockCandidate;
@@ -33,6 +35,72 @@ extern bool fEnableInstantSend;
 extern int nInstantSendDepth;
 extern int nCompleteTXLocks;
 
+/**
+ * Votes received before the corresponding lock request (orphan votes).
+ *
+ * Votes are indexed by hash, by tx hash and by expiration time, so looking
+ * up the votes of one tx and removing expired votes only touches the votes
+ * involved instead of the whole set.
+ */
+class CTxLockVoteOrphans
+{
+private:
+    std::map<uint256, std::pair<CTxLockVote, int64_t> > mapVotes; // vote hash - vote, expiration time
+    std::map<uint256, std::set<uint256> > mapVotesByTx; // tx hash - vote hashes
+    std::multimap<int64_t, uint256> mapExpiration; // expiration time - vote hash
+
+public:
+    CTxLockVoteOrphans() :
+        mapVotes(),
+        mapVotesByTx(),
+        mapExpiration()
+        {}
+
+    bool Add(const CTxLockVote& vote, int64_t nExpirationTime);
+    bool Has(const uint256& nVoteHash) const;
+    bool Remove(const uint256& nVoteHash);
+
+    std::vector<CTxLockVote> GetVotes(const uint256& txHash) const;
+    // count votes for each outpoint of the tx
+    std::map<COutPoint, int> CountVotes(const uint256& txHash) const;
+
+    // remove votes which expire before nTime, returns their hashes
+    std::vector<uint256> RemoveExpired(int64_t nTime);
+
+    size_t size() const { return mapVotes.size(); }
+    void Clear();
+};
+
+/**
+ * InstantSend counters and latency histograms, all latencies are in microseconds.
+ */
+class CInstantSendStats
+{
+public:
+    int64_t nTimeStart; // since when the stats are collected
+
+    CLatencyHistogram histRequestToCandidate; // lock request received -> lock candidate created
+    CLatencyHistogram histVoteVerify; // rank and signature check of a received vote (done without cs_main)
+    CLatencyHistogram histVoteProcess; // ProcessTxLockVote for a received vote
+    CLatencyHistogram histVoteToLock; // arrival of each vote counted in a lock -> lock completion
+    CLatencyHistogram histFirstVoteToLock; // arrival of the first vote for a tx -> lock completion
+    CLatencyHistogram histRequestToLock; // lock request received -> lock completion
+    CLatencyHistogram histLockToNotify; // lock completion -> wallet and listeners notified
+    CLatencyHistogram histCsMainWait; // waiting for cs_main to process lock requests and votes
+    CLatencyHistogram histVotesPerLock; // number of votes, not a latency
+
+    uint64_t nVotesReceived; // valid votes received from the network
+    uint64_t nVotesOrphan; // received before their lock request
+
+    CInstantSendStats() :
+        nTimeStart(GetTime()),
+        nVotesReceived(0),
+        nVotesOrphan(0)
+        {}
+
+    void Clear() { *this = CInstantSendStats(); }
+};
+
 class CInstantSend
 {
 private:
@@ -45,7 +113,7 @@ private:
     std::map<uint256, CTxLockRequest> mapLockRequestAccepted; // tx hash - tx
     std::map<uint256, CTxLockRequest> mapLockRequestRejected; // tx hash - tx
     std::map<uint256, CTxLockVote> mapTxLockVotes; // vote hash - vote
-    std::map<uint256, CTxLockVote> mapTxLockVotesOrphan; // vote hash - vote
+    CTxLockVoteOrphans txLockVotesOrphan;
 
     std::map<uint256, CTxLockCandidate> mapTxLockCandidates; // tx hash - lock candidate
 
@@ -54,21 +122,25 @@ private:
 
     //track masternodes who voted with no txreq (for DOS protection)
     std::map<COutPoint, int64_t> mapMasternodeOrphanVotes; // mn outpoint - time
+    int64_t nMasternodeOrphanVoteTimeTotal; // sum of mapMasternodeOrphanVotes times
+
+    CInstantSendStats stats;
 
     bool CreateTxLockCandidate(const CTxLockRequest& txLockRequest);
     void Vote(CTxLockCandidate& txLockCandidate);
 
-    //process consensus vote message
+    //process consensus vote message, vote must be verified already (see CTxLockVote::IsValid)
     bool ProcessTxLockVote(CNode* pfrom, CTxLockVote& vote);
-    void ProcessOrphanTxLockVotes();
+    void ProcessOrphanTxLockVotes(const uint256& txHash);
     bool IsEnoughOrphanVotesForTx(const CTxLockRequest& txLockRequest);
-    bool IsEnoughOrphanVotesForTxAndOutPoint(const uint256& txHash, const COutPoint& outpoint);
     int64_t GetAverageMasternodeOrphanVoteTime();
+    void SetMasternodeOrphanVoteTime(const COutPoint& outpointMasternode, int64_t nTime);
 
-    void TryToFinalizeLockCandidate(const CTxLockCandidate& txLockCandidate);
+    void TryToFinalizeLockCandidate(CTxLockCandidate& txLockCandidate);
     void LockTransactionInputs(const CTxLockCandidate& txLockCandidate);
     //update UI and notify external script if any
     void UpdateLockedTransaction(const CTxLockCandidate& txLockCandidate);
+    void UpdateLockLatencyStats(CTxLockCandidate& txLockCandidate);
     bool ResolveConflicts(const CTxLockCandidate& txLockCandidate, int nMaxBlocks);
 
     bool IsInstantSendReadyToLock(const uint256 &txHash);
@@ -76,6 +148,11 @@ private:
 public:
     CCriticalSection cs_instantsend;
 
+    CInstantSend() :
+        pCurrentBlockIndex(NULL),
+        nMasternodeOrphanVoteTimeTotal(0)
+        {}
+
     void ProcessMessage(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
 
     bool ProcessTxLockRequest(const CTxLockRequest& txLockRequest);
@@ -106,6 +183,9 @@ public:
     void UpdatedBlockTip(const CBlockIndex *pindex);
     void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
 
+    CInstantSendStats GetStats();
+    void ResetStats();
+
     std::string ToString();
 };
 
@@ -116,23 +196,27 @@ private:
     static const CAmount MIN_FEE            = 0.001 * COIN;
 
     int64_t nTimeCreated;
+    int64_t nTimeCreatedMicros; // for latency stats only
 
 public:
     static const int WARN_MANY_INPUTS       = 100;
 
     CTxLockRequest() :
         CTransaction(),
-        nTimeCreated(GetTime())
+        nTimeCreated(GetTime()),
+        nTimeCreatedMicros(GetTimeMicros())
         {}
     CTxLockRequest(const CTransaction& tx) :
         CTransaction(tx),
-        nTimeCreated(GetTime())
+        nTimeCreated(GetTime()),
+        nTimeCreatedMicros(GetTimeMicros())
         {}
 
     bool IsValid(bool fRequireUnspent = true) const;
     CAmount GetMinFee() const;
     int GetMaxSignatures() const;
     bool IsTimedOut() const;
+    int64_t GetTimeCreatedMicros() const { return nTimeCreatedMicros; }
 };
 
 class CTxLockVote
@@ -145,6 +229,7 @@ private:
     // local memory only
     int nConfirmedHeight; // when corresponding tx is 0-confirmed or conflicted, nConfirmedHeight is -1
     int64_t nTimeCreated;
+    int64_t nTimeCreatedMicros; // for latency stats only
 
 public:
     CTxLockVote() :
@@ -153,7 +238,8 @@ public:
         outpointMasternode(),
         vchMasternodeSignature(),
         nConfirmedHeight(-1),
-        nTimeCreated(GetTime())
+        nTimeCreated(GetTime()),
+        nTimeCreatedMicros(GetTimeMicros())
         {}
 
     CTxLockVote(const uint256& txHashIn, const COutPoint& outpointIn, const COutPoint& outpointMasternodeIn) :
@@ -162,7 +248,8 @@ public:
         outpointMasternode(outpointMasternodeIn),
         vchMasternodeSignature(),
         nConfirmedHeight(-1),
-        nTimeCreated(GetTime())
+        nTimeCreated(GetTime()),
+        nTimeCreatedMicros(GetTimeMicros())
         {}
 
     ADD_SERIALIZE_METHODS;
@@ -181,6 +268,7 @@ public:
     COutPoint GetOutpoint() const { return outpoint; }
     COutPoint GetMasternodeOutpoint() const { return outpointMasternode; }
     int64_t GetTimeCreated() const { return nTimeCreated; }
+    int64_t GetTimeCreatedMicros() const { return nTimeCreatedMicros; }
 
     bool IsValid(CNode* pnode) const;
     void SetConfirmedHeight(int nConfirmedHeightIn) { nConfirmedHeight = nConfirmedHeightIn; }
@@ -227,12 +315,18 @@ public:
     CTxLockCandidate(const CTxLockRequest& txLockRequestIn) :
         nConfirmedHeight(-1),
         txLockRequest(txLockRequestIn),
-        mapOutPointLocks()
+        mapOutPointLocks(),
+        nTimeFirstVoteMicros(0),
+        nTimeLockedMicros(0)
         {}
 
     CTxLockRequest txLockRequest;
     std::map<COutPoint, COutPointLock> mapOutPointLocks;
 
+    // set once all outpoints are locked, for latency stats only
+    int64_t nTimeFirstVoteMicros;
+    int64_t nTimeLockedMicros;
+
     uint256 GetHash() const { return txLockRequest.GetHash(); }
 
     void AddOutPointLock(const COutPoint& outpoint);
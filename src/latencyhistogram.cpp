@@ -0,0 +1,91 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "latencyhistogram.h"
+#include "tinyformat.h"
+
+const int CLatencyHistogram::SUB_BUCKET_BITS;
+const int CLatencyHistogram::SUB_BUCKETS;
+const int CLatencyHistogram::BUCKETS;
+
+CLatencyHistogram::CLatencyHistogram()
+    : vecBuckets(BUCKETS, 0),
+      nCount(0),
+      nSum(0),
+      nMax(0)
+{}
+
+void CLatencyHistogram::Add(int64_t nValue)
+{
+    if(nValue < 0) {
+        nValue = 0;
+    }
+    ++vecBuckets[GetBucket(nValue)];
+    ++nCount;
+    nSum += nValue;
+    if(nValue > nMax) {
+        nMax = nValue;
+    }
+}
+
+int64_t CLatencyHistogram::GetPercentile(double dPercentile) const
+{
+    if(nCount == 0) {
+        return 0;
+    }
+
+    uint64_t nRank = (uint64_t)(dPercentile / 100.0 * nCount + 0.5);
+    if(nRank < 1) nRank = 1;
+    if(nRank > nCount) nRank = nCount;
+
+    uint64_t nSeen = 0;
+    for(int i = 0; i < BUCKETS; ++i) {
+        nSeen += vecBuckets[i];
+        if(nSeen < nRank) continue;
+        // report the middle of the bucket but never more than we have actually seen
+        int64_t nLower = GetBucketLowerBound(i);
+        int64_t nUpper = (i + 1 < BUCKETS) ? GetBucketLowerBound(i + 1) : nMax;
+        int64_t nValue = nLower + (nUpper - nLower) / 2;
+        return nValue < nMax ? nValue : nMax;
+    }
+
+    return nMax;
+}
+
+void CLatencyHistogram::Clear()
+{
+    vecBuckets.assign(BUCKETS, 0);
+    nCount = 0;
+    nSum = 0;
+    nMax = 0;
+}
+
+std::string CLatencyHistogram::ToString() const
+{
+    return strprintf("count=%d mean=%d p50=%d p90=%d p99=%d max=%d",
+                     nCount, GetMean(), GetPercentile(50), GetPercentile(90), GetPercentile(99), nMax);
+}
+
+int CLatencyHistogram::GetBucket(int64_t nValue)
+{
+    uint64_t n = (uint64_t)nValue;
+    if(n < (uint64_t)SUB_BUCKETS) {
+        return (int)n;
+    }
+    int nBits = 0;
+    while((n >> nBits) >= (uint64_t)(2 * SUB_BUCKETS)) {
+        ++nBits;
+    }
+    // n >> nBits is in [SUB_BUCKETS, 2 * SUB_BUCKETS)
+    return (nBits + 1) * SUB_BUCKETS + (int)((n >> nBits) - SUB_BUCKETS);
+}
+
+int64_t CLatencyHistogram::GetBucketLowerBound(int nBucket)
+{
+    if(nBucket < SUB_BUCKETS) {
+        return nBucket;
+    }
+    int nBits = nBucket / SUB_BUCKETS - 1;
+    return (int64_t)((uint64_t)(SUB_BUCKETS + nBucket % SUB_BUCKETS) << nBits);
+}
@@ -0,0 +1,56 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * Log-linear histogram of non-negative durations (or any other int64 values).
+ *
+ * Every power of two is split into SUB_BUCKETS linear buckets, so the relative
+ * error of a reported percentile is below 1/SUB_BUCKETS while adding a sample
+ * is O(1) and memory use is fixed.
+ *
+ * Not thread safe, the owner must serialize access.
+ */
+class CLatencyHistogram
+{
+public:
+    static const int SUB_BUCKET_BITS = 3;
+    static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const int BUCKETS = SUB_BUCKETS * (64 - SUB_BUCKET_BITS);
+
+private:
+    std::vector<uint64_t> vecBuckets;
+    uint64_t nCount;
+    int64_t nSum;
+    int64_t nMax;
+
+public:
+    CLatencyHistogram();
+
+    /// Negative values are counted as zero
+    void Add(int64_t nValue);
+
+    uint64_t GetCount() const { return nCount; }
+    int64_t GetMax() const { return nMax; }
+    int64_t GetMean() const { return nCount ? nSum / (int64_t)nCount : 0; }
+
+    /// Approximate value below which dPercentile percent of the samples fall, 0 if empty
+    int64_t GetPercentile(double dPercentile) const;
+
+    void Clear();
+
+    std::string ToString() const;
+
+    static int GetBucket(int64_t nValue);
+    /// Smallest value which falls into the bucket
+    static int64_t GetBucketLowerBound(int nBucket);
+};
+
+#endif
@@ -33,6 +33,10 @@
 
 class CBlockIndex;
 class CBlockTreeDB;
+class CBlockUndo;
+class CCoinsViewDB;
+class CCoinsViewFlusher;
+class CCoinsViewPrefetch;
 class CBloomFilter;
 class CChainParams;
 class CInv;
@@ -73,6 +77,8 @@ static const unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 static const unsigned int BLOCKFILE_CHUNK_SIZE = 0x1000000; // 16 MiB
 /** The pre-allocation chunk size for rev?????.dat files (since 0.8) */
 static const unsigned int UNDOFILE_CHUNK_SIZE = 0x100000; // 1 MiB
+/** Bytes of an external block file read ahead while the blocks before are imported */
+static const unsigned int IMPORT_BATCH_SIZE = 0x800000; // 8 MiB
 
 /** Maximum number of script-checking threads allowed */
 static const int MAX_SCRIPTCHECK_THREADS = 16;
@@ -147,11 +153,16 @@ extern bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
+extern bool fAddressIndex;
+extern bool fTimestampIndex;
+extern bool fSpentIndex;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern unsigned int nBytesPerSigOp;
 extern bool fCheckBlockIndex;
 extern bool fCheckpointsEnabled;
+/** Block hash whose ancestors we will assume to have valid scripts without checking them. */
+extern uint256 hashAssumeValid;
 extern size_t nCoinCacheUsage;
 extern CFeeRate minRelayTxFee;
 extern bool fAlerts;
@@ -207,6 +218,11 @@ void UnregisterNodeSignals(CNodeSignals& nodeSignals);
  */
 bool ProcessNewBlock(CValidationState& state, const CChainParams& chainparams, const CNode* pfrom, const CBlock* pblock, bool fForceProcessing, const CDiskBlockPos* dbp);
 bool ProcessNewBlockv2(CValidationState& state, const CChainParams& chainparams, const CNode* pfrom, const CBlockv2* pblockv2, bool fForceProcessing, const CDiskBlockPos* dbp);
+/**
+ * Adds headers to the block index, each one building on the previous one or on a known block.
+ * @param[out] ppindex If set, the pointer will be set to point to the last new block index object for the given headers
+ */
+bool ProcessNewBlockHeaders(const std::vector<CBlockHeader>& headers, CValidationState& state, const CChainParams& chainparams, CBlockIndex** ppindex = NULL);
 /** Check whether enough disk space is available for an incoming block */
 bool CheckDiskSpace(uint64_t nAdditionalBytes = 0);
 /** Open a block file (blk?????.dat) */
@@ -695,8 +711,8 @@ private:
 
 public:
     CScriptCheck(): ptxTo(0), nIn(0), nFlags(0), cacheStore(false), error(SCRIPT_ERR_UNKNOWN_ERROR) {}
-    CScriptCheck(const CCoins& txFromIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn) :
-        scriptPubKey(txFromIn.vout[txToIn.vin[nInIn].prevout.n].scriptPubKey),
+    CScriptCheck(const CTxOut& outIn, const CTransaction& txToIn, unsigned int nInIn, unsigned int nFlagsIn, bool cacheIn) :
+        scriptPubKey(outIn.scriptPubKey),
         ptxTo(&txToIn), nIn(nInIn), nFlags(nFlagsIn), cacheStore(cacheIn), error(SCRIPT_ERR_UNKNOWN_ERROR) { }
 
     bool operator()();
@@ -725,6 +741,7 @@ bool GetAddressUnspent(uint160 addressHash, int type,
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus::Params& consensusParams);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex, const Consensus::Params& consensusParams);
+bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock);
 
 /** Functions for validating blocks and updating the block tree */
 
@@ -741,6 +758,9 @@ void ReprocessBlocks(int nBlocks);
 /** Apply the effects of this block (with given index) on the UTXO set represented by coins */
 bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindex, CCoinsViewCache& coins, bool fJustCheck = false);
 
+/** Marks a block below a UTXO snapshot fully validated, after the background validation connected it (with cs_main held) */
+void MarkSnapshotBlockValidated(CBlockIndex* pindex);
+
 /** Context-independent validity checks */
 bool CheckBlockHeader(const CBlockHeader& block, CValidationState& state, bool fCheckPOW = true);
 bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW = true, bool fCheckMerkleRoot = true);
@@ -832,6 +852,30 @@ extern CChain chainActive;
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache *pcoinsTip;
 
+/** The chainstate database below pcoinsTip */
+extern CCoinsViewDB *pcoinsdbview;
+
+/**
+ * Base block of the UTXO snapshot the chainstate was loaded from, NULL if it
+ * was built by connecting every block or once the background validation found
+ * the snapshot to match its chain. Its ancestors may have no block data.
+ * (protected by cs_main)
+ */
+extern CBlockIndex *pindexSnapshotBase;
+
+/**
+ * Last ancestor of pindexSnapshotBase the background validation of the
+ * snapshot has connected, the blocks after it are downloaded next. NULL when
+ * no validation is running. (protected by cs_main)
+ */
+extern CBlockIndex *pindexSnapshotValidated;
+
+/** Prefetch layer right below pcoinsTip, loading the coins of incoming blocks ahead of ConnectBlock */
+extern CCoinsViewPrefetch *pcoinsPrefetch;
+
+/** Layer right above the chainstate database, writing flushed coins out in the background with -backgroundflush */
+extern CCoinsViewFlusher *pcoinsFlusher;
+
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB *pblocktree;
 
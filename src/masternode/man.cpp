@@ -36,6 +36,16 @@ struct CompareScoreMN
     }
 };
 
+// Reverse of CompareScoreMN, for sorting forward with the highest score first
+struct CompareScoreMNDesc
+{
+    bool operator()(const std::pair<int64_t, CMasternode*>& t1,
+                    const std::pair<int64_t, CMasternode*>& t2) const
+    {
+        return CompareScoreMN()(t2, t1);
+    }
+};
+
 CMasternodeIndex::CMasternodeIndex()
     : nSize(0),
       mapIndex(),
@@ -113,7 +123,11 @@ CMasternodeMan::CMasternodeMan()
   fIndexRebuilt(false),
   fMasternodesAdded(false),
   fMasternodesRemoved(false),
-  vecDirtyGovernanceObjectHashes(),
+  mapQuorums(),
+  vecRemovedMasternodeVins(),
+  setCheckDeadlines(),
+  mapMasternodePos(),
+  fCheckDeadlinesDirty(false),
   nLastWatchdogVoteTime(0),
   mapSeenMasternodeBroadcast(),
   mapSeenMasternodePing(),
@@ -129,7 +143,10 @@ bool CMasternodeMan::Add(CMasternode &mn)
         LogPrint("masternode", "CMasternodeMan::Add -- Adding new Masternode: addr=%s, %i now\n", mn.addr.ToString(), size() + 1);
         vMasternodes.push_back(mn);
         indexMasternodes.AddMasternodeVIN(mn.vin);
+        mapMasternodePos[mn.vin.prevout] = vMasternodes.size() - 1;
+        setCheckDeadlines.insert(std::make_pair(GetTime(), mn.vin.prevout));
         fMasternodesAdded = true;
+        mapQuorums.clear();
         return true;
     }
 
@@ -171,11 +188,62 @@ void CMasternodeMan::Check()
 
     LogPrint("masternode", "CMasternodeMan::Check -- nLastWatchdogVoteTime=%d, IsWatchdogActive()=%d\n", nLastWatchdogVoteTime, IsWatchdogActive());
 
+    bool fStateChanged = false;
     BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+        int nActiveStatePrev = mn.nActiveState;
+        mn.Check();
+        fStateChanged |= mn.nActiveState != nActiveStatePrev;
+    }
+
+    if(fStateChanged) {
+        // active masternodes changed, so might quorums
+        mapQuorums.clear();
+    }
+}
+
+void CMasternodeMan::CheckDue()
+{
+    LOCK(cs);
+
+    if(fCheckDeadlinesDirty) {
+        RebuildCheckDeadlines();
+    }
+
+    int64_t nNow = GetTime();
+    bool fStateChanged = false;
+    while(!setCheckDeadlines.empty() && setCheckDeadlines.begin()->first <= nNow) {
+        COutPoint outpoint = setCheckDeadlines.begin()->second;
+        setCheckDeadlines.erase(setCheckDeadlines.begin());
+
+        std::map<COutPoint, size_t>::iterator it = mapMasternodePos.find(outpoint);
+        if(it == mapMasternodePos.end()) continue; // removed meanwhile
+
+        CMasternode& mn = vMasternodes[it->second];
+        int nActiveStatePrev = mn.nActiveState;
         mn.Check();
+        fStateChanged |= mn.nActiveState != nActiveStatePrev;
+
+        // Check() can bail out without updating nTimeLastChecked, e.g. on shutdown
+        setCheckDeadlines.insert(std::make_pair(std::max(mn.nTimeLastChecked + MASTERNODE_CHECK_SECONDS, nNow + 1), outpoint));
+    }
+
+    if(fStateChanged) {
+        // active masternodes changed, so might quorums
+        mapQuorums.clear();
     }
 }
 
+void CMasternodeMan::RebuildCheckDeadlines()
+{
+    setCheckDeadlines.clear();
+    mapMasternodePos.clear();
+    for(size_t i = 0; i < vMasternodes.size(); i++) {
+        mapMasternodePos[vMasternodes[i].vin.prevout] = i;
+        setCheckDeadlines.insert(std::make_pair(vMasternodes[i].nTimeLastChecked + MASTERNODE_CHECK_SECONDS, vMasternodes[i].vin.prevout));
+    }
+    fCheckDeadlinesDirty = false;
+}
+
 void CMasternodeMan::CheckAndRemove()
 {
     if(!masternodeSync.IsMasternodeListSynced()) return;
@@ -205,10 +273,12 @@ void CMasternodeMan::CheckAndRemove()
                 mapSeenMasternodeBroadcast.erase(hash);
                 mWeAskedForMasternodeListEntry.erase((*it).vin.prevout);
 
-                // and finally remove it from the list
-                it->FlagGovernanceItemsAsDirty();
+                // and finally remove it from the list, governance will drop its votes
+                vecRemovedMasternodeVins.push_back(it->vin);
                 it = vMasternodes.erase(it);
                 fMasternodesRemoved = true;
+                fCheckDeadlinesDirty = true;
+                mapQuorums.clear();
             } else {
                 bool fAsk = pCurrentBlockIndex &&
                             (nAskForMnbRecovery > 0) &&
@@ -377,6 +447,10 @@ void CMasternodeMan::Clear()
     nLastWatchdogVoteTime = 0;
     indexMasternodes.Clear();
     indexMasternodesOld.Clear();
+    mapQuorums.clear();
+    setCheckDeadlines.clear();
+    mapMasternodePos.clear();
+    fCheckDeadlinesDirty = false;
 }
 
 int CMasternodeMan::CountMasternodes(int nProtocolVersion)
@@ -690,6 +764,60 @@ int CMasternodeMan::GetMasternodeRank(const CTxIn& vin, int nBlockHeight, int nM
     return -1;
 }
 
+int CMasternodeMan::GetMasternodeQuorumRank(const CTxIn& vin, int nBlockHeight, int nQuorumSize, int nMinProtocol)
+{
+    //make sure we know about this block
+    uint256 blockHash = uint256();
+    if(!GetBlockHash(blockHash, nBlockHeight)) return -1;
+
+    return GetMasternodeQuorumRank(vin, blockHash, nQuorumSize, nMinProtocol);
+}
+
+int CMasternodeMan::GetMasternodeQuorumRank(const CTxIn& vin, const uint256& blockHash, int nQuorumSize, int nMinProtocol)
+{
+    LOCK(cs);
+
+    int64_t nNow = GetTime();
+    std::pair<uint256, int> key = std::make_pair(blockHash, nMinProtocol);
+    std::map<std::pair<uint256, int>, quorum_t>::iterator it = mapQuorums.find(key);
+
+    if(it == mapQuorums.end() || it->second.nQuorumSize < nQuorumSize || it->second.nTimeCreated + QUORUM_CACHE_SECONDS < nNow) {
+        // drop outdated quorums, there are only a few blocks referenced at any time
+        std::map<std::pair<uint256, int>, quorum_t>::iterator itOld = mapQuorums.begin();
+        while(itOld != mapQuorums.end()) {
+            if(itOld->second.nTimeCreated + QUORUM_CACHE_SECONDS < nNow) {
+                mapQuorums.erase(itOld++);
+            } else {
+                ++itOld;
+            }
+        }
+
+        std::vector<std::pair<int64_t, CMasternode*> > vecMasternodeScores;
+        BOOST_FOREACH(CMasternode& mn, vMasternodes) {
+            if(mn.nProtocolVersion < nMinProtocol || !mn.IsEnabled()) continue;
+            int64_t nScore = mn.CalculateScore(blockHash).GetCompact(false);
+            vecMasternodeScores.push_back(std::make_pair(nScore, &mn));
+        }
+
+        // only the top of the list is needed, highest score first like in GetMasternodeRank
+        size_t nTop = std::min(vecMasternodeScores.size(), (size_t)std::max(nQuorumSize, 0));
+        std::partial_sort(vecMasternodeScores.begin(), vecMasternodeScores.begin() + nTop, vecMasternodeScores.end(), CompareScoreMNDesc());
+
+        quorum_t& quorum = mapQuorums[key];
+        quorum.nQuorumSize = nQuorumSize;
+        quorum.nTimeCreated = nNow;
+        quorum.mapRanks.clear();
+        for(size_t i = 0; i < nTop; i++) {
+            quorum.mapRanks[vecMasternodeScores[i].second->vin.prevout] = i + 1;
+        }
+        it = mapQuorums.find(key);
+    }
+
+    std::map<COutPoint, int>::const_iterator itRank = it->second.mapRanks.find(vin.prevout);
+    if(itRank == it->second.mapRanks.end() || itRank->second > nQuorumSize) return -1;
+    return itRank->second;
+}
+
 std::vector<std::pair<int, CMasternode> > CMasternodeMan::GetMasternodeRanks(int nBlockHeight, int nMinProtocol)
 {
     std::vector<std::pair<int64_t, CMasternode*> > vecMasternodeScores;
@@ -1394,6 +1522,7 @@ void CMasternodeMan::UpdateMasternodeList(CMasternodeBroadcast mnb)
         CMasternodeBroadcast mnbOld = mapSeenMasternodeBroadcast[CMasternodeBroadcast(*pmn).GetHash()].second;
         if(pmn->UpdateFromNewBroadcast(mnb)) {
             masternodeSync.AddedMasternodeList();
+            mapQuorums.clear();
             mapSeenMasternodeBroadcast.erase(mnbOld.GetHash());
         }
     }
@@ -110,6 +110,8 @@ private:
     static const int MNB_RECOVERY_WAIT_SECONDS      = 60;
     static const int MNB_RECOVERY_RETRY_SECONDS     = 3 * 60 * 60;
 
+    static const int QUORUM_CACHE_SECONDS       = 10;
+
 
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
@@ -148,7 +150,32 @@ private:
     /// Set when masternodes are removed, cleared when CGovernanceManager is notified
     bool fMasternodesRemoved;
 
-    std::vector<uint256> vecDirtyGovernanceObjectHashes;
+    struct quorum_t {
+        quorum_t()
+            : nQuorumSize(0),
+              nTimeCreated(0),
+              mapRanks()
+            {}
+
+        int nQuorumSize;
+        int64_t nTimeCreated;
+        std::map<COutPoint, int> mapRanks; // mn outpoint - rank
+    };
+
+    /// Top ranked masternodes per (block hash, min protocol), see GetMasternodeQuorumRank
+    std::map<std::pair<uint256, int>, quorum_t> mapQuorums;
+
+    /// Masternodes removed since CGovernanceManager last cleared their votes
+    std::vector<CTxIn> vecRemovedMasternodeVins;
+
+    /// When each masternode is due for its next CMasternode::Check, see CheckDue
+    std::set<std::pair<int64_t, COutPoint> > setCheckDeadlines;
+    /// Position of each masternode in vMasternodes
+    std::map<COutPoint, size_t> mapMasternodePos;
+    /// Set when vMasternodes was changed other than by Add, see RebuildCheckDeadlines
+    bool fCheckDeadlinesDirty;
+
+    void RebuildCheckDeadlines();
 
     int64_t nLastWatchdogVoteTime;
 
@@ -194,6 +221,9 @@ public:
         if(ser_action.ForRead() && (strVersion != SERIALIZATION_VERSION_STRING)) {
             Clear();
         }
+        if(ser_action.ForRead()) {
+            fCheckDeadlinesDirty = true;
+        }
     }
 
     CMasternodeMan();
@@ -208,6 +238,9 @@ public:
     /// Check all Masternodes
     void Check();
 
+    /// Check only the Masternodes whose MASTERNODE_CHECK_SECONDS passed since their last check
+    void CheckDue();
+
     /// Check all Masternodes and remove inactive
     void CheckAndRemove();
 
@@ -296,6 +329,15 @@ public:
 
     std::vector<std::pair<int, CMasternode> > GetMasternodeRanks(int nBlockHeight = -1, int nMinProtocol=0);
     int GetMasternodeRank(const CTxIn &vin, int nBlockHeight, int nMinProtocol=0, bool fOnlyActive=true);
+
+    /**
+     * Rank of the masternode if it is one of the top nQuorumSize active masternodes for the block
+     * at nBlockHeight, -1 otherwise. Ranks are the same as GetMasternodeRank(vin, nBlockHeight, nMinProtocol, true)
+     * gives, but the top of the list is computed once per block and cached, so checking many votes is cheap.
+     * The cache is dropped whenever the list changes and entries expire after QUORUM_CACHE_SECONDS.
+     */
+    int GetMasternodeQuorumRank(const CTxIn &vin, int nBlockHeight, int nQuorumSize, int nMinProtocol);
+    int GetMasternodeQuorumRank(const CTxIn &vin, const uint256& blockHash, int nQuorumSize, int nMinProtocol);
     CMasternode* GetMasternodeByRank(int nRank, int nBlockHeight, int nMinProtocol=0, bool fOnlyActive=true);
 
     void ProcessMasternodeConnections();
@@ -325,18 +367,12 @@ public:
 
     void CheckAndRebuildMasternodeIndex();
 
-    void AddDirtyGovernanceObjectHash(const uint256& nHash)
-    {
-        LOCK(cs);
-        vecDirtyGovernanceObjectHashes.push_back(nHash);
-    }
-
-    std::vector<uint256> GetAndClearDirtyGovernanceObjectHashes()
+    std::vector<CTxIn> GetAndClearRemovedMasternodeVins()
     {
         LOCK(cs);
-        std::vector<uint256> vecTmp = vecDirtyGovernanceObjectHashes;
-        vecDirtyGovernanceObjectHashes.clear();
-        return vecTmp;;
+        std::vector<CTxIn> vecTmp;
+        vecTmp.swap(vecRemovedMasternodeVins);
+        return vecTmp;
     }
 
     bool IsWatchdogActive();
@@ -230,13 +230,21 @@ void CMasternodeSync::ProcessMessage(CNode* pfrom, std::string& strCommand, CDat
 {
     if (strCommand == NetMsgType::SYNCSTATUSCOUNT) { //Sync status count
 
-        //do not care about stats if sync process finished or failed
-        if(IsSynced() || IsFailed()) return;
-
         int nItemID;
         int nCount;
         vRecv >> nItemID >> nCount;
 
+        // vote count is the last message of a reply to a governance object vote request,
+        // it names the object unless it ends a reply to a full sync
+        if(nItemID == MASTERNODE_SYNC_GOVOBJ_VOTE && !vRecv.empty()) {
+            uint256 nHash;
+            vRecv >> nHash;
+            governance.VoteSyncResponseReceived(pfrom, nHash);
+        }
+
+        //do not care about stats if sync process finished or failed
+        if(IsSynced() || IsFailed()) return;
+
         LogPrintf("SYNCSTATUSCOUNT -- got inventory count: nItemID=%d  nCount=%d  peer=%d\n", nItemID, nCount, pfrom->id);
     }
 }
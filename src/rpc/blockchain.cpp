@@ -5,23 +5,31 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "amount.h"
+#include "blockreader.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
 #include "coins.h"
+#include "coinsflush.h"
 #include "consensus/validation.h"
+#include "indexer.h"
 #include "main.h"
 #include "policy/policy.h"
 #include "primitives/transaction.h"
 #include "rpc/server.h"
+#include "script/sigcache.h"
+#include "snapshot.h"
 #include "streams.h"
 #include "sync.h"
+#include "txdb.h"
 #include "txmempool.h"
 #include "util.h"
 #include "utilstrencodings.h"
 
 #include <stdint.h>
 
+#include <boost/filesystem.hpp>
+
 #include <univalue.h>
 
 using namespace std;
@@ -531,24 +539,25 @@ UniValue getblock(const UniValue& params, bool fHelp)
     if (mapBlockIndex.count(hash) == 0)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
-    CBlock block;
     CBlockIndex* pblockindex = mapBlockIndex[hash];
 
     if (fHavePruned && !(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Block not available (pruned data)");
 
-    if(!ReadBlockFromDisk(block, pblockindex, Params().GetConsensus()))
-        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
-
     if (!fVerbose)
     {
         CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-        ssBlock << block;
+        if (!blockreader.ReadRawBlock(ssBlock, pblockindex->GetBlockPos(), Params().MessageStart()))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
         std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
         return strHex;
     }
 
-    return blockToJSON(block, pblockindex, true);
+    boost::shared_ptr<const CBlock> pblock = blockreader.ReadBlock(pblockindex, Params().MessageStart());
+    if (!pblock)
+        throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+
+    return blockToJSON(*pblock, pblockindex, true);
 }
 
 UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
@@ -589,6 +598,117 @@ UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
     return ret;
 }
 
+UniValue dumptxoutset(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrites the unspent transaction output set at the current tip to a file, along with the headers\n"
+            "of the chain up to it. Nodes load it with -loadutxosnapshot once its content hash is listed in\n"
+            "the chain parameters of a release.\n"
+            "Note this call may take some time.\n"
+            "\nArguments:\n"
+            "1. \"path\"    (string, required) The file to write, it must not exist yet\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"coins_written\": n,          (numeric) The number of coins written\n"
+            "  \"base_hash\": \"hash\",        (string) The hash of the block the snapshot was taken at\n"
+            "  \"base_height\": n,            (numeric) The height of that block\n"
+            "  \"nchaintx\": n,               (numeric) The number of transactions in the chain up to that block\n"
+            "  \"path\": \"path\",             (string) The file written\n"
+            "  \"content_hash\": \"hash\"      (string) The hash the chain parameters need to list for the snapshot\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("dumptxoutset", "\"utxo.dat\"")
+            + HelpExampleRpc("dumptxoutset", "\"utxo.dat\"")
+        );
+
+    boost::filesystem::path path = boost::filesystem::absolute(params[0].get_str(), GetDataDir());
+    boost::filesystem::path pathTmp = path.string() + ".incomplete";
+    if (boost::filesystem::exists(path) || boost::filesystem::exists(pathTmp))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists");
+
+    // The cursor reads the database as it is once flushed, so the lock is
+    // only needed to take it and the headers, not while writing the file
+    boost::scoped_ptr<CCoinsViewDBCursor> pcursor;
+    std::vector<CBlockHeader> vHeaders;
+    CBlockIndex* pindexBase = NULL;
+    {
+        LOCK(cs_main);
+        FlushStateToDisk();
+        pcursor.reset(pcoinsdbview->Cursor());
+        BlockMap::iterator mi = mapBlockIndex.find(pcursor->GetBestBlock());
+        if (mi == mapBlockIndex.end() || mi->second->nHeight == 0)
+            throw JSONRPCError(RPC_MISC_ERROR, "The chainstate is not past the genesis block");
+        pindexBase = mi->second;
+        vHeaders.resize(pindexBase->nHeight);
+        for (CBlockIndex* pindex = pindexBase; pindex->pprev; pindex = pindex->pprev)
+            vHeaders[pindex->nHeight - 1] = pindex->GetBlockHeader();
+    }
+
+    CAutoFile file(fopen(pathTmp.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+    if (file.IsNull())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Cannot open " + pathTmp.string());
+    CUTXOSnapshotMetadata metadata;
+    memcpy(metadata.pchMessageStart, Params().MessageStart(), sizeof(metadata.pchMessageStart));
+    uint256 hashContent;
+    std::string strError;
+    if (!WriteUTXOSnapshot(file, metadata, vHeaders, pcursor.get(), hashContent, strError)) {
+        file.fclose();
+        boost::filesystem::remove(pathTmp);
+        throw JSONRPCError(RPC_MISC_ERROR, strError);
+    }
+    FileCommit(file.Get());
+    file.fclose();
+    if (!RenameOver(pathTmp, path))
+        throw JSONRPCError(RPC_MISC_ERROR, "Cannot rename " + pathTmp.string() + " to " + path.string());
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("coins_written", (int64_t)metadata.nCoins));
+    ret.push_back(Pair("base_hash", metadata.hashBaseBlock.GetHex()));
+    ret.push_back(Pair("base_height", pindexBase->nHeight));
+    ret.push_back(Pair("nchaintx", (int64_t)pindexBase->nChainTx));
+    ret.push_back(Pair("path", path.string()));
+    ret.push_back(Pair("content_hash", hashContent.GetHex()));
+    return ret;
+}
+
+UniValue getindexinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getindexinfo\n"
+            "\nReturns which indexes are maintained and how far the ones built in the background got.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"txindex\": true|false,        (boolean) whether the transaction index is maintained, it is always in sync\n"
+            "  \"addressindex\": true|false,   (boolean) whether the address index is maintained\n"
+            "  \"spentindex\": true|false,     (boolean) whether the spent index is maintained\n"
+            "  \"timestampindex\": true|false, (boolean) whether the timestamp index is maintained\n"
+            "  \"height\": n,                  (numeric) the height of the last block in all the enabled address, spent and timestamp indexes, -1 if none\n"
+            "  \"bestblockhash\": \"hash\",      (string, optional) the hash of that block\n"
+            "  \"synced\": true|false          (boolean) whether these indexes cover the whole active chain\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getindexinfo", "")
+            + HelpExampleRpc("getindexinfo", "")
+        );
+
+    LOCK(cs_main);
+
+    const CBlockIndex* pindex = blockIndexer.GetBestBlock();
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("txindex", fTxIndex));
+    ret.push_back(Pair("addressindex", fAddressIndex));
+    ret.push_back(Pair("spentindex", fSpentIndex));
+    ret.push_back(Pair("timestampindex", fTimestampIndex));
+    ret.push_back(Pair("height", pindex ? pindex->nHeight : -1));
+    if (pindex)
+        ret.push_back(Pair("bestblockhash", pindex->GetBlockHash().GetHex()));
+    ret.push_back(Pair("synced", blockIndexer.IsRunning() && pindex == chainActive.Tip()));
+    return ret;
+}
+
 UniValue gettxout(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 2 || params.size() > 3)
@@ -614,7 +734,6 @@ UniValue gettxout(const UniValue& params, bool fHelp)
             "        ,...\n"
             "     ]\n"
             "  },\n"
-            "  \"version\" : n,            (numeric) The version\n"
             "  \"coinbase\" : true|false   (boolean) Coinbase or not\n"
             "}\n"
 
@@ -638,33 +757,33 @@ UniValue gettxout(const UniValue& params, bool fHelp)
     if (params.size() > 2)
         fMempool = params[2].get_bool();
 
-    CCoins coins;
+    if (n < 0)
+        return NullUniValue;
+    COutPoint out(hash, n);
+
+    Coin coin;
     if (fMempool) {
         LOCK(mempool.cs);
         CCoinsViewMemPool view(pcoinsTip, mempool);
-        if (!view.GetCoins(hash, coins))
+        if (!view.GetCoin(out, coin) || mempool.isSpent(out)) // TODO: filtering spent coins should be done by the CCoinsViewMemPool
             return NullUniValue;
-        mempool.pruneSpent(hash, coins); // TODO: this should be done by the CCoinsViewMemPool
     } else {
-        if (!pcoinsTip->GetCoins(hash, coins))
+        if (!pcoinsTip->GetCoin(out, coin))
             return NullUniValue;
     }
-    if (n<0 || (unsigned int)n>=coins.vout.size() || coins.vout[n].IsNull())
-        return NullUniValue;
 
     BlockMap::iterator it = mapBlockIndex.find(pcoinsTip->GetBestBlock());
     CBlockIndex *pindex = it->second;
     ret.push_back(Pair("bestblock", pindex->GetBlockHash().GetHex()));
-    if ((unsigned int)coins.nHeight == MEMPOOL_HEIGHT)
+    if (coin.nHeight == MEMPOOL_HEIGHT)
         ret.push_back(Pair("confirmations", 0));
     else
-        ret.push_back(Pair("confirmations", pindex->nHeight - coins.nHeight + 1));
-    ret.push_back(Pair("value", ValueFromAmount(coins.vout[n].nValue)));
+        ret.push_back(Pair("confirmations", (int64_t)(pindex->nHeight - coin.nHeight + 1)));
+    ret.push_back(Pair("value", ValueFromAmount(coin.out.nValue)));
     UniValue o(UniValue::VOBJ);
-    ScriptPubKeyToJSON(coins.vout[n].scriptPubKey, o, true);
+    ScriptPubKeyToJSON(coin.out.scriptPubKey, o, true);
     ret.push_back(Pair("scriptPubKey", o));
-    ret.push_back(Pair("version", coins.nVersion));
-    ret.push_back(Pair("coinbase", coins.fCoinBase));
+    ret.push_back(Pair("coinbase", (bool)coin.fCoinBase));
 
     return ret;
 }
@@ -759,6 +878,21 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp)
             "  \"chainwork\": \"xxxx\"     (string) total amount of work in active chain, in hexadecimal\n"
             "  \"pruned\": xx,             (boolean) if the blocks are subject to pruning\n"
             "  \"pruneheight\": xxxxxx,    (numeric) heighest block available\n"
+            "  \"chainstateflush\": {      (object) how long writing the coins cache to the chainstate database takes\n"
+            "     \"background\": xx,       (boolean) whether the database is written on a background thread (-backgroundflush)\n"
+            "     \"writing\": xx,          (boolean) whether a background write is in progress\n"
+            "     \"flushes\": xx,          (numeric) number of database writes since startup\n"
+            "     \"lastlockms\": xx,       (numeric) time cs_main was held by the last flush, in milliseconds\n"
+            "     \"totallockms\": xx,      (numeric) same, for all flushes since startup\n"
+            "     \"lastwritems\": xx,      (numeric) time the last database write took, in milliseconds\n"
+            "     \"totalwritems\": xx      (numeric) same, for all database writes since startup\n"
+            "  },\n"
+            "  \"sigcache\": {             (object) the cache of verified signatures\n"
+            "     \"capacity\": xx,         (numeric) number of signatures it holds at most (-maxsigcachesize)\n"
+            "     \"lookups\": xx,          (numeric) signature checks which looked in it since startup\n"
+            "     \"hits\": xx,             (numeric) those which found the signature there\n"
+            "     \"hitrate\": xx           (numeric) hits / lookups\n"
+            "  },\n"
             "  \"softforks\": [            (array) status of softforks in progress\n"
             "     {\n"
             "        \"id\": \"xxxx\",        (string) name of softfork\n"
@@ -816,6 +950,40 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp)
 
         obj.push_back(Pair("pruneheight",        block->nHeight));
     }
+
+    if (pcoinsFlusher) {
+        CCoinsFlushStats stats = pcoinsFlusher->GetFlushStats();
+        UniValue flush(UniValue::VOBJ);
+        flush.push_back(Pair("background",      stats.fBackground));
+        flush.push_back(Pair("writing",         stats.fWriting));
+        flush.push_back(Pair("flushes",         (uint64_t)stats.nFlushes));
+        flush.push_back(Pair("lastlockms",      stats.nLastLockTime * 0.001));
+        flush.push_back(Pair("totallockms",     stats.nTotalLockTime * 0.001));
+        flush.push_back(Pair("lastwritems",     stats.nLastWriteTime * 0.001));
+        flush.push_back(Pair("totalwritems",    stats.nTotalWriteTime * 0.001));
+        obj.push_back(Pair("chainstateflush",   flush));
+    }
+
+    CSignatureCacheStats sigcachestats;
+    GetSignatureCacheStats(sigcachestats);
+    UniValue sigcache(UniValue::VOBJ);
+    sigcache.push_back(Pair("capacity",         (uint64_t)sigcachestats.nCapacity));
+    sigcache.push_back(Pair("lookups",          sigcachestats.nLookups));
+    sigcache.push_back(Pair("hits",             sigcachestats.nHits));
+    sigcache.push_back(Pair("hitrate",          sigcachestats.nLookups ? (double)sigcachestats.nHits / sigcachestats.nLookups : 0.0));
+    obj.push_back(Pair("sigcache",              sigcache));
+
+    CBlockReaderStats readerstats = blockreader.GetStats();
+    UniValue blockcache(UniValue::VOBJ);
+    blockcache.push_back(Pair("blocks",         (uint64_t)readerstats.nCacheBlocks));
+    blockcache.push_back(Pair("usage",          (uint64_t)readerstats.nCacheUsage));
+    blockcache.push_back(Pair("maxusage",       (uint64_t)readerstats.nMaxCacheUsage));
+    blockcache.push_back(Pair("hits",           readerstats.nCacheHits));
+    blockcache.push_back(Pair("misses",         readerstats.nCacheMisses));
+    blockcache.push_back(Pair("rawreads",       readerstats.nRawReads));
+    blockcache.push_back(Pair("mappedfiles",    readerstats.nMappedFiles));
+    blockcache.push_back(Pair("mappedbytes",    readerstats.nMappedBytes));
+    obj.push_back(Pair("blockcache",            blockcache));
     return obj;
 }
 
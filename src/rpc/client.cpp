@@ -113,6 +113,8 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "setban", 2 },
     { "setban", 3 },
     { "spork", 1 },
+    { "instantsendstats", 0 },
+    { "privatesendtasks", 0 },
     { "voteraw", 1 },
     { "voteraw", 5 },
     { "getblockhashes", 0 },
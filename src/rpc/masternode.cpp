@@ -5,6 +5,7 @@
 #include "masternode/active.h"
 #include "darksend.h"
 #include "init.h"
+#include "instantx.h"
 #include "main.h"
 #include "masternode/payments.h"
 #include "masternode/sync.h"
@@ -31,6 +32,127 @@ UniValue getpoolinfo(const UniValue& params, bool fHelp)
     return "Unknown command, please see \"help\"";
 }
 
+static UniValue HistogramToJSON(const CLatencyHistogram& hist)
+{
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("count", (uint64_t)hist.GetCount()));
+    obj.push_back(Pair("mean", hist.GetMean()));
+    obj.push_back(Pair("p50", hist.GetPercentile(50)));
+    obj.push_back(Pair("p90", hist.GetPercentile(90)));
+    obj.push_back(Pair("p99", hist.GetPercentile(99)));
+    obj.push_back(Pair("max", hist.GetMax()));
+    return obj;
+}
+
+UniValue instantsendstats(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw std::runtime_error(
+            "instantsendstats ( reset )\n"
+            "Returns InstantSend latency percentiles and counters collected since startup or the last reset.\n"
+            "\nArguments:\n"
+            "1. reset    (boolean, optional, default=false) Start collecting from scratch after returning the current stats\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"since\": xxxxx,           (numeric) the time stats are collected since in seconds since epoch\n"
+            "  \"locks\": n,               (numeric) the number of completed locks\n"
+            "  \"votes\": n,               (numeric) the number of valid votes received\n"
+            "  \"orphanvotes\": n,         (numeric) the number of votes received before their lock request\n"
+            "  \"orphanratio\": x.xxx,     (numeric) orphanvotes / votes\n"
+            "  \"votesperlock\": {...},    (json object) the number of votes locks completed with\n"
+            "  \"latency\": {              (json object) latencies in microseconds, each with count, mean, p50, p90, p99 and max\n"
+            "    \"requesttocandidate\": {...}, lock request received to lock candidate created\n"
+            "    \"requesttolock\": {...},      lock request received to lock completed\n"
+            "    \"firstvotetolock\": {...},    first vote received to lock completed\n"
+            "    \"votetolock\": {...},         each vote counted in a lock received to lock completed\n"
+            "    \"voteverify\": {...},         masternode rank and signature check of a vote\n"
+            "    \"voteprocess\": {...},        processing of a verified vote\n"
+            "    \"locktonotify\": {...},       lock completed to wallet and listeners notified\n"
+            "    \"csmainwait\": {...}          waiting for cs_main to process lock requests and votes\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("instantsendstats", "")
+            + HelpExampleRpc("instantsendstats", "true")
+        );
+
+    CInstantSendStats stats = instantsend.GetStats();
+    if (params.size() == 1 && params[0].get_bool())
+        instantsend.ResetStats();
+
+    UniValue latency(UniValue::VOBJ);
+    latency.push_back(Pair("requesttocandidate", HistogramToJSON(stats.histRequestToCandidate)));
+    latency.push_back(Pair("requesttolock", HistogramToJSON(stats.histRequestToLock)));
+    latency.push_back(Pair("firstvotetolock", HistogramToJSON(stats.histFirstVoteToLock)));
+    latency.push_back(Pair("votetolock", HistogramToJSON(stats.histVoteToLock)));
+    latency.push_back(Pair("voteverify", HistogramToJSON(stats.histVoteVerify)));
+    latency.push_back(Pair("voteprocess", HistogramToJSON(stats.histVoteProcess)));
+    latency.push_back(Pair("locktonotify", HistogramToJSON(stats.histLockToNotify)));
+    latency.push_back(Pair("csmainwait", HistogramToJSON(stats.histCsMainWait)));
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("since", stats.nTimeStart));
+    obj.push_back(Pair("locks", (uint64_t)stats.histRequestToLock.GetCount()));
+    obj.push_back(Pair("votes", stats.nVotesReceived));
+    obj.push_back(Pair("orphanvotes", stats.nVotesOrphan));
+    obj.push_back(Pair("orphanratio", stats.nVotesReceived ? (double)stats.nVotesOrphan / stats.nVotesReceived : 0.0));
+    obj.push_back(Pair("votesperlock", HistogramToJSON(stats.histVotesPerLock)));
+    obj.push_back(Pair("latency", latency));
+    return obj;
+}
+
+UniValue privatesendtasks(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw std::runtime_error(
+            "privatesendtasks ( reset )\n"
+            "Returns the PrivateSend and masternode maintenance tasks with their run times collected since startup or the last reset.\n"
+            "\nArguments:\n"
+            "1. reset    (boolean, optional, default=false) Start collecting from scratch after returning the current stats\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"since\": xxxxx,           (numeric) the time stats are collected since in seconds since epoch\n"
+            "  \"tasks\": {\n"
+            "    \"name\": {\n"
+            "      \"period\": n,          (numeric) seconds between two runs\n"
+            "      \"runs\": n,            (numeric) the number of runs\n"
+            "      \"skipped\": n,         (numeric) the number of runs skipped because the blockchain was not synced\n"
+            "      \"runtime\": {...},     (json object) microseconds per run with count, mean, p50, p90, p99 and max\n"
+            "      \"lockwait\": {...},    (json object) microseconds waiting for the task lock, if it has one\n"
+            "      \"lockhold\": {...}     (json object) microseconds holding the task lock, if it has one\n"
+            "    }, ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("privatesendtasks", "")
+            + HelpExampleRpc("privatesendtasks", "true")
+        );
+
+    int64_t nTimeStatsStart;
+    std::vector<CPrivateSendTask> vecTasks = privateSendScheduler.GetTasks(nTimeStatsStart);
+    if (params.size() == 1 && params[0].get_bool())
+        privateSendScheduler.ResetStats();
+
+    UniValue tasks(UniValue::VOBJ);
+    BOOST_FOREACH(const CPrivateSendTask& task, vecTasks) {
+        UniValue obj(UniValue::VOBJ);
+        obj.push_back(Pair("period", task.nPeriod));
+        obj.push_back(Pair("runs", task.nRuns));
+        obj.push_back(Pair("skipped", task.nSkipped));
+        obj.push_back(Pair("runtime", HistogramToJSON(task.histRunTime)));
+        if (task.pcs) {
+            obj.push_back(Pair("lockwait", HistogramToJSON(task.histLockWait)));
+            obj.push_back(Pair("lockhold", HistogramToJSON(task.histLockHold)));
+        }
+        tasks.push_back(Pair(task.strName, obj));
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("since", nTimeStatsStart));
+    obj.push_back(Pair("tasks", tasks));
+    return obj;
+}
+
 
 UniValue masternode(const UniValue& params, bool fHelp)
 {
@@ -286,12 +286,14 @@ static const CRPCCommand vRPCCommands[] =
     { "blockchain",         "getblockheaders",        &getblockheaders,        true  },
     { "blockchain",         "getchaintips",           &getchaintips,           true  },
     { "blockchain",         "getdifficulty",          &getdifficulty,          true  },
+    { "blockchain",         "getindexinfo",           &getindexinfo,           true  },
     { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true  },
     { "blockchain",         "getrawmempool",          &getrawmempool,          true  },
     { "blockchain",         "gettxout",               &gettxout,               true  },
     { "blockchain",         "gettxoutproof",          &gettxoutproof,          true  },
     { "blockchain",         "verifytxoutproof",       &verifytxoutproof,       true  },
     { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true  },
+    { "blockchain",         "dumptxoutset",           &dumptxoutset,           true  },
     { "blockchain",         "verifychain",            &verifychain,            true  },
     { "blockchain",         "getspentinfo",           &getspentinfo,           false },
 
@@ -352,6 +354,8 @@ static const CRPCCommand vRPCCommands[] =
     { "3dcoin",               "mnsync",                 &mnsync,                 true  },
     { "3dcoin",               "spork",                  &spork,                  true  },
     { "3dcoin",               "getpoolinfo",            &getpoolinfo,            true  },
+    { "3dcoin",               "instantsendstats",       &instantsendstats,       true  },
+    { "3dcoin",               "privatesendtasks",       &privatesendtasks,       true  },
 #ifdef ENABLE_WALLET
 
     /* Wallet */
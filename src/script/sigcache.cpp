@@ -5,28 +5,23 @@
 
 #include "sigcache.h"
 
-#include "memusage.h"
+#include "cuckoocache.h"
 #include "pubkey.h"
 #include "random.h"
 #include "uint256.h"
 #include "util.h"
 
-#include <boost/thread.hpp>
-#include <boost/unordered_set.hpp>
+#include <algorithm>
+#include <atomic>
 
 namespace {
 
-/**
- * We're hashing a nonce into the entries themselves, so we don't need extra
- * blinding in the set hash computation.
- */
-class CSignatureCacheHasher
+/** -maxsigcachesize in bytes, a negative size disables the cache like 0 does */
+size_t GetMaxSigCacheBytes()
 {
-public:
-    size_t operator()(const uint256& key) const {
-        return key.GetCheapHash();
-    }
-};
+    int64_t nMaxCacheSize = std::max((int64_t)0, GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE));
+    return (size_t)nMaxCacheSize << 20;
+}
 
 /**
  * Valid signature cache, to avoid doing expensive ECDSA signature checking
@@ -38,13 +33,13 @@ class CSignatureCache
 private:
      //! Entries are SHA256(nonce || signature hash || public key || signature):
     uint256 nonce;
-    typedef boost::unordered_set<uint256, CSignatureCacheHasher> map_type;
-    map_type setValid;
-    boost::shared_mutex cs_sigcache;
-
+    //! Sized once by -maxsigcachesize, lookups from the script check threads take no lock
+    CCuckooCache setValid;
+    std::atomic<uint64_t> nLookups;
+    std::atomic<uint64_t> nHits;
 
 public:
-    CSignatureCache()
+    CSignatureCache() : setValid(GetMaxSigCacheBytes()), nLookups(0), nHits(0)
     {
         GetRandBytes(nonce.begin(), 32);
     }
@@ -56,52 +51,52 @@ public:
     }
 
     bool
-    Get(const uint256& entry)
+    Get(const uint256& entry, bool fErase)
     {
-        boost::shared_lock<boost::shared_mutex> lock(cs_sigcache);
-        return setValid.count(entry);
+        bool fHit = setValid.Contains(entry, fErase);
+        nLookups.fetch_add(1, std::memory_order_relaxed);
+        if (fHit)
+            nHits.fetch_add(1, std::memory_order_relaxed);
+        return fHit;
     }
 
-    void Erase(const uint256& entry)
+    void Set(const uint256& entry)
     {
-        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
-        setValid.erase(entry);
+        setValid.Insert(entry);
     }
 
-    void Set(const uint256& entry)
+    void GetStats(CSignatureCacheStats& stats) const
     {
-        size_t nMaxCacheSize = GetArg("-maxsigcachesize", DEFAULT_MAX_SIG_CACHE_SIZE) * ((size_t) 1 << 20);
-        if (nMaxCacheSize <= 0) return;
-
-        boost::unique_lock<boost::shared_mutex> lock(cs_sigcache);
-        while (memusage::DynamicUsage(setValid) > nMaxCacheSize)
-        {
-            map_type::size_type s = GetRand(setValid.bucket_count());
-            map_type::local_iterator it = setValid.begin(s);
-            if (it != setValid.end(s)) {
-                setValid.erase(*it);
-            }
-        }
-
-        setValid.insert(entry);
+        stats.nLookups = nLookups.load(std::memory_order_relaxed);
+        stats.nHits = nHits.load(std::memory_order_relaxed);
+        stats.nCapacity = setValid.GetCapacity();
+        stats.nMemoryUsage = setValid.GetMemoryUsage();
     }
 };
 
+CSignatureCache& GetSignatureCache()
+{
+    static CSignatureCache signatureCache;
+    return signatureCache;
+}
+
+}
+
+void GetSignatureCacheStats(CSignatureCacheStats& stats)
+{
+    GetSignatureCache().GetStats(stats);
 }
 
 bool CachingTransactionSignatureChecker::VerifySignature(const std::vector<unsigned char>& vchSig, const CPubKey& pubkey, const uint256& sighash) const
 {
-    static CSignatureCache signatureCache;
+    CSignatureCache& signatureCache = GetSignatureCache();
 
     uint256 entry;
     signatureCache.ComputeEntry(entry, sighash, vchSig, pubkey);
 
-    if (signatureCache.Get(entry)) {
-        if (!store) {
-            signatureCache.Erase(entry);
-        }
+    // a block only needs the entries of its transactions once
+    if (signatureCache.Get(entry, !store))
         return true;
-    }
 
     if (!TransactionSignatureChecker::VerifySignature(vchSig, pubkey, sighash))
         return false;
@@ -10,12 +10,23 @@
 
 #include <vector>
 
-// DoS prevention: limit cache size to less than 40MB (over 500000
-// entries on 64-bit systems).
+// DoS prevention: limit cache size to 40MB (over 900000 entries), the
+// table takes up exactly that much from the first signature check on.
 static const unsigned int DEFAULT_MAX_SIG_CACHE_SIZE = 40;
 
 class CPubKey;
 
+struct CSignatureCacheStats
+{
+    uint64_t nLookups;
+    uint64_t nHits;
+    size_t nCapacity;
+    size_t nMemoryUsage;
+};
+
+/** Lookups and hits of the signature cache since startup, and its size */
+void GetSignatureCacheStats(CSignatureCacheStats& stats);
+
 class CachingTransactionSignatureChecker : public TransactionSignatureChecker
 {
 private:
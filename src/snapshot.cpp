@@ -0,0 +1,400 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "snapshot.h"
+
+#include "chainparams.h"
+#include "clientversion.h"
+#include "coins.h"
+#include "consensus/validation.h"
+#include "hash.h"
+#include "init.h"
+#include "main.h"
+#include "net.h"
+#include "primitives/block.h"
+#include "streams.h"
+#include "txdb.h"
+#include "ui_interface.h"
+#include "util.h"
+
+#include <stdio.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+
+/** Headers handed to ProcessNewBlockHeaders at once */
+static const size_t SNAPSHOT_HEADERS_BATCH_SIZE = 2000;
+
+bool WriteUTXOSnapshot(CAutoFile& file, CUTXOSnapshotMetadata& metadata, const std::vector<CBlockHeader>& vHeaders,
+                       CCoinsViewDBCursor* pcursor, uint256& hashContentRet, std::string& strError)
+{
+    if (vHeaders.empty()) {
+        strError = "A snapshot needs at least one block on top of the genesis block";
+        return false;
+    }
+    metadata.hashBaseBlock = vHeaders.back().GetHash();
+    metadata.nHeaders = vHeaders.size();
+    metadata.nCoins = 0;
+
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << metadata.hashBaseBlock;
+    try {
+        file << metadata;
+        for (size_t i = 0; i < vHeaders.size(); i++)
+            file << vHeaders[i];
+        for (; pcursor->Valid(); pcursor->Next()) {
+            boost::this_thread::interruption_point();
+            COutPoint outpoint;
+            Coin coin;
+            if (!pcursor->GetKey(outpoint) || !pcursor->GetValue(coin)) {
+                strError = "Unable to read the UTXO set";
+                return false;
+            }
+            file << outpoint << coin;
+            ss << outpoint << coin;
+            metadata.nCoins++;
+        }
+        // the metadata has a fixed size, fill in the count now that it is known
+        if (fseek(file.Get(), 0, SEEK_SET))
+            throw std::runtime_error("unable to seek");
+        file << metadata;
+    } catch (const std::exception& e) {
+        strError = strprintf("Unable to write the snapshot: %s", e.what());
+        return false;
+    }
+    hashContentRet = ss.GetHash();
+    return true;
+}
+
+bool ReadUTXOSnapshotHeaders(CAutoFile& file, const CUTXOSnapshotMetadata& metadata, std::vector<CBlockHeader>& vHeadersRet, std::string& strError)
+{
+    vHeadersRet.clear();
+    vHeadersRet.reserve(metadata.nHeaders);
+    try {
+        for (uint32_t i = 0; i < metadata.nHeaders; i++) {
+            vHeadersRet.push_back(CBlockHeader());
+            file >> vHeadersRet.back();
+        }
+    } catch (const std::exception& e) {
+        strError = strprintf("Unable to read the snapshot headers: %s", e.what());
+        return false;
+    }
+    if (vHeadersRet.empty() || vHeadersRet.back().GetHash() != metadata.hashBaseBlock) {
+        strError = "The snapshot headers don't end with its base block";
+        return false;
+    }
+    return true;
+}
+
+bool ReadUTXOSnapshotCoins(CAutoFile& file, const CUTXOSnapshotMetadata& metadata, CCoinsView* pviewDest, uint256& hashContentRet, std::string& strError)
+{
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << metadata.hashBaseBlock;
+    CCoinsMap mapCoins;
+    int nReported = 0;
+    try {
+        for (uint64_t i = 0; i < metadata.nCoins; i++) {
+            COutPoint outpoint;
+            Coin coin;
+            file >> outpoint >> coin;
+            ss << outpoint << coin;
+            if (!pviewDest)
+                continue;
+            CCoinsCacheEntry& entry = mapCoins[outpoint];
+            entry.coin.swap(coin);
+            entry.flags = CCoinsCacheEntry::DIRTY | CCoinsCacheEntry::FRESH;
+            if (mapCoins.size() >= UTXO_SNAPSHOT_BATCH_SIZE) {
+                boost::this_thread::interruption_point();
+                if (ShutdownRequested()) {
+                    strError = "Interrupted while loading the UTXO snapshot";
+                    return false;
+                }
+                // the best block is only set by the last batch
+                if (!pviewDest->BatchWrite(mapCoins, uint256())) {
+                    strError = "Unable to write the snapshot coins to the chainstate database";
+                    return false;
+                }
+                mapCoins.clear();
+                int nProgress = (int)(i * 100.0 / metadata.nCoins);
+                uiInterface.ShowProgress(_("Loading UTXO snapshot..."), std::max(1, std::min(99, nProgress)));
+                if (nProgress / 10 > nReported) {
+                    LogPrintf("[%d%%]...\n", nProgress);
+                    nReported = nProgress / 10;
+                }
+            }
+        }
+    } catch (const std::exception& e) {
+        strError = strprintf("Unable to read the snapshot coins: %s", e.what());
+        return false;
+    }
+    hashContentRet = ss.GetHash();
+    if (pviewDest) {
+        if (!pviewDest->BatchWrite(mapCoins, metadata.hashBaseBlock)) {
+            strError = "Unable to write the snapshot coins to the chainstate database";
+            return false;
+        }
+        uiInterface.ShowProgress("", 100);
+    }
+    return true;
+}
+
+/** Content hash of the coins at pcursor, as WriteUTXOSnapshot() computes it */
+static bool HashUTXOSet(const uint256& hashBaseBlock, CCoinsViewDBCursor* pcursor, uint256& hashContentRet)
+{
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << hashBaseBlock;
+    for (; pcursor->Valid(); pcursor->Next()) {
+        boost::this_thread::interruption_point();
+        COutPoint outpoint;
+        Coin coin;
+        if (!pcursor->GetKey(outpoint) || !pcursor->GetValue(coin))
+            return false;
+        ss << outpoint << coin;
+    }
+    hashContentRet = ss.GetHash();
+    return true;
+}
+
+/** Opens a snapshot file and reads its metadata, checking it is for this network */
+static bool OpenUTXOSnapshot(const std::string& strPath, const CChainParams& chainparams, CAutoFile& file, CUTXOSnapshotMetadata& metadata, std::string& strError)
+{
+    if (file.IsNull()) {
+        strError = strprintf("Unable to open UTXO snapshot %s", strPath);
+        return false;
+    }
+    try {
+        file >> metadata;
+    } catch (const std::exception& e) {
+        strError = strprintf("Unable to read UTXO snapshot %s: %s", strPath, e.what());
+        return false;
+    }
+    if (memcmp(metadata.pchMessageStart, chainparams.MessageStart(), sizeof(metadata.pchMessageStart))) {
+        strError = strprintf("UTXO snapshot %s is for another network", strPath);
+        return false;
+    }
+    if (metadata.nVersion != UTXO_SNAPSHOT_VERSION) {
+        strError = strprintf("UTXO snapshot %s has unsupported version %d", strPath, metadata.nVersion);
+        return false;
+    }
+    return true;
+}
+
+bool LoadUTXOSnapshot(const std::string& strPath, const CChainParams& chainparams, std::string& strError)
+{
+    CAutoFile file(fopen(strPath.c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+    CUTXOSnapshotMetadata metadata;
+    if (!OpenUTXOSnapshot(strPath, chainparams, file, metadata, strError))
+        return false;
+
+    MapUTXOSnapshots::const_iterator itSnapshot = chainparams.UTXOSnapshots().find(metadata.hashBaseBlock);
+    if (itSnapshot == chainparams.UTXOSnapshots().end()) {
+        strError = strprintf("UTXO snapshot %s at block %s is not one this version of the software knows about", strPath, metadata.hashBaseBlock.ToString());
+        return false;
+    }
+    const CUTXOSnapshotData& data = itSnapshot->second;
+
+    LogPrintf("Loading UTXO snapshot %s: block %s, %u headers, %u coins\n", strPath, metadata.hashBaseBlock.ToString(), metadata.nHeaders, metadata.nCoins);
+    int64_t nStart = GetTimeMillis();
+
+    // Hash the coins before touching the databases, so a corrupt file is
+    // turned down without leaving anything behind
+    std::vector<CBlockHeader> vHeaders;
+    if (!ReadUTXOSnapshotHeaders(file, metadata, vHeaders, strError))
+        return false;
+    if (vHeaders.front().hashPrevBlock != chainparams.GetConsensus().hashGenesisBlock) {
+        strError = "The snapshot headers don't start at the genesis block";
+        return false;
+    }
+    uint256 hashContent;
+    if (!ReadUTXOSnapshotCoins(file, metadata, NULL, hashContent, strError))
+        return false;
+    if (hashContent != data.hashContent) {
+        strError = strprintf("UTXO snapshot %s has content hash %s, expected %s", strPath, hashContent.ToString(), data.hashContent.ToString());
+        return false;
+    }
+
+    // The headers go through the same checks as those received from peers
+    uiInterface.InitMessage(_("Loading UTXO snapshot headers..."));
+    for (size_t i = 0; i < vHeaders.size(); i += SNAPSHOT_HEADERS_BATCH_SIZE) {
+        if (ShutdownRequested()) {
+            strError = "Interrupted while loading the UTXO snapshot";
+            return false;
+        }
+        std::vector<CBlockHeader> vBatch(vHeaders.begin() + i, vHeaders.begin() + std::min(i + SNAPSHOT_HEADERS_BATCH_SIZE, vHeaders.size()));
+        CValidationState state;
+        if (!ProcessNewBlockHeaders(vBatch, state, chainparams)) {
+            strError = strprintf("Invalid header in UTXO snapshot %s: %s", strPath, FormatStateMessage(state));
+            return false;
+        }
+    }
+    std::vector<CBlockHeader>().swap(vHeaders);
+    FlushStateToDisk();
+
+    // From here on an interruption leaves a partial chainstate, which the
+    // next start detects through this flag
+    if (!pblocktree->WriteFlag("utxosnapshotloading", true) || !pblocktree->WriteFlag("utxosnapshotvalidated", false)) {
+        strError = "Unable to write to the block index database";
+        return false;
+    }
+    // the background validation starts over at the genesis block
+    boost::filesystem::remove_all(GetDataDir() / UTXO_SNAPSHOT_VALIDATION_DIR);
+    uiInterface.InitMessage(_("Loading UTXO snapshot..."));
+    CAutoFile fileCoins(fopen(strPath.c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+    if (!OpenUTXOSnapshot(strPath, chainparams, fileCoins, metadata, strError))
+        return false;
+    if (!ReadUTXOSnapshotHeaders(fileCoins, metadata, vHeaders, strError))
+        return false;
+    std::vector<CBlockHeader>().swap(vHeaders);
+    if (!ReadUTXOSnapshotCoins(fileCoins, metadata, pcoinsdbview, hashContent, strError))
+        return false;
+    // the file could have changed since it was checked
+    if (hashContent != data.hashContent) {
+        strError = strprintf("UTXO snapshot %s changed while loading it", strPath);
+        return false;
+    }
+    if (!pblocktree->WriteSnapshotBase(metadata.hashBaseBlock, data.nChainTx) || !pblocktree->WriteFlag("utxosnapshotloading", false)) {
+        strError = "Unable to write to the block index database";
+        return false;
+    }
+    LogPrintf("Loaded UTXO snapshot at block %s in %dms\n", metadata.hashBaseBlock.ToString(), GetTimeMillis() - nStart);
+    return true;
+}
+
+SnapshotValidationResult ValidateUTXOSnapshot(const CChainParams& chainparams, CCoinsViewDB& viewDB, std::string& strError)
+{
+    CBlockIndex* pindexBase;
+    CBlockIndex* pindex;
+    {
+        LOCK(cs_main);
+        pindexBase = pindexSnapshotBase;
+        if (!pindexBase) {
+            strError = "The chainstate wasn't loaded from a UTXO snapshot";
+            return SNAPSHOT_VALIDATION_FAILED;
+        }
+        uint256 hashBest = viewDB.GetBestBlock();
+        if (hashBest.IsNull())
+            hashBest = chainparams.GetConsensus().hashGenesisBlock;
+        BlockMap::iterator mi = mapBlockIndex.find(hashBest);
+        if (mi == mapBlockIndex.end() || pindexBase->GetAncestor(mi->second->nHeight) != mi->second) {
+            strError = strprintf("The UTXO set in %s isn't on the chain of the snapshot", UTXO_SNAPSHOT_VALIDATION_DIR);
+            return SNAPSHOT_VALIDATION_FAILED;
+        }
+        pindex = mi->second;
+        pindexSnapshotValidated = pindex;
+    }
+    MapUTXOSnapshots::const_iterator itSnapshot = chainparams.UTXOSnapshots().find(pindexBase->GetBlockHash());
+    if (itSnapshot == chainparams.UTXOSnapshots().end()) {
+        strError = strprintf("UTXO snapshot at block %s is not one this version of the software knows about", pindexBase->GetBlockHash().ToString());
+        return SNAPSHOT_VALIDATION_FAILED;
+    }
+
+    // The coinbase of the genesis block isn't spendable, the UTXO set starts empty right after it
+    CCoinsViewCache view(&viewDB);
+    view.SetBestBlock(pindex->GetBlockHash());
+    while (pindex != pindexBase) {
+        boost::this_thread::interruption_point();
+        CBlockIndex* pindexNext = pindexBase->GetAncestor(pindex->nHeight + 1);
+        // cs_main is only taken per block and not while reading it, the node goes on meanwhile
+        CDiskBlockPos pos;
+        {
+            LOCK(cs_main);
+            if (!(pindexNext->nStatus & BLOCK_HAVE_DATA))
+                break;
+            pos = pindexNext->GetBlockPos();
+        }
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pos, chainparams.GetConsensus()) || block.GetHash() != pindexNext->GetBlockHash()) {
+            strError = strprintf("Unable to read block %s", pindexNext->GetBlockHash().ToString());
+            return SNAPSHOT_VALIDATION_FAILED;
+        }
+        {
+            LOCK(cs_main);
+            // Everything but writing the undo data and the indexes, the coins go to view
+            CValidationState state;
+            if (!ConnectBlock(block, state, pindexNext, view, true)) {
+                strError = strprintf("Block %s at height %d below the UTXO snapshot is invalid: %s",
+                                     pindexNext->GetBlockHash().ToString(), pindexNext->nHeight, FormatStateMessage(state));
+                return SNAPSHOT_VALIDATION_FAILED;
+            }
+            pindexSnapshotValidated = pindexNext;
+        }
+        view.SetBestBlock(pindexNext->GetBlockHash());
+        pindex = pindexNext;
+        if (view.DynamicMemoryUsage() > UTXO_SNAPSHOT_VALIDATION_CACHE && !view.Flush()) {
+            strError = strprintf("Unable to write to %s", UTXO_SNAPSHOT_VALIDATION_DIR);
+            return SNAPSHOT_VALIDATION_FAILED;
+        }
+    }
+    if (!view.Flush()) {
+        strError = strprintf("Unable to write to %s", UTXO_SNAPSHOT_VALIDATION_DIR);
+        return SNAPSHOT_VALIDATION_FAILED;
+    }
+    if (pindex != pindexBase)
+        return SNAPSHOT_VALIDATION_PENDING;
+
+    uint256 hashContent;
+    boost::scoped_ptr<CCoinsViewDBCursor> pcursor(viewDB.Cursor());
+    if (!HashUTXOSet(pindexBase->GetBlockHash(), pcursor.get(), hashContent)) {
+        strError = strprintf("Unable to read %s", UTXO_SNAPSHOT_VALIDATION_DIR);
+        return SNAPSHOT_VALIDATION_FAILED;
+    }
+    if (hashContent != itSnapshot->second.hashContent) {
+        strError = strprintf("The UTXO set at block %s has content hash %s, the snapshot had %s",
+                             pindexBase->GetBlockHash().ToString(), hashContent.ToString(), itSnapshot->second.hashContent.ToString());
+        return SNAPSHOT_VALIDATION_FAILED;
+    }
+
+    LOCK(cs_main);
+    // The blocks on top of the base counted their transactions from the snapshot's nChainTx
+    unsigned int nChainTx = 0;
+    for (CBlockIndex* pindexWalk = pindexBase; pindexWalk; pindexWalk = pindexWalk->pprev) {
+        nChainTx += pindexWalk->nTx;
+        if (pindexWalk->pprev)
+            MarkSnapshotBlockValidated(pindexWalk);
+    }
+    if (nChainTx != itSnapshot->second.nChainTx) {
+        strError = strprintf("The chain up to block %s has %u transactions, the snapshot had %u",
+                             pindexBase->GetBlockHash().ToString(), nChainTx, itSnapshot->second.nChainTx);
+        return SNAPSHOT_VALIDATION_FAILED;
+    }
+
+    // From now on the chainstate is like one built by connecting every block
+    if (!pblocktree->WriteFlag("utxosnapshotvalidated", true) || !pblocktree->EraseSnapshotBase()) {
+        strError = "Unable to write to the block index database";
+        return SNAPSHOT_VALIDATION_FAILED;
+    }
+    pindexSnapshotBase = NULL;
+    pindexSnapshotValidated = NULL;
+    if (!fPruneMode)
+        nLocalServices |= NODE_NETWORK;
+    return SNAPSHOT_VALIDATION_DONE;
+}
+
+void ThreadValidateUTXOSnapshot()
+{
+    RenameThread("3dcoin-snapshot");
+    const CChainParams& chainparams = Params();
+    LogPrintf("Validating the blocks below the UTXO snapshot in the background\n");
+
+    std::string strError;
+    SnapshotValidationResult result;
+    {
+        CCoinsViewDB viewDB(UTXO_SNAPSHOT_VALIDATION_CACHE / 8, false, false, UTXO_SNAPSHOT_VALIDATION_DIR);
+        // wait for the next blocks to be downloaded
+        while ((result = ValidateUTXOSnapshot(chainparams, viewDB, strError)) == SNAPSHOT_VALIDATION_PENDING)
+            MilliSleep(1000);
+    }
+    if (result == SNAPSHOT_VALIDATION_FAILED) {
+        strMiscWarning = strError;
+        LogPrintf("*** %s\n", strError);
+        uiInterface.ThreadSafeMessageBox(_("The block chain doesn't match the UTXO snapshot the chainstate was loaded from. Rebuild it using -reindex."),
+                                         "", CClientUIInterface::MSG_ERROR);
+        StartShutdown();
+        return;
+    }
+
+    boost::filesystem::remove_all(GetDataDir() / UTXO_SNAPSHOT_VALIDATION_DIR);
+    LogPrintf("The blocks below the UTXO snapshot are valid and lead to its UTXO set, serving them to peers\n");
+}
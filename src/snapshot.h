@@ -0,0 +1,119 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "protocol.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <string>
+#include <vector>
+
+class CAutoFile;
+class CBlockHeader;
+class CChainParams;
+class CCoinsView;
+class CCoinsViewDB;
+class CCoinsViewDBCursor;
+
+/** Version of the UTXO snapshot file format */
+static const int UTXO_SNAPSHOT_VERSION = 1;
+/** Coins written to the chainstate at once while loading a snapshot */
+static const size_t UTXO_SNAPSHOT_BATCH_SIZE = 100000;
+/** Memory for the coins of the background validation of a snapshot, written to its database when exceeded */
+static const size_t UTXO_SNAPSHOT_VALIDATION_CACHE = 64 << 20;
+/** Directory below the data directory with the UTXO set of the background validation */
+static const char* const UTXO_SNAPSHOT_VALIDATION_DIR = "chainstate_snapshot";
+
+enum SnapshotValidationResult
+{
+    SNAPSHOT_VALIDATION_PENDING,    //! connected the blocks downloaded so far
+    SNAPSHOT_VALIDATION_DONE,       //! the base block was reached and the UTXO sets match
+    SNAPSHOT_VALIDATION_FAILED,     //! invalid block, or the UTXO sets differ
+};
+
+/**
+ * Start of a UTXO snapshot file, as written by dumptxoutset.
+ *
+ * Serialized format:
+ * - the message start of the network
+ * - nVersion
+ * - the base block: the chainstate is the one right after connecting it
+ * - nHeaders, followed by that many block headers, from the block after
+ *   the genesis block up to the base block
+ * - nCoins, followed by that many pairs of COutPoint and Coin, in the
+ *   key order of the chainstate database
+ */
+class CUTXOSnapshotMetadata
+{
+public:
+    CMessageHeader::MessageStartChars pchMessageStart;
+    int nVersion;
+    uint256 hashBaseBlock;
+    uint32_t nHeaders;
+    uint64_t nCoins;
+
+    CUTXOSnapshotMetadata() : nVersion(UTXO_SNAPSHOT_VERSION), nHeaders(0), nCoins(0)
+    {
+        memset(pchMessageStart, 0, sizeof(pchMessageStart));
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersionIn) {
+        READWRITE(FLATDATA(pchMessageStart));
+        READWRITE(nVersion);
+        READWRITE(hashBaseBlock);
+        READWRITE(nHeaders);
+        READWRITE(nCoins);
+    }
+};
+
+/**
+ * Writes a snapshot of the coins at pcursor, which must be those after
+ * connecting the last of vHeaders. metadata gets the base block and the
+ * counts filled in. hashContentRet is what chainparams needs to list for the
+ * snapshot to be loaded.
+ */
+bool WriteUTXOSnapshot(CAutoFile& file, CUTXOSnapshotMetadata& metadata, const std::vector<CBlockHeader>& vHeaders,
+                       CCoinsViewDBCursor* pcursor, uint256& hashContentRet, std::string& strError);
+
+/** Reads the headers of a snapshot file positioned right after the metadata */
+bool ReadUTXOSnapshotHeaders(CAutoFile& file, const CUTXOSnapshotMetadata& metadata, std::vector<CBlockHeader>& vHeadersRet, std::string& strError);
+
+/**
+ * Reads the coins of a snapshot file positioned right after the headers and
+ * computes their content hash. If pviewDest is set the coins are written to
+ * it in batches, the last one setting its best block to the base block.
+ */
+bool ReadUTXOSnapshotCoins(CAutoFile& file, const CUTXOSnapshotMetadata& metadata, CCoinsView* pviewDest, uint256& hashContentRet, std::string& strError);
+
+/**
+ * Populates the empty chainstate from a snapshot file: checks its content
+ * hash against chainparams, adds its headers to the block index and writes
+ * its coins, leaving the base block as the tip. The block index and
+ * chainstate need to be loaded again afterwards.
+ */
+bool LoadUTXOSnapshot(const std::string& strPath, const CChainParams& chainparams, std::string& strError);
+
+/**
+ * Connects the blocks below pindexSnapshotBase that were downloaded so far
+ * to the UTXO set in viewDB, which starts out empty at the genesis block.
+ * Once the base block is connected the UTXO set has to have the content hash
+ * and the chain the transaction count the snapshot was loaded with. Then the
+ * chainstate is treated like one built by connecting every block: the snapshot
+ * base is forgotten and NODE_NETWORK gets set again.
+ */
+SnapshotValidationResult ValidateUTXOSnapshot(const CChainParams& chainparams, CCoinsViewDB& viewDB, std::string& strError);
+
+/**
+ * Validates the historical chain of a chainstate loaded from a snapshot as
+ * its blocks come in, shuts the node down if it doesn't match the snapshot.
+ */
+void ThreadValidateUTXOSnapshot();
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,107 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chain.h"
+#include "chainparams.h"
+#include "coins.h"
+#include "consensus/validation.h"
+#include "key.h"
+#include "main.h"
+#include "miner.h"
+#include "random.h"
+#include "script/standard.h"
+
+#include "test/test_3dcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(assumevalid_tests, TestChain100Setup)
+
+static bool TestConnectBlock(const CBlock& block, CBlockIndex* pindex)
+{
+    CCoinsViewCache view(pcoinsTip);
+    CValidationState state;
+    return ConnectBlock(block, state, pindex, view, true);
+}
+
+BOOST_AUTO_TEST_CASE(assumevalid_skips_scripts)
+{
+    const CChainParams& chainparams = Params();
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+
+    // a spend of a mature coinbase, signed by the wrong key
+    CKey keyWrong;
+    keyWrong.MakeNewKey(true);
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(coinbaseTxns[0].GetHash(), 0);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 11*CENT;
+    tx.vout[0].scriptPubKey = scriptPubKey;
+    std::vector<unsigned char> vchSig;
+    BOOST_CHECK(keyWrong.Sign(SignatureHash(scriptPubKey, tx, 0, SIGHASH_ALL), vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    tx.vin[0].scriptSig << vchSig;
+
+    CBlockTemplate* pblocktemplate = CreateNewBlock(chainparams, scriptPubKey);
+    CBlock block = pblocktemplate->block;
+    delete pblocktemplate;
+    block.vtx.resize(1);
+    block.vtx.push_back(tx);
+    unsigned int nExtraNonce = 0;
+    IncrementExtraNonce(&block, chainActive.Tip(), nExtraNonce);
+
+    LOCK(cs_main);
+    CBlockIndex* pindexPrev = chainActive.Tip();
+    uint256 hash = block.GetHash();
+    CBlockIndex index(block);
+    index.phashBlock = &hash;
+    index.pprev = pindexPrev;
+    index.nHeight = pindexPrev->nHeight + 1;
+    index.nChainWork = pindexPrev->nChainWork + GetBlockProof(index);
+
+    // the best header, four weeks of work on top of the block, is the assumed valid one
+    uint256 hashHeader = GetRandHash();
+    CBlockIndex indexHeader;
+    indexHeader.phashBlock = &hashHeader;
+    indexHeader.pprev = &index;
+    indexHeader.nHeight = index.nHeight + 1;
+    indexHeader.nBits = index.nBits;
+    indexHeader.nChainWork = index.nChainWork + GetBlockProof(index) * (uint32_t)(4 * 7 * 24 * 60 * 60 / chainparams.GetConsensus().nPowTargetSpacing);
+    mapBlockIndex[hashHeader] = &indexHeader;
+    CBlockIndex* pindexBestHeaderOld = pindexBestHeader;
+    uint256 hashAssumeValidOld = hashAssumeValid;
+    pindexBestHeader = &indexHeader;
+
+    // the bad signature is found without an assumed valid block
+    hashAssumeValid = uint256();
+    BOOST_CHECK(!TestConnectBlock(block, &index));
+
+    // and isn't looked at when the block is an ancestor of it
+    hashAssumeValid = hashHeader;
+    BOOST_CHECK(TestConnectBlock(block, &index));
+
+    // recent blocks are still checked
+    arith_uint256 nChainWorkHeader = indexHeader.nChainWork;
+    indexHeader.nChainWork = index.nChainWork + GetBlockProof(index);
+    BOOST_CHECK(!TestConnectBlock(block, &index));
+    indexHeader.nChainWork = nChainWorkHeader;
+
+    // and so is everything but the scripts, e.g. a spend of a missing output
+    CBlock blockMissing = block;
+    CMutableTransaction txMissing(tx);
+    txMissing.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    blockMissing.vtx[1] = txMissing;
+    IncrementExtraNonce(&blockMissing, pindexPrev, nExtraNonce);
+    CCoinsViewCache view(pcoinsTip);
+    CValidationState state;
+    BOOST_CHECK(!ConnectBlock(blockMissing, state, &index, view, true));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "bad-txns-inputs-missingorspent");
+
+    mapBlockIndex.erase(hashHeader);
+    pindexBestHeader = pindexBestHeaderOld;
+    hashAssumeValid = hashAssumeValidOld;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
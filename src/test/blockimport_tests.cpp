@@ -0,0 +1,76 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "clientversion.h"
+#include "consensus/validation.h"
+#include "main.h"
+#include "streams.h"
+#include "txdb.h"
+
+#include "test/test_3dcoin.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockimport_tests, TestChain100Setup)
+
+BOOST_AUTO_TEST_CASE(blockimport_bootstrap)
+{
+    const CChainParams& chainparams = Params();
+    uint256 hashTip = chainActive.Tip()->GetBlockHash();
+    std::vector<CBlock> vBlocks(chainActive.Height());
+    for (int i = 1; i <= chainActive.Height(); i++)
+        BOOST_CHECK(ReadBlockFromDisk(vBlocks[i - 1], chainActive[i], chainparams.GetConsensus()));
+
+    // A bootstrap file with more than one batch of data, and the things a
+    // block file can have besides blocks
+    boost::filesystem::path path = pathTemp / "bootstrap.dat";
+    {
+        CAutoFile file(fopen(path.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+        for (size_t i = 0; i < vBlocks.size(); i++) {
+            unsigned int nSize = file.GetSerializeSize(vBlocks[i]);
+            if (i == 20 || i == vBlocks.size() - 3) {
+                // a block that can't be decoded, the next one is found inside of it,
+                // also in the last batch once the end of the file was reached
+                std::vector<unsigned char> vchBad(100, 0xff);
+                file << FLATDATA(chainparams.MessageStart()) << (unsigned int)300;
+                file.write((const char*)&vchBad[0], vchBad.size());
+                file << FLATDATA(chainparams.MessageStart()) << nSize << vBlocks[i];
+                continue;
+            }
+            if (i == 49) {
+                // extra data after a block, which is scanned for the next one
+                // after the following batch was read up to the end of the file
+                file << FLATDATA(chainparams.MessageStart()) << nSize + 16 << vBlocks[i];
+                std::vector<unsigned char> vchPadding(16, 0);
+                file.write((const char*)&vchPadding[0], vchPadding.size());
+                // and data without blocks, beyond what is read at once
+                std::vector<unsigned char> vchEmpty(IMPORT_BATCH_SIZE + 1000, 0);
+                file.write((const char*)&vchEmpty[0], vchEmpty.size());
+                continue;
+            }
+            file << FLATDATA(chainparams.MessageStart()) << nSize << vBlocks[i];
+        }
+    }
+
+    // start over from the genesis block
+    UnloadBlockIndex();
+    delete pcoinsTip;
+    delete pcoinsdbview;
+    delete pblocktree;
+    pblocktree = new CBlockTreeDB(1 << 20, true);
+    pcoinsdbview = new CCoinsViewDB(1 << 23, true);
+    pcoinsTip = new CCoinsViewCache(pcoinsdbview);
+    BOOST_CHECK(InitBlockIndex(chainparams));
+    BOOST_CHECK_EQUAL(chainActive.Height(), 0);
+
+    BOOST_CHECK(LoadExternalBlockFile(chainparams, fopen(path.string().c_str(), "rb")));
+    CValidationState state;
+    BOOST_CHECK(ActivateBestChain(state, chainparams));
+    BOOST_CHECK_EQUAL(chainActive.Height(), (int)vBlocks.size());
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == hashTip);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,168 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockreader.h"
+#include "chainparams.h"
+#include "clientversion.h"
+#include "main.h"
+#include "random.h"
+
+#include "test/test_3dcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(blockreader_tests, TestingSetup)
+
+static CBlock MakeBlock(int nTx)
+{
+    CBlock block;
+    block.nTime = GetRand(1000000);
+    for (int i = 0; i < nTx; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(GetRandHash(), i);
+        tx.vout.resize(2);
+        tx.vout[0].nValue = i;
+        tx.vout[1].nValue = GetRand(1000);
+        block.vtx.push_back(tx);
+    }
+    return block;
+}
+
+static CBlockIndex* MakeIndex(const CBlock& block, const CDiskBlockPos& pos, uint256& hash)
+{
+    hash = block.GetHash();
+    CBlockIndex* pindex = new CBlockIndex(block);
+    pindex->phashBlock = &hash;
+    pindex->nFile = pos.nFile;
+    pindex->nDataPos = pos.nPos;
+    pindex->nStatus |= BLOCK_HAVE_DATA;
+    return pindex;
+}
+
+BOOST_AUTO_TEST_CASE(blockreader_raw)
+{
+    const CChainParams& chainparams = Params();
+
+    // the genesis block was stored by InitBlockIndex
+    CDataStream ssRaw(SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK(blockreader.ReadRawBlock(ssRaw, chainActive.Genesis()->GetBlockPos(), chainparams.MessageStart()));
+    CDataStream ssGenesis(SER_NETWORK, PROTOCOL_VERSION);
+    ssGenesis << chainparams.GenesisBlock();
+    BOOST_CHECK(ssRaw.str() == ssGenesis.str());
+
+    // blocks appended after the file was mapped are read too
+    CDiskBlockPos pos1(1, 0);
+    CBlock block1 = MakeBlock(10);
+    BOOST_CHECK(WriteBlockToDisk(block1, pos1, chainparams.MessageStart()));
+    CDataStream ss1(SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK(blockreader.ReadRawBlock(ss1, pos1, chainparams.MessageStart()));
+    CDiskBlockPos pos2(1, pos1.nPos + ss1.size());
+    CBlock block2 = MakeBlock(1000);
+    BOOST_CHECK(WriteBlockToDisk(block2, pos2, chainparams.MessageStart()));
+    CDataStream ss2(SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK(blockreader.ReadRawBlock(ss2, pos2, chainparams.MessageStart()));
+    CBlock blockRead;
+    ss2 >> blockRead;
+    BOOST_CHECK(blockRead.GetHash() == block2.GetHash());
+
+    // wrong magic, no block at all, or a missing file
+    CMessageHeader::MessageStartChars messageStart = {0, 1, 2, 3};
+    BOOST_CHECK(!blockreader.ReadRawBlock(ss2, pos2, messageStart));
+    BOOST_CHECK(!blockreader.ReadRawBlock(ss2, CDiskBlockPos(1, pos2.nPos + 1), chainparams.MessageStart()));
+    BOOST_CHECK(!blockreader.ReadRawBlock(ss2, CDiskBlockPos(2, 8), chainparams.MessageStart()));
+
+    blockreader.CloseFile(0);
+    blockreader.CloseFile(1);
+}
+
+BOOST_AUTO_TEST_CASE(blockreader_cache)
+{
+    const CChainParams& chainparams = Params();
+
+    CDiskBlockPos pos(1, 0);
+    CBlock block = MakeBlock(100);
+    BOOST_CHECK(WriteBlockToDisk(block, pos, chainparams.MessageStart()));
+    uint256 hash;
+    CBlockIndex* pindex = MakeIndex(block, pos, hash);
+
+    CBlockReaderStats stats = blockreader.GetStats();
+    boost::shared_ptr<const CBlock> pblock = blockreader.ReadBlock(pindex, chainparams.MessageStart());
+    BOOST_CHECK(pblock && pblock->GetHash() == hash);
+    BOOST_CHECK(blockreader.ReadBlock(pindex, chainparams.MessageStart()) == pblock);
+    BOOST_CHECK_EQUAL(blockreader.GetStats().nCacheMisses, stats.nCacheMisses + 1);
+    BOOST_CHECK_EQUAL(blockreader.GetStats().nCacheHits, stats.nCacheHits + 1);
+
+    // transactions are found by their offset after the header
+    unsigned int nTxOffset = GetSizeOfCompactSize(block.vtx.size());
+    for (int i = 0; i < 50; i++)
+        nTxOffset += ::GetSerializeSize(block.vtx[i], SER_DISK, CLIENT_VERSION);
+    CTransaction tx;
+    uint256 hashBlock;
+    BOOST_CHECK(blockreader.ReadTransaction(CDiskTxPos(pos, nTxOffset), chainparams.MessageStart(), tx, hashBlock));
+    BOOST_CHECK(tx.GetHash() == block.vtx[50].GetHash());
+    BOOST_CHECK(hashBlock == hash);
+
+    // a block which doesn't match its index entry isn't returned
+    CBlock blockOther = MakeBlock(1);
+    uint256 hashOther;
+    CBlockIndex* pindexOther = MakeIndex(blockOther, pos, hashOther);
+    BOOST_CHECK(!blockreader.ReadBlock(pindexOther, chainparams.MessageStart()));
+
+    // nothing is kept without a cache, the block is still read
+    blockreader.SetMaxCacheUsage(0);
+    BOOST_CHECK_EQUAL(blockreader.GetStats().nCacheBlocks, 0);
+    BOOST_CHECK(blockreader.ReadBlock(pindex, chainparams.MessageStart()));
+    BOOST_CHECK_EQUAL(blockreader.GetStats().nCacheBlocks, 0);
+    blockreader.SetMaxCacheUsage(DEFAULT_BLOCK_CACHE_SIZE << 20);
+
+    blockreader.CloseFile(1);
+    delete pindex;
+    delete pindexOther;
+}
+
+BOOST_AUTO_TEST_CASE(blockreader_unmapped)
+{
+    const CChainParams& chainparams = Params();
+
+    CDiskBlockPos pos1(1, 0);
+    CBlock block1 = MakeBlock(10);
+    BOOST_CHECK(WriteBlockToDisk(block1, pos1, chainparams.MessageStart()));
+    CDiskBlockPos pos2(2, 0);
+    CBlock block2 = MakeBlock(10);
+    BOOST_CHECK(WriteBlockToDisk(block2, pos2, chainparams.MessageStart()));
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK(blockreader.ReadRawBlock(ss, pos1, chainparams.MessageStart()));
+    CBlockReaderStats stats = blockreader.GetStats();
+    BOOST_CHECK(stats.nMappedBytes > 0);
+
+    // past the limit the least recently used file is unmapped first
+    blockreader.SetMaxMappedBytes(stats.nMappedBytes);
+    BOOST_CHECK(blockreader.ReadRawBlock(ss, pos2, chainparams.MessageStart()));
+    BOOST_CHECK(blockreader.GetStats().nMappedBytes <= stats.nMappedBytes);
+    BOOST_CHECK(blockreader.GetStats().nMappedFiles <= stats.nMappedFiles);
+
+    // without mapping the blocks are still read, with stdio
+    blockreader.SetMaxMappedBytes(0);
+    BOOST_CHECK_EQUAL(blockreader.GetStats().nMappedFiles, 0);
+    BOOST_CHECK_EQUAL(blockreader.GetStats().nMappedBytes, 0);
+    CDataStream ssRaw(SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK(blockreader.ReadRawBlock(ssRaw, pos2, chainparams.MessageStart()));
+    CBlock blockRead;
+    ssRaw >> blockRead;
+    BOOST_CHECK(blockRead.GetHash() == block2.GetHash());
+    BOOST_CHECK(!blockreader.ReadRawBlock(ssRaw, CDiskBlockPos(3, 8), chainparams.MessageStart()));
+    uint256 hash;
+    CBlockIndex* pindex = MakeIndex(block1, pos1, hash);
+    boost::shared_ptr<const CBlock> pblock = blockreader.ReadBlock(pindex, chainparams.MessageStart());
+    BOOST_CHECK(pblock && pblock->GetHash() == hash);
+    BOOST_CHECK_EQUAL(blockreader.GetStats().nMappedFiles, 0);
+    blockreader.SetMaxMappedBytes(MAX_MAPPED_BLOCK_BYTES);
+
+    blockreader.CloseFile(1);
+    blockreader.CloseFile(2);
+    delete pindex;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,101 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "checkqueue.h"
+
+#include "test/test_3dcoin.h"
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(checkqueue_tests, BasicTestingSetup)
+
+// Counts how often it ran, fails if fOk isn't set
+struct CCountingCheck
+{
+    std::atomic<int>* pnCount;
+    bool fOk;
+
+    CCountingCheck() : pnCount(NULL), fOk(true) {}
+    CCountingCheck(std::atomic<int>* pnCountIn, bool fOkIn) : pnCount(pnCountIn), fOk(fOkIn) {}
+
+    bool operator()()
+    {
+        if (pnCount)
+            (*pnCount)++;
+        return fOk;
+    }
+
+    void swap(CCountingCheck& check)
+    {
+        std::swap(pnCount, check.pnCount);
+        std::swap(fOk, check.fOk);
+    }
+};
+
+static void RunRounds(int nThreads)
+{
+    CCheckQueue<CCountingCheck> queue(4);
+    boost::thread_group threadGroup;
+    for (int i = 0; i < nThreads - 1; i++)
+        threadGroup.create_thread(boost::bind(&CCheckQueue<CCountingCheck>::Thread, &queue));
+
+    for (int nRound = 0; nRound < 50; nRound++) {
+        std::atomic<int> nCount(0);
+        int nChecks = 0;
+        // every fifth round has a failing check somewhere
+        bool fFail = nRound % 5 == 4;
+        {
+            CCheckQueueControl<CCountingCheck> control(&queue);
+            for (int i = 0; i < 100; i++) {
+                std::vector<CCountingCheck> vChecks;
+                for (int j = 0; j < i % 7; j++)
+                    vChecks.push_back(CCountingCheck(&nCount, !(fFail && i == 50 + nRound % 10 && j == 0)));
+                nChecks += vChecks.size();
+                control.Add(vChecks);
+                BOOST_CHECK(vChecks.empty() || vChecks[0].pnCount == NULL);
+            }
+            BOOST_CHECK_EQUAL(control.Wait(), !fFail);
+        }
+        // after a failure the remaining checks may be skipped, never run twice
+        if (fFail)
+            BOOST_CHECK(nCount <= nChecks);
+        else
+            BOOST_CHECK_EQUAL(nCount, nChecks);
+        BOOST_CHECK(queue.IsIdle());
+    }
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_master_only)
+{
+    RunRounds(1);
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_workers)
+{
+    RunRounds(2);
+    RunRounds(8);
+}
+
+BOOST_AUTO_TEST_CASE(checkqueue_empty)
+{
+    CCheckQueue<CCountingCheck> queue(16);
+    {
+        CCheckQueueControl<CCountingCheck> control(&queue);
+        BOOST_CHECK(control.Wait());
+    }
+    // a NULL queue has nothing to check
+    CCheckQueueControl<CCountingCheck> control(NULL);
+    std::atomic<int> nCount(0);
+    std::vector<CCountingCheck> vChecks(1, CCountingCheck(&nCount, false));
+    control.Add(vChecks);
+    BOOST_CHECK(control.Wait());
+    BOOST_CHECK_EQUAL(nCount, 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -8,6 +8,8 @@
 #include "test/test_3dcoin.h"
 #include "main.h"
 #include "consensus/validation.h"
+#include "streams.h"
+#include "undo.h"
 
 #include <vector>
 #include <map>
@@ -19,27 +21,27 @@ namespace
 class CCoinsViewTest : public CCoinsView
 {
     uint256 hashBestBlock_;
-    std::map<uint256, CCoins> map_;
+    std::map<COutPoint, Coin> map_;
 
 public:
-    bool GetCoins(const uint256& txid, CCoins& coins) const
+    bool GetCoin(const COutPoint& outpoint, Coin& coin) const
     {
-        std::map<uint256, CCoins>::const_iterator it = map_.find(txid);
+        std::map<COutPoint, Coin>::const_iterator it = map_.find(outpoint);
         if (it == map_.end()) {
             return false;
         }
-        coins = it->second;
-        if (coins.IsPruned() && insecure_rand() % 2 == 0) {
+        coin = it->second;
+        if (coin.IsSpent() && insecure_rand() % 2 == 0) {
             // Randomly return false in case of an empty entry.
             return false;
         }
         return true;
     }
 
-    bool HaveCoins(const uint256& txid) const
+    bool HaveCoin(const COutPoint& outpoint) const
     {
-        CCoins coins;
-        return GetCoins(txid, coins);
+        Coin coin;
+        return GetCoin(outpoint, coin) && !coin.IsSpent();
     }
 
     uint256 GetBestBlock() const { return hashBestBlock_; }
@@ -49,8 +51,8 @@ public:
         for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end(); ) {
             if (it->second.flags & CCoinsCacheEntry::DIRTY) {
                 // Same optimization used in CCoinsViewDB is to only write dirty entries.
-                map_[it->first] = it->second.coins;
-                if (it->second.coins.IsPruned() && insecure_rand() % 3 == 0) {
+                map_[it->first] = it->second.coin;
+                if (it->second.coin.IsSpent() && insecure_rand() % 3 == 0) {
                     // Randomly delete empty entries on write.
                     map_.erase(it->first);
                 }
@@ -75,7 +77,7 @@ public:
         // Manually recompute the dynamic usage of the whole data, and compare it.
         size_t ret = memusage::DynamicUsage(cacheCoins);
         for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end(); it++) {
-            ret += it->second.coins.DynamicMemoryUsage();
+            ret += it->second.coin.DynamicMemoryUsage();
         }
         BOOST_CHECK_EQUAL(DynamicMemoryUsage(), ret);
     }
@@ -91,7 +93,7 @@ static const unsigned int NUM_SIMULATION_ITERATIONS = 40000;
 // This is a large randomized insert/remove simulation test on a variable-size
 // stack of caches on top of CCoinsViewTest.
 //
-// It will randomly create/update/delete CCoins entries to a tip of caches, with
+// It will randomly create/update/delete Coin entries to a tip of caches, with
 // txids picked from a limited list of random 256-bit hashes. Occasionally, a
 // new tip is added to the stack of caches, or the tip is flushed and removed.
 //
@@ -103,13 +105,15 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
     bool removed_all_caches = false;
     bool reached_4_caches = false;
     bool added_an_entry = false;
+    bool added_an_unspendable_entry = false;
     bool removed_an_entry = false;
     bool updated_an_entry = false;
     bool found_an_entry = false;
     bool missed_an_entry = false;
+    bool uncached_an_entry = false;
 
     // A simple map to track what we expect the cache stack to represent.
-    std::map<uint256, CCoins> result;
+    std::map<COutPoint, Coin> result;
 
     // The cache stack.
     CCoinsViewTest base; // A CCoinsViewTest at the bottom.
@@ -127,36 +131,65 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
         // Do a random modification.
         {
             uint256 txid = txids[insecure_rand() % txids.size()]; // txid we're going to modify in this iteration.
-            CCoins& coins = result[txid];
-            CCoinsModifier entry = stack.back()->ModifyCoins(txid);
-            BOOST_CHECK(coins == *entry);
-            if (insecure_rand() % 5 == 0 || coins.IsPruned()) {
-                if (coins.IsPruned()) {
-                    added_an_entry = true;
+            COutPoint outpoint(txid, 0);
+            Coin& coin = result[outpoint];
+
+            // HaveCoin and AccessCoin can both pull the coin into the cache, test them in either order
+            bool fHaveCoinFirst = insecure_rand() % 2 == 0;
+            bool fHaveCoin = fHaveCoinFirst ? stack.back()->HaveCoin(outpoint) : false;
+            const Coin& entry = (insecure_rand() % 500 == 0) ? AccessByTxid(*stack.back(), txid) : stack.back()->AccessCoin(outpoint);
+            BOOST_CHECK(coin == entry);
+            if (!fHaveCoinFirst)
+                fHaveCoin = stack.back()->HaveCoin(outpoint);
+            BOOST_CHECK(fHaveCoin == !entry.IsSpent());
+
+            if (insecure_rand() % 5 == 0 || coin.IsSpent()) {
+                Coin newcoin;
+                newcoin.out.nValue = insecure_rand();
+                newcoin.nHeight = 1;
+                if (insecure_rand() % 16 == 0 && coin.IsSpent()) {
+                    // unspendable outputs never make it into the cache
+                    newcoin.out.scriptPubKey.assign(1 + insecure_rand() % 64, OP_RETURN);
+                    BOOST_CHECK(newcoin.out.scriptPubKey.IsUnspendable());
+                    added_an_unspendable_entry = true;
                 } else {
-                    updated_an_entry = true;
+                    // Random sizes so we can test memory usage accounting
+                    newcoin.out.scriptPubKey.assign(insecure_rand() % 64, 0);
+                    if (coin.IsSpent()) {
+                        added_an_entry = true;
+                    } else {
+                        updated_an_entry = true;
+                    }
+                    coin = newcoin;
                 }
-                coins.nVersion = insecure_rand();
-                coins.vout.resize(1);
-                coins.vout[0].nValue = insecure_rand();
-                *entry = coins;
+                stack.back()->AddCoin(outpoint, newcoin, !coin.IsSpent() || insecure_rand() % 2);
             } else {
-                coins.Clear();
-                entry->Clear();
                 removed_an_entry = true;
+                coin.Clear();
+                stack.back()->SpendCoin(outpoint);
             }
         }
 
+        // Once every 10 iterations, remove a random entry from the cache
+        if (insecure_rand() % 10 == 0) {
+            COutPoint outpoint(txids[insecure_rand() % txids.size()], 0);
+            unsigned int nCache = insecure_rand() % stack.size();
+            stack[nCache]->Uncache(outpoint);
+            uncached_an_entry |= !stack[nCache]->HaveCoinInCache(outpoint);
+        }
+
         // Once every 1000 iterations and at the end, verify the full cache.
         if (insecure_rand() % 1000 == 1 || i == NUM_SIMULATION_ITERATIONS - 1) {
-            for (std::map<uint256, CCoins>::iterator it = result.begin(); it != result.end(); it++) {
-                const CCoins* coins = stack.back()->AccessCoins(it->first);
-                if (coins) {
-                    BOOST_CHECK(*coins == it->second);
-                    found_an_entry = true;
-                } else {
-                    BOOST_CHECK(it->second.IsPruned());
+            for (std::map<COutPoint, Coin>::iterator it = result.begin(); it != result.end(); it++) {
+                bool fHave = stack.back()->HaveCoin(it->first);
+                const Coin& coin = stack.back()->AccessCoin(it->first);
+                BOOST_CHECK(fHave == !coin.IsSpent());
+                BOOST_CHECK(coin == it->second);
+                if (coin.IsSpent()) {
                     missed_an_entry = true;
+                } else {
+                    BOOST_CHECK(stack.back()->HaveCoinInCache(it->first));
+                    found_an_entry = true;
                 }
             }
             BOOST_FOREACH(const CCoinsViewCacheTest *test, stack) {
@@ -205,10 +238,12 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
     BOOST_CHECK(removed_all_caches);
     BOOST_CHECK(reached_4_caches);
     BOOST_CHECK(added_an_entry);
+    BOOST_CHECK(added_an_unspendable_entry);
     BOOST_CHECK(removed_an_entry);
     BOOST_CHECK(updated_an_entry);
     BOOST_CHECK(found_an_entry);
     BOOST_CHECK(missed_an_entry);
+    BOOST_CHECK(uncached_an_entry);
 }
 
 // This test is similar to the previous test
@@ -220,7 +255,7 @@ BOOST_AUTO_TEST_CASE(updatecoins_simulation_test)
 {
     bool spent_a_duplicate_coinbase = false;
     // A simple map to track what we expect the cache stack to represent.
-    std::map<uint256, CCoins> result;
+    std::map<COutPoint, Coin> result;
 
     // The cache stack.
     CCoinsViewTest base; // A CCoinsViewTest at the bottom.
@@ -272,9 +307,8 @@ BOOST_AUTO_TEST_CASE(updatecoins_simulation_test)
                 tx.vin[0].prevout.hash = prevouthash;
                 tx.vin[0].prevout.n = 0;
 
-                // Update the expected result of prevouthash to know these coins are spent
-                CCoins& oldcoins = result[prevouthash];
-                oldcoins.Clear();
+                // Update the expected result of prevouthash to know this coin is spent
+                result[tx.vin[0].prevout].Clear();
 
                 // It is of particular importance here that once we spend a coinbase tx hash
                 // it is no longer available to be duplicated (or spent again)
@@ -293,9 +327,8 @@ BOOST_AUTO_TEST_CASE(updatecoins_simulation_test)
             // Track this tx to possibly spend later
             alltxids.insert(tx.GetHash());
 
-            // Update the expected result to know about the new output coins
-            CCoins &coins = result[tx.GetHash()];
-            coins.FromTx(tx, height);
+            // Update the expected result to know about the new output coin
+            result[COutPoint(tx.GetHash(), 0)] = Coin(tx.vout[0], height, CTransaction(tx).IsCoinBase());
 
             CValidationState dummy;
             UpdateCoins(tx, dummy, *(stack.back()), height);
@@ -303,13 +336,10 @@ BOOST_AUTO_TEST_CASE(updatecoins_simulation_test)
 
         // Once every 1000 iterations and at the end, verify the full cache.
         if (insecure_rand() % 1000 == 1 || i == NUM_SIMULATION_ITERATIONS - 1) {
-            for (std::map<uint256, CCoins>::iterator it = result.begin(); it != result.end(); it++) {
-                const CCoins* coins = stack.back()->AccessCoins(it->first);
-                if (coins) {
-                    BOOST_CHECK(*coins == it->second);
-                 } else {
-                    BOOST_CHECK(it->second.IsPruned());
-                 }
+            for (std::map<COutPoint, Coin>::iterator it = result.begin(); it != result.end(); it++) {
+                const Coin& coin = stack.back()->AccessCoin(it->first);
+                BOOST_CHECK(coin == it->second);
+                BOOST_CHECK(stack.back()->HaveCoin(it->first) == !it->second.IsSpent());
             }
         }
 
@@ -347,4 +377,52 @@ BOOST_AUTO_TEST_CASE(updatecoins_simulation_test)
     BOOST_CHECK(spent_a_duplicate_coinbase);
 }
 
+
+BOOST_AUTO_TEST_CASE(coin_serialization)
+{
+    Coin coin(CTxOut(50 * COIN, CScript() << OP_TRUE), 120891, true);
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << coin;
+    BOOST_CHECK_EQUAL(ss.size(), ::GetSerializeSize(coin, SER_DISK, CLIENT_VERSION));
+
+    Coin coinRead;
+    ss >> coinRead;
+    BOOST_CHECK(coinRead == coin);
+    BOOST_CHECK(coinRead.IsCoinBase());
+    BOOST_CHECK_EQUAL(coinRead.nHeight, 120891);
+    BOOST_CHECK(ss.empty());
+}
+
+// Undo records written before coins were stored per output carry the version
+// of the spent transaction, make sure they still read back
+BOOST_AUTO_TEST_CASE(txundo_legacy_format)
+{
+    CTxOut txout(10 * COIN, CScript() << OP_TRUE);
+    CDataStream ssLegacy(SER_DISK, CLIENT_VERSION);
+    WriteCompactSize(ssLegacy, 2);
+    // last spend of a tx at height 5, version 2
+    unsigned int nCode = 5 * 2;
+    int nTxVersion = 2;
+    ssLegacy << VARINT(nCode) << VARINT(nTxVersion) << CTxOutCompressor(txout);
+    // spend of a tx which still had unspent outputs, no height nor version
+    nCode = 0;
+    ssLegacy << VARINT(nCode) << CTxOutCompressor(txout);
+
+    CTxUndo txundo;
+    ssLegacy >> txundo;
+    BOOST_CHECK(ssLegacy.empty());
+    BOOST_CHECK_EQUAL(txundo.vprevout.size(), 2);
+    BOOST_CHECK(txundo.vprevout[0] == Coin(txout, 5, false));
+    BOOST_CHECK_EQUAL(txundo.vprevout[1].nHeight, 0);
+    BOOST_CHECK(txundo.vprevout[1].out == txout);
+
+    // written back in the same format, so older versions can still disconnect these blocks
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << txundo;
+    CTxUndo txundoRead;
+    ss >> txundoRead;
+    BOOST_CHECK(txundoRead.vprevout[0] == txundo.vprevout[0]);
+    BOOST_CHECK(txundoRead.vprevout[1].out == txout);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
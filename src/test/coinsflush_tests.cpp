@@ -0,0 +1,96 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coinsflush.h"
+#include "random.h"
+#include "txdb.h"
+
+#include "test/test_3dcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(coinsflush_tests, BasicTestingSetup)
+
+static void FlushCoins(CCoinsView& view, const std::vector<COutPoint>& vOutPoints, bool fSpend, const uint256& hashBlock)
+{
+    CCoinsMap mapCoins;
+    for (size_t i = 0; i < vOutPoints.size(); i++) {
+        CCoinsCacheEntry& entry = mapCoins[vOutPoints[i]];
+        if (!fSpend)
+            entry.coin = Coin(CTxOut(i + 1, CScript() << OP_TRUE), 10, false);
+        entry.flags = CCoinsCacheEntry::DIRTY;
+    }
+    BOOST_CHECK(view.BatchWrite(mapCoins, hashBlock));
+    BOOST_CHECK(mapCoins.empty());
+}
+
+BOOST_AUTO_TEST_CASE(flush_background)
+{
+    CCoinsViewDB db(1 << 20, true);
+    CCoinsViewFlusher flusher(&db, &db, true);
+
+    std::vector<COutPoint> vOutPoints;
+    for (int i = 0; i < 1000; i++)
+        vOutPoints.push_back(COutPoint(GetRandHash(), i));
+    uint256 hashBlock1 = GetRandHash();
+    FlushCoins(flusher, vOutPoints, false, hashBlock1);
+
+    // readable through the flusher whether or not the write is done
+    Coin coin;
+    BOOST_CHECK(flusher.GetCoin(vOutPoints[5], coin));
+    BOOST_CHECK_EQUAL(coin.out.nValue, 6);
+    BOOST_CHECK(flusher.HaveCoin(vOutPoints[999]));
+    BOOST_CHECK(flusher.GetBestBlock() == hashBlock1);
+    // what is on disk only moves to the block once written
+    uint256 hashWritten = flusher.GetWrittenBestBlock();
+    BOOST_CHECK(hashWritten.IsNull() || hashWritten == hashBlock1);
+
+    BOOST_CHECK(flusher.Sync());
+    BOOST_CHECK(flusher.GetWrittenBestBlock() == hashBlock1);
+    BOOST_CHECK(db.GetCoin(vOutPoints[5], coin));
+    BOOST_CHECK_EQUAL(coin.out.nValue, 6);
+    BOOST_CHECK(db.GetBestBlock() == hashBlock1);
+
+    // spending them again, the next flush waits for nothing and the spent
+    // coins are gone through the flusher right away
+    std::vector<COutPoint> vSpent(vOutPoints.begin(), vOutPoints.begin() + 10);
+    uint256 hashBlock2 = GetRandHash();
+    FlushCoins(flusher, vSpent, true, hashBlock2);
+    BOOST_CHECK(!flusher.GetCoin(vOutPoints[5], coin));
+    BOOST_CHECK(!flusher.HaveCoin(vOutPoints[9]));
+    BOOST_CHECK(flusher.HaveCoin(vOutPoints[10]));
+    BOOST_CHECK(flusher.GetBestBlock() == hashBlock2);
+
+    BOOST_CHECK(flusher.Sync());
+    BOOST_CHECK(!db.HaveCoin(vOutPoints[5]));
+    BOOST_CHECK(db.HaveCoin(vOutPoints[10]));
+    BOOST_CHECK(db.GetBestBlock() == hashBlock2);
+
+    CCoinsFlushStats stats = flusher.GetFlushStats();
+    BOOST_CHECK_EQUAL(stats.nFlushes, 2);
+    BOOST_CHECK(stats.fBackground);
+    BOOST_CHECK(!stats.fWriting);
+}
+
+BOOST_AUTO_TEST_CASE(flush_synchronous)
+{
+    CCoinsViewDB db(1 << 20, true);
+    CCoinsViewFlusher flusher(&db, &db, false);
+
+    std::vector<COutPoint> vOutPoints;
+    for (int i = 0; i < 10; i++)
+        vOutPoints.push_back(COutPoint(GetRandHash(), i));
+    uint256 hashBlock = GetRandHash();
+    FlushCoins(flusher, vOutPoints, false, hashBlock);
+
+    // written before BatchWrite returns
+    Coin coin;
+    BOOST_CHECK(db.GetCoin(vOutPoints[3], coin));
+    BOOST_CHECK_EQUAL(coin.out.nValue, 4);
+    BOOST_CHECK(db.GetBestBlock() == hashBlock);
+    BOOST_CHECK_EQUAL(flusher.GetFlushStats().nFlushes, 1);
+    BOOST_CHECK(!flusher.GetFlushStats().fBackground);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,152 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coinsprefetch.h"
+#include "primitives/block.h"
+#include "random.h"
+#include "utiltime.h"
+
+#include "test/test_3dcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+/** Thread safe view counting its reads, standing in for the chainstate db */
+class CCoinsViewPrefetchTest : public CCoinsView
+{
+    mutable boost::mutex mutex;
+    std::map<COutPoint, Coin> mapCoins;
+    mutable int nReads;
+
+public:
+    CCoinsViewPrefetchTest() : nReads(0) {}
+
+    bool GetCoin(const COutPoint& outpoint, Coin& coin) const
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nReads++;
+        std::map<COutPoint, Coin>::const_iterator it = mapCoins.find(outpoint);
+        if (it == mapCoins.end())
+            return false;
+        coin = it->second;
+        return true;
+    }
+
+    bool BatchWrite(CCoinsMap& mapCoinsIn, const uint256& hashBlock)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        for (CCoinsMap::iterator it = mapCoinsIn.begin(); it != mapCoinsIn.end(); it++) {
+            if (it->second.coin.IsSpent())
+                mapCoins.erase(it->first);
+            else
+                mapCoins[it->first] = it->second.coin;
+        }
+        mapCoinsIn.clear();
+        return true;
+    }
+
+    void Add(const COutPoint& outpoint, const Coin& coin)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        mapCoins[outpoint] = coin;
+    }
+
+    /** Waits for the prefetch threads to have done nReadsExpected reads */
+    bool WaitForReads(int nReadsExpected) const
+    {
+        for (int i = 0; i < 1000; i++) {
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                if (nReads >= nReadsExpected)
+                    return true;
+            }
+            MilliSleep(10);
+        }
+        return false;
+    }
+};
+
+}
+
+BOOST_FIXTURE_TEST_SUITE(coinsprefetch_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(prefetch_outpoints)
+{
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vout.push_back(CTxOut(50 * COIN, CScript() << OP_TRUE));
+
+    CMutableTransaction tx1;
+    tx1.vin.push_back(CTxIn(COutPoint(GetRandHash(), 0)));
+    tx1.vin.push_back(CTxIn(COutPoint(GetRandHash(), 3)));
+    tx1.vout.push_back(CTxOut(COIN, CScript() << OP_TRUE));
+
+    // spends an output of tx1, which is not in the coins db yet
+    CMutableTransaction tx2;
+    tx2.vin.push_back(CTxIn(COutPoint(tx1.GetHash(), 0)));
+    tx2.vout.push_back(CTxOut(COIN, CScript() << OP_TRUE));
+
+    CBlock block;
+    block.vtx.push_back(coinbase);
+    block.vtx.push_back(tx1);
+    block.vtx.push_back(tx2);
+
+    std::vector<COutPoint> vOutPoints;
+    GetPrefetchOutPoints(block, vOutPoints);
+    BOOST_CHECK_EQUAL(vOutPoints.size(), 2);
+    BOOST_CHECK(vOutPoints[0] == tx1.vin[0].prevout);
+    BOOST_CHECK(vOutPoints[1] == tx1.vin[1].prevout);
+}
+
+BOOST_AUTO_TEST_CASE(prefetch_hits_and_invalidation)
+{
+    CCoinsViewPrefetchTest base;
+    CCoinsViewPrefetch prefetch(&base, 2);
+
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vout.push_back(CTxOut(50 * COIN, CScript() << OP_TRUE));
+    CMutableTransaction tx;
+    CBlock block;
+    block.vtx.push_back(coinbase);
+    for (int i = 0; i < 100; i++) {
+        COutPoint outpoint(GetRandHash(), i);
+        base.Add(outpoint, Coin(CTxOut(i + 1, CScript() << OP_TRUE), 10, false));
+        tx.vin.push_back(CTxIn(outpoint));
+    }
+    tx.vout.push_back(CTxOut(COIN, CScript() << OP_TRUE));
+    block.vtx.push_back(tx);
+
+    prefetch.Prefetch(block);
+    BOOST_CHECK(base.WaitForReads(100));
+    // the reads are done, wait for the last chunk to be stored
+    MilliSleep(100);
+
+    // served from memory, once
+    Coin coin;
+    BOOST_CHECK(prefetch.GetCoin(tx.vin[5].prevout, coin));
+    BOOST_CHECK_EQUAL(coin.out.nValue, 6);
+    uint64_t nHits, nMisses;
+    prefetch.GetCounters(nHits, nMisses);
+    BOOST_CHECK_EQUAL(nHits, 1);
+    BOOST_CHECK_EQUAL(nMisses, 0);
+    BOOST_CHECK(prefetch.GetCoin(tx.vin[5].prevout, coin));
+    prefetch.GetCounters(nHits, nMisses);
+    BOOST_CHECK_EQUAL(nHits, 1);
+    BOOST_CHECK_EQUAL(nMisses, 1);
+
+    // a write drops the prefetched coins it changes
+    CCoinsMap mapWrite;
+    mapWrite[tx.vin[7].prevout].flags = CCoinsCacheEntry::DIRTY;
+    BOOST_CHECK(prefetch.BatchWrite(mapWrite, uint256()));
+    BOOST_CHECK(!prefetch.GetCoin(tx.vin[7].prevout, coin));
+    BOOST_CHECK(prefetch.GetCoin(tx.vin[8].prevout, coin));
+    BOOST_CHECK_EQUAL(coin.out.nValue, 9);
+    prefetch.GetCounters(nHits, nMisses);
+    BOOST_CHECK_EQUAL(nHits, 2);
+    BOOST_CHECK_EQUAL(nMisses, 2);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
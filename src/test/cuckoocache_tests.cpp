@@ -0,0 +1,98 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "cuckoocache.h"
+#include "random.h"
+
+#include "test/test_3dcoin.h"
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(cuckoocache_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(cuckoocache_insert_erase)
+{
+    CCuckooCache cache(1 << 16);
+    BOOST_CHECK_EQUAL(cache.GetMemoryUsage(), 1 << 16);
+    BOOST_CHECK_EQUAL(cache.GetCapacity(), (1 << 16) / 128 * CUCKOO_BUCKET_SLOTS);
+
+    std::vector<uint256> vEntries;
+    for (int i = 0; i < 100; i++) {
+        vEntries.push_back(GetRandHash());
+        cache.Insert(vEntries.back());
+    }
+    for (int i = 0; i < 100; i++)
+        BOOST_CHECK(cache.Contains(vEntries[i], false));
+    BOOST_CHECK(!cache.Contains(GetRandHash(), false));
+
+    // erase on hit
+    BOOST_CHECK(cache.Contains(vEntries[7], true));
+    BOOST_CHECK(!cache.Contains(vEntries[7], false));
+    BOOST_CHECK(cache.Contains(vEntries[8], false));
+
+    // nothing fits into an empty cache
+    CCuckooCache cacheEmpty(0);
+    cacheEmpty.Insert(vEntries[0]);
+    BOOST_CHECK(!cacheEmpty.Contains(vEntries[0], false));
+}
+
+BOOST_AUTO_TEST_CASE(cuckoocache_fill)
+{
+    // most of what fits is kept, the newest entries always are
+    CCuckooCache cache(1 << 16);
+    size_t nCapacity = cache.GetCapacity();
+    std::vector<uint256> vEntries;
+    for (size_t i = 0; i < nCapacity * 2; i++) {
+        vEntries.push_back(GetRandHash());
+        cache.Insert(vEntries.back());
+    }
+    size_t nFound = 0;
+    for (size_t i = 0; i < vEntries.size(); i++)
+        nFound += cache.Contains(vEntries[i], false);
+    BOOST_CHECK(nFound <= nCapacity);
+    BOOST_CHECK(nFound > nCapacity * 9 / 10);
+    BOOST_CHECK(cache.Contains(vEntries.back(), false));
+
+    // below the capacity next to nothing is lost
+    CCuckooCache cacheHalf(1 << 16);
+    for (size_t i = 0; i < nCapacity / 2; i++)
+        cacheHalf.Insert(vEntries[i]);
+    nFound = 0;
+    for (size_t i = 0; i < nCapacity / 2; i++)
+        nFound += cacheHalf.Contains(vEntries[i], false);
+    BOOST_CHECK(nFound >= nCapacity / 2 - 1);
+}
+
+static void LookupAll(const CCuckooCache* pcache, const std::vector<uint256>* pvEntries, size_t* pnFound)
+{
+    for (int n = 0; n < 20; n++)
+        for (size_t i = 0; i < pvEntries->size(); i++)
+            *pnFound += pcache->Contains((*pvEntries)[i], false);
+}
+
+BOOST_AUTO_TEST_CASE(cuckoocache_concurrent)
+{
+    // entries which are not moved around are always found, even while
+    // other entries are inserted
+    CCuckooCache cache(1 << 20);
+    std::vector<uint256> vEntries;
+    for (int i = 0; i < 1000; i++) {
+        vEntries.push_back(GetRandHash());
+        cache.Insert(vEntries.back());
+    }
+    std::vector<size_t> vFound(4, 0);
+    boost::thread_group threadGroup;
+    for (int i = 0; i < 4; i++)
+        threadGroup.create_thread(boost::bind(&LookupAll, &cache, &vEntries, &vFound[i]));
+    for (int i = 0; i < 1000; i++)
+        cache.Insert(GetRandHash());
+    threadGroup.join_all();
+    // a lookup racing with a write to the same bucket may miss
+    for (int i = 0; i < 4; i++)
+        BOOST_CHECK(vFound[i] > 20 * vEntries.size() * 99 / 100);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
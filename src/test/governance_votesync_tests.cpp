@@ -0,0 +1,146 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "governance-votesync.h"
+
+#include "test/test_3dcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(governance_votesync_tests, BasicTestingSetup)
+
+static uint256 ObjectHash(int n)
+{
+    uint256 nHash;
+    *nHash.begin() = (unsigned char)n;
+    return nHash;
+}
+
+static std::vector<CGovernanceVoteSync::peer_info_t> MakePeers(int nCount)
+{
+    std::vector<CGovernanceVoteSync::peer_info_t> vPeers;
+    for(int i = 0; i < nCount; ++i) {
+        vPeers.push_back(CGovernanceVoteSync::peer_info_t(i, CService(strprintf("1.2.3.%d", i + 1), 9999), 0));
+    }
+    return vPeers;
+}
+
+BOOST_AUTO_TEST_CASE(votesync_priority_and_pipelining)
+{
+    CGovernanceVoteSync sync;
+
+    sync.AddObject(ObjectHash(1), false, 100);
+    sync.AddObject(ObjectHash(2), false, 200);
+    sync.AddObject(ObjectHash(3), true, 50);
+    BOOST_CHECK_EQUAL(sync.GetQueueSize(), 3);
+
+    // one peer, two requests in flight: trigger first, then the newest object
+    std::vector<CGovernanceVoteSync::peer_info_t> vPeers = MakePeers(1);
+    std::vector<CGovernanceVoteSync::request_t> vecRequests = sync.Schedule(vPeers, 1000, 2, 1);
+    BOOST_CHECK_EQUAL(vecRequests.size(), 2U);
+    BOOST_CHECK(vecRequests[0].nHash == ObjectHash(3));
+    BOOST_CHECK(vecRequests[1].nHash == ObjectHash(2));
+    BOOST_CHECK_EQUAL(sync.GetInFlight(0), 2);
+    BOOST_CHECK_EQUAL(sync.GetQueueSize(), 1);
+
+    // budget is exhausted until a reply arrives
+    BOOST_CHECK(sync.Schedule(vPeers, 1100, 2, 1).empty());
+
+    sync.ResponseReceived(0, ObjectHash(3), 1400);
+    BOOST_CHECK_EQUAL(sync.GetInFlight(0), 1);
+    BOOST_CHECK_EQUAL(sync.GetLatency(0), 400);
+
+    vecRequests = sync.Schedule(vPeers, 1500, 2, 1);
+    BOOST_CHECK_EQUAL(vecRequests.size(), 1U);
+    BOOST_CHECK(vecRequests[0].nHash == ObjectHash(1));
+    BOOST_CHECK_EQUAL(sync.GetQueueSize(), 0);
+
+    // the same peer is not asked for the same object again until the delay passes
+    sync.ResponseReceived(0, ObjectHash(2), 1600);
+    sync.ResponseReceived(0, ObjectHash(1), 1700);
+    BOOST_CHECK(sync.Schedule(vPeers, 2000, 2, 1).empty());
+    vecRequests = sync.Schedule(vPeers, 1000 + CGovernanceVoteSync::REASK_DELAY, 2, 1);
+    BOOST_CHECK_EQUAL(vecRequests.size(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(votesync_replies_by_hash)
+{
+    CGovernanceVoteSync sync;
+
+    sync.AddObject(ObjectHash(1), false, 100);
+    sync.AddObject(ObjectHash(2), false, 200);
+    sync.AddObject(ObjectHash(3), false, 300);
+
+    std::vector<CGovernanceVoteSync::peer_info_t> vPeers = MakePeers(1);
+    BOOST_CHECK_EQUAL(sync.Schedule(vPeers, 1000, 3, 1).size(), 3U);
+
+    // a reply for an object we didn't ask this peer for completes nothing
+    sync.ResponseReceived(0, ObjectHash(4), 1100);
+    sync.ResponseReceived(1, ObjectHash(3), 1100);
+    BOOST_CHECK_EQUAL(sync.GetInFlight(0), 3);
+
+    // replies complete their own request, whatever order they come in
+    sync.ResponseReceived(0, ObjectHash(1), 1200);
+    BOOST_CHECK_EQUAL(sync.GetInFlight(0), 2);
+    BOOST_CHECK_EQUAL(sync.GetLatency(0), 200);
+    sync.ResponseReceived(0, ObjectHash(1), 1300);
+    BOOST_CHECK_EQUAL(sync.GetInFlight(0), 2);
+
+    sync.ResponseReceived(0, ObjectHash(3), 1400);
+    sync.ResponseReceived(0, ObjectHash(2), 1500);
+    BOOST_CHECK_EQUAL(sync.GetInFlight(0), 0);
+}
+
+BOOST_AUTO_TEST_CASE(votesync_changed_objects_first)
+{
+    CGovernanceVoteSync sync;
+
+    sync.AddObject(ObjectHash(1), false, 100);
+    sync.AddObject(ObjectHash(2), false, 200);
+    sync.ObjectChanged(ObjectHash(1), 300);
+
+    std::vector<CGovernanceVoteSync::request_t> vecRequests = sync.Schedule(MakePeers(1), 1000, 1, 1);
+    BOOST_CHECK_EQUAL(vecRequests.size(), 1U);
+    BOOST_CHECK(vecRequests[0].nHash == ObjectHash(1));
+
+    sync.RemoveObject(ObjectHash(2));
+    BOOST_CHECK_EQUAL(sync.GetQueueSize(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(votesync_peers_per_object)
+{
+    CGovernanceVoteSync sync;
+
+    sync.AddObject(ObjectHash(1), false, 100);
+
+    std::vector<CGovernanceVoteSync::peer_info_t> vPeers = MakePeers(5);
+    std::vector<CGovernanceVoteSync::request_t> vecRequests = sync.Schedule(vPeers, 1000, 4, 1);
+    BOOST_CHECK_EQUAL(vecRequests.size(), CGovernanceVoteSync::PEERS_PER_OBJECT_MAX);
+    BOOST_CHECK_EQUAL(sync.GetQueueSize(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(votesync_timeout)
+{
+    CGovernanceVoteSync sync;
+
+    sync.AddObject(ObjectHash(1), false, 100);
+    sync.AddObject(ObjectHash(2), false, 200);
+
+    std::vector<CGovernanceVoteSync::peer_info_t> vPeers = MakePeers(1);
+    BOOST_CHECK_EQUAL(sync.Schedule(vPeers, 1000, 4, 1).size(), 2U);
+
+    // unanswered requests are requeued and the peer is throttled to one request
+    int64_t nNow = 1000 + CGovernanceVoteSync::REQUEST_TIMEOUT;
+    std::vector<CGovernanceVoteSync::request_t> vecRequests = sync.Schedule(vPeers, nNow, 4, 1);
+    BOOST_CHECK_EQUAL(sync.GetInFlight(0), 1);
+    BOOST_CHECK_EQUAL(vecRequests.size(), 1U);
+    BOOST_CHECK_EQUAL(sync.GetQueueSize(), 1);
+
+    // setAskFor limit is respected
+    vPeers[0].nAskForSize = SETASKFOR_MAX_SZ;
+    sync.ResponseReceived(0, ObjectHash(2), nNow);
+    BOOST_CHECK(sync.Schedule(vPeers, nNow, 4, 1).empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
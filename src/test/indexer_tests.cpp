@@ -0,0 +1,172 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "indexer.h"
+#include "key.h"
+#include "script/standard.h"
+#include "undo.h"
+
+#include "test/test_3dcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(indexer_tests, BasicTestingSetup)
+
+struct IndexerTestBlock
+{
+    CBlock block;
+    CBlockUndo blockundo;
+    uint256 hashBlock;
+    CBlockIndex index;
+    COutPoint prevout;
+    CTxOut txoutSpent;
+    uint160 hashSpent;
+    uint160 hashCreated;
+
+    IndexerTestBlock()
+    {
+        CKey key;
+        key.MakeNewKey(true);
+        hashSpent = key.GetPubKey().GetID();
+        CScript scriptCreated = CScript() << OP_TRUE;
+        hashCreated = CScriptID(scriptCreated);
+
+        CMutableTransaction coinbase;
+        coinbase.vin.resize(1);
+        coinbase.vin[0].prevout.SetNull();
+        coinbase.vout.push_back(CTxOut(50 * COIN, CScript() << OP_TRUE));
+        block.vtx.push_back(coinbase);
+
+        prevout = COutPoint(GetRandHash(), 1);
+        txoutSpent = CTxOut(10 * COIN, GetScriptForDestination(key.GetPubKey().GetID()));
+        CMutableTransaction tx;
+        tx.vin.push_back(CTxIn(prevout));
+        tx.vout.push_back(CTxOut(9 * COIN, GetScriptForDestination(CScriptID(scriptCreated))));
+        block.vtx.push_back(tx);
+
+        blockundo.vtxundo.resize(1);
+        blockundo.vtxundo[0].vprevout.push_back(Coin(txoutSpent, 5, false));
+
+        hashBlock = GetRandHash();
+        index.phashBlock = &hashBlock;
+        index.nHeight = 10;
+        index.nTime = 1500000000;
+    }
+};
+
+struct IndexerTestSetup
+{
+    bool fAddressIndexSaved, fSpentIndexSaved, fTimestampIndexSaved;
+
+    IndexerTestSetup() : fAddressIndexSaved(fAddressIndex), fSpentIndexSaved(fSpentIndex), fTimestampIndexSaved(fTimestampIndex)
+    {
+        fAddressIndex = fSpentIndex = fTimestampIndex = true;
+    }
+
+    ~IndexerTestSetup()
+    {
+        fAddressIndex = fAddressIndexSaved;
+        fSpentIndex = fSpentIndexSaved;
+        fTimestampIndex = fTimestampIndexSaved;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(indexer_connected_block)
+{
+    IndexerTestSetup setup;
+    IndexerTestBlock test;
+    const uint256 txhash = test.block.vtx[1].GetHash();
+
+    CIndexBatch batch;
+    BOOST_CHECK(AddConnectedBlockEntries(test.block, test.blockundo, &test.index, batch));
+
+    // spending the P2PKH output and receiving on the P2SH one, the coinbase pays to a script which is not indexed
+    BOOST_CHECK_EQUAL(batch.vAddressIndex.size(), 2);
+    const CAddressIndexKey& keySpent = batch.vAddressIndex[0].first;
+    BOOST_CHECK(keySpent.type == 1 && keySpent.hashBytes == test.hashSpent && keySpent.spending);
+    BOOST_CHECK(keySpent.blockHeight == 10 && keySpent.txhash == txhash && keySpent.index == 0);
+    BOOST_CHECK_EQUAL(batch.vAddressIndex[0].second, -10 * COIN);
+    const CAddressIndexKey& keyCreated = batch.vAddressIndex[1].first;
+    BOOST_CHECK(keyCreated.type == 2 && keyCreated.hashBytes == test.hashCreated && !keyCreated.spending);
+    BOOST_CHECK_EQUAL(batch.vAddressIndex[1].second, 9 * COIN);
+
+    BOOST_CHECK_EQUAL(batch.vAddressUnspentIndex.size(), 2);
+    BOOST_CHECK(batch.vAddressUnspentIndex[0].first.txhash == test.prevout.hash && batch.vAddressUnspentIndex[0].second.IsNull());
+    BOOST_CHECK(batch.vAddressUnspentIndex[1].first.txhash == txhash && batch.vAddressUnspentIndex[1].second.satoshis == 9 * COIN);
+
+    BOOST_CHECK_EQUAL(batch.vSpentIndex.size(), 1);
+    BOOST_CHECK(batch.vSpentIndex[0].first.txid == test.prevout.hash && batch.vSpentIndex[0].first.outputIndex == 1);
+    BOOST_CHECK(batch.vSpentIndex[0].second.txid == txhash && batch.vSpentIndex[0].second.addressHash == test.hashSpent);
+
+    BOOST_CHECK_EQUAL(batch.vTimestampIndex.size(), 1);
+    BOOST_CHECK(batch.vTimestampIndex[0].blockHash == test.hashBlock);
+}
+
+BOOST_AUTO_TEST_CASE(indexer_disconnected_block)
+{
+    IndexerTestSetup setup;
+    IndexerTestBlock test;
+
+    CIndexBatch batchConnect;
+    CIndexBatch batchDisconnect;
+    BOOST_CHECK(AddConnectedBlockEntries(test.block, test.blockundo, &test.index, batchConnect));
+    BOOST_CHECK(AddDisconnectedBlockEntries(test.block, test.blockundo, &test.index, batchDisconnect));
+
+    // the same address index entries get erased
+    BOOST_CHECK_EQUAL(batchDisconnect.vAddressIndex.size(), batchConnect.vAddressIndex.size());
+    for (size_t i = 0; i < batchConnect.vAddressIndex.size(); i++) {
+        bool fFound = false;
+        for (size_t j = 0; j < batchDisconnect.vAddressIndex.size(); j++)
+            fFound |= batchDisconnect.vAddressIndex[j].first.txhash == batchConnect.vAddressIndex[i].first.txhash &&
+                      batchDisconnect.vAddressIndex[j].first.spending == batchConnect.vAddressIndex[i].first.spending;
+        BOOST_CHECK(fFound);
+    }
+
+    // the created output leaves the unspent index, the spent one comes back
+    BOOST_CHECK_EQUAL(batchDisconnect.vAddressUnspentIndex.size(), 2);
+    BOOST_CHECK(batchDisconnect.vAddressUnspentIndex[0].second.IsNull());
+    BOOST_CHECK(batchDisconnect.vAddressUnspentIndex[1].first.txhash == test.prevout.hash);
+    BOOST_CHECK(batchDisconnect.vAddressUnspentIndex[1].second.satoshis == 10 * COIN);
+    BOOST_CHECK(batchDisconnect.vAddressUnspentIndex[1].second.script == test.txoutSpent.scriptPubKey);
+
+    BOOST_CHECK_EQUAL(batchDisconnect.vSpentIndex.size(), 1);
+    BOOST_CHECK(batchDisconnect.vSpentIndex[0].second.IsNull());
+    BOOST_CHECK_EQUAL(batchDisconnect.vTimestampIndex.size(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(indexer_batch_indexes)
+{
+    IndexerTestSetup setup;
+    IndexerTestBlock test;
+
+    // an index built up to the others gets only its own entries
+    CIndexBatch batch;
+    batch.nIndexes = 1 << INDEXER_SPENT;
+    BOOST_CHECK(AddConnectedBlockEntries(test.block, test.blockundo, &test.index, batch));
+    BOOST_CHECK_EQUAL(batch.vSpentIndex.size(), 1);
+    BOOST_CHECK_EQUAL(batch.Size(), 1);
+
+    CIndexBatch batchDisconnect;
+    batchDisconnect.nIndexes = (1 << INDEXER_ADDRESS) | (1 << INDEXER_TIMESTAMP);
+    BOOST_CHECK(AddDisconnectedBlockEntries(test.block, test.blockundo, &test.index, batchDisconnect));
+    BOOST_CHECK(batchDisconnect.vSpentIndex.empty());
+    BOOST_CHECK_EQUAL(batchDisconnect.vAddressIndex.size(), 2);
+    BOOST_CHECK_EQUAL(batchDisconnect.vTimestampIndex.size(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(indexer_inconsistent_undo)
+{
+    IndexerTestSetup setup;
+    IndexerTestBlock test;
+
+    CIndexBatch batch;
+    test.blockundo.vtxundo[0].vprevout.push_back(Coin(test.txoutSpent, 5, false));
+    BOOST_CHECK(!AddConnectedBlockEntries(test.block, test.blockundo, &test.index, batch));
+    BOOST_CHECK(!AddDisconnectedBlockEntries(test.block, test.blockundo, &test.index, batch));
+
+    test.blockundo.vtxundo.clear();
+    BOOST_CHECK(!AddConnectedBlockEntries(test.block, test.blockundo, &test.index, batch));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
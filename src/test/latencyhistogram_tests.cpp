@@ -0,0 +1,61 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "latencyhistogram.h"
+
+#include "test/test_3dcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(latencyhistogram_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(latencyhistogram_buckets)
+{
+    // small values get exact buckets
+    for(int i = 0; i < CLatencyHistogram::SUB_BUCKETS; ++i) {
+        BOOST_CHECK_EQUAL(CLatencyHistogram::GetBucket(i), i);
+    }
+
+    // buckets are monotonic and every value falls between its bucket bounds
+    int64_t vecValues[] = {8, 9, 15, 16, 18, 100, 1000, 123456, 1LL << 40, (1LL << 62) + 12345, INT64_MAX};
+    int nPrevBucket = -1;
+    for(size_t i = 0; i < sizeof(vecValues) / sizeof(vecValues[0]); ++i) {
+        int nBucket = CLatencyHistogram::GetBucket(vecValues[i]);
+        BOOST_CHECK(nBucket > nPrevBucket);
+        BOOST_CHECK(nBucket < CLatencyHistogram::BUCKETS);
+        BOOST_CHECK(CLatencyHistogram::GetBucketLowerBound(nBucket) <= vecValues[i]);
+        if(nBucket + 1 < CLatencyHistogram::BUCKETS) {
+            BOOST_CHECK(CLatencyHistogram::GetBucketLowerBound(nBucket + 1) > vecValues[i]);
+        }
+        nPrevBucket = nBucket;
+    }
+    BOOST_CHECK_EQUAL(CLatencyHistogram::GetBucket(INT64_MAX), CLatencyHistogram::BUCKETS - 1);
+}
+
+BOOST_AUTO_TEST_CASE(latencyhistogram_percentiles)
+{
+    CLatencyHistogram hist;
+    BOOST_CHECK_EQUAL(hist.GetPercentile(50), 0);
+
+    for(int i = 1; i <= 1000; ++i) {
+        hist.Add(i * 1000);
+    }
+    hist.Add(-5);
+
+    BOOST_CHECK_EQUAL(hist.GetCount(), 1001U);
+    BOOST_CHECK_EQUAL(hist.GetMax(), 1000000);
+
+    // within the relative error of one sub-bucket
+    int64_t p50 = hist.GetPercentile(50);
+    int64_t p99 = hist.GetPercentile(99);
+    BOOST_CHECK(p50 > 500000 * 7 / 8 && p50 < 500000 * 9 / 8);
+    BOOST_CHECK(p99 > 990000 * 7 / 8 && p99 <= 1000000);
+    BOOST_CHECK_EQUAL(hist.GetPercentile(100), 1000000);
+
+    hist.Clear();
+    BOOST_CHECK_EQUAL(hist.GetCount(), 0U);
+    BOOST_CHECK_EQUAL(hist.GetPercentile(99), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
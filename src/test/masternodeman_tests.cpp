@@ -0,0 +1,82 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "clientversion.h"
+#include "masternode/man.h"
+#include "random.h"
+#include "streams.h"
+#include "utiltime.h"
+
+#include "test/test_3dcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(masternodeman_tests, TestingSetup)
+
+static CTxIn AddMasternode()
+{
+    CMasternode mn;
+    mn.vin = CTxIn(COutPoint(GetRandHash(), 0));
+    mn.fUnitTest = true;
+    BOOST_CHECK(mnodeman.Add(mn));
+    return mn.vin;
+}
+
+static int64_t LastChecked(const CTxIn& vin)
+{
+    CMasternode* pmn = mnodeman.Find(vin);
+    BOOST_REQUIRE(pmn != NULL);
+    return pmn->nTimeLastChecked;
+}
+
+BOOST_AUTO_TEST_CASE(masternodeman_checkdue)
+{
+    int64_t nStart = 1500000000;
+    SetMockTime(nStart);
+
+    // new masternodes are checked on the next run
+    std::vector<CTxIn> vecVins;
+    for(int i = 0; i < 3; i++) {
+        vecVins.push_back(AddMasternode());
+    }
+    mnodeman.CheckDue();
+    for(size_t i = 0; i < vecVins.size(); i++) {
+        BOOST_CHECK_EQUAL(LastChecked(vecVins[i]), nStart);
+    }
+
+    // a masternode added later is due on its own schedule
+    SetMockTime(nStart + 2);
+    CTxIn vinLate = AddMasternode();
+    mnodeman.CheckDue();
+    BOOST_CHECK_EQUAL(LastChecked(vinLate), nStart + 2);
+    BOOST_CHECK_EQUAL(LastChecked(vecVins[0]), nStart);
+
+    SetMockTime(nStart + MASTERNODE_CHECK_SECONDS);
+    mnodeman.CheckDue();
+    for(size_t i = 0; i < vecVins.size(); i++) {
+        BOOST_CHECK_EQUAL(LastChecked(vecVins[i]), nStart + MASTERNODE_CHECK_SECONDS);
+    }
+    BOOST_CHECK_EQUAL(LastChecked(vinLate), nStart + 2);
+
+    SetMockTime(nStart + 2 + MASTERNODE_CHECK_SECONDS);
+    mnodeman.CheckDue();
+    BOOST_CHECK_EQUAL(LastChecked(vinLate), nStart + 2 + MASTERNODE_CHECK_SECONDS);
+
+    // the deadlines are rebuilt after the list was loaded
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << mnodeman;
+    mnodeman.Clear();
+    ss >> mnodeman;
+    SetMockTime(nStart + 2 * MASTERNODE_CHECK_SECONDS);
+    mnodeman.CheckDue();
+    for(size_t i = 0; i < vecVins.size(); i++) {
+        BOOST_CHECK_EQUAL(LastChecked(vecVins[i]), nStart + 2 * MASTERNODE_CHECK_SECONDS);
+    }
+    BOOST_CHECK_EQUAL(LastChecked(vinLate), nStart + 2 + MASTERNODE_CHECK_SECONDS);
+
+    mnodeman.Clear();
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,199 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "snapshot.h"
+#include "arith_uint256.h"
+#include "chainparams.h"
+#include "clientversion.h"
+#include "consensus/merkle.h"
+#include "consensus/validation.h"
+#include "main.h"
+#include "net.h"
+#include "pow.h"
+#include "streams.h"
+#include "txdb.h"
+
+#include "test/test_3dcoin.h"
+
+#include <stdio.h>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(snapshot_tests, TestChain100Setup)
+
+BOOST_AUTO_TEST_CASE(snapshot_roundtrip)
+{
+    std::vector<CBlockHeader> vHeaders;
+    {
+        LOCK(cs_main);
+        FlushStateToDisk();
+        for (int i = 1; i <= chainActive.Height(); i++)
+            vHeaders.push_back(chainActive[i]->GetBlockHeader());
+    }
+    CCoinsStats stats;
+    BOOST_CHECK(pcoinsdbview->GetStats(stats));
+
+    boost::filesystem::path path = pathTemp / "utxo.dat";
+    CUTXOSnapshotMetadata metadata;
+    memcpy(metadata.pchMessageStart, Params().MessageStart(), sizeof(metadata.pchMessageStart));
+    uint256 hashContent;
+    std::string strError;
+    {
+        CAutoFile file(fopen(path.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+        boost::scoped_ptr<CCoinsViewDBCursor> pcursor(pcoinsdbview->Cursor());
+        BOOST_CHECK(pcursor->GetBestBlock() == chainActive.Tip()->GetBlockHash());
+        BOOST_CHECK(WriteUTXOSnapshot(file, metadata, vHeaders, pcursor.get(), hashContent, strError));
+    }
+    BOOST_CHECK(metadata.hashBaseBlock == chainActive.Tip()->GetBlockHash());
+    BOOST_CHECK_EQUAL(metadata.nHeaders, 100);
+    BOOST_CHECK_EQUAL(metadata.nCoins, stats.nTransactionOutputs);
+
+    // read back into an empty chainstate
+    CCoinsViewDB viewDest(1 << 20, true);
+    {
+        CAutoFile file(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+        CUTXOSnapshotMetadata metadataRead;
+        file >> metadataRead;
+        BOOST_CHECK(metadataRead.hashBaseBlock == metadata.hashBaseBlock);
+        BOOST_CHECK_EQUAL(metadataRead.nCoins, metadata.nCoins);
+        std::vector<CBlockHeader> vHeadersRead;
+        BOOST_CHECK(ReadUTXOSnapshotHeaders(file, metadataRead, vHeadersRead, strError));
+        BOOST_CHECK_EQUAL(vHeadersRead.size(), vHeaders.size());
+        BOOST_CHECK(vHeadersRead.front().GetHash() == vHeaders.front().GetHash());
+        uint256 hashRead;
+        BOOST_CHECK(ReadUTXOSnapshotCoins(file, metadataRead, &viewDest, hashRead, strError));
+        BOOST_CHECK(hashRead == hashContent);
+    }
+    BOOST_CHECK(viewDest.GetBestBlock() == metadata.hashBaseBlock);
+    boost::scoped_ptr<CCoinsViewDBCursor> pcursor(pcoinsdbview->Cursor());
+    for (; pcursor->Valid(); pcursor->Next()) {
+        COutPoint outpoint;
+        Coin coin, coinDest;
+        BOOST_CHECK(pcursor->GetKey(outpoint) && pcursor->GetValue(coin));
+        BOOST_CHECK(viewDest.GetCoin(outpoint, coinDest));
+        BOOST_CHECK(coinDest.out == coin.out);
+        BOOST_CHECK(coinDest.nHeight == coin.nHeight);
+        BOOST_CHECK(coinDest.fCoinBase == coin.fCoinBase);
+    }
+
+    // a flipped bit in the last coin either breaks reading it or changes the content hash
+    FILE* f = fopen(path.string().c_str(), "r+b");
+    BOOST_CHECK(f);
+    fseek(f, -1, SEEK_END);
+    int ch = fgetc(f);
+    fseek(f, -1, SEEK_END);
+    fputc(ch ^ 1, f);
+    fclose(f);
+    {
+        CAutoFile file(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION);
+        CUTXOSnapshotMetadata metadataRead;
+        file >> metadataRead;
+        std::vector<CBlockHeader> vHeadersRead;
+        BOOST_CHECK(ReadUTXOSnapshotHeaders(file, metadataRead, vHeadersRead, strError));
+        uint256 hashRead;
+        BOOST_CHECK(!ReadUTXOSnapshotCoins(file, metadataRead, NULL, hashRead, strError) || hashRead != hashContent);
+    }
+}
+
+struct SnapshotRegTestSetup : public TestingSetup {
+    SnapshotRegTestSetup() : TestingSetup(CBaseChainParams::REGTEST) {}
+};
+
+/** Block 1 of the regtest chain the regtest UTXO snapshot in chainparams was taken at */
+static CBlock MakeSnapshotBlock(const CChainParams& chainparams)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = CScript() << 1 << OP_0;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 1 * COIN;
+    tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+
+    CBlock block;
+    block.nVersion = 4;
+    block.hashPrevBlock = chainparams.GenesisBlock().GetHash();
+    block.nTime = chainparams.GenesisBlock().nTime + 60;
+    block.nBits = 0x207fffff;
+    block.nNonce = 0;
+    block.vtx.push_back(tx);
+    block.hashMerkleRoot = BlockMerkleRoot(block);
+    while (!CheckProofOfWork(block.GetHash(), block.nBits, chainparams.GetConsensus()))
+        ++block.nNonce;
+    return block;
+}
+
+BOOST_FIXTURE_TEST_CASE(snapshot_load_regtest, SnapshotRegTestSetup)
+{
+    const CChainParams& chainparams = Params();
+    CBlock block = MakeSnapshotBlock(chainparams);
+    MapUTXOSnapshots::const_iterator itSnapshot = chainparams.UTXOSnapshots().find(block.GetHash());
+    BOOST_REQUIRE(itSnapshot != chainparams.UTXOSnapshots().end());
+
+    CValidationState state;
+    BOOST_CHECK(ProcessNewBlock(state, chainparams, NULL, &block, true, NULL));
+    std::vector<CBlockHeader> vHeaders;
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block.GetHash());
+        BOOST_CHECK_EQUAL(chainActive.Tip()->nChainTx, itSnapshot->second.nChainTx);
+        FlushStateToDisk();
+        vHeaders.push_back(block.GetBlockHeader());
+    }
+
+    // dumped at block 1 it is the snapshot chainparams has
+    boost::filesystem::path path = pathTemp / "utxo.dat";
+    CUTXOSnapshotMetadata metadata;
+    memcpy(metadata.pchMessageStart, chainparams.MessageStart(), sizeof(metadata.pchMessageStart));
+    uint256 hashContent;
+    std::string strError;
+    {
+        CAutoFile file(fopen(path.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+        boost::scoped_ptr<CCoinsViewDBCursor> pcursor(pcoinsdbview->Cursor());
+        BOOST_CHECK(WriteUTXOSnapshot(file, metadata, vHeaders, pcursor.get(), hashContent, strError));
+    }
+    BOOST_CHECK(hashContent == itSnapshot->second.hashContent);
+
+    // a new node loads it like init does: into a chainstate at the genesis block,
+    // then the block index and chainstate are loaded again
+    UnloadBlockIndex();
+    delete pcoinsTip;
+    delete pcoinsdbview;
+    delete pblocktree;
+    pblocktree = new CBlockTreeDB(1 << 20, true);
+    pcoinsdbview = new CCoinsViewDB(1 << 23, true);
+    pcoinsTip = new CCoinsViewCache(pcoinsdbview);
+    BOOST_CHECK(InitBlockIndex(chainparams));
+    BOOST_CHECK(LoadUTXOSnapshot(path.string(), chainparams, strError));
+    UnloadBlockIndex();
+    delete pcoinsTip;
+    pcoinsTip = new CCoinsViewCache(pcoinsdbview);
+    BOOST_CHECK(LoadBlockIndex());
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block.GetHash());
+        BOOST_CHECK(pindexSnapshotBase == chainActive.Tip());
+        BOOST_CHECK(!(pindexSnapshotBase->nStatus & BLOCK_HAVE_DATA));
+        BOOST_CHECK(pcoinsTip->HaveCoin(COutPoint(block.vtx[0].GetHash(), 0)));
+    }
+
+    // the background validation waits for the block, then ends up at the same UTXO set
+    CCoinsViewDB viewValidation(1 << 20, true, false, UTXO_SNAPSHOT_VALIDATION_DIR);
+    BOOST_CHECK_EQUAL(ValidateUTXOSnapshot(chainparams, viewValidation, strError), SNAPSHOT_VALIDATION_PENDING);
+    BOOST_CHECK(ProcessNewBlock(state, chainparams, NULL, &block, true, NULL));
+    BOOST_CHECK_EQUAL(ValidateUTXOSnapshot(chainparams, viewValidation, strError), SNAPSHOT_VALIDATION_DONE);
+    BOOST_CHECK(viewValidation.GetBestBlock() == block.GetHash());
+    {
+        LOCK(cs_main);
+        BOOST_CHECK(pindexSnapshotBase == NULL);
+        BOOST_CHECK(pindexSnapshotValidated == NULL);
+        BOOST_CHECK(chainActive.Tip()->IsValid(BLOCK_VALID_SCRIPTS));
+    }
+    uint256 hashBase;
+    unsigned int nChainTx;
+    BOOST_CHECK(!pblocktree->ReadSnapshotBase(hashBase, nChainTx));
+    BOOST_CHECK(nLocalServices & NODE_NETWORK);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -8,9 +8,13 @@
 #include "chain.h"
 #include "chainparams.h"
 #include "hash.h"
+#include "indexer.h"
+#include "init.h"
 #include "main.h"
 #include "pow.h"
+#include "ui_interface.h"
 #include "uint256.h"
+#include "util.h"
 
 #include <stdint.h>
 
@@ -18,6 +22,7 @@
 
 using namespace std;
 
+static const char DB_COIN = 'C';
 static const char DB_COINS = 'c';
 static const char DB_BLOCK_FILES = 'f';
 static const char DB_TXINDEX = 't';
@@ -31,18 +36,119 @@ static const char DB_BEST_BLOCK = 'B';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_INDEX_BEST_BLOCK = 'I';
+static const char DB_SNAPSHOT_BASE = 'S';
 
+//! Entries erased at once when wiping an index
+static const size_t WIPE_INDEX_BATCH_SIZE = 100000;
+//! Transactions converted at once when upgrading the chainstate to per-output records
+static const size_t UPGRADE_COINS_BATCH_SIZE = 100000;
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) 
+namespace {
+
+/** Key of a coin in the chainstate: DB_COIN, the txid and the output index as a VARINT */
+struct CoinEntry
+{
+    COutPoint* outpoint;
+    char key;
+
+    CoinEntry(const COutPoint* ptr) : outpoint(const_cast<COutPoint*>(ptr)), key(DB_COIN) {}
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const {
+        return 1 + 32 + ::GetSerializeSize(VARINT(outpoint->n), nType, nVersion);
+    }
+
+    template<typename Stream>
+    void Serialize(Stream &s, int nType, int nVersion) const {
+        ::Serialize(s, key, nType, nVersion);
+        ::Serialize(s, outpoint->hash, nType, nVersion);
+        ::Serialize(s, VARINT(outpoint->n), nType, nVersion);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream &s, int nType, int nVersion) {
+        ::Unserialize(s, key, nType, nVersion);
+        ::Unserialize(s, outpoint->hash, nType, nVersion);
+        ::Unserialize(s, VARINT(outpoint->n), nType, nVersion);
+    }
+};
+
+/**
+ * The per-transaction record the chainstate held before it was keyed by
+ * outpoint, only read by CCoinsViewDB::Upgrade()
+ *
+ * Serialized format:
+ * - VARINT(nVersion)
+ * - VARINT(nCode)
+ * - unspentness bitvector, for vout[2] and further; least significant byte first
+ * - the non-spent CTxOuts (via CTxOutCompressor)
+ * - VARINT(nHeight)
+ *
+ * The nCode value consists of:
+ * - bit 0: IsCoinBase()
+ * - bit 1: vout[0] is not spent
+ * - bit 2: vout[1] is not spent
+ * - The higher bits encode N, the number of non-zero bytes in the following bitvector.
+ *   - In case both bit 1 and bit 2 are unset, they encode N-1, as there must be at
+ *     least one non-spent output).
+ */
+class CLegacyCoins
 {
+public:
+    bool fCoinBase;
+    std::vector<CTxOut> vout;
+    int nHeight;
+
+    CLegacyCoins() : fCoinBase(false), nHeight(0) {}
+
+    template<typename Stream>
+    void Unserialize(Stream &s, int nType, int nVersion) {
+        unsigned int nCode = 0;
+        // version
+        int nVersionDummy;
+        ::Unserialize(s, VARINT(nVersionDummy), nType, nVersion);
+        // header code
+        ::Unserialize(s, VARINT(nCode), nType, nVersion);
+        fCoinBase = nCode & 1;
+        std::vector<bool> vAvail(2, false);
+        vAvail[0] = (nCode & 2) != 0;
+        vAvail[1] = (nCode & 4) != 0;
+        unsigned int nMaskCode = (nCode / 8) + ((nCode & 6) != 0 ? 0 : 1);
+        // spentness bitmask
+        while (nMaskCode > 0) {
+            unsigned char chAvail = 0;
+            ::Unserialize(s, chAvail, nType, nVersion);
+            for (unsigned int p = 0; p < 8; p++) {
+                bool f = (chAvail & (1 << p)) != 0;
+                vAvail.push_back(f);
+            }
+            if (chAvail != 0)
+                nMaskCode--;
+        }
+        // txouts themself
+        vout.assign(vAvail.size(), CTxOut());
+        for (unsigned int i = 0; i < vAvail.size(); i++) {
+            if (vAvail[i])
+                ::Unserialize(s, REF(CTxOutCompressor(vout[i])), nType, nVersion);
+        }
+        // coinbase height
+        ::Unserialize(s, VARINT(nHeight), nType, nVersion);
+    }
+};
+
 }
 
-bool CCoinsViewDB::GetCoins(const uint256 &txid, CCoins &coins) const {
-    return db.Read(make_pair(DB_COINS, txid), coins);
+
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe, const std::string& strName) : db(GetDataDir() / strName, nCacheSize, fMemory, fWipe, true)
+{
+}
+
+bool CCoinsViewDB::GetCoin(const COutPoint &outpoint, Coin &coin) const {
+    return db.Read(CoinEntry(&outpoint), coin);
 }
 
-bool CCoinsViewDB::HaveCoins(const uint256 &txid) const {
-    return db.Exists(make_pair(DB_COINS, txid));
+bool CCoinsViewDB::HaveCoin(const COutPoint &outpoint) const {
+    return db.Exists(CoinEntry(&outpoint));
 }
 
 uint256 CCoinsViewDB::GetBestBlock() const {
@@ -53,25 +159,28 @@ uint256 CCoinsViewDB::GetBestBlock() const {
 }
 
 bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
+    bool ret = WriteCoins(mapCoins, hashBlock);
+    mapCoins.clear();
+    return ret;
+}
+
+bool CCoinsViewDB::WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock) {
     CDBBatch batch(&db.GetObfuscateKey());
-    size_t count = 0;
     size_t changed = 0;
-    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); it++) {
         if (it->second.flags & CCoinsCacheEntry::DIRTY) {
-            if (it->second.coins.IsPruned())
-                batch.Erase(make_pair(DB_COINS, it->first));
+            CoinEntry entry(&it->first);
+            if (it->second.coin.IsSpent())
+                batch.Erase(entry);
             else
-                batch.Write(make_pair(DB_COINS, it->first), it->second.coins);
+                batch.Write(entry, it->second.coin);
             changed++;
         }
-        count++;
-        CCoinsMap::iterator itOld = it++;
-        mapCoins.erase(itOld);
     }
     if (!hashBlock.IsNull())
         batch.Write(DB_BEST_BLOCK, hashBlock);
 
-    LogPrint("coindb", "Committing %u changed transactions (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)count);
+    LogPrint("coindb", "Committing %u changed coins (out of %u) to coin database...\n", (unsigned int)changed, (unsigned int)mapCoins.size());
     return db.WriteBatch(batch);
 }
 
@@ -98,52 +207,165 @@ bool CBlockTreeDB::ReadLastBlockFile(int &nFile) {
     return Read(DB_LAST_BLOCK, nFile);
 }
 
+static void ApplyStats(CCoinsStats &stats, CHashWriter& ss, const uint256& hash, const std::map<uint32_t, Coin>& outputs)
+{
+    assert(!outputs.empty());
+    ss << hash;
+    uint32_t nCode = outputs.begin()->second.nHeight * 2 + outputs.begin()->second.fCoinBase;
+    ss << VARINT(nCode);
+    stats.nTransactions++;
+    for (std::map<uint32_t, Coin>::const_iterator it = outputs.begin(); it != outputs.end(); ++it) {
+        ss << VARINT(it->first + 1);
+        ss << it->second.out;
+        stats.nTransactionOutputs++;
+        stats.nTotalAmount += it->second.out.nValue;
+    }
+    ss << VARINT(0);
+}
+
 bool CCoinsViewDB::GetStats(CCoinsStats &stats) const {
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
     boost::scoped_ptr<CDBIterator> pcursor(const_cast<CDBWrapper*>(&db)->NewIterator());
-    pcursor->Seek(DB_COINS);
+    pcursor->Seek(DB_COIN);
 
     CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
     stats.hashBlock = GetBestBlock();
     ss << stats.hashBlock;
-    CAmount nTotalAmount = 0;
+    // the coins of a transaction are next to each other, group them so the
+    // transaction count and the hash do not depend on the db layout
+    uint256 hashPrev;
+    std::map<uint32_t, Coin> outputs;
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
-        std::pair<char, uint256> key;
-        CCoins coins;
-        if (pcursor->GetKey(key) && key.first == DB_COINS) {
-            if (pcursor->GetValue(coins)) {
-                stats.nTransactions++;
-                for (unsigned int i=0; i<coins.vout.size(); i++) {
-                    const CTxOut &out = coins.vout[i];
-                    if (!out.IsNull()) {
-                        stats.nTransactionOutputs++;
-                        ss << VARINT(i+1);
-                        ss << out;
-                        nTotalAmount += out.nValue;
-                    }
-                }
-                stats.nSerializedSize += 32 + pcursor->GetValueSize();
-                ss << VARINT(0);
-            } else {
+        COutPoint outpoint;
+        CoinEntry entry(&outpoint);
+        if (pcursor->GetKey(entry) && entry.key == DB_COIN) {
+            Coin coin;
+            if (!pcursor->GetValue(coin))
                 return error("CCoinsViewDB::GetStats() : unable to read value");
+            if (!outputs.empty() && outpoint.hash != hashPrev) {
+                ApplyStats(stats, ss, hashPrev, outputs);
+                outputs.clear();
             }
+            hashPrev = outpoint.hash;
+            outputs[outpoint.n].swap(coin);
+            stats.nSerializedSize += 32 + 4 + pcursor->GetValueSize();
         } else {
             break;
         }
         pcursor->Next();
     }
+    if (!outputs.empty())
+        ApplyStats(stats, ss, hashPrev, outputs);
     {
         LOCK(cs_main);
         stats.nHeight = mapBlockIndex.find(stats.hashBlock)->second->nHeight;
     }
     stats.hashSerialized = ss.GetHash();
-    stats.nTotalAmount = nTotalAmount;
     return true;
 }
 
+CCoinsViewDBCursor *CCoinsViewDB::Cursor() const
+{
+    CCoinsViewDBCursor *i = new CCoinsViewDBCursor(const_cast<CDBWrapper*>(&db)->NewIterator(), GetBestBlock());
+    i->pcursor->Seek(DB_COIN);
+    i->ReadKey();
+    return i;
+}
+
+void CCoinsViewDBCursor::ReadKey()
+{
+    // Cache the key of the current entry, so GetKey() is cheap and Valid() can
+    // tell when the cursor has left the coin records
+    CoinEntry entry(&keyTmp);
+    if (!pcursor->Valid() || !pcursor->GetKey(entry))
+        chKey = 0;
+    else
+        chKey = entry.key;
+}
+
+bool CCoinsViewDBCursor::GetKey(COutPoint &key) const
+{
+    if (chKey != DB_COIN)
+        return false;
+    key = keyTmp;
+    return true;
+}
+
+bool CCoinsViewDBCursor::GetValue(Coin &coin) const
+{
+    return pcursor->GetValue(coin);
+}
+
+bool CCoinsViewDBCursor::Valid() const
+{
+    return chKey == DB_COIN;
+}
+
+void CCoinsViewDBCursor::Next()
+{
+    pcursor->Next();
+    ReadKey();
+}
+
+bool CCoinsViewDB::Upgrade() {
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator());
+    pcursor->Seek(make_pair(DB_COINS, uint256()));
+    if (!pcursor->Valid())
+        return true;
+
+    LogPrintf("Upgrading UTXO database to per-output records...\n");
+    uiInterface.ShowProgress(_("Upgrading UTXO database..."), 0);
+    CDBBatch batch(&db.GetObfuscateKey());
+    size_t nBatch = 0;
+    int64_t nTxes = 0, nCoins = 0;
+    int nReported = 0;
+    // every record moves in the same batch which erases it, so an interrupted
+    // upgrade simply resumes with the transactions which are left
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested())
+            break;
+        std::pair<char, uint256> key;
+        if (!pcursor->GetKey(key) || key.first != DB_COINS)
+            break;
+        CLegacyCoins coins;
+        if (!pcursor->GetValue(coins))
+            return error("CCoinsViewDB::Upgrade() : unable to read value");
+        COutPoint outpoint(key.second, 0);
+        for (unsigned int i = 0; i < coins.vout.size(); i++) {
+            if (coins.vout[i].IsNull() || coins.vout[i].scriptPubKey.IsUnspendable())
+                continue;
+            outpoint.n = i;
+            batch.Write(CoinEntry(&outpoint), Coin(coins.vout[i], coins.nHeight, coins.fCoinBase));
+            nCoins++;
+        }
+        batch.Erase(key);
+        nTxes++;
+        if (++nBatch >= UPGRADE_COINS_BATCH_SIZE) {
+            if (!db.WriteBatch(batch))
+                return false;
+            batch.Clear();
+            nBatch = 0;
+            // txids are uniformly distributed, the first two bytes tell how far we are
+            int nProgress = (int)((0x100 * *key.second.begin() + *(key.second.begin() + 1)) * 100.0 / 65536.0);
+            uiInterface.ShowProgress(_("Upgrading UTXO database..."), std::max(1, std::min(99, nProgress)));
+            if (nProgress / 10 > nReported) {
+                LogPrintf("[%d%%]...\n", nProgress);
+                nReported = nProgress / 10;
+            }
+        }
+        pcursor->Next();
+    }
+    if (!db.WriteBatch(batch))
+        return false;
+    uiInterface.ShowProgress("", 100);
+    LogPrintf("UTXO database upgrade %s: %d transactions converted into %d coins\n", ShutdownRequested() ? "interrupted" : "done", nTxes, nCoins);
+    return !ShutdownRequested();
+}
+
 bool CBlockTreeDB::WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo) {
     CDBBatch batch(&GetObfuscateKey());
     for (std::vector<std::pair<int, const CBlockFileInfo*> >::const_iterator it=fileInfo.begin(); it != fileInfo.end(); it++) {
@@ -171,30 +393,6 @@ bool CBlockTreeDB::ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value)
     return Read(make_pair(DB_SPENTINDEX, key), value);
 }
 
-bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
-    CDBBatch batch(&GetObfuscateKey());
-    for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
-        if (it->second.IsNull()) {
-            batch.Erase(make_pair(DB_SPENTINDEX, it->first));
-        } else {
-            batch.Write(make_pair(DB_SPENTINDEX, it->first), it->second);
-        }
-    }
-    return WriteBatch(batch);
-}
-
-bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect) {
-    CDBBatch batch(&GetObfuscateKey());
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
-        if (it->second.IsNull()) {
-            batch.Erase(make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
-        } else {
-            batch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
-        }
-    }
-    return WriteBatch(batch);
-}
-
 bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
                                            std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) {
 
@@ -221,20 +419,6 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(uint160 addressHash, int type,
     return true;
 }
 
-bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
-    CDBBatch batch(&GetObfuscateKey());
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Write(make_pair(DB_ADDRESSINDEX, it->first), it->second);
-    return WriteBatch(batch);
-}
-
-bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
-    CDBBatch batch(&GetObfuscateKey());
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Erase(make_pair(DB_ADDRESSINDEX, it->first));
-    return WriteBatch(batch);
-}
-
 bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
                                     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                                     int start, int end) {
@@ -269,12 +453,6 @@ bool CBlockTreeDB::ReadAddressIndex(uint160 addressHash, int type,
     return true;
 }
 
-bool CBlockTreeDB::WriteTimestampIndex(const CTimestampIndexKey &timestampIndex) {
-    CDBBatch batch(&GetObfuscateKey());
-    batch.Write(make_pair(DB_TIMESTAMPINDEX, timestampIndex), 0);
-    return WriteBatch(batch);
-}
-
 bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &hashes) {
 
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
@@ -295,6 +473,106 @@ bool CBlockTreeDB::ReadTimestampIndex(const unsigned int &high, const unsigned i
     return true;
 }
 
+bool CBlockTreeDB::WriteIndexBatch(const CIndexBatch &indexBatch) {
+    CDBBatch batch(&GetObfuscateKey());
+    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=indexBatch.vAddressIndex.begin(); it!=indexBatch.vAddressIndex.end(); it++) {
+        if (indexBatch.fDisconnect) {
+            batch.Erase(make_pair(DB_ADDRESSINDEX, it->first));
+        } else {
+            batch.Write(make_pair(DB_ADDRESSINDEX, it->first), it->second);
+        }
+    }
+    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=indexBatch.vAddressUnspentIndex.begin(); it!=indexBatch.vAddressUnspentIndex.end(); it++) {
+        if (it->second.IsNull()) {
+            batch.Erase(make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
+        } else {
+            batch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
+        }
+    }
+    for (std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >::const_iterator it=indexBatch.vSpentIndex.begin(); it!=indexBatch.vSpentIndex.end(); it++) {
+        if (it->second.IsNull()) {
+            batch.Erase(make_pair(DB_SPENTINDEX, it->first));
+        } else {
+            batch.Write(make_pair(DB_SPENTINDEX, it->first), it->second);
+        }
+    }
+    for (std::vector<CTimestampIndexKey>::const_iterator it=indexBatch.vTimestampIndex.begin(); it!=indexBatch.vTimestampIndex.end(); it++) {
+        if (indexBatch.fDisconnect) {
+            batch.Erase(make_pair(DB_TIMESTAMPINDEX, *it));
+        } else {
+            batch.Write(make_pair(DB_TIMESTAMPINDEX, *it), 0);
+        }
+    }
+    // the entries and the block they lead up to are written atomically
+    for (int i = 0; i < INDEXER_COUNT; i++) {
+        if (indexBatch.HasIndex(i))
+            batch.Write(std::make_pair(DB_INDEX_BEST_BLOCK, GetIndexerIndexName(i)), indexBatch.hashBestBlock);
+    }
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::ReadIndexBestBlock(const std::string &name, uint256 &hashBlock) {
+    return Read(std::make_pair(DB_INDEX_BEST_BLOCK, name), hashBlock);
+}
+
+bool CBlockTreeDB::WriteIndexBestBlock(const std::string &name, const uint256 &hashBlock) {
+    return Write(std::make_pair(DB_INDEX_BEST_BLOCK, name), hashBlock);
+}
+
+template<typename K>
+bool CBlockTreeDB::EraseIndexEntries(char chPrefix) {
+    boost::scoped_ptr<CDBIterator> pcursor(NewIterator());
+
+    pcursor->Seek(chPrefix);
+
+    CDBBatch batch(&GetObfuscateKey());
+    size_t nBatch = 0;
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, K> key;
+        if (!pcursor->GetKey(key) || key.first != chPrefix)
+            break;
+        batch.Erase(key);
+        if (++nBatch >= WIPE_INDEX_BATCH_SIZE) {
+            if (!WriteBatch(batch))
+                return false;
+            batch.Clear();
+            nBatch = 0;
+        }
+        pcursor->Next();
+    }
+    return WriteBatch(batch);
+}
+
+bool CBlockTreeDB::WipeAddressIndex() {
+    return EraseIndexEntries<CAddressIndexKey>(DB_ADDRESSINDEX) && EraseIndexEntries<CAddressUnspentKey>(DB_ADDRESSUNSPENTINDEX);
+}
+
+bool CBlockTreeDB::WipeTimestampIndex() {
+    return EraseIndexEntries<CTimestampIndexKey>(DB_TIMESTAMPINDEX);
+}
+
+bool CBlockTreeDB::WipeSpentIndex() {
+    return EraseIndexEntries<CSpentIndexKey>(DB_SPENTINDEX);
+}
+
+bool CBlockTreeDB::ReadSnapshotBase(uint256 &hashBlock, unsigned int &nChainTx) {
+    std::pair<uint256, unsigned int> value;
+    if (!Read(DB_SNAPSHOT_BASE, value))
+        return false;
+    hashBlock = value.first;
+    nChainTx = value.second;
+    return true;
+}
+
+bool CBlockTreeDB::WriteSnapshotBase(const uint256 &hashBlock, unsigned int nChainTx) {
+    return Write(DB_SNAPSHOT_BASE, std::make_pair(hashBlock, nChainTx));
+}
+
+bool CBlockTreeDB::EraseSnapshotBase() {
+    return Erase(DB_SNAPSHOT_BASE);
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
 }
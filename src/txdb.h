@@ -14,9 +14,12 @@
 #include <utility>
 #include <vector>
 
+#include <boost/scoped_ptr.hpp>
+
 class CBlockFileInfo;
 class CBlockIndex;
 struct CDiskTxPos;
+struct CIndexBatch;
 struct CAddressUnspentKey;
 struct CAddressUnspentValue;
 struct CAddressIndexKey;
@@ -35,19 +38,58 @@ static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 16384 : 1024;
 //! min. -dbcache in (MiB)
 static const int64_t nMinDbCache = 4;
 
+class CCoinsViewDBCursor;
+
 /** CCoinsView backed by the coin database (chainstate/) */
 class CCoinsViewDB : public CCoinsView
 {
 protected:
     CDBWrapper db;
 public:
-    CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+    //! strName is the directory below the data directory, another one than chainstate/ holds a second UTXO set
+    CCoinsViewDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false, const std::string& strName = "chainstate");
 
-    bool GetCoins(const uint256 &txid, CCoins &coins) const;
-    bool HaveCoins(const uint256 &txid) const;
+    bool GetCoin(const COutPoint &outpoint, Coin &coin) const;
+    bool HaveCoin(const COutPoint &outpoint) const;
     uint256 GetBestBlock() const;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
     bool GetStats(CCoinsStats &stats) const;
+
+    //! Same as BatchWrite, but leaves mapCoins alone so it can still be read
+    //! from while the batch is written.
+    bool WriteCoins(const CCoinsMap &mapCoins, const uint256 &hashBlock);
+
+    //! Converts the per-transaction records of older versions into per-output ones.
+    //! Returns false on failure or when interrupted by a shutdown request.
+    bool Upgrade();
+
+    //! Cursor over all coins in key order, reading a consistent snapshot of the
+    //! database taken when it is created. The caller owns it.
+    CCoinsViewDBCursor *Cursor() const;
+};
+
+/** Walks the coins of a CCoinsViewDB */
+class CCoinsViewDBCursor
+{
+public:
+    bool GetKey(COutPoint &key) const;
+    bool GetValue(Coin &coin) const;
+    bool Valid() const;
+    void Next();
+
+    //! The best block of the database when the cursor was created
+    const uint256 &GetBestBlock() const { return hashBlock; }
+
+private:
+    CCoinsViewDBCursor(CDBIterator* pcursorIn, const uint256 &hashBlockIn) : pcursor(pcursorIn), hashBlock(hashBlockIn) {}
+    void ReadKey();
+
+    boost::scoped_ptr<CDBIterator> pcursor;
+    uint256 hashBlock;
+    char chKey;
+    COutPoint keyTmp;
+
+    friend class CCoinsViewDB;
 };
 
 /** Access to the block database (blocks/index/) */
@@ -58,6 +100,7 @@ public:
 private:
     CBlockTreeDB(const CBlockTreeDB&);
     void operator=(const CBlockTreeDB&);
+    template<typename K> bool EraseIndexEntries(char chPrefix);
 public:
     bool WriteBatchSync(const std::vector<std::pair<int, const CBlockFileInfo*> >& fileInfo, int nLastFile, const std::vector<const CBlockIndex*>& blockinfo);
     bool ReadBlockFileInfo(int nFile, CBlockFileInfo &fileinfo);
@@ -67,17 +110,21 @@ public:
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list);
     bool ReadSpentIndex(CSpentIndexKey &key, CSpentIndexValue &value);
-    bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
-    bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
     bool ReadAddressUnspentIndex(uint160 addressHash, int type,
                                  std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect);
-    bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
-    bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
     bool ReadAddressIndex(uint160 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                           int start = 0, int end = 0);
-    bool WriteTimestampIndex(const CTimestampIndexKey &timestampIndex);
     bool ReadTimestampIndex(const unsigned int &high, const unsigned int &low, std::vector<uint256> &vect);
+    bool WriteIndexBatch(const CIndexBatch &indexBatch);
+    bool ReadIndexBestBlock(const std::string &name, uint256 &hashBlock);
+    bool WriteIndexBestBlock(const std::string &name, const uint256 &hashBlock);
+    bool WipeAddressIndex();
+    bool WipeTimestampIndex();
+    bool WipeSpentIndex();
+    bool ReadSnapshotBase(uint256 &hashBlock, unsigned int &nChainTx);
+    bool WriteSnapshotBase(const uint256 &hashBlock, unsigned int nChainTx);
+    bool EraseSnapshotBase();
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
     bool LoadBlockIndexGuts();
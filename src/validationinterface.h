@@ -32,8 +32,11 @@ void SyncWithWallets(const CTransaction& tx, const CBlock* pblock = NULL);
 class CValidationInterface {
 protected:
     virtual void UpdatedBlockTip(const CBlockIndex *pindex) {}
+    virtual void BlockConnected(const CBlockIndex *pindex) {}
+    virtual void BlockDisconnected(const CBlockIndex *pindex) {}
     virtual void SyncTransaction(const CTransaction &tx, const CBlock *pblock) {}
     virtual void NotifyTransactionLock(const CTransaction &tx) {}
+    virtual void NotifyTransactionLockLatency(const uint256 &txHash, int64_t nRequestToLockMicros, int64_t nFirstVoteToLockMicros, int nVotes) {}
     virtual void SetBestChain(const CBlockLocator &locator) {}
     virtual bool UpdatedTransaction(const uint256 &hash) { return false;}
     virtual void Inventory(const uint256 &hash) {}
@@ -49,10 +52,16 @@ protected:
 struct CMainSignals {
     /** Notifies listeners of updated block chain tip */
     boost::signals2::signal<void (const CBlockIndex *)> UpdatedBlockTip;
+    /** Notifies listeners of a block added to the tip of the active chain, also during initial block download */
+    boost::signals2::signal<void (const CBlockIndex *)> BlockConnected;
+    /** Notifies listeners of a block removed from the tip of the active chain */
+    boost::signals2::signal<void (const CBlockIndex *)> BlockDisconnected;
     /** Notifies listeners of updated transaction data (transaction, and optionally the block it is found in. */
     boost::signals2::signal<void (const CTransaction &, const CBlock *)> SyncTransaction;
     /** Notifies listeners of an updated transaction lock without new data. */
     boost::signals2::signal<void (const CTransaction &)> NotifyTransactionLock;
+    /** Notifies listeners how long it took to lock a transaction via InstantSend and how many votes it got. */
+    boost::signals2::signal<void (const uint256 &, int64_t, int64_t, int)> NotifyTransactionLockLatency;
     /** Notifies listeners of an updated transaction without new data (for now: a coinbase potentially becoming visible). */
     boost::signals2::signal<bool (const uint256 &)> UpdatedTransaction;
     /** Notifies listeners of a new active block chain. */
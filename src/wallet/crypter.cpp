@@ -333,6 +333,14 @@ bool CCryptoKeyStore::AddCryptedKey(const CPubKey &vchPubKey, const std::vector<
     return true;
 }
 
+bool CCryptoKeyStore::RemoveKey(const CKeyID &address)
+{
+    LOCK(cs_KeyStore);
+    if (!IsCrypted())
+        return mapKeys.erase(address) > 0;
+    return mapCryptedKeys.erase(address) > 0;
+}
+
 bool CCryptoKeyStore::GetKey(const CKeyID &address, CKey& keyOut) const
 {
     {
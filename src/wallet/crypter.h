@@ -142,6 +142,8 @@ protected:
     bool DecryptHDChain(CHDChain& hdChainRet) const;
     bool SetHDChain(const CHDChain& chain);
     bool SetCryptedHDChain(const CHDChain& chain);
+    //! drops a key from memory again, for keys which couldn't be stored
+    bool RemoveKey(const CKeyID &address);
 
     bool Unlock(const CKeyingMaterial& vMasterKeyIn, bool fForMixingOnly = false);
 
@@ -0,0 +1,197 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "wallet/rescan.h"
+
+#include "main.h"
+#include "pubkey.h"
+#include "script/standard.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+
+bool CWalletScriptFilter::Match(const CScript& scriptPubKey) const
+{
+    if (!setWatchOnly.empty() && setWatchOnly.count(scriptPubKey))
+        return true;
+
+    std::vector<std::vector<unsigned char> > vSolutions;
+    txnouttype whichType;
+    if (!Solver(scriptPubKey, whichType, vSolutions))
+        return false;
+
+    switch (whichType)
+    {
+    case TX_PUBKEY:
+        return setIDs.count(CPubKey(vSolutions[0]).GetID()) != 0;
+    case TX_PUBKEYHASH:
+    case TX_SCRIPTHASH:
+        return setIDs.count(uint160(vSolutions[0])) != 0;
+    case TX_MULTISIG:
+        // first and last solutions are the required and total number of keys
+        for (size_t i = 1; i + 1 < vSolutions.size(); i++) {
+            if (setIDs.count(CPubKey(vSolutions[i]).GetID()))
+                return true;
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
+bool CWalletScriptFilter::Match(const CTransaction& tx) const
+{
+    BOOST_FOREACH(const CTxOut& txout, tx.vout) {
+        if (Match(txout.scriptPubKey))
+            return true;
+    }
+    return false;
+}
+
+void CWalletRescanProgress::Start(int nStartHeightIn, int nStopHeightIn)
+{
+    LOCK(cs);
+    fScanning = true;
+    nStartHeight = nStartHeightIn;
+    nStopHeight = nStopHeightIn;
+    nHeight = nStartHeightIn;
+    nStartTime = GetTimeMillis();
+}
+
+void CWalletRescanProgress::Update(int nHeightIn)
+{
+    LOCK(cs);
+    nHeight = nHeightIn;
+}
+
+void CWalletRescanProgress::Finish()
+{
+    LOCK(cs);
+    fScanning = false;
+}
+
+bool CWalletRescanProgress::IsScanning() const
+{
+    LOCK(cs);
+    return fScanning;
+}
+
+bool CWalletRescanProgress::Get(int& nStartHeightRet, int& nStopHeightRet, int& nHeightRet, int64_t& nDurationMillisRet) const
+{
+    LOCK(cs);
+    if (!fScanning)
+        return false;
+    nStartHeightRet = nStartHeight;
+    nStopHeightRet = nStopHeight;
+    nHeightRet = nHeight;
+    nDurationMillisRet = GetTimeMillis() - nStartTime;
+    return true;
+}
+
+CBlockRescanner::CBlockRescanner(const std::vector<CBlockIndex*>& vpindexIn, const CWalletScriptFilter& filterIn, const Consensus::Params& consensusParamsIn, int nThreads) :
+    vpindex(vpindexIn),
+    filter(filterIn),
+    consensusParams(consensusParamsIn),
+    nNextRead(0),
+    nNextResult(0),
+    fStop(false)
+{
+    // Solver() sets up its templates on first use, make sure this does not happen on the readers
+    std::vector<std::vector<unsigned char> > vSolutions;
+    txnouttype whichType;
+    Solver(CScript(), whichType, vSolutions);
+
+    if (nThreads < 1)
+        nThreads = 1;
+    if (nThreads > MAX_RESCAN_THREADS)
+        nThreads = MAX_RESCAN_THREADS;
+    for (int i = 0; i < nThreads; i++)
+        threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "rescan", boost::function<void()>(boost::bind(&CBlockRescanner::ThreadRead, this))));
+}
+
+CBlockRescanner::~CBlockRescanner()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fStop = true;
+    }
+    condWorker.notify_all();
+    threadGroup.join_all();
+}
+
+void CBlockRescanner::Fail(const std::string& strErrorIn)
+{
+    LogPrintf("CBlockRescanner::ThreadRead -- %s\n", strErrorIn);
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (strError.empty())
+            strError = strErrorIn;
+        fStop = true;
+    }
+    condWorker.notify_all();
+    condResult.notify_all();
+}
+
+void CBlockRescanner::ThreadRead()
+{
+    while (true) {
+        size_t nPos;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (!fStop && nNextRead < vpindex.size() && nNextRead >= nNextResult + RESCAN_BLOCK_WINDOW)
+                condWorker.wait(lock);
+            if (fStop || nNextRead >= vpindex.size())
+                return;
+            nPos = nNextRead++;
+        }
+
+        CRescanBlock result;
+        try {
+            result.pindex = vpindex[nPos];
+            result.pblock.reset(new CBlock());
+            const CBlock& block = *result.pblock;
+            if (!ReadBlockFromDisk(*result.pblock, result.pindex, consensusParams))
+                LogPrintf("CBlockRescanner::ThreadRead -- failed to read block %s at height %d\n", result.pindex->GetBlockHash().ToString(), result.pindex->nHeight);
+            result.vMatch.resize(block.vtx.size());
+            for (size_t i = 0; i < block.vtx.size(); i++)
+                result.vMatch[i] = filter.Match(block.vtx[i]);
+        } catch (const std::exception& e) {
+            Fail(strprintf("block at height %d: %s", vpindex[nPos]->nHeight, e.what()));
+            return;
+        } catch (...) {
+            Fail(strprintf("block at height %d: unknown exception", vpindex[nPos]->nHeight));
+            return;
+        }
+
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            mapResults[nPos] = result;
+        }
+        condResult.notify_all();
+    }
+}
+
+bool CBlockRescanner::Next(CRescanBlock& blockRet)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (nNextResult >= vpindex.size())
+        return false;
+
+    std::map<size_t, CRescanBlock>::iterator it;
+    while ((it = mapResults.find(nNextResult)) == mapResults.end()) {
+        if (!strError.empty())
+            throw std::runtime_error("CBlockRescanner: failed to read " + strError);
+        condResult.wait(lock);
+    }
+
+    blockRet = it->second;
+    mapResults.erase(it);
+    nNextResult++;
+
+    lock.unlock();
+    condWorker.notify_all();
+    return true;
+}
@@ -0,0 +1,158 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef WALLET_RESCAN_H
+#define WALLET_RESCAN_H
+
+#include "crypto/common.h"
+#include "primitives/block.h"
+#include "script/script.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/functional/hash.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/unordered_set.hpp>
+
+class CBlockIndex;
+
+namespace Consensus { struct Params; }
+
+/** Don't start more block reader threads than this for a rescan */
+static const int MAX_RESCAN_THREADS = 8;
+/** How many blocks the readers may be ahead of the block the wallet is looking at */
+static const int RESCAN_BLOCK_WINDOW = 128;
+
+/**
+ * Cheap and thread safe pre-filter of the outputs a wallet may be interested in,
+ * built from a snapshot of its keys, scripts and watch-only scripts. It never misses
+ * an output IsMine() would accept but may let through ones it would not (e.g. a P2SH
+ * or multisig output we only know some of the keys of).
+ */
+class CWalletScriptFilter
+{
+private:
+    struct CIDHasher
+    {
+        size_t operator()(const uint160& id) const { return ReadLE64(id.begin()); }
+    };
+    struct CScriptHasher
+    {
+        size_t operator()(const CScript& script) const { return boost::hash_range(script.begin(), script.end()); }
+    };
+
+    // key ids and script ids share the same 160 bit space
+    boost::unordered_set<uint160, CIDHasher> setIDs;
+    boost::unordered_set<CScript, CScriptHasher> setWatchOnly;
+
+public:
+    void AddID(const uint160& id) { setIDs.insert(id); }
+    void AddWatchOnly(const CScript& script) { setWatchOnly.insert(script); }
+
+    bool Match(const CScript& scriptPubKey) const;
+    bool Match(const CTransaction& tx) const;
+
+    size_t size() const { return setIDs.size() + setWatchOnly.size(); }
+};
+
+/**
+ * Where a running rescan is, for RPC callers which can't take the wallet lock
+ * while it is held by the rescan.
+ */
+class CWalletRescanProgress
+{
+private:
+    mutable CCriticalSection cs;
+    bool fScanning;
+    int nStartHeight;
+    int nStopHeight;
+    int nHeight;
+    int64_t nStartTime;
+
+public:
+    CWalletRescanProgress() : fScanning(false), nStartHeight(0), nStopHeight(0), nHeight(0), nStartTime(0) {}
+
+    void Start(int nStartHeightIn, int nStopHeightIn);
+    void Update(int nHeightIn);
+    void Finish();
+
+    bool IsScanning() const;
+    /// Fills in where the rescan is, returns false if there is none running
+    bool Get(int& nStartHeightRet, int& nStopHeightRet, int& nHeightRet, int64_t& nDurationMillisRet) const;
+};
+
+/** Marks a rescan as running for as long as it is in scope, also when the rescan throws */
+class CWalletRescanGuard
+{
+private:
+    CWalletRescanProgress& progress;
+
+    CWalletRescanGuard(const CWalletRescanGuard&);
+    void operator=(const CWalletRescanGuard&);
+
+public:
+    CWalletRescanGuard(CWalletRescanProgress& progressIn, int nStartHeight, int nStopHeight) : progress(progressIn)
+    {
+        progress.Start(nStartHeight, nStopHeight);
+    }
+
+    ~CWalletRescanGuard()
+    {
+        progress.Finish();
+    }
+};
+
+/**
+ * Reads and deserializes the blocks of a rescan on a pool of threads and matches
+ * their txes against a CWalletScriptFilter, the blocks are handed back to the
+ * caller in chain order. vpindex must not change (i.e. cs_main must be held)
+ * until the rescanner is gone.
+ */
+class CBlockRescanner
+{
+public:
+    struct CRescanBlock
+    {
+        CBlockIndex* pindex;
+        boost::shared_ptr<CBlock> pblock;
+        // txes of the block the filter matched an output of
+        std::vector<bool> vMatch;
+    };
+
+private:
+    const std::vector<CBlockIndex*>& vpindex;
+    const CWalletScriptFilter& filter;
+    const Consensus::Params& consensusParams;
+
+    boost::mutex mutex;
+    boost::condition_variable condWorker;
+    boost::condition_variable condResult;
+    boost::thread_group threadGroup;
+
+    // next block to hand to a reader and to the caller
+    size_t nNextRead;
+    size_t nNextResult;
+    std::map<size_t, CRescanBlock> mapResults;
+    bool fStop;
+    // set when a reader failed, Next() throws it instead of waiting for the block
+    std::string strError;
+
+    void ThreadRead();
+    void Fail(const std::string& strErrorIn);
+
+public:
+    CBlockRescanner(const std::vector<CBlockIndex*>& vpindexIn, const CWalletScriptFilter& filterIn, const Consensus::Params& consensusParamsIn, int nThreads);
+    ~CBlockRescanner();
+
+    /// Next block in chain order, false once all of them were returned.
+    /// Throws std::runtime_error if a reader failed.
+    bool Next(CRescanBlock& blockRet);
+};
+
+#endif // WALLET_RESCAN_H
@@ -2392,50 +2392,88 @@ UniValue getwalletinfo(const UniValue& params, bool fHelp)
             "      }\n"
             "      ,...\n"
             "    ]\n"
+            "  \"scanning\":                  (json object or false) false unless a rescan is running. The rescan holds\n"
+            "                               the wallet until done, only keys_left, unlocked_until and paytxfee are\n"
+            "                               reported besides it while it does\n"
+            "    {\n"
+            "      \"startheight\": xxxx,         (numeric) the height the rescan started at\n"
+            "      \"stopheight\": xxxx,          (numeric) the height the rescan ends at\n"
+            "      \"height\": xxxx,              (numeric) the height of the block being scanned\n"
+            "      \"progress\": x.xxx,           (numeric) share of the blocks scanned so far\n"
+            "      \"duration\": xxxx,            (numeric) seconds since the rescan started\n"
+            "      \"blockspersecond\": x.xx,     (numeric) blocks scanned per second\n"
+            "    }\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getwalletinfo", "")
             + HelpExampleRpc("getwalletinfo", "")
         );
 
-    LOCK2(cs_main, pwalletMain->cs_wallet);
+    int nStartHeight, nStopHeight, nHeight;
+    int64_t nDurationMillis;
+    UniValue scanning(UniValue::VOBJ);
+    bool fScanning = pwalletMain->rescanProgress.Get(nStartHeight, nStopHeight, nHeight, nDurationMillis);
+    if (fScanning) {
+        int nScanned = nHeight - nStartHeight;
+        scanning.push_back(Pair("startheight", nStartHeight));
+        scanning.push_back(Pair("stopheight", nStopHeight));
+        scanning.push_back(Pair("height", nHeight));
+        scanning.push_back(Pair("progress", nStopHeight > nStartHeight ? (double)nScanned / (nStopHeight - nStartHeight) : 0.0));
+        scanning.push_back(Pair("duration", nDurationMillis / 1000));
+        scanning.push_back(Pair("blockspersecond", nDurationMillis > 0 ? nScanned * 1000.0 / nDurationMillis : 0.0));
+    }
 
-    CHDChain hdChainCurrent;
-    bool fHDEnabled = pwalletMain->GetHDChain(hdChainCurrent);
+    // a rescan holds the wallet until it is done, don't wait for it
+    CCriticalBlock lockMain(cs_main, "cs_main", __FILE__, __LINE__, fScanning);
+    CCriticalBlock lockWallet(pwalletMain->cs_wallet, "pwalletMain->cs_wallet", __FILE__, __LINE__, fScanning);
     UniValue obj(UniValue::VOBJ);
-    obj.push_back(Pair("walletversion", pwalletMain->GetVersion()));
-    obj.push_back(Pair("balance",       ValueFromAmount(pwalletMain->GetBalance())));
-    obj.push_back(Pair("unconfirmed_balance", ValueFromAmount(pwalletMain->GetUnconfirmedBalance())));
-    obj.push_back(Pair("immature_balance",    ValueFromAmount(pwalletMain->GetImmatureBalance())));
-    obj.push_back(Pair("txcount",       (int)pwalletMain->mapWallet.size()));
-    obj.push_back(Pair("keypoololdest", pwalletMain->GetOldestKeyPoolTime()));
-    obj.push_back(Pair("keypoolsize",   (int64_t)pwalletMain->KeypoolCountExternalKeys()));
-    if (fHDEnabled) {
-        obj.push_back(Pair("keypoolsize_hd_internal",   (int64_t)(pwalletMain->KeypoolCountInternalKeys())));
-    }
-    obj.push_back(Pair("keys_left",     pwalletMain->nKeysLeftSinceAutoBackup));
-    if (pwalletMain->IsCrypted())
-        obj.push_back(Pair("unlocked_until", nWalletUnlockTime));
-    obj.push_back(Pair("paytxfee",      ValueFromAmount(payTxFee.GetFeePerK())));
-    if (fHDEnabled) {
-        obj.push_back(Pair("hdchainid", hdChainCurrent.GetID().GetHex()));
-        obj.push_back(Pair("hdaccountcount", (int64_t)hdChainCurrent.CountAccounts()));
-        UniValue accounts(UniValue::VARR);
-        for (size_t i = 0; i < hdChainCurrent.CountAccounts(); ++i)
-        {
-            CHDAccount acc;
-            UniValue account(UniValue::VOBJ);
-            account.push_back(Pair("hdaccountindex", (int64_t)i));
-            if(hdChainCurrent.GetAccount(i, acc)) {
-                account.push_back(Pair("hdexternalkeyindex", (int64_t)acc.nExternalChainCounter));
-                account.push_back(Pair("hdinternalkeyindex", (int64_t)acc.nInternalChainCounter));
-            } else {
-                account.push_back(Pair("error", strprintf("account %d is missing", i)));
+    if (lockMain && lockWallet) {
+        CHDChain hdChainCurrent;
+        bool fHDEnabled = pwalletMain->GetHDChain(hdChainCurrent);
+        obj.push_back(Pair("walletversion", pwalletMain->GetVersion()));
+        obj.push_back(Pair("balance",       ValueFromAmount(pwalletMain->GetBalance())));
+        obj.push_back(Pair("unconfirmed_balance", ValueFromAmount(pwalletMain->GetUnconfirmedBalance())));
+        obj.push_back(Pair("immature_balance",    ValueFromAmount(pwalletMain->GetImmatureBalance())));
+        obj.push_back(Pair("txcount",       (int)pwalletMain->mapWallet.size()));
+        obj.push_back(Pair("keypoololdest", pwalletMain->GetOldestKeyPoolTime()));
+        obj.push_back(Pair("keypoolsize",   (int64_t)pwalletMain->KeypoolCountExternalKeys()));
+        if (fHDEnabled) {
+            obj.push_back(Pair("keypoolsize_hd_internal",   (int64_t)(pwalletMain->KeypoolCountInternalKeys())));
+        }
+        obj.push_back(Pair("keys_left",     pwalletMain->nKeysLeftSinceAutoBackup));
+        if (pwalletMain->IsCrypted())
+            obj.push_back(Pair("unlocked_until", nWalletUnlockTime));
+        obj.push_back(Pair("paytxfee",      ValueFromAmount(payTxFee.GetFeePerK())));
+        if (fHDEnabled) {
+            obj.push_back(Pair("hdchainid", hdChainCurrent.GetID().GetHex()));
+            obj.push_back(Pair("hdaccountcount", (int64_t)hdChainCurrent.CountAccounts()));
+            UniValue accounts(UniValue::VARR);
+            for (size_t i = 0; i < hdChainCurrent.CountAccounts(); ++i)
+            {
+                CHDAccount acc;
+                UniValue account(UniValue::VOBJ);
+                account.push_back(Pair("hdaccountindex", (int64_t)i));
+                if(hdChainCurrent.GetAccount(i, acc)) {
+                    account.push_back(Pair("hdexternalkeyindex", (int64_t)acc.nExternalChainCounter));
+                    account.push_back(Pair("hdinternalkeyindex", (int64_t)acc.nInternalChainCounter));
+                } else {
+                    account.push_back(Pair("error", strprintf("account %d is missing", i)));
+                }
+                accounts.push_back(account);
             }
-            accounts.push_back(account);
+            obj.push_back(Pair("hdaccounts", accounts));
         }
-        obj.push_back(Pair("hdaccounts", accounts));
+    } else {
+        // only what can be read without the wallet lock
+        obj.push_back(Pair("keys_left",     pwalletMain->nKeysLeftSinceAutoBackup));
+        if (pwalletMain->IsCrypted())
+            obj.push_back(Pair("unlocked_until", nWalletUnlockTime));
+        obj.push_back(Pair("paytxfee",      ValueFromAmount(payTxFee.GetFeePerK())));
     }
+    if (fScanning)
+        obj.push_back(Pair("scanning", scanning));
+    else
+        obj.push_back(Pair("scanning", false));
 
     return obj;
 }
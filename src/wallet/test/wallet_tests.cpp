@@ -4,6 +4,10 @@
 
 #include "wallet/wallet.h"
 
+#include "consensus/consensus.h"
+#include "consensus/validation.h"
+#include "main.h"
+
 #include <set>
 #include <stdint.h>
 #include <utility>
@@ -361,4 +365,38 @@ BOOST_AUTO_TEST_CASE(ApproximateBestSubset)
     BOOST_CHECK_EQUAL(setCoinsRet.size(), 101);
 }
 
+BOOST_FIXTURE_TEST_CASE(balance_settled_coinbase, TestChain100Setup)
+{
+    // the first coinbase matures with one more block
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    CBlock block = CreateAndProcessBlock(std::vector<CMutableTransaction>(), scriptPubKey);
+
+    CWallet walletCoinbase;
+    {
+        LOCK(walletCoinbase.cs_wallet);
+        BOOST_CHECK(walletCoinbase.AddKeyPubKey(coinbaseKey, coinbaseKey.GetPubKey()));
+    }
+    walletCoinbase.ScanForWalletTransactions(chainActive.Genesis());
+
+    CAmount nCreditFirst = walletCoinbase.mapWallet[coinbaseTxns[0].GetHash()].GetCredit(ISMINE_SPENDABLE);
+    CAmount nCreditLast = walletCoinbase.mapWallet[block.vtx[0].GetHash()].GetCredit(ISMINE_SPENDABLE);
+    BOOST_CHECK(nCreditFirst > 0);
+
+    // the mature coinbase is settled by the first call and stays counted
+    CWalletBalance balance = walletCoinbase.GetBalances();
+    BOOST_CHECK_EQUAL(balance.nTrusted, nCreditFirst);
+    CAmount nImmature = balance.nImmature;
+    balance = walletCoinbase.GetBalances();
+    BOOST_CHECK_EQUAL(balance.nTrusted, nCreditFirst);
+    BOOST_CHECK_EQUAL(balance.nImmature, nImmature);
+
+    // it is immature again once the tip goes back, although its block is still connected
+    CValidationState state;
+    BOOST_CHECK(InvalidateBlock(state, Params().GetConsensus(), chainActive.Tip()));
+    BOOST_CHECK_EQUAL(chainActive.Height(), COINBASE_MATURITY);
+    balance = walletCoinbase.GetBalances();
+    BOOST_CHECK_EQUAL(balance.nTrusted, 0);
+    BOOST_CHECK_EQUAL(balance.nImmature, nImmature + nCreditFirst - nCreditLast);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,173 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "wallet/txloader.h"
+
+#include "consensus/validation.h"
+#include "main.h" // For CheckTransaction
+#include "util.h"
+
+#include <boost/bind.hpp>
+
+bool ReadWalletTxRecord(CDataStream& ssKey, CDataStream& ssValue, CWalletTx& wtx, bool& fUpgradedRet, std::string& strErr)
+{
+    uint256 hash;
+    ssKey >> hash;
+    ssValue >> wtx;
+    CValidationState state;
+    if (!(CheckTransaction(wtx, state) && (wtx.GetHash() == hash) && state.IsValid()))
+        return false;
+
+    fUpgradedRet = false;
+    // Undo serialize changes in 31600
+    if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
+    {
+        if (!ssValue.empty())
+        {
+            char fTmp;
+            char fUnused;
+            ssValue >> fTmp >> fUnused >> wtx.strFromAccount;
+            strErr = strprintf("LoadWallet() upgrading tx ver=%d %d '%s' %s",
+                               wtx.fTimeReceivedIsTxTime, fTmp, wtx.strFromAccount, hash.ToString());
+            wtx.fTimeReceivedIsTxTime = fTmp;
+        }
+        else
+        {
+            strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
+            wtx.fTimeReceivedIsTxTime = 0;
+        }
+        fUpgradedRet = true;
+    }
+    return true;
+}
+
+CWalletTxLoader::CWalletTxLoader(int nThreads) :
+    pchunkCurrent(new RecordChunk()),
+    nChunks(0),
+    fDone(false)
+{
+    if (nThreads < 1)
+        nThreads = 1;
+    if (nThreads > MAX_WALLET_LOAD_THREADS)
+        nThreads = MAX_WALLET_LOAD_THREADS;
+    // don't let the cursor get too far ahead, the raw records take memory too
+    nMaxQueued = 2 * nThreads;
+    pchunkCurrent->reserve(WALLET_LOAD_CHUNK_SIZE);
+    for (int i = 0; i < nThreads; i++)
+        threadGroup.create_thread(boost::bind(&CWalletTxLoader::ThreadLoad, this));
+}
+
+CWalletTxLoader::~CWalletTxLoader()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fDone = true;
+    }
+    condWorker.notify_all();
+    threadGroup.join_all();
+}
+
+void CWalletTxLoader::Add(const CDataStream& ssKey, const CDataStream& ssValue)
+{
+    pchunkCurrent->push_back(std::make_pair(ssKey, ssValue));
+    if (pchunkCurrent->size() >= WALLET_LOAD_CHUNK_SIZE)
+        QueueChunk();
+}
+
+void CWalletTxLoader::QueueChunk()
+{
+    if (pchunkCurrent->empty())
+        return;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (mapQueued.size() >= nMaxQueued)
+            condQueue.wait(lock);
+        mapQueued[nChunks++] = pchunkCurrent;
+    }
+    condWorker.notify_one();
+    pchunkCurrent.reset(new RecordChunk());
+    pchunkCurrent->reserve(WALLET_LOAD_CHUNK_SIZE);
+}
+
+void CWalletTxLoader::LoadChunk(RecordChunk& chunk, CChunkResult& result)
+{
+    for (size_t i = 0; i < chunk.size(); i++) {
+        CDataStream& ssKey = chunk[i].first;
+        CDataStream& ssValue = chunk[i].second;
+        result.lWtx.push_back(CWalletTx());
+        bool fOk = false;
+        bool fUpgraded = false;
+        std::string strErr;
+        try {
+            std::string strType;
+            ssKey >> strType;
+            fOk = ReadWalletTxRecord(ssKey, ssValue, result.lWtx.back(), fUpgraded, strErr);
+        } catch (...) {
+            fOk = false;
+        }
+        if (!strErr.empty())
+            result.vErrors.push_back(strErr);
+        if (!fOk) {
+            result.lWtx.pop_back();
+            result.nFailed++;
+            continue;
+        }
+        if (fUpgraded)
+            result.vUpgraded.push_back(result.lWtx.back().GetHash());
+    }
+}
+
+void CWalletTxLoader::ThreadLoad()
+{
+    RenameThread("3dcoin-walletload");
+    while (true) {
+        size_t nChunk;
+        boost::shared_ptr<RecordChunk> pchunk;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (mapQueued.empty() && !fDone)
+                condWorker.wait(lock);
+            if (mapQueued.empty())
+                return;
+            nChunk = mapQueued.begin()->first;
+            pchunk = mapQueued.begin()->second;
+            mapQueued.erase(mapQueued.begin());
+        }
+        condQueue.notify_all();
+
+        CChunkResult result;
+        LoadChunk(*pchunk, result);
+        pchunk.reset();
+
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            CChunkResult& stored = mapResults[nChunk];
+            stored.lWtx.swap(result.lWtx);
+            stored.vUpgraded.swap(result.vUpgraded);
+            stored.vErrors.swap(result.vErrors);
+            stored.nFailed = result.nFailed;
+        }
+    }
+}
+
+void CWalletTxLoader::Finish(std::list<CWalletTx>& lWtxRet, std::vector<uint256>& vUpgradedRet, std::vector<std::string>& vErrorsRet, unsigned int& nFailedRet)
+{
+    QueueChunk();
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fDone = true;
+    }
+    condWorker.notify_all();
+    threadGroup.join_all();
+
+    nFailedRet = 0;
+    for (std::map<size_t, CChunkResult>::iterator it = mapResults.begin(); it != mapResults.end(); ++it) {
+        CChunkResult& result = it->second;
+        lWtxRet.splice(lWtxRet.end(), result.lWtx);
+        vUpgradedRet.insert(vUpgradedRet.end(), result.vUpgraded.begin(), result.vUpgraded.end());
+        vErrorsRet.insert(vErrorsRet.end(), result.vErrors.begin(), result.vErrors.end());
+        nFailedRet += result.nFailed;
+    }
+    mapResults.clear();
+}
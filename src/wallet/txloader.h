@@ -0,0 +1,80 @@
+// Copyright (c) 2014-2017 The Dash Core developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef WALLET_TXLOADER_H
+#define WALLET_TXLOADER_H
+
+#include "streams.h"
+#include "wallet/wallet.h"
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+
+/** Don't start more threads than this to load the txes of a wallet */
+static const int MAX_WALLET_LOAD_THREADS = 8;
+/** Wallet tx records handed to a loader thread at once */
+static const size_t WALLET_LOAD_CHUNK_SIZE = 1000;
+
+/**
+ * Reads a "tx" wallet record, ssKey must be past the record type. Checks the tx
+ * and fixes up ones written by 0.3.16 (fUpgradedRet is set then, strErr tells what was done).
+ */
+bool ReadWalletTxRecord(CDataStream& ssKey, CDataStream& ssValue, CWalletTx& wtx, bool& fUpgradedRet, std::string& strErr);
+
+/**
+ * Deserializes and checks the "tx" records of a wallet on a few threads while
+ * the caller goes on reading the database. The txes are handed back in the
+ * order the records were added, see CWallet::LoadWalletTxes().
+ */
+class CWalletTxLoader
+{
+private:
+    typedef std::vector<std::pair<CDataStream, CDataStream> > RecordChunk;
+
+    struct CChunkResult
+    {
+        std::list<CWalletTx> lWtx;
+        std::vector<uint256> vUpgraded;
+        std::vector<std::string> vErrors;
+        unsigned int nFailed;
+
+        CChunkResult() : nFailed(0) {}
+    };
+
+    boost::mutex mutex;
+    boost::condition_variable condWorker;
+    boost::condition_variable condQueue;
+    boost::thread_group threadGroup;
+
+    boost::shared_ptr<RecordChunk> pchunkCurrent;
+    std::map<size_t, boost::shared_ptr<RecordChunk> > mapQueued;
+    std::map<size_t, CChunkResult> mapResults;
+    size_t nChunks;
+    size_t nMaxQueued;
+    bool fDone;
+
+    void ThreadLoad();
+    void QueueChunk();
+    static void LoadChunk(RecordChunk& chunk, CChunkResult& result);
+
+public:
+    explicit CWalletTxLoader(int nThreads);
+    ~CWalletTxLoader();
+
+    /// Queues a "tx" record (the key still starting with the record type)
+    void Add(const CDataStream& ssKey, const CDataStream& ssValue);
+
+    /**
+     * Waits for all records and returns the txes, the hashes of the ones upgraded,
+     * messages to log and how many records could not be read
+     */
+    void Finish(std::list<CWalletTx>& lWtxRet, std::vector<uint256>& vUpgradedRet, std::vector<std::string>& vErrorsRet, unsigned int& nFailedRet);
+};
+
+#endif // WALLET_TXLOADER_H
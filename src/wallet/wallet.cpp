@@ -47,6 +47,7 @@ CAmount maxTxFee = DEFAULT_TRANSACTION_MAXFEE;
 unsigned int nTxConfirmTarget = DEFAULT_TX_CONFIRM_TARGET;
 bool bSpendZeroConfChange = DEFAULT_SPEND_ZEROCONF_CHANGE;
 bool fSendFreeTransactions = DEFAULT_SEND_FREE_TRANSACTIONS;
+bool fCheckWalletBalances = false;
 
 /** 
  * Fees smaller than this (in duffs) are considered zero fee (for transaction creation)
@@ -76,6 +77,13 @@ struct CompareValueOnly
     }
 };
 
+std::string CWalletBalance::ToString() const
+{
+    return strprintf("CWalletBalance(trusted=%s, pending=%s, immature=%s, watchonly trusted=%s, pending=%s, immature=%s)",
+                     FormatMoney(nTrusted), FormatMoney(nUntrustedPending), FormatMoney(nImmature),
+                     FormatMoney(nWatchOnlyTrusted), FormatMoney(nWatchOnlyUntrustedPending), FormatMoney(nWatchOnlyImmature));
+}
+
 std::string COutput::ToString() const
 {
     return strprintf("COutput(%s, %d, %d) [%s]", tx->GetHash().ToString(), i, nDepth, FormatMoney(tx->vout[i].nValue));
@@ -100,45 +108,90 @@ const CWalletTx* CWallet::GetWalletTx(const uint256& hash) const
     return &(it->second);
 }
 
+/** Don't use more threads than this to generate or derive keys */
+static const int MAX_KEYGEN_THREADS = 8;
+/** Smaller batches of keys are generated on the calling thread */
+static const size_t MIN_KEYGEN_PARALLEL_BATCH = 32;
+
+static void KeyGenRange(const boost::function<void(size_t)>& func, size_t nBegin, size_t nEnd)
+{
+    for (size_t i = nBegin; i < nEnd; i++)
+        func(i);
+}
+
+// Calls func for every index of the batch, split over a few threads if there are enough of them
+static void RunKeyGenBatch(size_t nCount, const boost::function<void(size_t)>& func)
+{
+    int nThreads = std::min(GetNumCores(), MAX_KEYGEN_THREADS);
+    if (nThreads <= 1 || nCount < MIN_KEYGEN_PARALLEL_BATCH) {
+        KeyGenRange(func, 0, nCount);
+        return;
+    }
+
+    boost::thread_group threadGroup;
+    size_t nPerThread = (nCount + nThreads - 1) / nThreads;
+    for (size_t nBegin = 0; nBegin < nCount; nBegin += nPerThread)
+        threadGroup.create_thread(boost::bind(&KeyGenRange, boost::cref(func), nBegin, std::min(nBegin + nPerThread, nCount)));
+    threadGroup.join_all();
+}
+
+static void MakeNewKeyAt(bool fCompressed, std::vector<CKey>* pvKeys, std::vector<CPubKey>* pvPubKeys, size_t i)
+{
+    (*pvKeys)[i].MakeNewKey(fCompressed);
+    (*pvPubKeys)[i] = (*pvKeys)[i].GetPubKey();
+    assert((*pvKeys)[i].VerifyPubKey((*pvPubKeys)[i]));
+}
+
+static void DeriveChildKeyAt(const CExtKey* pParentKey, uint32_t nFirstChildIndex, std::vector<CExtKey>* pvKeys, std::vector<CPubKey>* pvPubKeys, size_t i)
+{
+    pParentKey->Derive((*pvKeys)[i], nFirstChildIndex + i);
+    (*pvPubKeys)[i] = (*pvKeys)[i].key.GetPubKey();
+    assert((*pvKeys)[i].key.VerifyPubKey((*pvPubKeys)[i]));
+}
+
 CPubKey CWallet::GenerateNewKey(uint32_t nAccountIndex, bool fInternal)
+{
+    std::vector<CPubKey> vPubKeys;
+    GenerateNewKeys(1, nAccountIndex, fInternal, vPubKeys);
+    return vPubKeys[0];
+}
+
+void CWallet::GenerateNewKeys(unsigned int nCount, uint32_t nAccountIndex, bool fInternal, std::vector<CPubKey>& vPubKeysRet)
 {
     AssertLockHeld(cs_wallet); // mapKeyMetadata
     bool fCompressed = CanSupportFeature(FEATURE_COMPRPUBKEY); // default to compressed public keys if we want 0.6.0 wallets
 
-    CKey secret;
-
     // Create new metadata
     int64_t nCreationTime = GetTime();
     CKeyMetadata metadata(nCreationTime);
 
-    CPubKey pubkey;
     // use HD key derivation if HD was enabled during wallet creation
     if (IsHDEnabled()) {
-        DeriveNewChildKey(metadata, secret, nAccountIndex, fInternal);
-        pubkey = secret.GetPubKey();
-    } else {
-        secret.MakeNewKey(fCompressed);
+        DeriveNewChildKeys(metadata, nCount, nAccountIndex, fInternal, vPubKeysRet);
+        return;
+    }
 
-        // Compressed public keys were introduced in version 0.6.0
-        if (fCompressed)
-            SetMinVersion(FEATURE_COMPRPUBKEY);
+    std::vector<CKey> vKeys(nCount);
+    std::vector<CPubKey> vPubKeys(nCount);
+    RunKeyGenBatch(nCount, boost::bind(&MakeNewKeyAt, fCompressed, &vKeys, &vPubKeys, _1));
 
-        pubkey = secret.GetPubKey();
-        assert(secret.VerifyPubKey(pubkey));
+    // Compressed public keys were introduced in version 0.6.0
+    if (fCompressed)
+        SetMinVersion(FEATURE_COMPRPUBKEY, pwalletdbEncryption);
 
-    // Create new metadata
-        mapKeyMetadata[pubkey.GetID()] = metadata;
-        if (!nTimeFirstKey || nCreationTime < nTimeFirstKey)
-            nTimeFirstKey = nCreationTime;
+    if (!nTimeFirstKey || nCreationTime < nTimeFirstKey)
+        nTimeFirstKey = nCreationTime;
 
-        if (!AddKeyPubKey(secret, pubkey))
+    for (unsigned int i = 0; i < nCount; i++) {
+        mapKeyMetadata[vPubKeys[i].GetID()] = metadata;
+        // returned before it's added, so a failed batch can remove it again
+        vPubKeysRet.push_back(vPubKeys[i]);
+        if (!AddKeyPubKey(vKeys[i], vPubKeys[i]))
             throw std::runtime_error(std::string(__func__) + ": AddKey failed");
     }
-
-    return pubkey;
 }
 
-void CWallet::DeriveNewChildKey(const CKeyMetadata& metadata, CKey& secretRet, uint32_t nAccountIndex, bool fInternal)
+void CWallet::DeriveNewChildKeys(const CKeyMetadata& metadata, unsigned int nCount, uint32_t nAccountIndex, bool fInternal, std::vector<CPubKey>& vPubKeysRet)
 {
     CHDChain hdChainTmp;
     if (!GetHDChain(hdChainTmp)) {
@@ -155,25 +208,38 @@ void CWallet::DeriveNewChildKey(const CKeyMetadata& metadata, CKey& secretRet, u
     if (!hdChainTmp.GetAccount(nAccountIndex, acc))
         throw std::runtime_error(std::string(__func__) + ": Wrong HD account!");
 
-    // derive child key at next index, skip keys already known to the wallet
-    CExtKey childKey;
+    // all keys of the batch are children of the same key, derive it just once
+    CExtKey changeKey;
+    hdChainTmp.DeriveChangeExtKey(nAccountIndex, fInternal, changeKey);
+
+    // derive child keys starting at next index, skip keys already known to the wallet
     uint32_t nChildIndex = fInternal ? acc.nInternalChainCounter : acc.nExternalChainCounter;
-    do {
-        hdChainTmp.DeriveChildExtKey(nAccountIndex, fInternal, nChildIndex, childKey);
-        // increment childkey index
-        nChildIndex++;
-    } while (HaveKey(childKey.key.GetPubKey().GetID()));
-    secretRet = childKey.key;
-
-    CPubKey pubkey = secretRet.GetPubKey();
-    assert(secretRet.VerifyPubKey(pubkey));
-
-    // store metadata
-    mapKeyMetadata[pubkey.GetID()] = metadata;
+    unsigned int nFound = 0;
+    while (nFound < nCount) {
+        size_t nMissing = nCount - nFound;
+        std::vector<CExtKey> vChildKeys(nMissing);
+        std::vector<CPubKey> vChildPubKeys(nMissing);
+        RunKeyGenBatch(nMissing, boost::bind(&DeriveChildKeyAt, &changeKey, nChildIndex, &vChildKeys, &vChildPubKeys, _1));
+        nChildIndex += nMissing;
+
+        for (size_t i = 0; i < nMissing; i++) {
+            CKeyID keyID = vChildPubKeys[i].GetID();
+            if (HaveKey(keyID))
+                continue;
+
+            // store metadata
+            mapKeyMetadata[keyID] = metadata;
+            vPubKeysRet.push_back(vChildPubKeys[i]);
+            if (!AddHDPubKey(vChildKeys[i].Neuter(), fInternal))
+                throw std::runtime_error(std::string(__func__) + ": AddHDPubKey failed");
+            nFound++;
+        }
+    }
+
     if (!nTimeFirstKey || metadata.nCreateTime < nTimeFirstKey)
         nTimeFirstKey = metadata.nCreateTime;
 
-    // update the chain model in the database
+    // update the chain model in the database, once for the whole batch
     CHDChain hdChainCurrent;
     GetHDChain(hdChainCurrent);
 
@@ -188,16 +254,25 @@ void CWallet::DeriveNewChildKey(const CKeyMetadata& metadata, CKey& secretRet, u
         throw std::runtime_error(std::string(__func__) + ": SetAccount failed");
 
     if (IsCrypted()) {
-        if (!SetCryptedHDChain(hdChainCurrent, false))
+        if (!SetCryptedHDChain(hdChainCurrent, !fFileBacked))
             throw std::runtime_error(std::string(__func__) + ": SetCryptedHDChain failed");
     }
     else {
-        if (!SetHDChain(hdChainCurrent, false))
+        if (!SetHDChain(hdChainCurrent, !fFileBacked))
             throw std::runtime_error(std::string(__func__) + ": SetHDChain failed");
     }
+}
 
-    if (!AddHDPubKey(childKey.Neuter(), fInternal))
-        throw std::runtime_error(std::string(__func__) + ": AddHDPubKey failed");
+void CWallet::RemoveNewKeys(const std::vector<CPubKey>& vPubKeys)
+{
+    AssertLockHeld(cs_wallet); // mapKeyMetadata, mapHdPubKeys
+    BOOST_FOREACH(const CPubKey& pubkey, vPubKeys)
+    {
+        CKeyID keyID = pubkey.GetID();
+        mapKeyMetadata.erase(keyID);
+        if (!mapHdPubKeys.erase(keyID))
+            RemoveKey(keyID);
+    }
 }
 
 bool CWallet::GetPubKey(const CKeyID &address, CPubKey& vchPubKeyOut) const
@@ -283,6 +358,8 @@ bool CWallet::AddHDPubKey(const CExtPubKey &extPubKey, bool fInternal)
     if (!fFileBacked)
         return true;
 
+    if (pwalletdbEncryption)
+        return pwalletdbEncryption->WriteHDPubKey(hdPubKey, mapKeyMetadata[extPubKey.pubkey.GetID()]);
     return CWalletDB(strWalletFile).WriteHDPubKey(hdPubKey, mapKeyMetadata[extPubKey.pubkey.GetID()]);
 }
 
@@ -305,6 +382,10 @@ bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey &pubkey)
     if (!fFileBacked)
         return true;
     if (!IsCrypted()) {
+        if (pwalletdbEncryption)
+            return pwalletdbEncryption->WriteKey(pubkey,
+                                                 secret.GetPrivKey(),
+                                                 mapKeyMetadata[pubkey.GetID()]);
         return CWalletDB(strWalletFile).WriteKey(pubkey,
                                                  secret.GetPrivKey(),
                                                  mapKeyMetadata[pubkey.GetID()]);
@@ -391,9 +472,13 @@ bool CWallet::RemoveWatchOnly(const CScript &dest)
         return false;
     if (!HaveWatchOnly())
         NotifyWatchonlyChanged(false);
-    if (fFileBacked)
-        if (!CWalletDB(strWalletFile).EraseWatchOnly(dest))
+    if (fFileBacked) {
+        if (pwalletdbEncryption) {
+            if (!pwalletdbEncryption->EraseWatchOnly(dest))
+                return false;
+        } else if (!CWalletDB(strWalletFile).EraseWatchOnly(dest))
             return false;
+    }
 
     return true;
 }
@@ -524,6 +609,20 @@ void CWallet::SetBestChain(const CBlockLocator& loc)
 {
     CWalletDB walletdb(strWalletFile);
     walletdb.WriteBestBlock(loc);
+
+    // only the PrivateSend rounds calculated since the last flush are written
+    LOCK(cs_wallet);
+    if (!setPrivateSendRoundsDirty.empty()) {
+        bool fBatch = walletdb.TxnBegin();
+        BOOST_FOREACH(const COutPoint& outpoint, setPrivateSendRoundsDirty) {
+            std::map<COutPoint, int8_t>::const_iterator it = mapPrivateSendRoundsCache.find(outpoint);
+            if (it != mapPrivateSendRoundsCache.end())
+                walletdb.WritePrivateSendRounds(outpoint, nPrivateSendRoundsGeneration, it->second);
+        }
+        if (fBatch)
+            walletdb.TxnCommit();
+        setPrivateSendRoundsDirty.clear();
+    }
 }
 
 bool CWallet::SetMinVersion(enum WalletFeature nVersion, CWalletDB* pwalletdbIn, bool fExplicit)
@@ -707,6 +806,8 @@ void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
     pair<TxSpends::iterator, TxSpends::iterator> range;
     range = mapTxSpends.equal_range(outpoint);
     SyncMetaData(range);
+
+    UnindexCoinIfSpent(outpoint);
 }
 
 
@@ -873,12 +974,68 @@ void CWallet::MarkDirty()
         LOCK(cs_wallet);
         BOOST_FOREACH(PAIRTYPE(const uint256, CWalletTx)& item, mapWallet)
             item.second.MarkDirty();
+        // e.g. keys or watch-only scripts were imported, which outputs are ours may have changed
+        fCoinsByAmountIndexed = false;
     }
 
     fAnonymizableTallyCached = false;
     fAnonymizableTallyCachedNonDenom = false;
 }
 
+void CWallet::LoadWalletTxes(std::list<CWalletTx>& lWtx)
+{
+    AssertLockHeld(cs_wallet);
+
+    // All txes go in first, so spends and conflicts are found no matter in which order the records come.
+    // Each tx leaves the list as soon as it's in mapWallet, so the wallet isn't held twice in memory.
+    std::vector<CWalletTx*> vLoaded;
+    vLoaded.reserve(lWtx.size());
+    while (!lWtx.empty())
+    {
+        const CWalletTx& wtxIn = lWtx.front();
+        uint256 hash = wtxIn.GetHash();
+        // the records come sorted by hash, i.e. in the order of mapWallet
+        map<uint256, CWalletTx>::iterator it = mapWallet.insert(mapWallet.end(), make_pair(hash, wtxIn));
+        lWtx.pop_front();
+        CWalletTx& wtx = it->second;
+        wtx.BindWallet(this);
+        wtxOrdered.insert(make_pair(wtx.nOrderPos, TxPair(&wtx, (CAccountingEntry*)0)));
+        if (!wtx.IsCoinBase()) {
+            BOOST_FOREACH(const CTxIn& txin, wtx.vin)
+                mapTxSpends.insert(make_pair(txin.prevout, hash));
+        }
+        vLoaded.push_back(&wtx);
+    }
+
+    // Metadata of txes spending the same outputs is synced once per output instead of once per tx
+    TxSpends::iterator itSpend = mapTxSpends.begin();
+    while (itSpend != mapTxSpends.end())
+    {
+        TxSpends::iterator itEnd = itSpend;
+        size_t nSpends = 0;
+        while (itEnd != mapTxSpends.end() && itEnd->first == itSpend->first) {
+            ++itEnd;
+            ++nSpends;
+        }
+        if (nSpends > 1)
+            SyncMetaData(make_pair(itSpend, itEnd));
+        itSpend = itEnd;
+    }
+
+    BOOST_FOREACH(const CWalletTx* pwtx, vLoaded)
+    {
+        BOOST_FOREACH(const CTxIn& txin, pwtx->vin) {
+            map<uint256, CWalletTx>::const_iterator itPrev = mapWallet.find(txin.prevout.hash);
+            if (itPrev == mapWallet.end())
+                continue;
+            const CWalletTx& prevtx = itPrev->second;
+            if (prevtx.nIndex == -1 && !prevtx.hashUnset()) {
+                MarkConflicted(prevtx.hashBlock, pwtx->GetHash());
+            }
+        }
+    }
+}
+
 bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletDB* pwalletdb)
 {
     uint256 hash = wtxIn.GetHash();
@@ -909,6 +1066,11 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
         bool fInsertedNew = ret.second;
         if (fInsertedNew)
         {
+            // We already have txes spending this one, their PrivateSend rounds were calculated without it
+            TxSpends::const_iterator itSpend = mapTxSpends.lower_bound(COutPoint(hash, 0));
+            if (itSpend != mapTxSpends.end() && itSpend->first.hash == hash)
+                ClearPrivateSendRoundsCache(pwalletdb);
+
             wtx.nTimeReceived = GetAdjustedTime();
             wtx.nOrderPos = IncOrderPosNext(pwalletdb);
             wtxOrdered.insert(make_pair(wtx.nOrderPos, TxPair(&wtx, (CAccountingEntry*)0)));
@@ -958,6 +1120,8 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
                              wtxIn.hashBlock.ToString());
             }
             AddToSpends(hash);
+            for (unsigned int i = 0; i < wtx.vout.size(); i++)
+                IndexCoin(COutPoint(hash, i));
         }
 
         bool fUpdated = false;
@@ -985,6 +1149,12 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
                 wtx.fFromMe = wtxIn.fFromMe;
                 fUpdated = true;
             }
+            // e.g. an abandoned tx which is back in the mempool spends its inputs again
+            if (fUpdated)
+            {
+                BOOST_FOREACH(const CTxIn& txin, wtx.vin)
+                    UnindexCoinIfSpent(txin.prevout);
+            }
         }
 
         //// debug print
@@ -1111,6 +1281,7 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
             {
                 if (mapWallet.count(txin.prevout.hash))
                     mapWallet[txin.prevout.hash].MarkDirty();
+                IndexCoin(txin.prevout);
             }
         }
     }
@@ -1175,6 +1346,7 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
             {
                 if (mapWallet.count(txin.prevout.hash))
                     mapWallet[txin.prevout.hash].MarkDirty();
+                IndexCoin(txin.prevout);
             }
         }
     }
@@ -1187,6 +1359,14 @@ void CWallet::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
 {
     LOCK2(cs_main, cs_wallet);
 
+    // A confirmed tx synced without a block means it was disconnected, drop cached
+    // PrivateSend rounds as they can change on reorgs
+    if (pblock == NULL) {
+        std::map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(tx.GetHash());
+        if (mi != mapWallet.end() && !mi->second.hashUnset())
+            ClearPrivateSendRoundsCache();
+    }
+
     if (!AddToWalletIfInvolvingMe(tx, pblock, true))
         return; // Not one of ours
 
@@ -1238,8 +1418,6 @@ CAmount CWallet::GetDebit(const CTxIn &txin, const isminefilter& filter) const
 // Recursively determine the rounds of a given input (How deep is the PrivateSend chain for a given input)
 int CWallet::GetRealInputPrivateSendRounds(CTxIn txin, int nRounds) const
 {
-    static std::map<uint256, CMutableTransaction> mDenomWtxes;
-
     if(nRounds >= 16) return 15; // 16 rounds max
 
     uint256 hash = txin.prevout.hash;
@@ -1248,17 +1426,12 @@ int CWallet::GetRealInputPrivateSendRounds(CTxIn txin, int nRounds) const
     const CWalletTx* wtx = GetWalletTx(hash);
     if(wtx != NULL)
     {
-        std::map<uint256, CMutableTransaction>::const_iterator mdwi = mDenomWtxes.find(hash);
-        if (mdwi == mDenomWtxes.end()) {
-            // not known yet, let's add it
-            LogPrint("privatesend", "GetRealInputPrivateSendRounds INSERTING %s\n", hash.ToString());
-            mDenomWtxes[hash] = CMutableTransaction(*wtx);
-        } else if(mDenomWtxes[hash].vout[nout].nRounds != -10) {
-            // found and it's not an initial value, just return it
-            return mDenomWtxes[hash].vout[nout].nRounds;
+        std::map<COutPoint, int8_t>::const_iterator it = mapPrivateSendRoundsCache.find(txin.prevout);
+        if (it != mapPrivateSendRoundsCache.end()) {
+            // found, just return it
+            return it->second;
         }
 
-
         // bounds check
         if (nout >= wtx->vout.size()) {
             // should never actually hit this
@@ -1266,49 +1439,46 @@ int CWallet::GetRealInputPrivateSendRounds(CTxIn txin, int nRounds) const
             return -4;
         }
 
+        int nRoundsRet;
         if (IsCollateralAmount(wtx->vout[nout].nValue)) {
-            mDenomWtxes[hash].vout[nout].nRounds = -3;
-            LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
-
-        //make sure the final output is non-denominate
-        if (!IsDenominatedAmount(wtx->vout[nout].nValue)) { //NOT DENOM
-            mDenomWtxes[hash].vout[nout].nRounds = -2;
-            LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
-
-        bool fAllDenoms = true;
-        BOOST_FOREACH(CTxOut out, wtx->vout) {
-            fAllDenoms = fAllDenoms && IsDenominatedAmount(out.nValue);
-        }
-
-        // this one is denominated but there is another non-denominated output found in the same tx
-        if (!fAllDenoms) {
-            mDenomWtxes[hash].vout[nout].nRounds = 0;
-            LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-            return mDenomWtxes[hash].vout[nout].nRounds;
-        }
+            nRoundsRet = -3;
+        } else if (!IsDenominatedAmount(wtx->vout[nout].nValue)) { //NOT DENOM
+            //make sure the final output is non-denominate
+            nRoundsRet = -2;
+        } else {
+            bool fAllDenoms = true;
+            BOOST_FOREACH(const CTxOut& out, wtx->vout) {
+                fAllDenoms = fAllDenoms && IsDenominatedAmount(out.nValue);
+            }
 
-        int nShortest = -10; // an initial value, should be no way to get this by calculations
-        bool fDenomFound = false;
-        // only denoms here so let's look up
-        BOOST_FOREACH(CTxIn txinNext, wtx->vin) {
-            if (IsMine(txinNext)) {
-                int n = GetRealInputPrivateSendRounds(txinNext, nRounds + 1);
-                // denom found, find the shortest chain or initially assign nShortest with the first found value
-                if(n >= 0 && (n < nShortest || nShortest == -10)) {
-                    nShortest = n;
-                    fDenomFound = true;
+            if (!fAllDenoms) {
+                // this one is denominated but there is another non-denominated output found in the same tx
+                nRoundsRet = 0;
+            } else {
+                int nShortest = -10; // an initial value, should be no way to get this by calculations
+                bool fDenomFound = false;
+                // only denoms here so let's look up
+                BOOST_FOREACH(const CTxIn& txinNext, wtx->vin) {
+                    if (IsMine(txinNext)) {
+                        int n = GetRealInputPrivateSendRounds(txinNext, nRounds + 1);
+                        // denom found, find the shortest chain or initially assign nShortest with the first found value
+                        if(n >= 0 && (n < nShortest || nShortest == -10)) {
+                            nShortest = n;
+                            fDenomFound = true;
+                        }
+                    }
                 }
+                nRoundsRet = fDenomFound
+                        ? (nShortest >= 15 ? 16 : nShortest + 1) // good, we a +1 to the shortest one but only 16 rounds max allowed
+                        : 0;            // too bad, we are the fist one in that chain
             }
         }
-        mDenomWtxes[hash].vout[nout].nRounds = fDenomFound
-                ? (nShortest >= 15 ? 16 : nShortest + 1) // good, we a +1 to the shortest one but only 16 rounds max allowed
-                : 0;            // too bad, we are the fist one in that chain
-        LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, mDenomWtxes[hash].vout[nout].nRounds);
-        return mDenomWtxes[hash].vout[nout].nRounds;
+
+        mapPrivateSendRoundsCache.insert(std::make_pair(txin.prevout, (int8_t)nRoundsRet));
+        if (fFileBacked)
+            setPrivateSendRoundsDirty.insert(txin.prevout);
+        LogPrint("privatesend", "GetRealInputPrivateSendRounds UPDATED   %s %3d %3d\n", hash.ToString(), nout, nRoundsRet);
+        return nRoundsRet;
     }
 
     return nRounds - 1;
@@ -1322,6 +1492,31 @@ int CWallet::GetInputPrivateSendRounds(CTxIn txin) const
     return realPrivateSendRounds > nPrivateSendRounds ? nPrivateSendRounds : realPrivateSendRounds;
 }
 
+void CWallet::LoadPrivateSendRoundsCache(int64_t nGeneration, const std::map<COutPoint, int8_t>& mapRounds)
+{
+    LOCK(cs_wallet);
+    mapPrivateSendRoundsCache = mapRounds;
+    setPrivateSendRoundsDirty.clear();
+    nPrivateSendRoundsGeneration = nGeneration;
+}
+
+void CWallet::ClearPrivateSendRoundsCache(CWalletDB* pwalletdb)
+{
+    LOCK(cs_wallet);
+    if (mapPrivateSendRoundsCache.empty())
+        return;
+    LogPrint("privatesend", "CWallet::ClearPrivateSendRoundsCache -- %d entries\n", mapPrivateSendRoundsCache.size());
+    mapPrivateSendRoundsCache.clear();
+    setPrivateSendRoundsDirty.clear();
+    // entries in the wallet are outdated from now on, even if we don't get to flush again
+    nPrivateSendRoundsGeneration++;
+    if (pwalletdb) {
+        pwalletdb->WritePrivateSendRoundsGeneration(nPrivateSendRoundsGeneration);
+    } else if (fFileBacked) {
+        CWalletDB(strWalletFile).WritePrivateSendRoundsGeneration(nPrivateSendRoundsGeneration);
+    }
+}
+
 bool CWallet::IsDenominated(const CTxIn &txin) const
 {
     LOCK(cs_wallet);
@@ -1430,8 +1625,13 @@ bool CWallet::SetHDChain(const CHDChain& chain, bool memonly)
     if (!CCryptoKeyStore::SetHDChain(chain))
         return false;
 
-    if (!memonly && !CWalletDB(strWalletFile).WriteHDChain(chain))
-        throw std::runtime_error(std::string(__func__) + ": WriteHDChain failed");
+    if (!memonly) {
+        if (pwalletdbEncryption) {
+            if (!pwalletdbEncryption->WriteHDChain(chain))
+                throw std::runtime_error(std::string(__func__) + ": WriteHDChain failed");
+        } else if (!CWalletDB(strWalletFile).WriteHDChain(chain))
+            throw std::runtime_error(std::string(__func__) + ": WriteHDChain failed");
+    }
 
     return true;
 }
@@ -1676,10 +1876,32 @@ bool CWalletTx::WriteToDisk(CWalletDB *pwalletdb)
     return pwalletdb->WriteTx(GetHash(), *this);
 }
 
+void CWallet::GetScriptFilter(CWalletScriptFilter& filter) const
+{
+    AssertLockHeld(cs_wallet);
+
+    std::set<CKeyID> setKeys;
+    GetKeys(setKeys);
+    BOOST_FOREACH(const CKeyID& keyID, setKeys)
+        filter.AddID(keyID);
+    for (std::map<CKeyID, CHDPubKey>::const_iterator it = mapHdPubKeys.begin(); it != mapHdPubKeys.end(); ++it)
+        filter.AddID(it->first);
+
+    LOCK(cs_KeyStore);
+    for (ScriptMap::const_iterator it = mapScripts.begin(); it != mapScripts.end(); ++it)
+        filter.AddID(it->first);
+    BOOST_FOREACH(const CScript& script, setWatchOnly)
+        filter.AddWatchOnly(script);
+}
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
  * exist in the wallet will be updated.
+ *
+ * Blocks are read and matched against a snapshot of our keys and scripts
+ * by a pool of CBlockRescanner threads, only txes which pay to us, spend or
+ * conflict with our txes or are in the wallet already are looked at here.
  */
 int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
 {
@@ -1691,27 +1913,52 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
     {
         LOCK2(cs_main, cs_wallet);
 
+        // txes found by the rescan can change the PrivateSend rounds of the ones we have
+        ClearPrivateSendRoundsCache();
+        // and the rescan may be for keys we did not have when the coins were indexed
+        fCoinsByAmountIndexed = false;
+
         // no need to read and scan block, if block was created before
         // our wallet birthday (as adjusted for block time variability)
         while (pindex && nTimeFirstKey && (pindex->GetBlockTime() < (nTimeFirstKey - 7200)))
             pindex = chainActive.Next(pindex);
 
+        std::vector<CBlockIndex*> vpindex;
+        for (CBlockIndex* pindexScan = pindex; pindexScan; pindexScan = chainActive.Next(pindexScan))
+            vpindex.push_back(pindexScan);
+        if (vpindex.empty())
+            return ret;
+
+        CWalletScriptFilter filter;
+        GetScriptFilter(filter);
+
         ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
+        CWalletRescanGuard rescanGuard(rescanProgress, vpindex.front()->nHeight, vpindex.back()->nHeight);
+        LogPrintf("Rescanning %d blocks from height %d with %d keys and scripts\n", vpindex.size(), vpindex.front()->nHeight, filter.size());
         double dProgressStart = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false);
         double dProgressTip = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), chainActive.Tip(), false);
-        while (pindex)
+
+        CBlockRescanner rescanner(vpindex, filter, chainParams.GetConsensus(), GetNumCores());
+        CBlockRescanner::CRescanBlock result;
+        while (rescanner.Next(result))
         {
+            pindex = result.pindex;
             if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0)
                 ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
+            rescanProgress.Update(pindex->nHeight);
 
-            CBlock block;
-            ReadBlockFromDisk(block, pindex, Params().GetConsensus());
-            BOOST_FOREACH(CTransaction& tx, block.vtx)
+            const CBlock& block = *result.pblock;
+            for (size_t i = 0; i < block.vtx.size(); i++)
             {
-                if (AddToWalletIfInvolvingMe(tx, &block, fUpdate))
+                const CTransaction& tx = block.vtx[i];
+                // the filter does not know about our txes, neither the ones we
+                // had nor the ones this rescan added in earlier blocks
+                bool fRelevant = result.vMatch[i] || mapWallet.count(tx.GetHash());
+                for (size_t j = 0; !fRelevant && j < tx.vin.size(); j++)
+                    fRelevant = mapWallet.count(tx.vin[j].prevout.hash) || mapTxSpends.count(tx.vin[j].prevout);
+                if (fRelevant && AddToWalletIfInvolvingMe(tx, &block, fUpdate))
                     ret++;
             }
-            pindex = chainActive.Next(pindex);
             if (GetTime() >= nNow + 60) {
                 nNow = GetTime();
                 LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex));
@@ -1863,6 +2110,25 @@ CAmount CWalletTx::GetImmatureCredit(bool fUseCache) const
     return 0;
 }
 
+void CWalletTx::MarkDirty()
+{
+    fCreditCached = false;
+    fAvailableCreditCached = false;
+    fImmatureCreditCached = false;
+    fAnonymizedCreditCached = false;
+    fDenomUnconfCreditCached = false;
+    fDenomConfCreditCached = false;
+    fWatchDebitCached = false;
+    fWatchCreditCached = false;
+    fAvailableWatchCreditCached = false;
+    fImmatureWatchCreditCached = false;
+    fDebitCached = false;
+    fChangeCached = false;
+
+    if (pwallet)
+        pwallet->MarkBalanceDirty(GetHash());
+}
+
 CAmount CWalletTx::GetAvailableCredit(bool fUseCache) const
 {
     if (pwallet == 0)
@@ -2131,20 +2397,107 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime)
  */
 
 
-CAmount CWallet::GetBalance() const
+void CWallet::MarkBalanceDirty(const uint256& hash) const
 {
-    CAmount nTotal = 0;
+    LOCK(cs_wallet);
+    setBalanceDirty.insert(hash);
+}
+
+CWalletBalance CWallet::GetTxBalance(const CWalletTx& wtx, bool fUseCache) const
+{
+    CWalletBalance balance;
+    if (wtx.IsTrusted()) {
+        balance.nTrusted = wtx.GetAvailableCredit(fUseCache);
+        balance.nWatchOnlyTrusted = wtx.GetAvailableWatchOnlyCredit(fUseCache);
+    } else if (wtx.GetDepthInMainChain() == 0 && wtx.InMempool()) {
+        balance.nUntrustedPending = wtx.GetAvailableCredit(fUseCache);
+        balance.nWatchOnlyUntrustedPending = wtx.GetAvailableWatchOnlyCredit(fUseCache);
+    }
+    balance.nImmature = wtx.GetImmatureCredit(fUseCache);
+    balance.nWatchOnlyImmature = wtx.GetImmatureWatchOnlyCredit(fUseCache);
+    return balance;
+}
+
+CWalletBalance CWallet::GetBalancesFullRecount() const
+{
+    AssertLockHeld(cs_wallet);
+
+    CWalletBalance balance;
+    for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+        balance += GetTxBalance(it->second, false);
+    return balance;
+}
+
+CWalletBalance CWallet::GetBalances() const
+{
+    CWalletBalance balance;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableCredit();
+
+        // A coinbase is immature again if the tip went back, e.g. by invalidateblock, without
+        // disconnecting its block, there is no wallet event for this
+        if (chainActive.Height() < nBalanceSettledHeight) {
+            for (std::map<uint256, CWalletBalance>::const_iterator itSettled = mapBalanceSettled.begin(); itSettled != mapBalanceSettled.end(); ++itSettled) {
+                std::map<uint256, CWalletTx>::const_iterator itTx = mapWallet.find(itSettled->first);
+                if (itTx != mapWallet.end() && itTx->second.IsCoinBase())
+                    setBalanceDirty.insert(itSettled->first);
+            }
+        }
+        nBalanceSettledHeight = chainActive.Height();
+
+        // take the txes which changed out of the running totals, they are recounted below
+        BOOST_FOREACH(const uint256& hash, setBalanceDirty) {
+            std::map<uint256, CWalletBalance>::iterator itSettled = mapBalanceSettled.find(hash);
+            if (itSettled != mapBalanceSettled.end()) {
+                balanceSettled -= itSettled->second;
+                mapBalanceSettled.erase(itSettled);
+            }
+            if (mapWallet.count(hash))
+                setBalanceUnsettled.insert(hash);
+        }
+        setBalanceDirty.clear();
+
+        balance = balanceSettled;
+        std::set<uint256>::iterator it = setBalanceUnsettled.begin();
+        while (it != setBalanceUnsettled.end()) {
+            const CWalletTx& wtx = mapWallet.find(*it)->second;
+            CWalletBalance balanceTx = GetTxBalance(wtx);
+            balance += balanceTx;
+            // confirmed and mature, only a wallet event (incl. a reorg) can change it now
+            if (wtx.GetDepthInMainChain(false) > 0 && wtx.GetBlocksToMaturity() == 0) {
+                balanceSettled += balanceTx;
+                // most old txes are fully spent, no need to remember them, but a coinbase
+                // has to be found again if it becomes immature
+                if (!balanceTx.IsNull() || wtx.IsCoinBase())
+                    mapBalanceSettled[*it] = balanceTx;
+                setBalanceUnsettled.erase(it++);
+            } else {
+                ++it;
+            }
+        }
+
+        if (fCheckWalletBalances) {
+            CWalletBalance balanceRecount = GetBalancesFullRecount();
+            if (!(balance == balanceRecount)) {
+                LogPrintf("CWallet::GetBalances -- ERROR: cached balances %s do not match the recount %s\n",
+                          balance.ToString(), balanceRecount.ToString());
+                // start over from scratch
+                balanceSettled = CWalletBalance();
+                mapBalanceSettled.clear();
+                setBalanceUnsettled.clear();
+                for (map<uint256, CWalletTx>::const_iterator itTx = mapWallet.begin(); itTx != mapWallet.end(); ++itTx)
+                    setBalanceDirty.insert(itTx->first);
+                balance = balanceRecount;
+            }
         }
     }
 
-    return nTotal;
+    return balance;
+}
+
+CAmount CWallet::GetBalance() const
+{
+    return GetBalances().nTrusted;
 }
 
 CAmount CWallet::GetAnonymizableBalance() const
@@ -2295,76 +2648,82 @@ CAmount CWallet::GetDenominatedBalance(bool unconfirmed) const
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nUntrustedPending;
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nImmature;
 }
 
 CAmount CWallet::GetWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalances().nWatchOnlyTrusted;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nWatchOnlyUntrustedPending;
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
+    return GetBalances().nWatchOnlyImmature;
+}
+
+bool CWallet::IsCoinTxAvailable(const CWalletTx* pcoin, bool fOnlyConfirmed, bool fUseInstantSend, int& nDepthRet) const
+{
+    if (!CheckFinalTx(*pcoin))
+        return false;
+
+    if (fOnlyConfirmed && !pcoin->IsTrusted())
+        return false;
+
+    if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
+        return false;
+
+    nDepthRet = pcoin->GetDepthInMainChain(false);
+    // do not use IX for inputs that have less then INSTANTSEND_CONFIRMATIONS_REQUIRED blockchain confirmations
+    if (fUseInstantSend && nDepthRet < INSTANTSEND_CONFIRMATIONS_REQUIRED)
+        return false;
+
+    // We should not consider coins which aren't at least in our mempool
+    // It's possible for these to be conflicted via ancestors which we may never be able to detect
+    if (nDepthRet == 0 && !pcoin->InMempool())
+        return false;
+
+    return true;
+}
+
+void CWallet::AvailableCoinsOutput(vector<COutput>& vCoins, const CWalletTx* pcoin, unsigned int i, int nDepth, isminetype mine, const CCoinControl *coinControl, bool fIncludeZeroValue, AvailableCoinsType nCoinType) const
+{
+    const uint256& wtxid = pcoin->GetHash();
+
+    bool found = false;
+    if(nCoinType == ONLY_DENOMINATED) {
+        found = IsDenominatedAmount(pcoin->vout[i].nValue);
+    } else if(nCoinType == ONLY_NOT1000IFMN) {
+        found = !(fMasterNode && pcoin->vout[i].nValue == 1000*COIN);
+    } else if(nCoinType == ONLY_NONDENOMINATED_NOT1000IFMN) {
+        if (IsCollateralAmount(pcoin->vout[i].nValue)) return; // do not use collateral amounts
+        found = !IsDenominatedAmount(pcoin->vout[i].nValue);
+        if(found && fMasterNode) found = pcoin->vout[i].nValue != 1000*COIN; // do not use Hot MN funds
+    } else if(nCoinType == ONLY_1000) {
+        found = pcoin->vout[i].nValue == 1000*COIN;
+    } else if(nCoinType == ONLY_PRIVATESEND_COLLATERAL) {
+        found = IsCollateralAmount(pcoin->vout[i].nValue);
+    } else {
+        found = true;
     }
-    return nTotal;
+    if(!found) return;
+
+    if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
+        (!IsLockedCoin(wtxid, i) || nCoinType == ONLY_1000) &&
+        (pcoin->vout[i].nValue > 0 || fIncludeZeroValue) &&
+        (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected(wtxid, i)))
+            vCoins.push_back(COutput(pcoin, i, nDepth,
+                                     ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
+                                      (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO)));
 }
 
 void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const CCoinControl *coinControl, bool fIncludeZeroValue, AvailableCoinsType nCoinType, bool fUseInstantSend) const
@@ -2373,60 +2732,90 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
 
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const uint256& wtxid = it->first;
-            const CWalletTx* pcoin = &(*it).second;
+        IndexCoinsByAmount();
+
+        // look up only the amounts the coin type can use, e.g. PrivateSend needs just a few of them
+        std::vector<CAmount> vecAmounts;
+        if (nCoinType == ONLY_DENOMINATED) {
+            vecAmounts = vecPrivateSendDenominations;
+        } else if (nCoinType == ONLY_PRIVATESEND_COLLATERAL) {
+            for (int i = 2; i <= 4; i++)
+                vecAmounts.push_back(PRIVATESEND_COLLATERAL * i);
+        } else if (nCoinType == ONLY_1000) {
+            vecAmounts.push_back(1000*COIN);
+        } else {
+            for (std::map<CAmount, std::map<COutPoint, isminetype> >::const_iterator itBucket = mapCoinsByAmount.begin(); itBucket != mapCoinsByAmount.end(); ++itBucket)
+                vecAmounts.push_back(itBucket->first);
+        }
 
-            if (!CheckFinalTx(*pcoin))
+        // whether the outputs of a tx can be used and at which depth, txes usually have several outputs
+        std::map<const CWalletTx*, std::pair<bool, int> > mapTxAvailable;
+        BOOST_FOREACH(CAmount nAmount, vecAmounts) {
+            std::map<CAmount, std::map<COutPoint, isminetype> >::const_iterator itBucket = mapCoinsByAmount.find(nAmount);
+            if (itBucket == mapCoinsByAmount.end())
                 continue;
+            for (std::map<COutPoint, isminetype>::const_iterator it = itBucket->second.begin(); it != itBucket->second.end(); ++it) {
+                const CWalletTx* pcoin = &mapWallet.find(it->first.hash)->second;
+                std::map<const CWalletTx*, std::pair<bool, int> >::iterator itTx = mapTxAvailable.find(pcoin);
+                if (itTx == mapTxAvailable.end()) {
+                    int nDepth = 0;
+                    bool fAvailable = IsCoinTxAvailable(pcoin, fOnlyConfirmed, fUseInstantSend, nDepth);
+                    itTx = mapTxAvailable.insert(std::make_pair(pcoin, std::make_pair(fAvailable, nDepth))).first;
+                }
+                if (!itTx->second.first)
+                    continue;
+                AvailableCoinsOutput(vCoins, pcoin, it->first.n, itTx->second.second, it->second, coinControl, fIncludeZeroValue, nCoinType);
+            }
+        }
+    }
+}
 
-            if (fOnlyConfirmed && !pcoin->IsTrusted())
-                continue;
+void CWallet::IndexCoinsByAmount() const
+{
+    AssertLockHeld(cs_wallet);
+    if (fCoinsByAmountIndexed)
+        return;
 
-            if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0)
-                continue;
+    mapCoinsByAmount.clear();
+    fCoinsByAmountIndexed = true;
+    for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+        for (unsigned int i = 0; i < it->second.vout.size(); i++)
+            IndexCoin(COutPoint(it->first, i));
+}
 
-            int nDepth = pcoin->GetDepthInMainChain(false);
-            // do not use IX for inputs that have less then INSTANTSEND_CONFIRMATIONS_REQUIRED blockchain confirmations
-            if (fUseInstantSend && nDepth < INSTANTSEND_CONFIRMATIONS_REQUIRED)
-                continue;
+void CWallet::IndexCoin(const COutPoint& outpoint) const
+{
+    if (!fCoinsByAmountIndexed)
+        return;
 
-            // We should not consider coins which aren't at least in our mempool
-            // It's possible for these to be conflicted via ancestors which we may never be able to detect
-            if (nDepth == 0 && !pcoin->InMempool())
-                continue;
+    map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+    if (it == mapWallet.end() || outpoint.n >= it->second.vout.size())
+        return;
 
-            for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
-                bool found = false;
-                if(nCoinType == ONLY_DENOMINATED) {
-                    found = IsDenominatedAmount(pcoin->vout[i].nValue);
-                } else if(nCoinType == ONLY_NOT1000IFMN) {
-                    found = !(fMasterNode && pcoin->vout[i].nValue == 1000*COIN);
-                } else if(nCoinType == ONLY_NONDENOMINATED_NOT1000IFMN) {
-                    if (IsCollateralAmount(pcoin->vout[i].nValue)) continue; // do not use collateral amounts
-                    found = !IsDenominatedAmount(pcoin->vout[i].nValue);
-                    if(found && fMasterNode) found = pcoin->vout[i].nValue != 1000*COIN; // do not use Hot MN funds
-                } else if(nCoinType == ONLY_1000) {
-                    found = pcoin->vout[i].nValue == 1000*COIN;
-                } else if(nCoinType == ONLY_PRIVATESEND_COLLATERAL) {
-                    found = IsCollateralAmount(pcoin->vout[i].nValue);
-                } else {
-                    found = true;
-                }
-                if(!found) continue;
-
-                isminetype mine = IsMine(pcoin->vout[i]);
-                if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO &&
-                    (!IsLockedCoin((*it).first, i) || nCoinType == ONLY_1000) &&
-                    (pcoin->vout[i].nValue > 0 || fIncludeZeroValue) &&
-                    (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected((*it).first, i)))
-                        vCoins.push_back(COutput(pcoin, i, nDepth,
-                                                 ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
-                                                  (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO)));
-            }
-        }
-    }
+    const CTxOut& txout = it->second.vout[outpoint.n];
+    isminetype mine = IsMine(txout);
+    if (mine != ISMINE_NO && !IsSpent(outpoint.hash, outpoint.n))
+        mapCoinsByAmount[txout.nValue][outpoint] = mine;
+}
+
+void CWallet::UnindexCoinIfSpent(const COutPoint& outpoint) const
+{
+    if (!fCoinsByAmountIndexed)
+        return;
+
+    map<uint256, CWalletTx>::const_iterator it = mapWallet.find(outpoint.hash);
+    if (it == mapWallet.end() || outpoint.n >= it->second.vout.size())
+        return;
+
+    if (!IsSpent(outpoint.hash, outpoint.n))
+        return;
+
+    std::map<CAmount, std::map<COutPoint, isminetype> >::iterator itBucket = mapCoinsByAmount.find(it->second.vout[outpoint.n].nValue);
+    if (itBucket == mapCoinsByAmount.end())
+        return;
+    itBucket->second.erase(outpoint);
+    if (itBucket->second.empty())
+        mapCoinsByAmount.erase(itBucket);
 }
 
 static void ApproximateBestSubset(vector<pair<CAmount, pair<const CWalletTx*,unsigned int> > >vValue, const CAmount& nTotalLower, const CAmount& nTargetValue,
@@ -2624,12 +3013,11 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, int nConfMine, int
     return true;
 }
 
-bool CWallet::SelectCoins(const CAmount& nTargetValue, set<pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet, const CCoinControl* coinControl, AvailableCoinsType nCoinType, bool fUseInstantSend) const
+bool CWallet::SelectCoins(const vector<COutput>& vAvailableCoins, const CAmount& nTargetValue, set<pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet, const CCoinControl* coinControl, AvailableCoinsType nCoinType) const
 {
     // Note: this function should never be used for "always free" tx types like dstx
 
-    vector<COutput> vCoins;
-    AvailableCoins(vCoins, true, coinControl, false, nCoinType, fUseInstantSend);
+    vector<COutput> vCoins(vAvailableCoins);
 
     // coin control -> return all selected outputs (we want all selected to go into the transaction for sure)
     if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs)
@@ -2971,7 +3359,7 @@ bool CWallet::GetCollateralTxIn(CTxIn& txinRet, CAmount& nValueRet) const
 {
     vector<COutput> vCoins;
 
-    AvailableCoins(vCoins);
+    AvailableCoins(vCoins, true, NULL, false, ONLY_PRIVATESEND_COLLATERAL);
 
     BOOST_FOREACH(const COutput& out, vCoins)
     {
@@ -3049,23 +3437,21 @@ int CWallet::CountInputsWithAmount(CAmount nInputAmount)
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted()){
-                int nDepth = pcoin->GetDepthInMainChain(false);
+        if(!IsDenominatedAmount(nInputAmount)) return 0;
 
-                for (unsigned int i = 0; i < pcoin->vout.size(); i++) {
-                    COutput out = COutput(pcoin, i, nDepth, true);
-                    CTxIn txin = CTxIn(out.tx->GetHash(), out.i);
+        IndexCoinsByAmount();
+        std::map<CAmount, std::map<COutPoint, isminetype> >::const_iterator itBucket = mapCoinsByAmount.find(nInputAmount);
+        if (itBucket == mapCoinsByAmount.end()) return 0;
 
-                    if(out.tx->vout[out.i].nValue != nInputAmount) continue;
-                    if(!IsDenominatedAmount(pcoin->vout[i].nValue)) continue;
-                    if(IsSpent(out.tx->GetHash(), i) || IsMine(pcoin->vout[i]) != ISMINE_SPENDABLE || !IsDenominated(txin)) continue;
+        for (std::map<COutPoint, isminetype>::const_iterator it = itBucket->second.begin(); it != itBucket->second.end(); ++it) {
+            const COutPoint& outpoint = it->first;
+            const CWalletTx* pcoin = &mapWallet.find(outpoint.hash)->second;
+            if (!pcoin->IsTrusted()) continue;
 
-                    nTotal++;
-                }
-            }
+            CTxIn txin = CTxIn(outpoint);
+            if(IsSpent(outpoint.hash, outpoint.n) || it->second != ISMINE_SPENDABLE || !IsDenominated(txin)) continue;
+
+            nTotal++;
         }
     }
 
@@ -3238,6 +3624,10 @@ bool CWallet::CreateTransaction(const vector<CRecipient>& vecSend, CWalletTx& wt
     {
         LOCK2(cs_main, cs_wallet);
         {
+            // the wallet can't change while we hold cs_wallet, no need to look for coins again for every fee
+            vector<COutput> vAvailableCoins;
+            AvailableCoins(vAvailableCoins, true, coinControl, false, nCoinType, fUseInstantSend);
+
             nFeeRet = 0;
             if(nFeePay > 0) nFeeRet = nFeePay;
             // Start with no fee and loop until there is enough fee
@@ -3289,7 +3679,7 @@ bool CWallet::CreateTransaction(const vector<CRecipient>& vecSend, CWalletTx& wt
                 set<pair<const CWalletTx*,unsigned int> > setCoins;
                 CAmount nValueIn = 0;
 
-                if (!SelectCoins(nValueToSelect, setCoins, nValueIn, coinControl, nCoinType, fUseInstantSend))
+                if (!SelectCoins(vAvailableCoins, nValueToSelect, setCoins, nValueIn, coinControl, nCoinType))
                 {
                     if (nCoinType == ONLY_NOT1000IFMN) {
                         strFailReason = _("Unable to locate enough funds for this transaction that are not equal 1000 3DC.");
@@ -3801,35 +4191,83 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
         } else {
             nTargetSize *= 2;
         }
-        bool fInternal = false;
         CWalletDB walletdb(strWalletFile);
-        for (int64_t i = missingInternal + missingExternal; i--;)
+        // Write all new keys, the chain and the pool entries in a single db transaction.
+        // The keystore writes of GenerateNewKeys() go through pwalletdbEncryption.
+        bool fBatch = fFileBacked && missingExternal + missingInternal > 0 && !pwalletdbEncryption && walletdb.TxnBegin();
+        if (fBatch)
+            pwalletdbEncryption = &walletdb;
+
+        // The pools only get the new entries once they are stored, everything
+        // else the batch changed in memory is undone if it fails.
+        std::vector<CPubKey> vPubKeys;
+        std::vector<std::pair<int64_t, bool> > vPoolEntries;
+        CHDChain hdChainOld;
+        bool fHDChain = GetHDChain(hdChainOld);
+        int64_t nTimeFirstKeyOld = nTimeFirstKey;
+        int nWalletVersionOld = nWalletVersion;
+
+        int64_t nEnd = 1;
+        if (!setInternalKeyPool.empty()) {
+            nEnd = *(--setInternalKeyPool.end()) + 1;
+        }
+        if (!setExternalKeyPool.empty()) {
+            nEnd = std::max(nEnd, *(--setExternalKeyPool.end()) + 1);
+        }
+        try {
+            for (int nPool = 0; nPool < 2; nPool++)
+            {
+                bool fInternal = nPool == 1;
+                int64_t nMissing = fInternal ? missingInternal : missingExternal;
+                if (nMissing == 0)
+                    continue;
 
-        {
-            int64_t nEnd = 1;
-           if (i < missingInternal) {
-                fInternal = true;
+                size_t nFirst = vPubKeys.size();
+                // TODO: implement keypools for all accounts?
+                GenerateNewKeys(nMissing, 0, fInternal, vPubKeys);
+
+                for (size_t i = nFirst; i < vPubKeys.size(); i++, nEnd++)
+                {
+                    if (fFileBacked && !walletdb.WritePool(nEnd, CKeyPool(vPubKeys[i], fInternal)))
+                        throw runtime_error("TopUpKeyPool(): writing generated key failed");
+                    vPoolEntries.push_back(std::make_pair(nEnd, fInternal));
+                }
+                LogPrintf("keypool added %d keys, last key %d, size=%u, internal=%d\n", vPubKeys.size() - nFirst, nEnd - 1, setInternalKeyPool.size() + setExternalKeyPool.size() + vPoolEntries.size(), fInternal);
+
+                double dProgress = 100.f * (nEnd - 1) / (nTargetSize + 1);
+                std::string strMsg = strprintf(_("Loading wallet... (%3.2f %%)"), dProgress);
+                uiInterface.InitMessage(strMsg);
             }
-            if (!setInternalKeyPool.empty()) {
-                nEnd = *(--setInternalKeyPool.end()) + 1;
+            if (fBatch) {
+                pwalletdbEncryption = NULL;
+                fBatch = false;
+                if (!walletdb.TxnCommit())
+                    throw runtime_error("TopUpKeyPool(): committing generated keys failed");
             }
-            if (!setExternalKeyPool.empty()) {
-                nEnd = std::max(nEnd, *(--setExternalKeyPool.end()) + 1);
+        } catch (...) {
+            if (fBatch) {
+                pwalletdbEncryption = NULL;
+                walletdb.TxnAbort();
             }
-            // TODO: implement keypools for all accounts?
-            if (!walletdb.WritePool(nEnd, CKeyPool(GenerateNewKey(0, fInternal), fInternal)))
-                throw runtime_error("TopUpKeyPool(): writing generated key failed");
+            RemoveNewKeys(vPubKeys);
+            if (fHDChain) {
+                if (IsCrypted())
+                    CCryptoKeyStore::SetCryptedHDChain(hdChainOld);
+                else
+                    CCryptoKeyStore::SetHDChain(hdChainOld);
+            }
+            nTimeFirstKey = nTimeFirstKeyOld;
+            nWalletVersion = nWalletVersionOld;
+            throw;
+        }
 
-            if (fInternal) {
-                setInternalKeyPool.insert(nEnd);
+        for (size_t i = 0; i < vPoolEntries.size(); i++)
+        {
+            if (vPoolEntries[i].second) {
+                setInternalKeyPool.insert(vPoolEntries[i].first);
             } else {
-                setExternalKeyPool.insert(nEnd);
+                setExternalKeyPool.insert(vPoolEntries[i].first);
             }
-            LogPrintf("keypool added key %d, size=%u, internal=%d\n", nEnd, setInternalKeyPool.size() + setExternalKeyPool.size(), fInternal);
-
-            double dProgress = 100.f * nEnd / (nTargetSize + 1);
-            std::string strMsg = strprintf(_("Loading wallet... (%3.2f %%)"), dProgress);
-            uiInterface.InitMessage(strMsg);
         }
     }
     return true;
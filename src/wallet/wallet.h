@@ -16,6 +16,7 @@
 #include "utilstrencodings.h"
 #include "validationinterface.h"
 #include "wallet/crypter.h"
+#include "wallet/rescan.h"
 #include "wallet/wallet_ismine.h"
 #include "wallet/walletdb.h"
 
@@ -38,6 +39,7 @@ extern CAmount maxTxFee;
 extern unsigned int nTxConfirmTarget;
 extern bool bSpendZeroConfChange;
 extern bool fSendFreeTransactions;
+extern bool fCheckWalletBalances;
 
 extern bool fLargeWorkForkFound;
 extern bool fLargeWorkInvalidChainFound;
@@ -105,6 +107,65 @@ enum AvailableCoinsType
     ONLY_PRIVATESEND_COLLATERAL = 6
 };
 
+/** Wallet balances, or the part of them a single wallet transaction accounts for */
+struct CWalletBalance
+{
+    CAmount nTrusted;           //! GetBalance()
+    CAmount nUntrustedPending;  //! GetUnconfirmedBalance()
+    CAmount nImmature;          //! GetImmatureBalance()
+    CAmount nWatchOnlyTrusted;
+    CAmount nWatchOnlyUntrustedPending;
+    CAmount nWatchOnlyImmature;
+
+    CWalletBalance() :
+        nTrusted(0),
+        nUntrustedPending(0),
+        nImmature(0),
+        nWatchOnlyTrusted(0),
+        nWatchOnlyUntrustedPending(0),
+        nWatchOnlyImmature(0)
+        {}
+
+    CWalletBalance& operator+=(const CWalletBalance& b)
+    {
+        nTrusted += b.nTrusted;
+        nUntrustedPending += b.nUntrustedPending;
+        nImmature += b.nImmature;
+        nWatchOnlyTrusted += b.nWatchOnlyTrusted;
+        nWatchOnlyUntrustedPending += b.nWatchOnlyUntrustedPending;
+        nWatchOnlyImmature += b.nWatchOnlyImmature;
+        return *this;
+    }
+
+    CWalletBalance& operator-=(const CWalletBalance& b)
+    {
+        nTrusted -= b.nTrusted;
+        nUntrustedPending -= b.nUntrustedPending;
+        nImmature -= b.nImmature;
+        nWatchOnlyTrusted -= b.nWatchOnlyTrusted;
+        nWatchOnlyUntrustedPending -= b.nWatchOnlyUntrustedPending;
+        nWatchOnlyImmature -= b.nWatchOnlyImmature;
+        return *this;
+    }
+
+    bool IsNull() const
+    {
+        return *this == CWalletBalance();
+    }
+
+    friend bool operator==(const CWalletBalance& a, const CWalletBalance& b)
+    {
+        return a.nTrusted == b.nTrusted &&
+               a.nUntrustedPending == b.nUntrustedPending &&
+               a.nImmature == b.nImmature &&
+               a.nWatchOnlyTrusted == b.nWatchOnlyTrusted &&
+               a.nWatchOnlyUntrustedPending == b.nWatchOnlyUntrustedPending &&
+               a.nWatchOnlyImmature == b.nWatchOnlyImmature;
+    }
+
+    std::string ToString() const;
+};
+
 struct CompactTallyItem
 {
     CBitcoinAddress address;
@@ -413,21 +474,8 @@ public:
     }
 
     //! make sure balances are recalculated
-    void MarkDirty()
-    {
-        fCreditCached = false;
-        fAvailableCreditCached = false;
-        fImmatureCreditCached = false;
-        fAnonymizedCreditCached = false;
-        fDenomUnconfCreditCached = false;
-        fDenomConfCreditCached = false;
-        fWatchDebitCached = false;
-        fWatchCreditCached = false;
-        fAvailableWatchCreditCached = false;
-        fImmatureWatchCreditCached = false;
-        fDebitCached = false;
-        fChangeCached = false;
-    }
+    //! Reset the cached credits and debits and have the wallet balances recount this tx
+    void MarkDirty();
 
     void BindWallet(CWallet *pwalletIn)
     {
@@ -618,8 +666,9 @@ private:
      * all coins from coinControl are selected; Never select unconfirmed coins
      * if they are not ours
      */
-    bool SelectCoins(const CAmount& nTargetValue, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet, const CCoinControl *coinControl = NULL, AvailableCoinsType nCoinType=ALL_COINS, bool fUseInstantSend = true) const;
+    bool SelectCoins(const std::vector<COutput>& vAvailableCoins, const CAmount& nTargetValue, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet, const CCoinControl *coinControl = NULL, AvailableCoinsType nCoinType=ALL_COINS) const;
 
+    //! Set while the wallet is encrypted or the keypool refilled, keystore writes go through its db transaction
     CWalletDB *pwalletdbEncryption;
 
     //! the current wallet version: clients below this version are not able to load the wallet
@@ -637,6 +686,47 @@ private:
     mutable bool fAnonymizableTallyCachedNonDenom;
     mutable std::vector<CompactTallyItem> vecAnonymizableTallyCachedNonDenom;
 
+    /**
+     * PrivateSend rounds of wallet outpoints (see GetRealInputPrivateSendRounds).
+     * Every entry is persisted with the generation of the cache, which is bumped
+     * in the wallet right away when the cache is cleared, so entries written
+     * before are dropped on load. New entries are written by SetBestChain.
+     */
+    mutable std::map<COutPoint, int8_t> mapPrivateSendRoundsCache;
+    mutable std::set<COutPoint> setPrivateSendRoundsDirty;
+    int64_t nPrivateSendRoundsGeneration;
+
+    /**
+     * Our wallet outputs by amount with their IsMine() type, without the ones known
+     * to be spent. Built on first use (keys are not known yet while txes are loaded)
+     * and kept up to date as txes are added, spent, abandoned or conflicted, dropped
+     * when keys or scripts are imported. A reorg can make indexed outputs spent
+     * again, so users must still check IsSpent().
+     */
+    mutable std::map<CAmount, std::map<COutPoint, isminetype> > mapCoinsByAmount;
+    mutable bool fCoinsByAmountIndexed;
+    void IndexCoinsByAmount() const;
+    void IndexCoin(const COutPoint& outpoint) const;
+    void UnindexCoinIfSpent(const COutPoint& outpoint) const;
+
+    /**
+     * Running balance totals of the txes whose balances only change through wallet events
+     * (ones confirmed and mature), updated one tx at a time once the tx is marked dirty.
+     * All other txes, i.e. unconfirmed, conflicted and immature ones, are recounted on
+     * every call as their balances depend on the mempool and the chain tip. Settled
+     * coinbases are recounted when the tip height goes below nBalanceSettledHeight.
+     */
+    mutable CWalletBalance balanceSettled;
+    mutable std::map<uint256, CWalletBalance> mapBalanceSettled;
+    mutable int nBalanceSettledHeight;
+    mutable std::set<uint256> setBalanceUnsettled;
+    mutable std::set<uint256> setBalanceDirty;
+    CWalletBalance GetTxBalance(const CWalletTx& wtx, bool fUseCache = true) const;
+    CWalletBalance GetBalancesFullRecount() const;
+
+    bool IsCoinTxAvailable(const CWalletTx* pcoin, bool fOnlyConfirmed, bool fUseInstantSend, int& nDepthRet) const;
+    void AvailableCoinsOutput(std::vector<COutput>& vCoins, const CWalletTx* pcoin, unsigned int i, int nDepth, isminetype mine, const CCoinControl *coinControl, bool fIncludeZeroValue, AvailableCoinsType nCoinType) const;
+
     /**
      * Used to keep track of spent outpoints, and
      * detect and report conflicts (double-spends or
@@ -652,8 +742,13 @@ private:
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
-    /* HD derive new child key (on internal or external chain) */
-    void DeriveNewChildKey(const CKeyMetadata& metadata, CKey& secretRet, uint32_t nAccountIndex, bool fInternal /*= false*/);
+    /* Snapshot of the keys and scripts a rescan looks for */
+    void GetScriptFilter(CWalletScriptFilter& filter) const;
+
+    /* HD derive nCount new child keys (on internal or external chain) */
+    void DeriveNewChildKeys(const CKeyMetadata& metadata, unsigned int nCount, uint32_t nAccountIndex, bool fInternal, std::vector<CPubKey>& vPubKeysRet);
+    /* Forget keys generated by a keypool top up which wasn't written to the database */
+    void RemoveNewKeys(const std::vector<CPubKey>& vPubKeys);
 
 
 public:
@@ -669,6 +764,9 @@ public:
     bool fFileBacked;
     std::string strWalletFile;
 
+    /* Where a running ScanForWalletTransactions() is, has its own lock */
+    CWalletRescanProgress rescanProgress;
+
     void LoadKeyPool(int nIndex, const CKeyPool &keypool)
     {
         if (keypool.fInternal) {
@@ -728,6 +826,16 @@ public:
         fAnonymizableTallyCachedNonDenom = false;
         vecAnonymizableTallyCached.clear();
         vecAnonymizableTallyCachedNonDenom.clear();
+        mapPrivateSendRoundsCache.clear();
+        setPrivateSendRoundsDirty.clear();
+        nPrivateSendRoundsGeneration = 0;
+        mapCoinsByAmount.clear();
+        fCoinsByAmountIndexed = false;
+        balanceSettled = CWalletBalance();
+        mapBalanceSettled.clear();
+        nBalanceSettledHeight = -1;
+        setBalanceUnsettled.clear();
+        setBalanceDirty.clear();
     }
 
     std::map<uint256, CWalletTx> mapWallet;
@@ -788,6 +896,11 @@ public:
     // respect current settings
     int GetInputPrivateSendRounds(CTxIn txin) const;
 
+    //! Adds the PrivateSend rounds cache read from the database to the wallet
+    void LoadPrivateSendRoundsCache(int64_t nGeneration, const std::map<COutPoint, int8_t>& mapRounds);
+    //! Forget all PrivateSend rounds, they will be calculated again when needed
+    void ClearPrivateSendRoundsCache(CWalletDB* pwalletdb = NULL);
+
     bool IsDenominated(const CTxIn &txin) const;
     bool IsDenominatedAmount(CAmount nInputAmount) const;
 
@@ -804,6 +917,8 @@ public:
      * Generate a new key
      */
     CPubKey GenerateNewKey(uint32_t nAccountIndex, bool fInternal /*= false*/);
+    //! Generates (or derives) nCount keys at once on a few threads, used to refill the keypool
+    void GenerateNewKeys(unsigned int nCount, uint32_t nAccountIndex, bool fInternal, std::vector<CPubKey>& vPubKeysRet);
     //! HaveKey implementation that also checks the mapHdPubKeys
     bool HaveKey(const CKeyID &address) const;
     //! GetPubKey implementation that also checks the mapHdPubKeys
@@ -859,12 +974,17 @@ public:
 
     void MarkDirty();
     bool AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletDB* pwalletdb);
+    //! Adds all txes read by LoadWallet() at once and empties lWtx, see CWalletTxLoader
+    void LoadWalletTxes(std::list<CWalletTx>& lWtx);
     void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate);
     int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
     void ReacceptWalletTransactions();
     void ResendWalletTransactions(int64_t nBestBlockTime);
     std::vector<uint256> ResendWalletTransactionsBefore(int64_t nTime);
+    /** Have GetBalances() recount the balances of the tx, see CWalletTx::MarkDirty */
+    void MarkBalanceDirty(const uint256& hash) const;
+    CWalletBalance GetBalances() const;
     CAmount GetBalance() const;
     CAmount GetUnconfirmedBalance() const;
     CAmount GetImmatureBalance() const;
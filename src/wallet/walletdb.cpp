@@ -14,6 +14,7 @@
 #include "sync.h"
 #include "util.h"
 #include "utiltime.h"
+#include "wallet/txloader.h"
 #include "wallet/wallet.h"
 
 #include <boost/filesystem.hpp>
@@ -148,6 +149,24 @@ bool CWalletDB::WriteOrderPosNext(int64_t nOrderPosNext)
     return Write(std::string("orderposnext"), nOrderPosNext);
 }
 
+bool CWalletDB::WritePrivateSendRoundsGeneration(int64_t nGeneration)
+{
+    nWalletDBUpdated++;
+    return Write(std::string("psroundsgen"), nGeneration);
+}
+
+bool CWalletDB::WritePrivateSendRounds(const COutPoint& outpoint, int64_t nGeneration, int8_t nRounds)
+{
+    nWalletDBUpdated++;
+    return Write(std::make_pair(std::string("psround"), outpoint), std::make_pair(nGeneration, nRounds));
+}
+
+bool CWalletDB::ErasePrivateSendRounds(const COutPoint& outpoint)
+{
+    nWalletDBUpdated++;
+    return Erase(std::make_pair(std::string("psround"), outpoint));
+}
+
 bool CWalletDB::WriteDefaultKey(const CPubKey& vchPubKey)
 {
     nWalletDBUpdated++;
@@ -337,12 +356,15 @@ public:
     bool fAnyUnordered;
     int nFileVersion;
     vector<uint256> vWalletUpgrade;
+    int64_t nPrivateSendRoundsGeneration;
+    map<COutPoint, pair<int64_t, int8_t> > mapPrivateSendRounds;
 
     CWalletScanState() {
         nKeys = nCKeys = nKeyMeta = 0;
         fIsEncrypted = false;
         fAnyUnordered = false;
         nFileVersion = 0;
+        nPrivateSendRoundsGeneration = 0;
     }
 };
 
@@ -369,33 +391,12 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
         }
         else if (strType == "tx")
         {
-            uint256 hash;
-            ssKey >> hash;
             CWalletTx wtx;
-            ssValue >> wtx;
-            CValidationState state;
-            if (!(CheckTransaction(wtx, state) && (wtx.GetHash() == hash) && state.IsValid()))
+            bool fUpgraded = false;
+            if (!ReadWalletTxRecord(ssKey, ssValue, wtx, fUpgraded, strErr))
                 return false;
-
-            // Undo serialize changes in 31600
-            if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
-            {
-                if (!ssValue.empty())
-                {
-                    char fTmp;
-                    char fUnused;
-                    ssValue >> fTmp >> fUnused >> wtx.strFromAccount;
-                    strErr = strprintf("LoadWallet() upgrading tx ver=%d %d '%s' %s",
-                                       wtx.fTimeReceivedIsTxTime, fTmp, wtx.strFromAccount, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = fTmp;
-                }
-                else
-                {
-                    strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = 0;
-                }
-                wss.vWalletUpgrade.push_back(hash);
-            }
+            if (fUpgraded)
+                wss.vWalletUpgrade.push_back(wtx.GetHash());
 
             if (wtx.nOrderPos == -1)
                 wss.fAnyUnordered = true;
@@ -580,6 +581,17 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
         {
             ssValue >> pwallet->nOrderPosNext;
         }
+        else if (strType == "psroundsgen")
+        {
+            ssValue >> wss.nPrivateSendRoundsGeneration;
+        }
+        else if (strType == "psround")
+        {
+            // the generation is not known yet, records are matched against it after the scan
+            COutPoint outpoint;
+            ssKey >> outpoint;
+            ssValue >> wss.mapPrivateSendRounds[outpoint];
+        }
         else if (strType == "destdata")
         {
             std::string strAddress, strKey, strValue;
@@ -639,6 +651,18 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
     return true;
 }
 
+static bool IsWalletTxRecord(const CDataStream& ssKey)
+{
+    try {
+        CDataStream ssType(ssKey);
+        string strType;
+        ssType >> strType;
+        return strType == "tx";
+    } catch (...) {
+        return false;
+    }
+}
+
 static bool IsKeyType(string strType)
 {
     return (strType== "key" || strType == "wkey" ||
@@ -671,6 +695,10 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
             return DB_CORRUPT;
         }
 
+        // Txes are deserialized and checked on the loader threads while the cursor goes on
+        CWalletTxLoader txLoader(GetNumCores());
+        int64_t nStart = GetTimeMillis();
+
         while (true)
         {
             // Read next record
@@ -685,6 +713,12 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
                 return DB_CORRUPT;
             }
 
+            if (IsWalletTxRecord(ssKey))
+            {
+                txLoader.Add(ssKey, ssValue);
+                continue;
+            }
+
             // Try to be tolerant of single corrupt records:
             string strType, strErr;
             if (!ReadKeyValue(pwallet, ssKey, ssValue, wss, strType, strErr))
@@ -707,6 +741,27 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
         }
         pcursor->close();
 
+        std::list<CWalletTx> lWtx;
+        std::vector<std::string> vErrors;
+        unsigned int nFailed;
+        txLoader.Finish(lWtx, wss.vWalletUpgrade, vErrors, nFailed);
+        BOOST_FOREACH(const std::string& strErr, vErrors)
+            LogPrintf("%s\n", strErr);
+        if (nFailed > 0)
+        {
+            // Rescan if there is a bad transaction record:
+            fNoncriticalErrors = true;
+            SoftSetBoolArg("-rescan", true);
+        }
+        BOOST_FOREACH(const CWalletTx& wtx, lWtx)
+        {
+            if (wtx.nOrderPos == -1)
+                wss.fAnyUnordered = true;
+        }
+        size_t nWtx = lWtx.size();
+        pwallet->LoadWalletTxes(lWtx);
+        LogPrintf("Loaded %u wallet txes in %dms\n", nWtx, GetTimeMillis() - nStart);
+
        // Store initial external keypool size since we mostly use external keys in mixing
         pwallet->nKeysLeftSinceAutoBackup = pwallet->KeypoolCountExternalKeys();
         LogPrintf("nKeysLeftSinceAutoBackup: %d\n", pwallet->nKeysLeftSinceAutoBackup);
@@ -738,6 +793,16 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
     BOOST_FOREACH(uint256 hash, wss.vWalletUpgrade)
         WriteTx(hash, pwallet->mapWallet[hash]);
 
+    // PrivateSend rounds written before the cache was last cleared are outdated
+    std::map<COutPoint, int8_t> mapRounds;
+    for (map<COutPoint, pair<int64_t, int8_t> >::const_iterator it = wss.mapPrivateSendRounds.begin(); it != wss.mapPrivateSendRounds.end(); ++it) {
+        if (it->second.first == wss.nPrivateSendRoundsGeneration)
+            mapRounds.insert(mapRounds.end(), std::make_pair(it->first, it->second.second));
+        else
+            ErasePrivateSendRounds(it->first);
+    }
+    pwallet->LoadPrivateSendRoundsCache(wss.nPrivateSendRoundsGeneration, mapRounds);
+
     // Rewrite encrypted wallets of versions 0.4.0 and 0.5.0rc:
     if (wss.fIsEncrypted && (wss.nFileVersion == 40000 || wss.nFileVersion == 50000))
         return DB_NEED_REWRITE;
@@ -24,6 +24,7 @@ class CAccountingEntry;
 struct CBlockLocator;
 class CKeyPool;
 class CMasterKey;
+class COutPoint;
 class CScript;
 class CWallet;
 class CWalletTx;
@@ -105,6 +106,10 @@ public:
 
     bool WriteOrderPosNext(int64_t nOrderPosNext);
 
+    bool WritePrivateSendRoundsGeneration(int64_t nGeneration);
+    bool WritePrivateSendRounds(const COutPoint& outpoint, int64_t nGeneration, int8_t nRounds);
+    bool ErasePrivateSendRounds(const COutPoint& outpoint);
+
     bool WriteDefaultKey(const CPubKey& vchPubKey);
 
     bool ReadPool(int64_t nPool, CKeyPool& keypool);
@@ -25,3 +25,8 @@ bool CZMQAbstractNotifier::NotifyTransactionLock(const CTransaction &/*transacti
 {
     return true;
 }
+
+bool CZMQAbstractNotifier::NotifyTransactionLockLatency(const uint256 &/*txHash*/, int64_t /*nRequestToLockMicros*/, int64_t /*nFirstVoteToLockMicros*/, int /*nVotes*/)
+{
+    return true;
+}
@@ -35,6 +35,7 @@ public:
     virtual bool NotifyBlock(const CBlockIndex *pindex);
     virtual bool NotifyTransaction(const CTransaction &transaction);
     virtual bool NotifyTransactionLock(const CTransaction &transaction);
+    virtual bool NotifyTransactionLockLatency(const uint256 &txHash, int64_t nRequestToLockMicros, int64_t nFirstVoteToLockMicros, int nVotes);
 
 protected:
     void *psocket;
@@ -27,6 +27,7 @@ protected:
     void SyncTransaction(const CTransaction &tx, const CBlock *pblock);
     void UpdatedBlockTip(const CBlockIndex *pindex);
     void NotifyTransactionLock(const CTransaction &tx);
+    void NotifyTransactionLockLatency(const uint256 &txHash, int64_t nRequestToLockMicros, int64_t nFirstVoteToLockMicros, int nVotes);
 
 private:
     CZMQNotificationInterface();
@@ -2,7 +2,9 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "blockreader.h"
 #include "chainparams.h"
+#include "crypto/common.h"
 #include "zmqpublishnotifier.h"
 #include "main.h"
 #include "util.h"
@@ -15,6 +17,7 @@ static const char *MSG_HASHTXLOCK = "hashtxlock";
 static const char *MSG_RAWBLOCK   = "rawblock";
 static const char *MSG_RAWTX      = "rawtx";
 static const char *MSG_RAWTXLOCK = "rawtxlock";
+static const char *MSG_TXLOCKLATENCY = "txlocklatency";
 
 // Internal function to send multipart message
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
@@ -176,18 +179,14 @@ bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
 {
     LogPrint("zmq", "zmq: Publish rawblock %s\n", pindex->GetBlockHash().GetHex());
 
-    const Consensus::Params& consensusParams = Params().GetConsensus();
     CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
     {
         LOCK(cs_main);
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex, consensusParams))
+        if(!blockreader.ReadRawBlock(ss, pindex->GetBlockPos(), Params().MessageStart()))
         {
             zmqError("Can't read block from disk");
             return false;
         }
-
-        ss << block;
     }
 
     return SendMessage(MSG_RAWBLOCK, &(*ss.begin()), ss.size());
@@ -210,3 +209,16 @@ bool CZMQPublishRawTransactionLockNotifier::NotifyTransactionLock(const CTransac
     ss << transaction;
     return SendMessage(MSG_RAWTXLOCK, &(*ss.begin()), ss.size());
 }
+
+bool CZMQPublishTransactionLockLatencyNotifier::NotifyTransactionLockLatency(const uint256 &txHash, int64_t nRequestToLockMicros, int64_t nFirstVoteToLockMicros, int nVotes)
+{
+    LogPrint("zmq", "zmq: Publish txlocklatency %s\n", txHash.GetHex());
+    // tx hash, then little endian request to lock and first vote to lock times in microseconds and vote count
+    unsigned char data[52];
+    for (unsigned int i = 0; i < 32; i++)
+        data[31 - i] = txHash.begin()[i];
+    WriteLE64(data + 32, (uint64_t)nRequestToLockMicros);
+    WriteLE64(data + 40, (uint64_t)nFirstVoteToLockMicros);
+    WriteLE32(data + 48, (uint32_t)nVotes);
+    return SendMessage(MSG_TXLOCKLATENCY, data, sizeof(data));
+}
@@ -64,4 +64,10 @@ public:
     bool NotifyTransactionLock(const CTransaction &transaction);
 };
 
+class CZMQPublishTransactionLockLatencyNotifier : public CZMQAbstractPublishNotifier
+{
+public:
+    bool NotifyTransactionLockLatency(const uint256 &txHash, int64_t nRequestToLockMicros, int64_t nFirstVoteToLockMicros, int nVotes);
+};
+
 #endif // BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H